@@ -16,10 +16,22 @@ BuildRequires: meson
 BuildRequires: gcc-c++
 BuildRequires: libwreport-devel
 BuildRequires: netcdf-cxx-devel
+BuildRequires: netcdf-devel >= 4.6.2
+BuildRequires: zlib-devel
+BuildRequires: xz-devel
+BuildRequires: libzstd-devel
 
 %description
 Tools to convert BUFR weather reports in NetCDF file format in DWD standard
 
+%package devel
+Summary: Library to convert BUFR weather reports to NetCDF in memory
+Requires: %{name}%{?_isa} = %{version}-%{release}
+
+%description devel
+Headers and development files for the bufr2netcdf library, which converts
+BUFR messages held in memory to NetCDF images or columns of values
+
 %prep
 %setup -q -n %{srcarchivename}
 
@@ -40,9 +52,17 @@ Tools to convert BUFR weather reports in NetCDF file format in DWD standard
 %files
 %defattr(-,root,root,-)
 %{_bindir}/bufr2netcdf
+%{_bindir}/bufr2netcdf-merge
+%{_libdir}/libbufr2netcdf.so.*
 %dir %{_datadir}/%{name}
 %{_datadir}/%{name}/*
 
+%files devel
+%defattr(-,root,root,-)
+%{_includedir}/%{name}
+%{_libdir}/libbufr2netcdf.so
+%{_libdir}/pkgconfig/%{name}.pc
+
 
 %changelog
 * Tue Sep 24 2024 Daniele Branchini <dbranchini@arpae.it> - 1.8-1%{?dist}
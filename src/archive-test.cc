@@ -0,0 +1,202 @@
+/*
+ * Copyright (C) 2026  ARPA-SIM <urpsim@smr.arpa.emr.it>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#include "archive.h"
+#include "input.h"
+#include "convert.h"
+#include "tests/tests.h"
+#include <wreport/bulletin.h>
+#include <wreport/utils/sys.h>
+#include <map>
+#include <cstring>
+
+#include "config.h"
+
+#ifdef HAVE_ZLIB
+#include <zlib.h>
+#endif
+
+using namespace b2nc;
+using namespace wreport;
+using namespace wreport::tests;
+using namespace std;
+
+namespace {
+
+/// Count the bulletins received, by file name
+struct CountingSink : public BufrSink
+{
+    map<string, unsigned> counts;
+    unsigned total = 0;
+
+    void add_bufr(std::unique_ptr<wreport::BufrBulletin>&& bulletin, const std::string&) override
+    {
+        ++counts[bulletin->fname];
+        ++total;
+    }
+};
+
+/// Append a ustar entry to \a out
+void add_tar_entry(string& out, const string& name, const string& data, char type='0')
+{
+    char header[512];
+    memset(header, 0, 512);
+    strncpy(header, name.c_str(), 99);
+    snprintf(header + 100, 8, "%07o", 0644);
+    snprintf(header + 124, 12, "%011zo", data.size());
+    header[156] = type;
+    memcpy(header + 257, "ustar\0" "00", 8);
+    memset(header + 148, ' ', 8);
+    unsigned sum = 0;
+    for (unsigned i = 0; i < 512; ++i)
+        sum += (unsigned char)header[i];
+    snprintf(header + 148, 8, "%06o", sum);
+    out.append(header, 512);
+    out += data;
+    out.append((512 - data.size() % 512) % 512, 0);
+}
+
+void put16(string& out, unsigned val)
+{
+    out += (char)(val & 0xff);
+    out += (char)((val >> 8) & 0xff);
+}
+
+void put32(string& out, unsigned val)
+{
+    put16(out, val & 0xffff);
+    put16(out, val >> 16);
+}
+
+/// Append a zip local file entry to \a out, with data already compressed
+void add_zip_entry(string& out, const string& name, const string& data, unsigned method, size_t usize, bool descriptor)
+{
+    put32(out, 0x04034b50);
+    put16(out, 20);
+    put16(out, descriptor ? 8 : 0);
+    put16(out, method);
+    put16(out, 0);
+    put16(out, 0);
+    put32(out, 0);
+    put32(out, descriptor ? 0 : data.size());
+    put32(out, descriptor ? 0 : usize);
+    put16(out, name.size());
+    put16(out, 0);
+    out += name;
+    out += data;
+    if (descriptor)
+    {
+        put32(out, 0x08074b50);
+        put32(out, 0);
+        put32(out, data.size());
+        put32(out, usize);
+    }
+}
+
+/// Split the acars test data in two halves at a message boundary
+pair<string, string> split_acars()
+{
+    string data = sys::read_file(b2nc::tests::datafile("bufr/cdfin_acars"));
+    size_t pos = data.find("BUFR", data.size() / 2);
+    return make_pair(data.substr(0, pos), data.substr(pos));
+}
+
+class Tests : public TestCase
+{
+    using TestCase::TestCase;
+
+    void register_tests() override
+    {
+        add_method("detect", []() {
+            wassert_true(detect_archive("BUFR") == ArchiveFormat::NONE);
+            wassert_true(detect_archive("PK\x03\x04") == ArchiveFormat::ZIP);
+            string tar;
+            add_tar_entry(tar, "test", "");
+            wassert_true(detect_archive(tar) == ArchiveFormat::TAR);
+        });
+
+        add_method("tar", []() {
+            auto halves = split_acars();
+            string tar;
+            add_tar_entry(tar, "dir/", "", '5');
+            add_tar_entry(tar, "dir/first.bufr", halves.first);
+            add_tar_entry(tar, "dir/empty.bufr", "");
+            add_tar_entry(tar, "dir/second.bufr", halves.second);
+            tar.append(1024, 0);
+            sys::write_file("archive-test.tar", tar, 0666);
+
+            CountingSink sink;
+            read_bufr("archive-test.tar", sink);
+            wassert(actual(sink.total) == 133u);
+            wassert(actual(sink.counts.size()) == 2u);
+            wassert(actual(sink.counts["archive-test.tar:dir/first.bufr"]) > 0u);
+            wassert(actual(sink.counts["archive-test.tar:dir/second.bufr"]) > 0u);
+
+            // A truncated archive is reported
+            sys::write_file("archive-test-truncated.tar", tar.substr(0, 1024 + halves.first.size() / 2), 0666);
+            CountingSink truncated;
+            wassert_throws(wreport::error_consistency, read_bufr("archive-test-truncated.tar", truncated));
+
+#ifdef HAVE_ZLIB
+            // Compressed tar files are read as well
+            gzFile out = gzopen("archive-test.tar.gz", "wb");
+            gzwrite(out, tar.data(), tar.size());
+            gzclose(out);
+            CountingSink compressed;
+            read_bufr("archive-test.tar.gz", compressed);
+            wassert(actual(compressed.total) == 133u);
+            wassert(actual(compressed.counts["archive-test.tar.gz:dir/first.bufr"]) == sink.counts["archive-test.tar:dir/first.bufr"]);
+#endif
+        });
+
+        add_method("zip", []() {
+            auto halves = split_acars();
+            string zip;
+            add_zip_entry(zip, "first.bufr", halves.first, 0, halves.first.size(), false);
+#ifdef HAVE_ZLIB
+            // Deflate the second half as a raw deflate stream
+            z_stream zs;
+            memset(&zs, 0, sizeof(zs));
+            wassert(actual(deflateInit2(&zs, 6, Z_DEFLATED, -15, 8, Z_DEFAULT_STRATEGY)) == Z_OK);
+            string deflated(deflateBound(&zs, halves.second.size()), 0);
+            zs.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(halves.second.data()));
+            zs.avail_in = halves.second.size();
+            zs.next_out = reinterpret_cast<Bytef*>(&deflated[0]);
+            zs.avail_out = deflated.size();
+            wassert(actual(deflate(&zs, Z_FINISH)) == Z_STREAM_END);
+            deflated.resize(deflated.size() - zs.avail_out);
+            deflateEnd(&zs);
+            add_zip_entry(zip, "second.bufr", deflated, 8, halves.second.size(), true);
+#else
+            add_zip_entry(zip, "second.bufr", halves.second, 0, halves.second.size(), false);
+#endif
+            // Central directory end record, without entries as it is not read
+            put32(zip, 0x06054b50);
+            zip.append(18, 0);
+            sys::write_file("archive-test.zip", zip, 0666);
+
+            CountingSink sink;
+            read_bufr("archive-test.zip", sink);
+            wassert(actual(sink.total) == 133u);
+            wassert(actual(sink.counts.size()) == 2u);
+            wassert(actual(sink.counts["archive-test.zip:first.bufr"]) > 0u);
+            wassert(actual(sink.counts["archive-test.zip:second.bufr"]) > 0u);
+        });
+    }
+} test("archive");
+
+}
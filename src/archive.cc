@@ -0,0 +1,388 @@
+/*
+ * archive - Read BUFR files stored in tar and zip archives
+ *
+ * Copyright (C) 2026  ARPA-SIM <urpsim@smr.arpa.emr.it>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#include "archive.h"
+#include "input.h"
+#include <wreport/error.h>
+#include <cstring>
+#include <cstdint>
+
+#include "config.h"
+
+#ifdef HAVE_ZLIB
+#include <zlib.h>
+#endif
+
+using namespace wreport;
+using namespace std;
+
+namespace b2nc {
+
+namespace {
+
+/**
+ * Buffered sequential reader, that allows to look at data before consuming
+ * it
+ */
+class StreamReader
+{
+protected:
+    FILE* in;
+    const std::string& fname;
+    std::string buf;
+    size_t pos = 0;
+
+public:
+    StreamReader(FILE* in, const std::string& fname) : in(in), fname(fname) {}
+
+    /// Buffer at least \a size bytes, returning false if the data ends first
+    bool fill(size_t size)
+    {
+        if (buf.size() - pos >= size)
+            return true;
+        buf.erase(0, pos);
+        pos = 0;
+        char chunk[65536];
+        while (buf.size() < size)
+        {
+            size_t res = fread(chunk, 1, sizeof(chunk), in);
+            if (res == 0)
+            {
+                if (ferror(in))
+                    error_system::throwf("cannot read %s", fname.c_str());
+                return false;
+            }
+            buf.append(chunk, res);
+        }
+        return true;
+    }
+
+    /// Number of bytes available without reading
+    size_t available() const { return buf.size() - pos; }
+
+    /// Buffered data
+    const char* data() const { return buf.data() + pos; }
+
+    void consume(size_t size) { pos += size; }
+
+    /// Read exactly \a size bytes
+    std::string read(size_t size)
+    {
+        if (!fill(size))
+            error_consistency::throwf("%s: archive is truncated", fname.c_str());
+        std::string res = buf.substr(pos, size);
+        pos += size;
+        return res;
+    }
+
+    /// Skip exactly \a size bytes
+    void skip(size_t size)
+    {
+        while (size > 0)
+        {
+            size_t len = min(size, (size_t)65536);
+            if (!fill(len))
+                error_consistency::throwf("%s: archive is truncated", fname.c_str());
+            pos += len;
+            size -= len;
+        }
+    }
+};
+
+/// Call func with a stream reading \a data
+void send_member(const std::string& data, const std::string& name,
+                 std::function<void(FILE*, const std::string&)>& func)
+{
+    // Empty members have no messages, and fmemopen rejects empty buffers
+    if (data.empty())
+        return;
+
+    // The buffer is opened read only, so it is never written to
+    FILE* member = fmemopen(const_cast<char*>(data.data()), data.size(), "rb");
+    if (member == NULL)
+        error_system::throwf("cannot open memory buffer for %s", name.c_str());
+
+    try {
+        func(member, name);
+        fclose(member);
+    } catch (...) {
+        fclose(member);
+        throw;
+    }
+}
+
+/// Parse a numeric tar header field, in octal or in GNU base-256
+uint64_t tar_number(const char* field, size_t size)
+{
+    uint64_t res = 0;
+    if ((unsigned char)field[0] & 0x80)
+    {
+        res = (unsigned char)field[0] & 0x7f;
+        for (size_t i = 1; i < size; ++i)
+            res = (res << 8) | (unsigned char)field[i];
+        return res;
+    }
+    for (size_t i = 0; i < size && field[i]; ++i)
+        if (field[i] >= '0' && field[i] <= '7')
+            res = res * 8 + (field[i] - '0');
+    return res;
+}
+
+/// Return a NUL-terminated tar header field
+std::string tar_string(const char* field, size_t size)
+{
+    return std::string(field, strnlen(field, size));
+}
+
+/// Return the path in a pax extended header, or "" if there is none
+std::string pax_path(const std::string& data)
+{
+    // Records are "LENGTH key=value\n", with LENGTH covering the whole record
+    size_t pos = 0;
+    while (pos < data.size())
+    {
+        size_t len = strtoul(data.c_str() + pos, NULL, 10);
+        if (len == 0 || pos + len > data.size())
+            break;
+        size_t space = data.find(' ', pos);
+        if (space != string::npos && space < pos + len && data.compare(space + 1, 5, "path=") == 0)
+            return data.substr(space + 6, pos + len - space - 7);
+        pos += len;
+    }
+    return std::string();
+}
+
+void read_tar(StreamReader& in, const std::string& fname, std::function<void(FILE*, const std::string&)>& func)
+{
+    std::string long_name;
+    while (true)
+    {
+        // Archives may end without the trailing zero blocks
+        if (!in.fill(512))
+        {
+            if (in.available() == 0)
+                return;
+            error_consistency::throwf("%s: archive is truncated", fname.c_str());
+        }
+        const char* header = in.data();
+
+        // A zero block marks the end of the archive
+        bool zero = true;
+        for (unsigned i = 0; i < 512 && zero; ++i)
+            zero = header[i] == 0;
+        if (zero)
+            return;
+
+        // Validate the checksum, computed with the checksum field as spaces
+        unsigned long sum = 8 * ' ';
+        for (unsigned i = 0; i < 512; ++i)
+            if (i < 148 || i >= 156)
+                sum += (unsigned char)header[i];
+        if (sum != tar_number(header + 148, 8))
+            error_consistency::throwf("%s: invalid tar header checksum", fname.c_str());
+
+        std::string name = tar_string(header, 100);
+        if (memcmp(header + 257, "ustar", 5) == 0 && header[345])
+            name = tar_string(header + 345, 155) + "/" + name;
+        uint64_t size = tar_number(header + 124, 12);
+        char type = header[156];
+        in.consume(512);
+
+        size_t padding = (512 - size % 512) % 512;
+        switch (type)
+        {
+            case 'L': // GNU long name of the next member
+                long_name = tar_string(in.read(size).c_str(), size);
+                in.skip(padding);
+                continue;
+            case 'x': // pax extended header of the next member
+                long_name = pax_path(in.read(size));
+                in.skip(padding);
+                continue;
+            case '0':
+            case '\0':
+            case '7': {
+                std::string data = in.read(size);
+                in.skip(padding);
+                if (!long_name.empty())
+                    name = long_name;
+                send_member(data, fname + ":" + name, func);
+                break;
+            }
+            default:
+                // Directories, links and other entries have no data for us
+                in.skip(size + padding);
+                break;
+        }
+        long_name.clear();
+    }
+}
+
+uint32_t le16(const std::string& buf, size_t pos)
+{
+    return (unsigned char)buf[pos] | ((unsigned char)buf[pos + 1] << 8);
+}
+
+uint32_t le32(const std::string& buf, size_t pos)
+{
+    return le16(buf, pos) | (le16(buf, pos + 2) << 16);
+}
+
+uint64_t le64(const std::string& buf, size_t pos)
+{
+    return le32(buf, pos) | ((uint64_t)le32(buf, pos + 4) << 32);
+}
+
+#ifdef HAVE_ZLIB
+/**
+ * Inflate a raw deflate stream from \a in, leaving any data after its end
+ * unconsumed
+ */
+std::string inflate_member(StreamReader& in, const std::string& name, size_t size_hint)
+{
+    z_stream zs;
+    memset(&zs, 0, sizeof(zs));
+    if (inflateInit2(&zs, -15) != Z_OK)
+        error_consistency::throwf("%s: cannot initialise decompression", name.c_str());
+    struct Guard { z_stream& zs; ~Guard() { inflateEnd(&zs); } } guard{zs};
+
+    std::string res;
+    res.reserve(size_hint);
+    char out[65536];
+    while (true)
+    {
+        if (in.available() == 0 && !in.fill(1))
+            error_consistency::throwf("%s: compressed data is truncated", name.c_str());
+        zs.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(in.data()));
+        zs.avail_in = in.available();
+        zs.next_out = (Bytef*)out;
+        zs.avail_out = sizeof(out);
+        int ret = inflate(&zs, Z_NO_FLUSH);
+        in.consume(in.available() - zs.avail_in);
+        res.append(out, sizeof(out) - zs.avail_out);
+        if (ret == Z_STREAM_END)
+            return res;
+        if (ret != Z_OK && ret != Z_BUF_ERROR)
+            error_consistency::throwf("%s: decompression failed: %s", name.c_str(), zs.msg ? zs.msg : "unknown error");
+    }
+}
+#endif
+
+void read_zip(StreamReader& in, const std::string& fname, std::function<void(FILE*, const std::string&)>& func)
+{
+    while (true)
+    {
+        std::string header = in.read(4);
+        uint32_t sig = le32(header, 0);
+        // Members are followed by the central directory, which we do not need
+        if (sig == 0x02014b50 || sig == 0x06054b50 || sig == 0x06064b50)
+            return;
+        if (sig != 0x04034b50)
+            error_consistency::throwf("%s: invalid zip member header", fname.c_str());
+
+        header = in.read(26);
+        uint32_t flags = le16(header, 2);
+        uint32_t method = le16(header, 4);
+        uint64_t csize = le32(header, 14);
+        uint64_t usize = le32(header, 18);
+        std::string name = fname + ":" + in.read(le16(header, 22));
+        std::string extra = in.read(le16(header, 24));
+
+        // Zip64 sizes are in an extra field
+        bool zip64 = false;
+        for (size_t pos = 0; pos + 4 <= extra.size(); )
+        {
+            uint32_t id = le16(extra, pos);
+            uint32_t len = le16(extra, pos + 2);
+            if (id == 0x0001 && len >= 16 && pos + 4 + len <= extra.size())
+            {
+                usize = le64(extra, pos + 4);
+                csize = le64(extra, pos + 12);
+                zip64 = true;
+            }
+            pos += 4 + len;
+        }
+
+        if (flags & 1)
+            error_unimplemented::throwf("%s: encrypted zip members are not supported", name.c_str());
+        bool descriptor = flags & 8;
+
+        std::string data;
+        switch (method)
+        {
+            case 0: // Stored
+                if (descriptor)
+                    error_unimplemented::throwf("%s: stored zip members with a data descriptor are not supported", name.c_str());
+                data = in.read(csize);
+                break;
+            case 8: // Deflated
+#ifdef HAVE_ZLIB
+                data = inflate_member(in, name, descriptor ? 0 : usize);
+                break;
+#else
+                error_unimplemented::throwf("%s: this build cannot read deflated zip members", name.c_str());
+#endif
+            default:
+                error_unimplemented::throwf("%s: zip compression method %u is not supported", name.c_str(), (unsigned)method);
+        }
+
+        if (descriptor)
+        {
+            // The data descriptor signature is optional
+            if (in.fill(4) && le32(std::string(in.data(), 4), 0) == 0x08074b50)
+                in.consume(4);
+            in.skip(zip64 ? 20 : 12);
+        }
+
+        // Directories have names ending in '/'
+        if (name.back() != '/')
+            send_member(data, name, func);
+    }
+}
+
+}
+
+ArchiveFormat detect_archive(const std::string& head)
+{
+    if (head.size() >= 4 && head.compare(0, 4, "PK\x03\x04", 4) == 0)
+        return ArchiveFormat::ZIP;
+    if (head.size() >= 262 && head.compare(257, 5, "ustar") == 0)
+        return ArchiveFormat::TAR;
+    return ArchiveFormat::NONE;
+}
+
+void read_members(InputFile& in, std::function<void(FILE* member, const std::string& name)> func)
+{
+    ArchiveFormat format = detect_archive(in.head(archive_head_size));
+    if (format == ArchiveFormat::NONE)
+    {
+        func(in.file(), in.name());
+        return;
+    }
+
+    StreamReader reader(in.file(), in.name());
+    switch (format)
+    {
+        case ArchiveFormat::TAR: read_tar(reader, in.name(), func); break;
+        case ArchiveFormat::ZIP: read_zip(reader, in.name(), func); break;
+        case ArchiveFormat::NONE: break;
+    }
+}
+
+}
@@ -0,0 +1,59 @@
+/*
+ * archive - Read BUFR files stored in tar and zip archives
+ *
+ * Copyright (C) 2026  ARPA-SIM <urpsim@smr.arpa.emr.it>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#ifndef B2NC_ARCHIVE_H
+#define B2NC_ARCHIVE_H
+
+#include <functional>
+#include <string>
+#include <cstdio>
+
+namespace b2nc {
+
+class InputFile;
+
+/// Archive format of an input file
+enum class ArchiveFormat
+{
+    NONE,
+    TAR,
+    ZIP,
+};
+
+/// Number of bytes needed by detect_archive()
+static const size_t archive_head_size = 512;
+
+/// Detect the archive format of data starting with \a head
+ArchiveFormat detect_archive(const std::string& head);
+
+/**
+ * Call \a func with a stream for each regular file in \a in, if it is a tar
+ * or zip archive, or with the whole file otherwise.
+ *
+ * Archives are read sequentially, also when compressed, and members are
+ * never extracted to disk. Members are named "archive:member" in the name
+ * passed to \a func, to be used in error messages and logs.
+ *
+ * Only stored and deflated zip members are supported.
+ */
+void read_members(InputFile& in, std::function<void(FILE* member, const std::string& name)> func);
+
+}
+
+#endif
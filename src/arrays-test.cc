@@ -52,6 +52,61 @@ static void read_bufr(Arrays& a, const std::string& testname)
     fclose(infd);
 }
 
+/**
+ * Decode all bulletins of a test file, splitting the subsets of each one in
+ * \a ranges ranges
+ */
+static void read_bufr_parallel(Arrays& a, const std::string& testname, unsigned ranges, vector<unique_ptr<BufrBulletin>>& bulletins)
+{
+    string srcfile(b2nc::tests::datafile("bufr/" + testname));
+    FILE* infd = fopen(srcfile.c_str(), "rb");
+    if (infd == NULL)
+        error_system::throwf("cannot open %s", srcfile.c_str());
+
+    string rawmsg;
+    while (BufrBulletin::read(infd, rawmsg, srcfile.c_str()))
+    {
+        unique_ptr<BufrBulletin> bulletin = bulletin->decode(rawmsg);
+        if (a.plan.sections.empty())
+            a.plan.build(*bulletin);
+        a.add_parallel(*bulletin, ranges);
+        // The plan can use the Varinfos of the bulletin
+        bulletins.emplace_back(move(bulletin));
+    }
+
+    fclose(infd);
+}
+
+/// Check that two Arrays produce the same output variables
+static void assert_same_columns(const Arrays& a, const Arrays& b)
+{
+    vector<Column> ca, cb;
+    a.columns(ca);
+    b.columns(cb);
+    wassert(actual(cb.size()) == ca.size());
+    for (size_t i = 0; i < ca.size(); ++i)
+    {
+        wassert(actual(cb[i].name) == ca[i].name);
+        wassert(actual(cb[i].loop_size) == ca[i].loop_size);
+        wassert(actual(cb[i].attributes.size()) == ca[i].attributes.size());
+        for (size_t j = 0; j < ca[i].attributes.size(); ++j)
+        {
+            wassert(actual(cb[i].attributes[j].name) == ca[i].attributes[j].name);
+            wassert(actual(cb[i].attributes[j].text) == ca[i].attributes[j].text);
+            wassert_true(cb[i].attributes[j].ints == ca[i].attributes[j].ints);
+        }
+
+        ColumnData da, db;
+        ca[i].collect(0, a.bufr_idx, da);
+        cb[i].collect(0, b.bufr_idx, db);
+        wassert_true(db.offsets == da.offsets);
+        wassert_true(db.ints == da.ints);
+        wassert_true(db.floats == da.floats);
+        wassert_true(db.doubles == da.doubles);
+        wassert_true(db.strings == da.strings);
+    }
+}
+
 class Tests : public TestCase
 {
     using TestCase::TestCase;
@@ -201,6 +256,25 @@ class Tests : public TestCase
             //p.print(stderr);
         });
 
+        add_method("parallel", []() {
+            // Converting ranges of subsets separately gives the same result
+            for (const char* name: { "AMSUA.bufr", "atms2.bufr", "cdfin_temp" })
+            {
+                Options opts;
+                Arrays serial(opts);
+                read_bufr(serial, name);
+
+                for (unsigned ranges: { 2, 3, 7 })
+                {
+                    vector<unique_ptr<BufrBulletin>> bulletins;
+                    Arrays parallel(opts);
+                    read_bufr_parallel(parallel, name, ranges, bulletins);
+                    wassert(actual(parallel.bufr_idx) == serial.bufr_idx);
+                    wassert(assert_same_columns(serial, parallel));
+                }
+            }
+        });
+
         add_method("intarray", []() {
             // Test IntArray
             IntArray test("test");
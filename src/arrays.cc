@@ -24,14 +24,23 @@
 #include "mnemo.h"
 #include "ncoutfile.h"
 #include "options.h"
+#include "instruments.h"
+#include "plancache.h"
 #include "config.h"
+#include "threads.h"
+#include "stats.h"
+#include "trace.h"
+#include "memory.h"
+#include "sparsity.h"
 #include <wreport/var.h>
 #include <wreport/bulletin.h>
 //#include <wreport/bulletin/buffers.h>
 #include <wreport/bulletin/internals.h>
 #include <wreport/utils/sys.h>
 #include <netcdf.h>
+#include <algorithm>
 #include <stack>
+#include <thread>
 #include <cstring>
 
 using namespace wreport;
@@ -39,6 +48,16 @@ using namespace std;
 
 namespace b2nc {
 
+namespace {
+
+/**
+ * Minimum number of subsets that each thread converts when a bulletin is
+ * split among Options::jobs threads
+ */
+const size_t parallel_min_subsets = 256;
+
+}
+
 /**
  * wreport encoder/interpreter which sends bulletin data to an Arrays object
  */
@@ -56,7 +75,17 @@ protected:
 
     Arrays& arrays;
 
-    std::stack<plan::Section*> cur_section;
+    /// Position in a section of the plan
+    struct Position
+    {
+        plan::Section* section;
+        unsigned cursor;
+
+        Position(plan::Section* section) : section(section), cursor(0) {}
+        plan::Variable& current() const { return section->at(cursor); }
+    };
+
+    std::stack<Position> cur_section;
 
     map<Varcode, const ValArray*> context;
     unsigned bufr_idx;
@@ -75,7 +104,7 @@ protected:
 
     plan::Variable& variable_for(Varcode code)
     {
-        plan::Variable& v = cur_section.top()->current();
+        plan::Variable& v = cur_section.top().current();
         if (v.subsection)
         {
             if (arrays.verbose)
@@ -84,7 +113,7 @@ protected:
                         WR_VAR_F(code), WR_VAR_X(code), WR_VAR_Y(code));
                 v.print(stderr);
             }
-            error_consistency::throwf("out of sync at %u: value is a subsection instead of a variable", cur_section.top()->cursor);
+            error_consistency::throwf("out of sync at %u: value is a subsection instead of a variable", cur_section.top().cursor);
         } else {
             if (arrays.debug)
             {
@@ -95,26 +124,26 @@ protected:
         }
         if (v.data && v.data->info->code != code)
             error_consistency::throwf("out of sync at %u: vars mismatch (%d%02d%03d != %d%02d%03d)",
-                    cur_section.top()->cursor, WR_VAR_FXY(v.data->info->code), WR_VAR_FXY(code));
+                    cur_section.top().cursor, WR_VAR_FXY(v.data->info->code), WR_VAR_FXY(code));
         return v;
     }
 
     plan::Section* section_for_current_position()
     {
-        plan::Section* plan_sec = cur_section.top()->current().subsection;
+        plan::Section* plan_sec = cur_section.top().current().subsection;
         if (!plan_sec)
         {
             if (arrays.verbose)
             {
                 fprintf(stderr, "Looking for section, got ");
-                cur_section.top()->current().print(stderr);
+                cur_section.top().current().print(stderr);
             }
-            error_consistency::throwf("out of sync at %u: value is not a subsection", cur_section.top()->cursor);
+            error_consistency::throwf("out of sync at %u: value is not a subsection", cur_section.top().cursor);
         } else {
             if (arrays.debug)
             {
                 fprintf(stderr, "Looking for section, got ");
-                cur_section.top()->current().print(stderr);
+                cur_section.top().current().print(stderr);
             }
         }
         return plan_sec;
@@ -127,8 +156,7 @@ public:
           bufr_idx(bufr_idx),
           prev_code(0), prev_code_count(0)
     {
-        cur_section.push(arrays.plan.sections[0]);
-        cur_section.top()->cursor = 0;
+        cur_section.push(Position(arrays.plan.sections[0]));
     }
 
     void r_replication(Varcode code, Varcode delayed_code, const Opcodes& ops) override
@@ -138,17 +166,17 @@ public:
                     WR_VAR_F(code), WR_VAR_X(code), WR_VAR_Y(code),
                     WR_VAR_F(delayed_code), WR_VAR_X(delayed_code), WR_VAR_Y(delayed_code));
 
-        plan::Section* cur_top = cur_section.top();
+        plan::Section* cur_top = cur_section.top().section;
 
         UncompressedEncoder::r_replication(code, delayed_code, ops);
 
-        if (cur_top != cur_section.top())
+        if (cur_top != cur_section.top().section)
             // If it iterated, we need to pop the subsection from the stack
             cur_section.pop();
 
         if (arrays.debug)
         {
-            plan::Variable& v = cur_section.top()->current();
+            plan::Variable& v = cur_section.top().current();
             fprintf(stderr, "End replicated section %01d%02d%03d/%01d%02d%03d; next: ",
                     WR_VAR_F(code), WR_VAR_X(code), WR_VAR_Y(code),
                     WR_VAR_F(delayed_code), WR_VAR_X(delayed_code), WR_VAR_Y(delayed_code));
@@ -156,8 +184,8 @@ public:
         }
 
         // Skip past the subsection
-        if (cur_section.top()->current().subsection)
-            cur_section.top()->cursor++;
+        if (cur_section.top().current().subsection)
+            cur_section.top().cursor++;
     }
 
     void run_r_repetition(unsigned cur, unsigned total) override
@@ -165,9 +193,9 @@ public:
         if (cur == 0)
         {
             plan::Section* plan_sec = section_for_current_position();
-            cur_section.push(plan_sec);
+            cur_section.push(Position(plan_sec));
         }
-        cur_section.top()->cursor = 0;
+        cur_section.top().cursor = 0;
 
         if (arrays.debug)
             fprintf(stderr, "Repetition #%u/%u %u elements\n", cur, total, opcode_stack.top().size());
@@ -211,8 +239,7 @@ public:
 
         // Fetch the section
         plan::Section* plan_sec = section_for_current_position();
-        cur_section.push(plan_sec);
-        cur_section.top()->cursor = 0;
+        cur_section.push(Position(plan_sec));
 
         // TODO:   feed it bits
 
@@ -247,7 +274,7 @@ public:
         if (v.qbits)
             if (const Var* q = get_qbits(var))
                 v.qbits->add(*q, bufr_idx);
-        cur_section.top()->cursor++;
+        cur_section.top().cursor++;
     }
 
     unsigned define_bitmap_delayed_replication_factor(Varinfo) override
@@ -271,14 +298,14 @@ public:
     void define_raw_character_data(Varcode) override
     {
         const Var& var = get_var();
-        plan::Variable& v = cur_section.top()->current();
+        plan::Variable& v = cur_section.top().current();
         if (v.subsection)
-            error_consistency::throwf("out of sync at %u: value is a subsection instead of a variable", cur_section.top()->cursor);
+            error_consistency::throwf("out of sync at %u: value is a subsection instead of a variable", cur_section.top().cursor);
         if (v.data)
         {
             if (WR_VAR_F(v.data->info->code) != WR_VAR_F(var.code())
               || WR_VAR_X(v.data->info->code) != WR_VAR_X(var.code()))
-                error_consistency::throwf("out of sync at %u: vars mismatch", cur_section.top()->cursor);
+                error_consistency::throwf("out of sync at %u: vars mismatch", cur_section.top().cursor);
             v.data->add(var, bufr_idx);
         }
 #if 0
@@ -370,28 +397,119 @@ ValArray& Arrays::get_valarray(Namer::DataType type, const Var& var, const std::
 
 void Arrays::add(unique_ptr<Bulletin>&& bulletin)
 {
+    TraceSpan span(instruments(plan.opts).trace, "arrays", bulletin->fname.c_str(), bulletin->offset);
     if (plan.sections.empty())
     {
-        if (debug)
-            fprintf(stderr, "\nBuilding conversion plan:\n");
-        plan.build(*bulletin);
-        if (debug)
+        PhaseTimer timer(stats, Phase::PLAN);
+        TraceSpan plan_span(instruments(plan.opts).trace, "plan");
+        PlanCache cache(plan.opts);
+        if (cache.load(plan, *bulletin))
         {
-            fprintf(stderr, "\nComputed conversion plan:\n");
-            plan.print(stderr);
+            if (debug)
+            {
+                fprintf(stderr, "\nCached conversion plan:\n");
+                plan.print(stderr);
+            }
+        } else {
+            if (debug)
+                fprintf(stderr, "\nBuilding conversion plan:\n");
+            plan.build(*bulletin);
+            if (debug)
+            {
+                fprintf(stderr, "\nComputed conversion plan:\n");
+                plan.print(stderr);
+            }
+            cache.save(plan, *bulletin);
         }
     }
 
-    for (unsigned i = 0; i < bulletin->subsets.size(); ++i)
+    size_t subsets = bulletin->subsets.size();
+    if (stats)
     {
-        ArrayBuilder ab(*bulletin, i, *this, bufr_idx++);
-        ab.run();
+        ++stats->messages;
+        stats->subsets += subsets;
     }
 
+    PhaseTimer timer(stats, Phase::ARRAYS);
+    unsigned ranges = min<size_t>(plan.opts.jobs, subsets / parallel_min_subsets);
+    if (ranges > 1)
+        add_parallel(*bulletin, ranges);
+    else
+        for (unsigned i = 0; i < subsets; ++i)
+        {
+            ArrayBuilder ab(*bulletin, i, *this, bufr_idx++);
+            ab.run();
+        }
+
     if (!first_bulletin)
         first_bulletin = bulletin.release();
 }
 
+void Arrays::add_parallel(const wreport::Bulletin& bulletin, unsigned ranges)
+{
+    // Each range is converted into its own copy of the plan, since ValArrays
+    // grow as they are filled and track whether their value changes
+    string encoded_plan = plan.serialize();
+    size_t subsets = bulletin.subsets.size();
+    vector<unique_ptr<Arrays>> parts(ranges);
+    std::thread::id caller = std::this_thread::get_id();
+    parallel_for(ranges, ranges, [&](size_t r) {
+        TraceSpan span(instruments(plan.opts).trace, "arrays range",
+                instruments(plan.opts).trace ? to_string(subsets * r / ranges) + "-" + to_string(subsets * (r + 1) / ranges) : string());
+        uint64_t start_cpu = stats ? PhaseTimer::thread_cpu_ns() : 0;
+        unique_ptr<Arrays> part(new Arrays(plan.opts));
+        part->plan.deserialize(encoded_plan);
+        size_t end = subsets * (r + 1) / ranges;
+        for (size_t i = subsets * r / ranges; i < end; ++i)
+        {
+            ArrayBuilder ab(bulletin, i, *part, part->bufr_idx++);
+            ab.run();
+        }
+        parts[r] = move(part);
+
+        // The time of the calling thread is already measured by add()
+        if (stats && std::this_thread::get_id() != caller)
+            stats->add_cpu(Phase::ARRAYS, PhaseTimer::thread_cpu_ns() - start_cpu);
+    });
+
+    // Join the ranges in order, as if they had been added one after the
+    // other
+    for (const auto& part: parts)
+    {
+        merge(*part, bufr_idx);
+        bufr_idx += part->bufr_idx;
+    }
+}
+
+void Arrays::merge(const Arrays& part, unsigned offset)
+{
+    for (size_t s = 0; s < plan.sections.size(); ++s)
+    {
+        const plan::Section& dest = *plan.sections[s];
+        const plan::Section& src = *part.plan.sections[s];
+        for (size_t e = 0; e < dest.entries.size(); ++e)
+        {
+            const plan::Variable& d = *dest.entries[e];
+            const plan::Variable& v = *src.entries[e];
+            if (d.data && v.data)
+            {
+                d.data->merge(*v.data, offset);
+
+                // Take note of significant ValArrays, that the part found
+                // first if we did not
+                if (!date_year && v.data == part.date_year) date_year = d.data;
+                if (!date_month && v.data == part.date_month) date_month = d.data;
+                if (!date_day && v.data == part.date_day) date_day = d.data;
+                if (!time_hour && v.data == part.time_hour) time_hour = d.data;
+                if (!time_minute && v.data == part.time_minute) time_minute = d.data;
+                if (!time_second && v.data == part.time_second) time_second = d.data;
+            }
+            if (d.qbits && v.qbits)
+                d.qbits->merge(*v.qbits, offset);
+        }
+    }
+}
+
 void Arrays::dump(FILE* out)
 {
     plan.print(out);
@@ -399,7 +517,6 @@ void Arrays::dump(FILE* out)
 
 bool Arrays::define(NCOutfile& outfile)
 {
-    int ncid = outfile.ncid;
     int bufrdim = outfile.dim_bufr_records;
 
     // Define the array size dimensions
@@ -408,53 +525,90 @@ bool Arrays::define(NCOutfile& outfile)
     if (date_year && date_month && date_day)
     {
         date_varid = outfile.def_var("DATE", NC_INT, 1, &bufrdim);
-
-        int missing = NC_FILL_INT;
-        int res = nc_put_att_int(ncid, date_varid, "_FillValue", NC_INT, 1, &missing);
-        error_netcdf::throwf_iferror(res, "creating _FillValue attribute in DATE");
-
-        const char* attname = "Date as YYYYMMDD";
-        res = nc_put_att_text(ncid, date_varid, "long_name", strlen(attname), attname);
-        error_netcdf::throwf_iferror(res, "setting long_name attribute for DATE");
-
-        res = nc_put_att_text(ncid, date_varid, "var_year", date_year->name.size(), date_year->name.data());
-        error_netcdf::throwf_iferror(res, "setting var_year attribute for DATE");
-
-        res = nc_put_att_text(ncid, date_varid, "var_month", date_month->name.size(), date_month->name.data());
-        error_netcdf::throwf_iferror(res, "setting var_month attribute for DATE");
-
-        res = nc_put_att_text(ncid, date_varid, "var_day", date_day->name.size(), date_day->name.data());
-        error_netcdf::throwf_iferror(res, "setting var_day attribute for DATE");
+        Attributes attrs;
+        date_attributes(attrs);
+        outfile.put_attributes(date_varid, "DATE", attrs);
     }
 
     if (time_hour)
     {
         time_varid = outfile.def_var("TIME", NC_INT, 1, &bufrdim);
+        Attributes attrs;
+        time_attributes(attrs);
+        outfile.put_attributes(time_varid, "TIME", attrs);
+    }
+    return true;
+}
 
-        int missing = NC_FILL_INT;
-        int res = nc_put_att_int(ncid, time_varid, "_FillValue", NC_INT, 1, &missing);
-        error_netcdf::throwf_iferror(res, "creating _FillValue attribute in TIME");
+void Arrays::memory_usage(MemoryUsage& out) const
+{
+    out.add("(plan)", plan.heap_size());
+    for (const auto* section: plan.sections)
+        for (const auto* entry: section->entries)
+        {
+            if (entry->data) out.add(entry->data->name, entry->data->heap_size());
+            if (entry->qbits) out.add(entry->qbits->name, entry->qbits->heap_size());
+        }
 
-        const char* attname = "Time as HHMMSS";
-        res = nc_put_att_text(ncid, time_varid, "long_name", strlen(attname), attname);
-        error_netcdf::throwf_iferror(res, "setting long_name attribute for TIME");
+    if (first_bulletin)
+    {
+        // Variables may also hold strings and attributes, not counted here
+        size_t size = heap_size_of(first_bulletin->datadesc) + heap_size_of(first_bulletin->subsets);
+        for (const auto& subset: first_bulletin->subsets)
+            size += heap_size_of(static_cast<const std::vector<Var>&>(subset));
+        out.add("(first bulletin)", size);
+    }
+}
 
-        res = nc_put_att_text(ncid, time_varid, "var_hour", time_hour->name.size(), time_hour->name.data());
-        error_netcdf::throwf_iferror(res, "setting time_hour attribute for TIME");
+void Arrays::date_attributes(Attributes& out) const
+{
+    out.push_back(Attribute::make_int("_FillValue", NC_FILL_INT));
+    out.push_back(Attribute::make_text("long_name", "Date as YYYYMMDD"));
+    out.push_back(Attribute::make_text("var_year", date_year->name));
+    out.push_back(Attribute::make_text("var_month", date_month->name));
+    out.push_back(Attribute::make_text("var_day", date_day->name));
+}
 
-        if (time_minute)
-        {
-            res = nc_put_att_text(ncid, time_varid, "var_minute", time_minute->name.size(), time_minute->name.data());
-            error_netcdf::throwf_iferror(res, "setting time_minute attribute for TIME");
-        }
+void Arrays::time_attributes(Attributes& out) const
+{
+    out.push_back(Attribute::make_int("_FillValue", NC_FILL_INT));
+    out.push_back(Attribute::make_text("long_name", "Time as HHMMSS"));
+    out.push_back(Attribute::make_text("var_hour", time_hour->name));
+    if (time_minute)
+        out.push_back(Attribute::make_text("var_minute", time_minute->name));
+    if (time_second)
+        out.push_back(Attribute::make_text("var_second", time_second->name));
+}
 
-        if (time_second)
-        {
-            res = nc_put_att_text(ncid, time_varid, "var_second", time_second->name.size(), time_second->name.data());
-            error_netcdf::throwf_iferror(res, "setting time_second attribute for TIME");
-        }
+int Arrays::date_value(size_t idx) const
+{
+    Var vy = date_year->get_var(idx, 0);
+    Var vm = date_month->get_var(idx, 0);
+    Var vd = date_day->get_var(idx, 0);
+    if (vy.isset() && vm.isset() && vd.isset())
+        return vy.enqi() * 10000 + vm.enqi() * 100 + vd.enqi();
+    else
+        return NC_FILL_INT;
+}
+
+int Arrays::time_value(size_t idx) const
+{
+    Var th = time_hour->get_var(idx, 0);
+    if (!th.isset())
+        return NC_FILL_INT;
+
+    int res = th.enqi() * 10000;
+    if (time_minute)
+    {
+        Var tm = time_minute->get_var(idx, 0);
+        if (tm.isset()) res += tm.enqi() * 100;
     }
-    return true;
+    if (time_second)
+    {
+        Var ts = time_second->get_var(idx, 0);
+        if (ts.isset()) res += ts.enqi();
+    }
+    return res;
 }
 
 void Arrays::putvar(NCOutfile& outfile) const
@@ -465,18 +619,11 @@ void Arrays::putvar(NCOutfile& outfile) const
 
     if (date_year && date_month && date_day)
     {
-        size_t size = date_year->get_size();
+        TraceSpan span(outfile.trace, "putvar", "DATE");
+        size_t size = outfile.records_to_write(date_year->get_size());
         sys::TempBuffer<int> values(size);
         for (size_t i = 0; i < size; ++i)
-        {
-            Var vy = date_year->get_var(i, 0);
-            Var vm = date_month->get_var(i, 0);
-            Var vd = date_day->get_var(i, 0);
-            if (vy.isset() && vm.isset() && vd.isset())
-                values[i] = vy.enqi() * 10000 + vm.enqi() * 100 + vd.enqi();
-            else
-                values[i] = NC_FILL_INT;
-        }
+            values[i] = date_value(i);
 
         size_t start[] = {0};
         size_t count[] = {size};
@@ -486,28 +633,11 @@ void Arrays::putvar(NCOutfile& outfile) const
 
     if (time_hour)
     {
-        size_t size = time_hour->get_size();
+        TraceSpan span(outfile.trace, "putvar", "TIME");
+        size_t size = outfile.records_to_write(time_hour->get_size());
         sys::TempBuffer<int> values(size);
         for (size_t i = 0; i < size; ++i)
-        {
-            Var th = time_hour->get_var(i, 0);
-            if (th.isset())
-            {
-                values[i] = th.enqi() * 10000;
-                if (time_minute)
-                {
-                    Var tm = time_minute->get_var(i, 0);
-                    if (tm.isset()) values[i] += tm.enqi() * 100;
-                }
-                if (time_second)
-                {
-                   Var ts = time_second->get_var(i, 0);
-                   if (ts.isset()) values[i] += ts.enqi();
-                }
-            }
-            else
-                values[i] = NC_FILL_INT;
-        }
+            values[i] = time_value(i);
 
         size_t start[] = {0};
         size_t count[] = {size};
@@ -516,6 +646,95 @@ void Arrays::putvar(NCOutfile& outfile) const
     }
 }
 
+namespace {
+
+/// Describe a ValArray as a Column
+Column valarray_column(const ValArray& arr, size_t loop_size)
+{
+    Column res;
+    res.name = arr.name;
+    res.type = arr.value_type();
+    if (const LoopInfo* loop = arr.get_loopinfo())
+    {
+        res.loop_dim = loop->dim_name();
+        res.loop_size = loop_size;
+    }
+    if (res.type == VT_STRING)
+    {
+        res.strlen_dim = arr.name + "_strlen";
+        res.strlen = arr.info->len;
+    }
+    arr.get_attributes(res.attributes);
+    const ValArray* a = &arr;
+    res.collect = [a](size_t first, size_t count, ColumnData& out) { a->collect(first, count, out); };
+    return res;
+}
+
+}
+
+void Arrays::columns(std::vector<Column>& out) const
+{
+    // All arrays in the same loop share the loop dimension, which needs to
+    // fit the longest of them
+    map<const LoopInfo*, size_t> loop_sizes;
+    for (const auto& section: plan.sections)
+        for (const auto& v: section->entries)
+            for (const ValArray* arr: { v->data, v->qbits })
+            {
+                if (!arr || arr->get_size() == 0) continue;
+                if (const LoopInfo* loop = arr->get_loopinfo())
+                {
+                    size_t& size = loop_sizes[loop];
+                    if (arr->get_max_rep() > size)
+                        size = arr->get_max_rep();
+                }
+            }
+
+    for (const auto& section: plan.sections)
+        for (const auto& v: section->entries)
+            for (const ValArray* arr: { v->data, v->qbits })
+            {
+                // Skip variables that have never been found
+                if (!arr || arr->get_size() == 0) continue;
+                const LoopInfo* loop = arr->get_loopinfo();
+                out.push_back(valarray_column(*arr, loop ? loop_sizes[loop] : 1));
+            }
+
+    if (date_year && date_month && date_day)
+    {
+        Column col;
+        col.name = "DATE";
+        col.type = VT_INT;
+        date_attributes(col.attributes);
+        col.collect = [this](size_t first, size_t count, ColumnData& data) {
+            data.reset(VT_INT);
+            for (size_t i = first; i < first + count; ++i)
+            {
+                data.ints.push_back(date_value(i));
+                data.offsets.push_back(data.ints.size());
+            }
+        };
+        out.push_back(col);
+    }
+
+    if (time_hour)
+    {
+        Column col;
+        col.name = "TIME";
+        col.type = VT_INT;
+        time_attributes(col.attributes);
+        col.collect = [this](size_t first, size_t count, ColumnData& data) {
+            data.reset(VT_INT);
+            for (size_t i = first; i < first + count; ++i)
+            {
+                data.ints.push_back(time_value(i));
+                data.offsets.push_back(data.ints.size());
+            }
+        };
+        out.push_back(col);
+    }
+}
+
 Sections::Sections(unsigned idx)
     : max_length(0), idx(idx), nc_dimid(-1), nc_varid(-1)
 {
@@ -565,28 +784,52 @@ void Sections::putvar(NCOutfile& outfile) const
     if (max_length == 0)
         return;
 
+    TraceSpan span(outfile.trace, "putvar", outfile.trace ? "section" + to_string(idx) : string());
     size_t start[] = {0, 0};
-    size_t count[] = {1, 0};
-    sys::TempBuffer<unsigned char> missing(max_length); // Missing value
-    memset(missing, NC_FILL_BYTE, max_length);
-    for (size_t i = 0; i < values.size(); ++i)
+    size_t count[] = {1, max_length};
+    vector<unsigned char> value(max_length); // Fill-padded value
+    size_t records = outfile.records_to_write(values.size());
+    for (size_t i = 0; i < records; ++i)
     {
-        int res;
         start[0] = i;
-        if (!values[i].empty())
-        {
-            count[1] = values[i].size();
-            res = nc_put_vara_uchar(ncid, nc_varid, start, count, (const unsigned char*)values[i].data());
-        }
-        else
-        {
-            count[1] = max_length;
-            res = nc_put_vara_uchar(ncid, nc_varid, start, count, missing);
-        }
+        size_t len = i < values.size() ? values[i].size() : 0;
+        if (len)
+            memcpy(value.data(), values[i].data(), len);
+        memset(value.data() + len, NC_FILL_BYTE, max_length - len);
+        int res = nc_put_vara_uchar(ncid, nc_varid, start, count, value.data());
         error_netcdf::throwf_iferror(res, "storing %zd string values", count[1]);
     }
 }
 
+void Sections::columns(std::vector<Column>& out) const
+{
+    if (max_length == 0)
+        return;
+
+    Column col;
+    char name[20];
+    snprintf(name, 20, "section%d", idx);
+    col.name = name;
+    col.type = VT_BYTES;
+    snprintf(name, 20, "section%d_length", idx);
+    col.strlen_dim = name;
+    col.strlen = max_length;
+    col.collect = [this](size_t first, size_t count, ColumnData& data) {
+        data.reset(VT_BYTES);
+        for (size_t i = first; i < first + count; ++i)
+        {
+            data.strings.push_back(i < values.size() ? values[i] : string());
+            data.offsets.push_back(data.strings.size());
+        }
+    };
+    out.push_back(col);
+}
+
+size_t Sections::heap_size() const
+{
+    return heap_size_of(values);
+}
+
 IntArray::IntArray(const std::string& name)
     : name(name), nc_varid(-1)
 {
@@ -606,6 +849,7 @@ bool IntArray::define(NCOutfile& outfile)
     int bufrdim = outfile.dim_bufr_records;
 
     if (values.empty()) return false;
+    TraceSpan span(outfile.trace, "define", name);
     nc_varid = outfile.def_var(name.c_str(), NC_INT, 1, &bufrdim);
 
     int missing = NC_FILL_INT;
@@ -618,6 +862,7 @@ bool IntArray::define(NCOutfile& outfile)
 void IntArray::putvar(NCOutfile& outfile) const
 {
     if (values.empty()) return;
+    TraceSpan span(outfile.trace, "putvar", name);
     size_t start[] = {0};
     size_t count[] = {values.size()};
 #ifdef HAVE_VECTOR_DATA
@@ -631,6 +876,217 @@ void IntArray::putvar(NCOutfile& outfile) const
     error_netcdf::throwf_iferror(res, "storing %zd integer values", values.size());
     delete[] temp;
 #endif
+
+    // Pad missing trailing records, as the file is written in NC_NOFILL mode
+    if (values.size() < outfile.record_count)
+    {
+        vector<int> missing(outfile.record_count - values.size(), NC_FILL_INT);
+        start[0] = values.size();
+        count[0] = missing.size();
+        res = nc_put_vara_int(outfile.ncid, nc_varid, start, count, missing.data());
+        error_netcdf::throwf_iferror(res, "storing %zd padding values", missing.size());
+    }
+}
+
+void IntArray::columns(std::vector<Column>& out) const
+{
+    if (values.empty()) return;
+
+    Column col;
+    col.name = name;
+    col.type = VT_INT;
+    col.attributes.push_back(Attribute::make_int("_FillValue", NC_FILL_INT));
+    col.collect = [this](size_t first, size_t count, ColumnData& data) {
+        data.reset(VT_INT);
+        for (size_t i = first; i < first + count; ++i)
+        {
+            data.ints.push_back(i < values.size() ? values[i] : NC_FILL_INT);
+            data.offsets.push_back(data.ints.size());
+        }
+    };
+    out.push_back(col);
+}
+
+size_t IntArray::heap_size() const
+{
+    return heap_size_of(name) + heap_size_of(values);
+}
+
+NCFiller::NCFiller(const Options& opts)
+    : arrays(opts),
+      sec1(1), sec2(2),
+      edition("edition_number"),
+      s1mtn("section1_master_table_nr"),
+      s1ce("section1_centre"),
+      s1sc("section1_subcentre"),
+      s1usn("section1_update_sequence_nr"),
+      s1cat("section1_data_category"),
+      s1subcat("section1_int_data_sub_category"),
+      s1localsubcat("section1_local_data_sub_category"),
+      s1mtv("section1_master_tables_version"),
+      s1ltv("section1_local_tables_version"),
+      s1date("section1_date"),
+      s1time("section1_time")
+{
+    //arrays.debug = true;
+}
+
+void NCFiller::add(unique_ptr<BufrBulletin>&& bulletin, const std::string& raw)
+{
+    for (size_t i = 0; i < bulletin->subsets.size(); ++i)
+    {
+        // Add contents to the various data arrays
+        edition.add(bulletin->edition_number);
+        s1mtn.add(bulletin->master_table_number);
+        s1ce.add(bulletin->originating_centre);
+        s1sc.add(bulletin->originating_subcentre);
+        s1usn.add(bulletin->update_sequence_number);
+        s1cat.add(bulletin->data_category);
+        if (bulletin->data_subcategory == 255)
+            s1subcat.add_missing();
+        else
+            s1subcat.add(bulletin->data_subcategory);
+        s1localsubcat.add(bulletin->data_subcategory_local);
+        s1mtv.add(bulletin->master_table_version_number);
+        s1ltv.add(bulletin->master_table_version_number_local);
+        s1date.add(bulletin->rep_year * 10000 + bulletin->rep_month * 100 + bulletin->rep_day);
+        s1time.add(bulletin->rep_hour * 10000 + bulletin->rep_minute * 100 + bulletin->rep_second);
+        sec1.add(*bulletin, raw);
+        sec2.add(*bulletin, raw);
+    }
+
+    arrays.add(move(bulletin));
+}
+
+void NCFiller::define(NCOutfile& outfile)
+{
+    // All arrays are padded up to the number of subsets seen
+    outfile.record_count = record_count();
+
+    // Define variables
+
+    edition.define(outfile);
+    s1mtn.define(outfile);
+    s1ce.define(outfile);
+    s1sc.define(outfile);
+    s1usn.define(outfile);
+    s1cat.define(outfile);
+    s1subcat.define(outfile);
+    s1localsubcat.define(outfile);
+    s1mtv.define(outfile);
+    s1ltv.define(outfile);
+    s1date.define(outfile);
+    s1time.define(outfile);
+    sec1.define(outfile);
+    sec2.define(outfile);
+    arrays.define(outfile);
+}
+
+void NCFiller::putvar(NCOutfile& outfile)
+{
+    edition.putvar(outfile);
+    s1mtn.putvar(outfile);
+    s1ce.putvar(outfile);
+    s1sc.putvar(outfile);
+    s1usn.putvar(outfile);
+    s1cat.putvar(outfile);
+    s1subcat.putvar(outfile);
+    s1localsubcat.putvar(outfile);
+    s1mtv.putvar(outfile);
+    s1ltv.putvar(outfile);
+    s1date.putvar(outfile);
+    s1time.putvar(outfile);
+    sec1.putvar(outfile);
+    sec2.putvar(outfile);
+    arrays.putvar(outfile);
+}
+
+void NCFiller::set_stats(KeyStats* stats)
+{
+    this->stats = stats;
+    arrays.stats = stats;
+}
+
+void NCFiller::count_stats() const
+{
+    if (stats)
+        stats->count_cells(arrays.plan, record_count());
+}
+
+void NCFiller::write(NCOutfile& outfile)
+{
+    TraceSpan span(outfile.trace, "write", outfile.fname);
+    try {
+        // Define all other dimensions, variables and attributes
+        {
+            PhaseTimer timer(stats, Phase::DEFINE);
+            TraceSpan span(outfile.trace, "define");
+            define(outfile);
+        }
+
+        // End define mode
+        {
+            PhaseTimer timer(stats, Phase::ENDDEF);
+            TraceSpan span(outfile.trace, "enddef");
+            outfile.end_define_mode();
+        }
+
+        // Put variables
+        {
+            PhaseTimer timer(stats, Phase::PUTVAR);
+            TraceSpan span(outfile.trace, "putvar");
+            putvar(outfile);
+        }
+
+        if (stats)
+        {
+            count_stats();
+            stats->count_variable_bytes(outfile.ncid);
+        }
+
+        PhaseTimer timer(stats, Phase::CLOSE);
+        TraceSpan close_span(outfile.trace, "close");
+        outfile.close();
+    } catch (...) {
+        // Close the file anyway in case of error, so we don't try to write
+        // things out again in the destructor
+        outfile.close();
+        throw;
+    }
+}
+
+void NCFiller::columns(std::vector<Column>& out) const
+{
+    edition.columns(out);
+    s1mtn.columns(out);
+    s1ce.columns(out);
+    s1sc.columns(out);
+    s1usn.columns(out);
+    s1cat.columns(out);
+    s1subcat.columns(out);
+    s1localsubcat.columns(out);
+    s1mtv.columns(out);
+    s1ltv.columns(out);
+    s1date.columns(out);
+    s1time.columns(out);
+    sec1.columns(out);
+    sec2.columns(out);
+    arrays.columns(out);
+}
+
+void NCFiller::memory_usage(MemoryUsage& out) const
+{
+    for (const IntArray* arr: { &edition, &s1mtn, &s1ce, &s1sc, &s1usn, &s1cat, &s1subcat,
+                                &s1localsubcat, &s1mtv, &s1ltv, &s1date, &s1time })
+        out.add(arr->name, arr->heap_size());
+    out.add("section1", sec1.heap_size());
+    out.add("section2", sec2.heap_size());
+    arrays.memory_usage(out);
+}
+
+void NCFiller::sparsity(OutputSparsity& out) const
+{
+    out.analyse(arrays.plan, record_count());
 }
 
 }
@@ -29,6 +29,7 @@
 #include <string>
 #include <vector>
 #include <map>
+#include <memory>
 #include <cstdio>
 
 namespace wreport {
@@ -42,6 +43,9 @@ namespace b2nc {
 
 struct Options;
 struct NCOutfile;
+struct KeyStats;
+struct MemoryUsage;
+struct OutputSparsity;
 
 /**
  * Constructs and holds NetCDF arrays from BUFR bulletins
@@ -68,6 +72,9 @@ struct Arrays
     bool verbose;
     bool debug;
 
+    /// If set, add timings and counters of plans and arrays to it
+    KeyStats* stats = nullptr;
+
     /*
      * Keep a copy of the first bulletin that we use to generate the plan, as
      * the plan's temporay Varinfos will be managed by it
@@ -79,9 +86,27 @@ struct Arrays
 
     /**
      * Adds all the subsets for a bulletin.
+     *
+     * Bulletins with many subsets are split in ranges converted by up to
+     * Options::jobs threads.
      */
     void add(std::unique_ptr<wreport::Bulletin>&& bulletin);
 
+    /**
+     * Add the subsets of a bulletin splitting them in \a ranges ranges, each
+     * converted by its own thread into a copy of the plan, and then merged
+     * in order
+     */
+    void add_parallel(const wreport::Bulletin& bulletin, unsigned ranges);
+
+    /**
+     * Add the values of the arrays of \a part, built with a copy of our plan,
+     * with their record indices shifted by \a offset.
+     *
+     * bufr_idx is not changed.
+     */
+    void merge(const Arrays& part, unsigned offset);
+
     /**
      * Define variables for these arrays on a NetCDF file in define mode
      */
@@ -93,6 +118,27 @@ struct Arrays
      */
     void putvar(NCOutfile& outfile) const;
 
+    /**
+     * Append to \a out the description of all the output variables, in the
+     * same order as define() would create them
+     */
+    void columns(std::vector<Column>& out) const;
+
+    /// Compute the value of the DATE variable for a record
+    int date_value(size_t idx) const;
+    /// Compute the value of the TIME variable for a record
+    int time_value(size_t idx) const;
+    /// Append the attributes of the DATE variable to \a out
+    void date_attributes(Attributes& out) const;
+    /// Append the attributes of the TIME variable to \a out
+    void time_attributes(Attributes& out) const;
+
+    /**
+     * Add to \a out the heap memory used by the plan, by each array, and by
+     * the first bulletin
+     */
+    void memory_usage(MemoryUsage& out) const;
+
     void dump(FILE* out);
 };
 
@@ -111,6 +157,12 @@ struct Sections
 
     bool define(NCOutfile& outfile);
     void putvar(NCOutfile& outfile) const;
+
+    /// Append the output variable description to \a out, if it has data
+    void columns(std::vector<Column>& out) const;
+
+    /// Heap memory used by the values, including vector slack
+    size_t heap_size() const;
 };
 
 /**
@@ -129,6 +181,77 @@ struct IntArray
 
     bool define(NCOutfile& outfile);
     void putvar(NCOutfile& outfile) const;
+
+    /// Append the output variable description to \a out, if it has data
+    void columns(std::vector<Column>& out) const;
+
+    /// Heap memory used by the name and values, including vector slack
+    size_t heap_size() const;
+};
+
+/**
+ * Collect data from BUFR bulletins, organise them in NetCDF-style arrays, and
+ * write a NetCDF file with the resulting arrays
+ */
+struct NCFiller
+{
+    Arrays arrays;
+    Sections sec1;
+    Sections sec2;
+    IntArray edition;
+    IntArray s1mtn;
+    IntArray s1ce;
+    IntArray s1sc;
+    IntArray s1usn;
+    IntArray s1cat;
+    IntArray s1subcat;
+    IntArray s1localsubcat;
+    IntArray s1mtv;
+    IntArray s1ltv;
+    IntArray s1date;
+    IntArray s1time;
+
+    /// If set, add timings and counters of the conversion to it
+    KeyStats* stats = nullptr;
+
+    NCFiller(const Options& opts);
+
+    /// Collect timings and counters of the conversion in \a stats
+    void set_stats(KeyStats* stats);
+
+    /**
+     * Add the values, replications and padding of the arrays collected so
+     * far to stats, if set
+     */
+    void count_stats() const;
+
+    void add(std::unique_ptr<wreport::BufrBulletin>&& bulletin, const std::string& raw);
+
+    /// Number of records (BUFR subsets) seen so far
+    size_t record_count() const { return edition.values.size(); }
+
+    void define(NCOutfile& outfile);
+    void putvar(NCOutfile& outfile);
+
+    /**
+     * Define and write all variables to a NetCDF file that has just been
+     * opened, and close it.
+     *
+     * The file is closed also in case of errors.
+     */
+    void write(NCOutfile& outfile);
+
+    /**
+     * Describe all output variables, in the same order as define() creates
+     * them, for backends that do not write through the NetCDF library
+     */
+    void columns(std::vector<Column>& out) const;
+
+    /// Add to \a out the heap memory used by each part of the output
+    void memory_usage(MemoryUsage& out) const;
+
+    /// Analyse the padding and missing values of the arrays
+    void sparsity(OutputSparsity& out) const;
 };
 
 }
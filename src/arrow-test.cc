@@ -0,0 +1,91 @@
+/*
+ * Copyright (C) 2026  ARPA-SIM <urpsim@smr.arpa.emr.it>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#include "arrow.h"
+#include "convert.h"
+#include "options.h"
+#include "tests/tests.h"
+#include <wreport/utils/sys.h>
+#include <cstdint>
+#include <cstring>
+
+using namespace b2nc;
+using namespace wreport;
+using namespace wreport::tests;
+using namespace std;
+
+namespace {
+
+static const char* testfname = "test-arrow.arrow";
+
+string convert(const Options& opts, const std::string& testname)
+{
+    unique_ptr<Outfile> outfile = Outfile::get(opts);
+    outfile->open(testfname);
+    read_bufr(b2nc::tests::datafile("bufr/" + testname), *outfile);
+    outfile->close();
+    return sys::read_file(testfname);
+}
+
+void check_file_structure(const std::string& data)
+{
+    wassert(actual(data.size()) > 20u);
+    wassert(actual(data.substr(0, 8)) == string("ARROW1\0\0", 8));
+    wassert(actual(data.substr(data.size() - 6)) == "ARROW1");
+
+    // Footer length is stored before the trailing magic number
+    uint32_t footer_size =
+          (unsigned char)data[data.size() - 10]
+        | (unsigned char)data[data.size() - 9] << 8
+        | (unsigned char)data[data.size() - 8] << 16
+        | (unsigned)(unsigned char)data[data.size() - 7] << 24;
+    wassert(actual(footer_size) > 0u);
+    wassert(actual(footer_size % 8) == 0u);
+    wassert(actual(footer_size) < data.size() - 18);
+}
+
+class Tests : public TestCase
+{
+    using TestCase::TestCase;
+
+    void register_tests() override
+    {
+        add_method("synop", []() {
+            Options opts;
+            opts.format = "arrow";
+            string data = convert(opts, "cdfin_synop");
+            wassert(check_file_structure(data));
+            wassert(actual(data).contains("edition_number"));
+            wassert(actual(data).contains("mnemonic"));
+        });
+
+        add_method("batches", []() {
+            // Output is the same regardless of the number of threads
+            Options opts;
+            opts.format = "arrow";
+            opts.arrow_batch_records = 2;
+            string data = convert(opts, "cdfin_temp");
+            wassert(check_file_structure(data));
+            wassert(actual(data).contains("Loop_000_maxlen"));
+
+            opts.jobs = 4;
+            wassert(actual(convert(opts, "cdfin_temp")) == data);
+        });
+    }
+} tests("arrow");
+
+}
@@ -0,0 +1,664 @@
+/*
+ * arrow - Write converted data as an Arrow IPC file
+ *
+ * Copyright (C) 2026  ARPA-SIM <urpsim@smr.arpa.emr.it>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#include "arrow.h"
+#include "columnio.h"
+#include "convert.h"
+#include "arrays.h"
+#include "options.h"
+#include "instruments.h"
+#include "stats.h"
+#include "threads.h"
+#include "trace.h"
+#include <wreport/error.h>
+#include <wreport/bulletin.h>
+#include <netcdf.h>
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+
+using namespace wreport;
+using namespace std;
+
+namespace b2nc {
+
+namespace {
+
+/*
+ * Minimal FlatBuffers encoder, enough to write Arrow IPC metadata.
+ *
+ * Objects are laid out front to back: each table is written after its
+ * vtable, and followed by the objects it references, so that all offsets
+ * point forward as required by the format. FlatBuffers data is always little
+ * endian.
+ */
+namespace fb {
+
+void put_le(std::string& buf, size_t pos, uint64_t val, unsigned size)
+{
+    for (unsigned i = 0; i < size; ++i)
+        buf[pos + i] = (char)((val >> (8 * i)) & 0xff);
+}
+
+void append_le(std::string& buf, uint64_t val, unsigned size)
+{
+    size_t pos = buf.size();
+    buf.append(size, 0);
+    put_le(buf, pos, val, size);
+}
+
+void pad_to(std::string& buf, size_t align)
+{
+    if (buf.size() % align)
+        buf.append(align - buf.size() % align, 0);
+}
+
+struct Node
+{
+    virtual ~Node() {}
+
+    /// Append the object to \a buf, returning the position to reference
+    virtual size_t write(std::string& buf) const = 0;
+};
+
+typedef std::shared_ptr<Node> Ref;
+
+/// Write \a ref and store a reference to it at \a pos
+void write_ref(std::string& buf, size_t pos, const Ref& ref)
+{
+    size_t target = ref->write(buf);
+    put_le(buf, pos, target - pos, 4);
+}
+
+struct Table : public Node
+{
+    struct Field
+    {
+        unsigned id;
+        unsigned size;
+        uint64_t value;
+        Ref ref;
+    };
+    std::vector<Field> fields;
+
+    Table& scalar(unsigned id, unsigned size, uint64_t value)
+    {
+        fields.push_back(Field{id, size, value, Ref()});
+        return *this;
+    }
+    Table& ref(unsigned id, Ref ref)
+    {
+        fields.push_back(Field{id, 4, 0, ref});
+        return *this;
+    }
+
+    size_t write(std::string& buf) const override
+    {
+        // Lay out fields by decreasing size, so that they are all aligned
+        std::vector<const Field*> sorted;
+        for (const auto& f: fields)
+            sorted.push_back(&f);
+        stable_sort(sorted.begin(), sorted.end(), [](const Field* a, const Field* b) { return a->size > b->size; });
+
+        unsigned slots = 0;
+        std::vector<unsigned> offsets(fields.size());
+        unsigned size = 4;
+        for (const Field* f: sorted)
+        {
+            if (size % f->size)
+                size += f->size - size % f->size;
+            offsets[f - fields.data()] = size;
+            size += f->size;
+            if (f->id + 1 > slots) slots = f->id + 1;
+        }
+        if (size % 4)
+            size += 4 - size % 4;
+
+        // vtable
+        pad_to(buf, 2);
+        size_t vt_pos = buf.size();
+        std::vector<unsigned> slot_offsets(slots, 0);
+        for (size_t i = 0; i < fields.size(); ++i)
+            slot_offsets[fields[i].id] = offsets[i];
+        append_le(buf, 4 + 2 * slots, 2);
+        append_le(buf, size, 2);
+        for (unsigned o: slot_offsets)
+            append_le(buf, o, 2);
+
+        // Table, aligned so that 8 byte fields are aligned
+        pad_to(buf, 8);
+        size_t pos = buf.size();
+        buf.append(size, 0);
+        put_le(buf, pos, pos - vt_pos, 4);
+        for (size_t i = 0; i < fields.size(); ++i)
+            if (!fields[i].ref)
+                put_le(buf, pos + offsets[i], fields[i].value, fields[i].size);
+
+        // Referenced objects
+        for (size_t i = 0; i < fields.size(); ++i)
+            if (fields[i].ref)
+                write_ref(buf, pos + offsets[i], fields[i].ref);
+
+        return pos;
+    }
+};
+
+struct String : public Node
+{
+    std::string value;
+
+    explicit String(const std::string& value) : value(value) {}
+
+    size_t write(std::string& buf) const override
+    {
+        pad_to(buf, 4);
+        size_t pos = buf.size();
+        append_le(buf, value.size(), 4);
+        buf += value;
+        buf += '\0';
+        return pos;
+    }
+};
+
+/// Vector of references to other objects
+struct Vector : public Node
+{
+    std::vector<Ref> items;
+
+    size_t write(std::string& buf) const override
+    {
+        pad_to(buf, 4);
+        size_t pos = buf.size();
+        append_le(buf, items.size(), 4);
+        buf.append(4 * items.size(), 0);
+        for (size_t i = 0; i < items.size(); ++i)
+            write_ref(buf, pos + 4 + 4 * i, items[i]);
+        return pos;
+    }
+};
+
+/// Vector of structs, given as already encoded data
+struct StructVector : public Node
+{
+    size_t count = 0;
+    std::string data;
+
+    size_t write(std::string& buf) const override
+    {
+        // All structs used here need 8 byte alignment
+        while ((buf.size() + 4) % 8)
+            buf += '\0';
+        size_t pos = buf.size();
+        append_le(buf, count, 4);
+        buf += data;
+        return pos;
+    }
+};
+
+std::shared_ptr<Table> table() { return std::make_shared<Table>(); }
+Ref string(const std::string& val) { return std::make_shared<String>(val); }
+
+/// Encode a buffer with \a root as its root table
+std::string finish(const Ref& root)
+{
+    std::string buf(4, 0);
+    write_ref(buf, 0, root);
+    pad_to(buf, 8);
+    return buf;
+}
+
+}
+
+// Constants from the Arrow format definitions (Schema.fbs, Message.fbs)
+const int16_t METADATA_V5 = 4;
+const uint8_t HEADER_SCHEMA = 1;
+const uint8_t HEADER_RECORD_BATCH = 3;
+const uint8_t TYPE_INT = 2;
+const uint8_t TYPE_FLOATING_POINT = 3;
+const uint8_t TYPE_BINARY = 4;
+const uint8_t TYPE_UTF8 = 5;
+const uint8_t TYPE_LIST = 12;
+const int16_t PRECISION_SINGLE = 1;
+const int16_t PRECISION_DOUBLE = 2;
+
+/// Format an attribute value as a metadata string
+std::string attribute_text(const Attribute& attr)
+{
+    std::string res;
+    char buf[32];
+    switch (attr.type)
+    {
+        case VT_INT:
+            for (int val: attr.ints)
+            {
+                if (!res.empty()) res += ",";
+                res += to_string(val);
+            }
+            break;
+        case VT_FLOAT:
+        case VT_DOUBLE:
+            for (double val: attr.reals)
+            {
+                if (!res.empty()) res += ",";
+                snprintf(buf, 32, attr.type == VT_FLOAT ? "%.9g" : "%.17g", val);
+                res += buf;
+            }
+            break;
+        case VT_STRING:
+        case VT_BYTES:
+            res = attr.text;
+            break;
+    }
+    return res;
+}
+
+fb::Ref key_value(const std::string& key, const std::string& value)
+{
+    auto res = fb::table();
+    res->ref(0, fb::string(key));
+    res->ref(1, fb::string(value));
+    return res;
+}
+
+/// Field metadata with the attributes of a column
+fb::Ref arrow_metadata(const Column& col)
+{
+    auto res = std::make_shared<fb::Vector>();
+    for (const auto& attr: col.attributes)
+    {
+        // Missing values are represented as nulls
+        if (attr.name == "_FillValue") continue;
+        res->items.push_back(key_value(attr.name, attribute_text(attr)));
+    }
+    if (!col.loop_dim.empty())
+        res->items.push_back(key_value("loop_dim", col.loop_dim));
+    return res;
+}
+
+std::shared_ptr<fb::Table> arrow_field(const std::string& name, ValType type)
+{
+    auto res = fb::table();
+    res->ref(0, fb::string(name));
+    res->scalar(1, 1, 1); // nullable
+
+    auto t = fb::table();
+    switch (type)
+    {
+        case VT_INT:
+            res->scalar(2, 1, TYPE_INT);
+            t->scalar(0, 4, 32).scalar(1, 1, 1);
+            break;
+        case VT_FLOAT:
+            res->scalar(2, 1, TYPE_FLOATING_POINT);
+            t->scalar(0, 2, PRECISION_SINGLE);
+            break;
+        case VT_DOUBLE:
+            res->scalar(2, 1, TYPE_FLOATING_POINT);
+            t->scalar(0, 2, PRECISION_DOUBLE);
+            break;
+        case VT_STRING:
+            res->scalar(2, 1, TYPE_UTF8);
+            break;
+        case VT_BYTES:
+            res->scalar(2, 1, TYPE_BINARY);
+            break;
+    }
+    res->ref(3, t);
+    // Readers require children to be present, even if empty
+    res->ref(5, std::make_shared<fb::Vector>());
+    return res;
+}
+
+fb::Ref arrow_field(const Column& col)
+{
+    std::shared_ptr<fb::Table> res;
+    if (col.loop_dim.empty())
+        res = arrow_field(col.name, col.type);
+    else
+    {
+        // Replicated values become a list
+        res = fb::table();
+        res->ref(0, fb::string(col.name));
+        res->scalar(1, 1, 1); // nullable
+        res->scalar(2, 1, TYPE_LIST);
+        res->ref(3, fb::table());
+        auto children = std::make_shared<fb::Vector>();
+        children->items.push_back(arrow_field("item", col.type));
+        res->ref(5, children);
+    }
+    res->ref(6, arrow_metadata(col));
+    return res;
+}
+
+fb::Ref arrow_schema(const std::vector<Column>& columns)
+{
+    auto fields = std::make_shared<fb::Vector>();
+    for (const auto& col: columns)
+        fields->items.push_back(arrow_field(col));
+    auto res = fb::table();
+    res->scalar(0, 2, is_little_endian() ? 0 : 1);
+    res->ref(1, fields);
+    return res;
+}
+
+/// Location of a message in the file, as stored in the footer
+struct Block
+{
+    int64_t offset;
+    int32_t metadata_length;
+    int64_t body_length;
+};
+
+/// Field nodes and body buffers for the values of one column in a batch
+struct EncodedColumn
+{
+    /// Length and null count of each node
+    std::vector<std::pair<int64_t, int64_t>> nodes;
+    std::vector<std::string> buffers;
+};
+
+template<typename T>
+void append_raw(std::string& out, const T& val)
+{
+    out.append((const char*)&val, sizeof(T));
+}
+
+/// Encode values [begin, end) of \a data as a primitive or binary array
+void encode_values(ValType type, const ColumnData& data, size_t begin, size_t end, EncodedColumn& out)
+{
+    size_t count = end - begin;
+    std::string validity((count + 7) / 8, 0);
+    std::string offsets;
+    std::string values;
+    int64_t nulls = 0;
+
+    if (type == VT_STRING || type == VT_BYTES)
+        append_raw(offsets, (int32_t)0);
+
+    for (size_t i = begin; i < end; ++i)
+    {
+        bool valid = true;
+        switch (type)
+        {
+            case VT_INT:
+                valid = data.ints[i] != NC_FILL_INT;
+                append_raw(values, valid ? data.ints[i] : 0);
+                break;
+            case VT_FLOAT:
+                valid = data.floats[i] != NC_FILL_FLOAT;
+                append_raw(values, valid ? data.floats[i] : 0.0f);
+                break;
+            case VT_DOUBLE:
+                valid = data.doubles[i] != NC_FILL_DOUBLE;
+                append_raw(values, valid ? data.doubles[i] : 0.0);
+                break;
+            case VT_STRING:
+            case VT_BYTES:
+                valid = !data.strings[i].empty();
+                values += data.strings[i];
+                if (values.size() > INT32_MAX)
+                    throw error_consistency("too much string data in a single Arrow record batch");
+                append_raw(offsets, (int32_t)values.size());
+                break;
+        }
+        if (valid)
+            validity[(i - begin) / 8] |= (char)(1 << ((i - begin) % 8));
+        else
+            ++nulls;
+    }
+
+    out.nodes.push_back(make_pair((int64_t)count, nulls));
+    // The validity bitmap can be omitted if there are no nulls
+    out.buffers.push_back(nulls ? validity : std::string());
+    if (type == VT_STRING || type == VT_BYTES)
+        out.buffers.push_back(offsets);
+    out.buffers.push_back(values);
+}
+
+void encode_column(const Column& col, const ColumnData& data, EncodedColumn& out)
+{
+    size_t records = data.records();
+    if (col.loop_dim.empty())
+    {
+        encode_values(col.type, data, 0, records, out);
+        return;
+    }
+
+    // List of values, never null itself
+    std::string offsets;
+    for (size_t o: data.offsets)
+    {
+        if (o > INT32_MAX)
+            throw error_consistency("too many values in a single Arrow record batch");
+        append_raw(offsets, (int32_t)o);
+    }
+    out.nodes.push_back(make_pair((int64_t)records, (int64_t)0));
+    out.buffers.push_back(std::string());
+    out.buffers.push_back(offsets);
+    encode_values(col.type, data, 0, data.offsets.back(), out);
+}
+
+/**
+ * Write an output file as an Arrow IPC file.
+ *
+ * Data is accumulated by an NCFiller, and everything is written on close().
+ */
+struct ArrowOutfile : public Outfile
+{
+    const Options& opts;
+    NCFiller filler;
+    std::string fname;
+    FILE* out = nullptr;
+    size_t pos = 0;
+
+    explicit ArrowOutfile(const Options& opts)
+        : opts(opts), filler(opts)
+    {
+    }
+
+    ~ArrowOutfile()
+    {
+        close();
+    }
+
+    void open(const std::string& fname) override
+    {
+        this->fname = fname;
+        out = fopen(fname.c_str(), "wb");
+        if (!out)
+            error_system::throwf("cannot open %s", fname.c_str());
+        pos = 0;
+    }
+
+    void close() override
+    {
+        if (!out)
+            return;
+        try {
+            write();
+        } catch (...) {
+            fclose(out);
+            out = nullptr;
+            throw;
+        }
+        if (fclose(out) != 0)
+        {
+            out = nullptr;
+            error_system::throwf("cannot close %s", fname.c_str());
+        }
+        out = nullptr;
+    }
+
+    void add_bufr(std::unique_ptr<wreport::BufrBulletin>&& bulletin, const std::string& raw) override
+    {
+        filler.add(move(bulletin), raw);
+    }
+
+    void set_stats(KeyStats* stats) override
+    {
+        filler.set_stats(stats);
+    }
+
+    void memory_usage(MemoryUsage& out) const override
+    {
+        filler.memory_usage(out);
+    }
+
+    void sparsity(OutputSparsity& out) const override
+    {
+        filler.sparsity(out);
+    }
+
+    void write_raw(const std::string& data)
+    {
+        if (fwrite(data.data(), data.size(), 1, out) != 1 && !data.empty())
+            error_system::throwf("cannot write %zu bytes to %s", data.size(), fname.c_str());
+        pos += data.size();
+    }
+
+    /// Write an encapsulated IPC message
+    Block write_message(const std::string& metadata, const std::string& body)
+    {
+        Block res;
+        res.offset = pos;
+        std::string prefix;
+        fb::append_le(prefix, 0xffffffff, 4);
+        fb::append_le(prefix, metadata.size(), 4);
+        write_raw(prefix);
+        write_raw(metadata);
+        write_raw(body);
+        res.metadata_length = prefix.size() + metadata.size();
+        res.body_length = body.size();
+        return res;
+    }
+
+    Block write_batch(const std::vector<EncodedColumn>& encoded, size_t length)
+    {
+        auto nodes = std::make_shared<fb::StructVector>();
+        auto buffers = std::make_shared<fb::StructVector>();
+        std::string body;
+        for (const auto& col: encoded)
+        {
+            for (const auto& n: col.nodes)
+            {
+                fb::append_le(nodes->data, n.first, 8);
+                fb::append_le(nodes->data, n.second, 8);
+                ++nodes->count;
+            }
+            for (const auto& b: col.buffers)
+            {
+                fb::append_le(buffers->data, body.size(), 8);
+                fb::append_le(buffers->data, b.size(), 8);
+                ++buffers->count;
+                body += b;
+                fb::pad_to(body, 8);
+            }
+        }
+
+        auto batch = fb::table();
+        batch->scalar(0, 8, length);
+        batch->ref(1, nodes);
+        batch->ref(2, buffers);
+
+        auto message = fb::table();
+        message->scalar(0, 2, METADATA_V5);
+        message->scalar(1, 1, HEADER_RECORD_BATCH);
+        message->ref(2, batch);
+        message->scalar(3, 8, body.size());
+        return write_message(fb::finish(message), body);
+    }
+
+    void write()
+    {
+        TraceSpan span(instruments(opts).trace, "write");
+        std::vector<Column> columns;
+        filler.columns(columns);
+        size_t records = filler.record_count();
+        filler.count_stats();
+        size_t batch_size = opts.arrow_batch_records ? opts.arrow_batch_records : 1;
+
+        write_raw(std::string("ARROW1\0\0", 8));
+
+        auto message = fb::table();
+        message->scalar(0, 2, METADATA_V5);
+        message->scalar(1, 1, HEADER_SCHEMA);
+        message->ref(2, arrow_schema(columns));
+        message->scalar(3, 8, 0);
+        write_message(fb::finish(message), std::string());
+
+        std::vector<Block> blocks;
+        for (size_t first = 0; first < records; first += batch_size)
+        {
+            size_t count = min(batch_size, records - first);
+            std::vector<EncodedColumn> encoded(columns.size());
+            parallel_for(opts.jobs, columns.size(), [&](size_t i) {
+                TraceSpan span(instruments(opts).trace, "putvar", columns[i].name);
+                ColumnData data;
+                columns[i].collect(first, count, data);
+                encode_column(columns[i], data, encoded[i]);
+                if (filler.stats)
+                {
+                    size_t bytes = 0;
+                    for (const auto& b: encoded[i].buffers)
+                        bytes += b.size();
+                    filler.stats->add_variable_bytes(columns[i].name, bytes);
+                }
+            });
+            blocks.push_back(write_batch(encoded, count));
+        }
+
+        // End of stream marker
+        std::string eos;
+        fb::append_le(eos, 0xffffffff, 4);
+        fb::append_le(eos, 0, 4);
+        write_raw(eos);
+
+        // Footer
+        auto record_batches = std::make_shared<fb::StructVector>();
+        for (const auto& b: blocks)
+        {
+            fb::append_le(record_batches->data, b.offset, 8);
+            fb::append_le(record_batches->data, b.metadata_length, 4);
+            fb::append_le(record_batches->data, 0, 4);
+            fb::append_le(record_batches->data, b.body_length, 8);
+            ++record_batches->count;
+        }
+        auto footer = fb::table();
+        footer->scalar(0, 2, METADATA_V5);
+        footer->ref(1, arrow_schema(columns));
+        footer->ref(2, std::make_shared<fb::StructVector>());
+        footer->ref(3, record_batches);
+        std::string encoded_footer = fb::finish(footer);
+        write_raw(encoded_footer);
+        std::string trailer;
+        fb::append_le(trailer, encoded_footer.size(), 4);
+        trailer += "ARROW1";
+        write_raw(trailer);
+    }
+};
+
+}
+
+std::unique_ptr<Outfile> make_arrow_outfile(const Options& opts)
+{
+    return unique_ptr<Outfile>(new ArrowOutfile(opts));
+}
+
+}
@@ -0,0 +1,43 @@
+/*
+ * arrow - Write converted data as an Arrow IPC file
+ *
+ * Copyright (C) 2026  ARPA-SIM <urpsim@smr.arpa.emr.it>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#ifndef B2NC_ARROW_H
+#define B2NC_ARROW_H
+
+#include <memory>
+
+namespace b2nc {
+
+struct Options;
+struct Outfile;
+
+/**
+ * Create an Outfile that writes an Arrow IPC file (also known as Feather
+ * version 2).
+ *
+ * Every output variable becomes a column, with its attributes as field
+ * metadata. Missing values become nulls, and replicated variables become
+ * list columns. Data is split in record batches of
+ * Options::arrow_batch_records records.
+ */
+std::unique_ptr<Outfile> make_arrow_outfile(const Options& opts);
+
+}
+
+#endif
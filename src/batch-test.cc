@@ -0,0 +1,90 @@
+/*
+ * Copyright (C) 2026  ARPA-SIM <urpsim@smr.arpa.emr.it>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#include "batch.h"
+#include "options.h"
+#include "tests/tests.h"
+#include <map>
+
+using namespace b2nc;
+using namespace wreport;
+using namespace wreport::tests;
+using namespace std;
+
+namespace {
+
+/// Record what is received, checking each batch
+struct CheckingSink : public BatchSink
+{
+    unsigned batches = 0;
+    /// Records received, by output name
+    map<string, size_t> records;
+
+    void add_batch(ColumnBatch& batch) override
+    {
+        ++batches;
+        // Batches of an output come in order
+        wassert(actual(batch.first_record) == records[batch.name]);
+        records[batch.name] += batch.records;
+
+        wassert(actual(batch.columns.size()) > 0u);
+        wassert(actual(batch.columns[0].column.name) == "edition_number");
+        wassert_true(batch.columns[0].info == nullptr);
+
+        bool found_bufr_var = false;
+        for (const auto& col: batch.columns)
+        {
+            wassert(actual(col.values.records()) == batch.records);
+            if (col.info) found_bufr_var = true;
+        }
+        wassert_true(found_bufr_var);
+    }
+};
+
+class Tests : public TestCase
+{
+    using TestCase::TestCase;
+
+    void register_tests() override
+    {
+        add_method("batches", []() {
+            Options opts;
+
+            // Everything in one batch per output
+            CheckingSink whole;
+            {
+                BatchDispatcher dispatcher(opts, whole, 1000000);
+                read_bufr(b2nc::tests::datafile("bufr/cdfin_acars"), dispatcher);
+                wassert(actual(whole.batches) == 0u);
+                dispatcher.flush();
+            }
+            wassert(actual(whole.batches) == whole.records.size());
+
+            // One batch per bulletin
+            CheckingSink split;
+            {
+                BatchDispatcher dispatcher(opts, split, 1);
+                read_bufr(b2nc::tests::datafile("bufr/cdfin_acars"), dispatcher);
+                dispatcher.flush();
+            }
+            wassert(actual(split.batches) >= whole.batches);
+            wassert_true(split.records == whole.records);
+        });
+    }
+} test("batch");
+
+}
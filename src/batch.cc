@@ -0,0 +1,124 @@
+/*
+ * batch - Stream converted records to in-process consumers
+ *
+ * Copyright (C) 2026  ARPA-SIM <urpsim@smr.arpa.emr.it>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#include "batch.h"
+#include "arrays.h"
+#include <wreport/bulletin.h>
+
+using namespace wreport;
+using namespace std;
+
+namespace b2nc {
+
+struct BatchDispatcher::Stream
+{
+    std::string name;
+    int data_category;
+    int data_subcategory;
+    int data_subcategory_local;
+    size_t first_record = 0;
+    std::unique_ptr<NCFiller> filler;
+};
+
+void make_batch(const NCFiller& filler, ColumnBatch& out)
+{
+    // BUFR variables of the output variables coming from the plan
+    map<string, Varinfo> infos;
+    for (const auto& section: filler.arrays.plan.sections)
+        for (const auto& v: section->entries)
+            for (const ValArray* arr: { v->data, v->qbits })
+                if (arr)
+                    infos[arr->name] = arr->info;
+
+    vector<Column> columns;
+    filler.columns(columns);
+
+    out.records = filler.record_count();
+    out.columns.clear();
+    out.columns.resize(columns.size());
+    for (size_t i = 0; i < columns.size(); ++i)
+    {
+        BatchColumn& col = out.columns[i];
+        columns[i].collect(0, out.records, col.values);
+        col.column = move(columns[i]);
+        col.column.collect = nullptr;
+        auto info = infos.find(col.column.name);
+        if (info != infos.end())
+            col.info = info->second;
+    }
+}
+
+BatchDispatcher::BatchDispatcher(const Options& opts, BatchSink& out, size_t batch_records)
+    : opts(opts), out(out), batch_records(batch_records)
+{
+}
+
+BatchDispatcher::~BatchDispatcher()
+{
+}
+
+void BatchDispatcher::add_bufr(std::unique_ptr<wreport::BufrBulletin>&& bulletin, const std::string& raw)
+{
+    Dispatcher::Key key(*bulletin);
+    auto i = streams.find(key);
+    if (i == streams.end())
+    {
+        unique_ptr<Stream> stream(new Stream);
+        stream->name = output_name(*bulletin, used_names);
+        stream->data_category = bulletin->data_category;
+        stream->data_subcategory = bulletin->data_subcategory;
+        stream->data_subcategory_local = bulletin->data_subcategory_local;
+        stream->filler.reset(new NCFiller(opts));
+        i = streams.insert(make_pair(key, move(stream))).first;
+    }
+
+    Stream& stream = *i->second;
+    stream.filler->add(move(bulletin), raw);
+    if (stream.filler->record_count() >= batch_records)
+        flush(stream);
+}
+
+void BatchDispatcher::flush(Stream& stream)
+{
+    if (stream.filler->record_count() == 0)
+        return;
+
+    ColumnBatch batch;
+    batch.name = stream.name;
+    batch.data_category = stream.data_category;
+    batch.data_subcategory = stream.data_subcategory;
+    batch.data_subcategory_local = stream.data_subcategory_local;
+    batch.first_record = stream.first_record;
+    make_batch(*stream.filler, batch);
+
+    // The Varinfos in the batch can belong to the filler, which is only
+    // replaced after the consumer has run
+    out.add_batch(batch);
+
+    stream.first_record += batch.records;
+    stream.filler.reset(new NCFiller(opts));
+}
+
+void BatchDispatcher::flush()
+{
+    for (auto& i: streams)
+        flush(*i.second);
+}
+
+}
@@ -0,0 +1,136 @@
+/*
+ * batch - Stream converted records to in-process consumers
+ *
+ * Copyright (C) 2026  ARPA-SIM <urpsim@smr.arpa.emr.it>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#ifndef B2NC_BATCH_H
+#define B2NC_BATCH_H
+
+#include "convert.h"
+#include "column.h"
+#include "options.h"
+#include <wreport/varinfo.h>
+#include <map>
+#include <memory>
+#include <set>
+#include <string>
+#include <vector>
+
+namespace b2nc {
+
+struct NCFiller;
+
+/// Values of one output variable in a ColumnBatch
+struct BatchColumn
+{
+    /// Description of the variable; its collect function is not set
+    Column column;
+    /**
+     * BUFR variable the values come from, or nullptr for variables built from
+     * the bulletin headers, like edition_number, DATE and TIME
+     */
+    wreport::Varinfo info = nullptr;
+    /**
+     * Values for all the records of the batch.
+     *
+     * For replicated variables, values.offsets gives the values of each
+     * record.
+     */
+    ColumnData values;
+};
+
+/**
+ * A range of records converted from bulletins with the same dispatch key
+ */
+struct ColumnBatch
+{
+    /// Name of the output the records belong to (see output_name())
+    std::string name;
+    int data_category = 0;
+    int data_subcategory = 0;
+    int data_subcategory_local = 0;
+    /// Position of the first record of the batch in its output
+    size_t first_record = 0;
+    /// Number of records in the batch
+    size_t records = 0;
+    std::vector<BatchColumn> columns;
+};
+
+/// Generic interface for consumers of column batches
+struct BatchSink
+{
+    virtual ~BatchSink() {}
+
+    /**
+     * Consume a batch.
+     *
+     * The batch is only valid during the call, and its columns and values
+     * can be moved out of it.
+     */
+    virtual void add_batch(ColumnBatch& batch) = 0;
+};
+
+/**
+ * Group bulletins like Dispatcher, and send their converted records to a
+ * BatchSink as soon as at least batch_records of them are available.
+ *
+ * Bulletins are not split across batches, so a batch can be larger than
+ * batch_records. After a batch is sent its records are freed, so memory use
+ * is bounded by the batch size rather than by the input size. Conversion
+ * plans are cached, so starting a new batch does not rebuild them.
+ *
+ * Since each batch is converted on its own, replicated variables in
+ * different batches of the same output can have a different loop size, and
+ * variables that have no values in a batch are not included in it.
+ */
+class BatchDispatcher : public BufrSink
+{
+protected:
+    struct Stream;
+
+    Options opts;
+    BatchSink& out;
+    size_t batch_records;
+    std::map<Dispatcher::Key, std::unique_ptr<Stream>> streams;
+    std::set<std::string> used_names;
+
+    /// Send the pending records of a stream, if any
+    void flush(Stream& stream);
+
+public:
+    BatchDispatcher(const Options& opts, BatchSink& out, size_t batch_records);
+    ~BatchDispatcher();
+
+    void add_bufr(std::unique_ptr<wreport::BufrBulletin>&& bulletin, const std::string& raw) override;
+
+    /// Send all pending records
+    void flush();
+
+    /// Number of outputs seen so far
+    size_t size() const { return streams.size(); }
+};
+
+/**
+ * Fill \a out with the values of all the records in \a filler.
+ *
+ * The name, categories and first_record of \a out are not changed.
+ */
+void make_batch(const NCFiller& filler, ColumnBatch& out);
+
+}
+
+#endif
@@ -0,0 +1,120 @@
+/*
+ * alloc - Count heap allocations
+ *
+ * Copyright (C) 2026  ARPA-SIM <urpsim@smr.arpa.emr.it>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#include "alloc.h"
+#include <atomic>
+#include <new>
+#include <cstdlib>
+
+namespace {
+
+std::atomic<size_t> alloc_count(0);
+std::atomic<size_t> alloc_bytes(0);
+
+inline void count_alloc(size_t size)
+{
+    alloc_count.fetch_add(1, std::memory_order_relaxed);
+    alloc_bytes.fetch_add(size, std::memory_order_relaxed);
+}
+
+void* counted_alloc(size_t size)
+{
+#ifndef __GLIBC__
+    // With glibc, malloc counts it
+    count_alloc(size);
+#endif
+    // malloc(0) may return NULL, which operator new must not
+    return malloc(size ? size : 1);
+}
+
+}
+
+#ifdef __GLIBC__
+extern "C" {
+
+void* __libc_malloc(size_t size);
+void* __libc_calloc(size_t nmemb, size_t size);
+void* __libc_realloc(void* ptr, size_t size);
+
+void* malloc(size_t size) noexcept
+{
+    count_alloc(size);
+    return __libc_malloc(size);
+}
+
+void* calloc(size_t nmemb, size_t size) noexcept
+{
+    count_alloc(nmemb * size);
+    return __libc_calloc(nmemb, size);
+}
+
+// Every realloc is counted, as it may move the data to a new allocation
+void* realloc(void* ptr, size_t size) noexcept
+{
+    count_alloc(size);
+    return __libc_realloc(ptr, size);
+}
+
+}
+#endif
+
+namespace b2nc {
+namespace bench {
+
+AllocStats alloc_stats()
+{
+    AllocStats res;
+    res.count = alloc_count.load(std::memory_order_relaxed);
+    res.bytes = alloc_bytes.load(std::memory_order_relaxed);
+    return res;
+}
+
+}
+}
+
+void* operator new(size_t size)
+{
+    if (void* res = counted_alloc(size))
+        return res;
+    throw std::bad_alloc();
+}
+
+void* operator new[](size_t size)
+{
+    if (void* res = counted_alloc(size))
+        return res;
+    throw std::bad_alloc();
+}
+
+void* operator new(size_t size, const std::nothrow_t&) noexcept
+{
+    return counted_alloc(size);
+}
+
+void* operator new[](size_t size, const std::nothrow_t&) noexcept
+{
+    return counted_alloc(size);
+}
+
+void operator delete(void* ptr) noexcept { free(ptr); }
+void operator delete[](void* ptr) noexcept { free(ptr); }
+void operator delete(void* ptr, size_t) noexcept { free(ptr); }
+void operator delete[](void* ptr, size_t) noexcept { free(ptr); }
+void operator delete(void* ptr, const std::nothrow_t&) noexcept { free(ptr); }
+void operator delete[](void* ptr, const std::nothrow_t&) noexcept { free(ptr); }
@@ -0,0 +1,56 @@
+/*
+ * alloc - Count heap allocations
+ *
+ * Copyright (C) 2026  ARPA-SIM <urpsim@smr.arpa.emr.it>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#ifndef B2NC_BENCH_ALLOC_H
+#define B2NC_BENCH_ALLOC_H
+
+#include <cstddef>
+
+namespace b2nc {
+namespace bench {
+
+/**
+ * Heap allocations made since the program started.
+ *
+ * Linking alloc.cc replaces the global operator new and delete of the whole
+ * program, including the libraries it uses, with versions that keep these
+ * counts. With glibc it also replaces malloc, calloc and realloc, so that
+ * the allocations of C libraries like NetCDF are counted too.
+ */
+struct AllocStats
+{
+    size_t count = 0;
+    size_t bytes = 0;
+
+    AllocStats operator-(const AllocStats& o) const
+    {
+        AllocStats res;
+        res.count = count - o.count;
+        res.bytes = bytes - o.bytes;
+        return res;
+    }
+};
+
+/// Return the allocations made so far
+AllocStats alloc_stats();
+
+}
+}
+
+#endif
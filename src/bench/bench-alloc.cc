@@ -0,0 +1,364 @@
+#include "bench.h"
+#include "alloc.h"
+#include "convert.h"
+#include "options.h"
+#include <wreport/bulletin.h>
+#include <wreport/error.h>
+#include <wreport/utils/sys.h>
+#include <wreport/utils/string.h>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <memory>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+
+#include "config.h"
+
+#ifdef HAS_GETOPT_LONG
+#include <getopt.h>
+#else
+#include <unistd.h>
+#endif
+
+using namespace b2nc;
+using namespace wreport;
+using namespace std;
+
+namespace {
+
+/// Allocations allowed per message when converting one test file
+struct Budget
+{
+    std::string file;
+    /// False for files listed with "-" instead of numbers, not measured yet
+    bool measured = false;
+    double allocs = 0;
+    double bytes = 0;
+};
+
+/// Format a budget value, or "-" if it has not been measured
+std::string format_budget(const Budget& budget, double value)
+{
+    if (!budget.measured)
+        return "-";
+    char buf[32];
+    snprintf(buf, 32, "%.0f", value);
+    return buf;
+}
+
+/**
+ * Read a budget file: one "file allocs/msg bytes/msg" line per dataset, with
+ * blank lines and lines starting with '#' ignored. Files whose budget has
+ * not been measured yet are listed as "file - -".
+ */
+std::vector<Budget> read_budgets(const std::string& fname)
+{
+    ifstream in(fname);
+    if (!in)
+        error_system::throwf("cannot open %s", fname.c_str());
+
+    vector<Budget> res;
+    string line;
+    unsigned lineno = 0;
+    while (getline(in, line))
+    {
+        ++lineno;
+        line = str::strip(line);
+        if (line.empty() || line[0] == '#')
+            continue;
+        istringstream fields(line);
+        Budget b;
+        string allocs, bytes;
+        if (!(fields >> b.file >> allocs >> bytes))
+            error_consistency::throwf("%s:%u: expected \"file allocs bytes\"", fname.c_str(), lineno);
+        if (allocs != "-" || bytes != "-")
+        {
+            char* end_allocs;
+            char* end_bytes;
+            b.allocs = strtod(allocs.c_str(), &end_allocs);
+            b.bytes = strtod(bytes.c_str(), &end_bytes);
+            if (*end_allocs || *end_bytes)
+                error_consistency::throwf("%s:%u: budgets must be numbers, or both \"-\" if not measured", fname.c_str(), lineno);
+            b.measured = true;
+        }
+        res.push_back(b);
+    }
+    return res;
+}
+
+/// Header of the budget file, kept when it is rewritten with --update
+const char* budgets_header =
+    "# Heap allocations allowed per message when converting each test file\n"
+    "# with bench-alloc, amortised over its messages replicated --scale times.\n"
+    "#\n"
+    "# Regenerate with: meson compile -C <builddir> alloc-budgets-update\n"
+    "# or: bench-alloc --update --budgets=<this file> --data=<test/bufr>\n"
+    "#\n"
+    "# Files listed with \"- -\" have not been measured yet, and fail the check.\n"
+    "#\n"
+    "# file allocs/msg bytes/msg\n";
+
+void write_budgets(const std::string& fname, const std::vector<Budget>& budgets)
+{
+    string out = budgets_header;
+    char buf[256];
+    for (const auto& b: budgets)
+    {
+        snprintf(buf, 256, "%-16s %12s %14s\n", b.file.c_str(),
+                format_budget(b, b.allocs).c_str(), format_budget(b, b.bytes).c_str());
+        out += buf;
+    }
+    sys::write_file_atomically(fname, out, 0666);
+}
+
+/// Allocations of each stage of a conversion
+struct Usage
+{
+    bench::AllocStats decode;
+    bench::AllocStats add;
+    bench::AllocStats write;
+
+    bench::AllocStats total() const
+    {
+        bench::AllocStats res;
+        res.count = decode.count + add.count + write.count;
+        res.bytes = decode.bytes + add.bytes + write.bytes;
+        return res;
+    }
+};
+
+/**
+ * Forward bulletins to a Dispatcher, telling apart the allocations made
+ * decoding them from those made adding them to the outputs
+ */
+class CountingSink : public BufrSink
+{
+protected:
+    BufrSink& next;
+    Usage& usage;
+    /// Allocation counts when the decoding of the current message started
+    bench::AllocStats decode_start;
+
+public:
+    CountingSink(BufrSink& next, Usage& usage) : next(next), usage(usage) {}
+
+    void start_decode()
+    {
+        decode_start = bench::alloc_stats();
+    }
+
+    void add_bufr(std::unique_ptr<BufrBulletin>&& bulletin, const std::string& raw) override
+    {
+        bench::AllocStats add_start = bench::alloc_stats();
+        bench::AllocStats used = add_start - decode_start;
+        usage.decode.count += used.count;
+        usage.decode.bytes += used.bytes;
+
+        next.add_bufr(move(bulletin), raw);
+
+        used = bench::alloc_stats() - add_start;
+        usage.add.count += used.count;
+        usage.add.bytes += used.bytes;
+    }
+};
+
+/**
+ * Convert the corpus replicated \a scale times, as one input stream, to
+ * outputs in \a workdir, counting the allocations of each stage
+ */
+Usage convert(const bench::Corpus& corpus, unsigned scale, const std::string& workdir)
+{
+    Options opts;
+    opts.out_fname = str::joinpath(workdir, "bench");
+
+    Usage usage;
+    Dispatcher dispatcher(opts);
+    CountingSink sink(dispatcher, usage);
+    for (unsigned i = 0; i < scale; ++i)
+        for (const auto& msg: corpus.messages)
+        {
+            sink.start_decode();
+            decode_bufr(msg.first, sink, corpus.fname.c_str(), msg.second);
+        }
+
+    bench::AllocStats start = bench::alloc_stats();
+    dispatcher.close();
+    usage.write = bench::alloc_stats() - start;
+    return usage;
+}
+
+void usage(FILE* out)
+{
+    fprintf(out, "Usage: bench-alloc [options] --budgets=FILE\n");
+    fprintf(out, "Count the heap allocations made converting each test file listed in a\n");
+    fprintf(out, " budget file, and fail if any uses more per message than its budget.\n");
+    fprintf(out, "\n");
+    fprintf(out, "Options:\n");
+    fprintf(out, "  -h, --help                  this help message.\n");
+    fprintf(out, "  -b FILE, --budgets=FILE     file with the allocations allowed per message.\n");
+    fprintf(out, "  -d DIR, --data=DIR          directory with the test files (default: test/bufr).\n");
+    fprintf(out, "  -s N, --scale=N             number of times the messages of each file are\n");
+    fprintf(out, "                              replicated, to amortise per-output costs\n");
+    fprintf(out, "                              (default: 10).\n");
+    fprintf(out, "  --update                    rewrite the budgets from the measured\n");
+    fprintf(out, "                              allocations instead of checking them.\n");
+    fprintf(out, "  --margin=PCT                headroom added to the budgets by --update\n");
+    fprintf(out, "                              (default: 10).\n");
+#ifndef HAS_GETOPT_LONG
+    fprintf(out, "NOTE: long options are not supported on this system\n");
+#endif
+}
+
+enum {
+    OPT_UPDATE = 256,
+    OPT_MARGIN,
+};
+
+}
+
+int main(int argc, char* argv[])
+{
+#ifdef HAS_GETOPT_LONG
+    static struct option long_options[] =
+    {
+        {"help",    no_argument,       NULL, 'h'},
+        {"budgets", required_argument, NULL, 'b'},
+        {"data",    required_argument, NULL, 'd'},
+        {"scale",   required_argument, NULL, 's'},
+        {"update",  no_argument,       NULL, OPT_UPDATE},
+        {"margin",  required_argument, NULL, OPT_MARGIN},
+        {0, 0, 0, 0}
+    };
+#endif
+
+    string budgets_fname;
+    string datadir = "test/bufr";
+    unsigned scale = 10;
+    bool update = false;
+    double margin = 10;
+
+    while (1)
+    {
+        int option_index = 0;
+
+#ifdef HAS_GETOPT_LONG
+        int c = getopt_long(argc, argv, "b:d:s:h", long_options, &option_index);
+#else
+        int c = getopt(argc, argv, "b:d:s:h");
+#endif
+
+        if (c == -1)
+            break;
+
+        switch (c)
+        {
+            case 'h':
+                usage(stdout);
+                return 0;
+            case 'b':
+                budgets_fname = optarg;
+                break;
+            case 'd':
+                datadir = optarg;
+                break;
+            case 's':
+                scale = strtoul(optarg, NULL, 10);
+                if (scale == 0)
+                    scale = 1;
+                break;
+            case OPT_UPDATE:
+                update = true;
+                break;
+            case OPT_MARGIN:
+                margin = strtod(optarg, NULL);
+                break;
+            default:
+                // getopt already prints an error message
+                fputc('\n', stderr);
+                usage(stderr);
+                return 1;
+        }
+    }
+
+    if (budgets_fname.empty() || optind < argc)
+    {
+        usage(stderr);
+        return 1;
+    }
+
+    unsigned over = 0;
+    unsigned unmeasured = 0;
+    try {
+        vector<Budget> budgets = read_budgets(budgets_fname);
+
+        char tmpl[] = "/tmp/bench-alloc.XXXXXX";
+        if (!mkdtemp(tmpl))
+            error_system::throwf("cannot create a temporary directory");
+        string workdir = tmpl;
+
+        printf("%-12s %10s %10s %10s %10s %10s %10s %12s %12s %s\n",
+                "dataset", "messages", "decode", "add", "write",
+                "allocs/msg", "budget", "bytes/msg", "budget", "");
+        try {
+            for (auto& budget: budgets)
+            {
+                string fname = str::joinpath(datadir, budget.file);
+                bench::Corpus corpus(fname);
+                if (corpus.messages.empty())
+                    error_consistency::throwf("%s contains no messages", fname.c_str());
+
+                Usage used = convert(corpus, scale, workdir);
+                double messages = corpus.messages.size() * scale;
+                double allocs = used.total().count / messages;
+                double bytes = used.total().bytes / messages;
+
+                const char* status;
+                if (update)
+                {
+                    budget.allocs = ceil(allocs * (1 + margin / 100));
+                    budget.bytes = ceil(bytes * (1 + margin / 100));
+                    budget.measured = true;
+                    status = "updated";
+                } else if (!budget.measured) {
+                    status = "UNMEASURED";
+                    ++unmeasured;
+                } else if (allocs > budget.allocs || bytes > budget.bytes) {
+                    status = "OVER";
+                    ++over;
+                } else
+                    status = "ok";
+
+                printf("%-12s %10.0f %10.1f %10.1f %10.1f %10.1f %10s %12.0f %12s %s\n",
+                        bench::dataset_name(budget.file).c_str(), messages,
+                        used.decode.count / messages, used.add.count / messages,
+                        used.write.count / messages, allocs,
+                        format_budget(budget, budget.allocs).c_str(),
+                        bytes, format_budget(budget, budget.bytes).c_str(), status);
+                fflush(stdout);
+
+                sys::rmtree(workdir);
+                sys::makedirs(workdir);
+            }
+        } catch (...) {
+            sys::rmtree_ifexists(workdir);
+            throw;
+        }
+        sys::rmtree_ifexists(workdir);
+
+        if (update)
+            write_budgets(budgets_fname, budgets);
+    } catch (std::exception& e) {
+        fprintf(stderr, "%s\n", e.what());
+        return 1;
+    }
+
+    if (unmeasured)
+        fprintf(stderr, "%u datasets have no measured budget: measure them with --update"
+                " (meson compile alloc-budgets-update) on a release build, and commit the result\n", unmeasured);
+    if (over)
+        fprintf(stderr, "%u datasets over their allocation budget\n", over);
+    return over || unmeasured ? 1 : 0;
+}
@@ -0,0 +1,452 @@
+#include "bench.h"
+#include "convert.h"
+#include "options.h"
+#include "json.h"
+#include <wreport/error.h>
+#include <wreport/utils/sys.h>
+#include <wreport/utils/string.h>
+#include <map>
+#include <string>
+#include <vector>
+#include <memory>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <unistd.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+
+#include "config.h"
+
+#ifdef HAS_GETOPT_LONG
+#include <getopt.h>
+#endif
+
+using namespace b2nc;
+using namespace wreport;
+using namespace std;
+
+namespace {
+
+/// Measurements of one conversion run
+struct Result
+{
+    size_t messages = 0;
+    size_t subsets = 0;
+    size_t bytes = 0;
+    double seconds = 0;
+    double cpu_seconds = 0;
+    /// Peak resident set size, in KiB
+    long peak_rss = 0;
+};
+
+double cpu_seconds(const struct rusage& ru)
+{
+    return ru.ru_utime.tv_sec + ru.ru_utime.tv_usec / 1e6
+         + ru.ru_stime.tv_sec + ru.ru_stime.tv_usec / 1e6;
+}
+
+/**
+ * Convert the corpus replicated \a scale times, as one input stream, to
+ * outputs in \a workdir
+ */
+Result convert(const Options& base_opts, const bench::Corpus& corpus, unsigned scale, const std::string& workdir)
+{
+    Options opts(base_opts);
+    opts.out_fname = str::joinpath(workdir, "bench");
+
+    struct rusage ru_start;
+    getrusage(RUSAGE_SELF, &ru_start);
+    bench::Timer timer;
+    {
+        Dispatcher dispatcher(opts);
+        for (unsigned i = 0; i < scale; ++i)
+            for (const auto& msg: corpus.messages)
+                decode_bufr(msg.first, dispatcher, corpus.fname.c_str(), msg.second);
+        dispatcher.close();
+    }
+
+    Result res;
+    res.seconds = timer.elapsed();
+    struct rusage ru_end;
+    getrusage(RUSAGE_SELF, &ru_end);
+    res.cpu_seconds = cpu_seconds(ru_end) - cpu_seconds(ru_start);
+    res.messages = corpus.messages.size() * scale;
+    res.subsets = corpus.subsets * scale;
+    res.bytes = corpus.bytes * scale;
+    return res;
+}
+
+/**
+ * Run convert() in a child process, so that the peak RSS measured is that of
+ * this run only
+ */
+Result run_isolated(const Options& opts, const bench::Corpus& corpus, unsigned scale, const std::string& workdir)
+{
+    int fds[2];
+    if (pipe(fds) != 0)
+        error_system::throwf("cannot create pipe");
+
+    pid_t pid = fork();
+    if (pid == -1)
+        error_system::throwf("cannot fork");
+
+    if (pid == 0)
+    {
+        ::close(fds[0]);
+        int status = 0;
+        try {
+            Result res = convert(opts, corpus, scale, workdir);
+            if (write(fds[1], &res, sizeof(res)) != (ssize_t)sizeof(res))
+                status = 1;
+        } catch (std::exception& e) {
+            fprintf(stderr, "%s\n", e.what());
+            status = 1;
+        }
+        _exit(status);
+    }
+
+    ::close(fds[1]);
+    Result res;
+    ssize_t got = read(fds[0], &res, sizeof(res));
+    ::close(fds[0]);
+
+    int status;
+    struct rusage ru;
+    if (wait4(pid, &status, 0, &ru) == -1)
+        error_system::throwf("cannot wait for benchmark process");
+    if (got != (ssize_t)sizeof(res) || !WIFEXITED(status) || WEXITSTATUS(status) != 0)
+        error_consistency::throwf("converting %s %ux failed", corpus.fname.c_str(), scale);
+
+    // ru_maxrss is in KiB on Linux
+    res.peak_rss = ru.ru_maxrss;
+    return res;
+}
+
+/// Results of repeated runs of the same conversion
+struct Summary
+{
+    /// Median of each measurement
+    Result median;
+    /// Median absolute deviation of the wall clock time
+    double seconds_mad = 0;
+    unsigned runs = 0;
+
+    explicit Summary(const std::vector<Result>& results)
+        : runs(results.size())
+    {
+        vector<double> seconds, cpu_seconds, peak_rss;
+        for (const auto& r: results)
+        {
+            seconds.push_back(r.seconds);
+            cpu_seconds.push_back(r.cpu_seconds);
+            peak_rss.push_back(r.peak_rss);
+        }
+        median = results.front();
+        seconds_mad = bench::median_abs_dev(seconds);
+        median.seconds = bench::median(seconds);
+        median.cpu_seconds = bench::median(cpu_seconds);
+        median.peak_rss = lround(bench::median(peak_rss));
+    }
+
+    /**
+     * Subsets converted in the time taken by the calibration workload, which
+     * can be compared between machines
+     */
+    double normalised_throughput(double calibration) const
+    {
+        return median.subsets / median.seconds * calibration;
+    }
+};
+
+/// Baseline results of one dataset and scale
+struct Baseline
+{
+    double normalised_throughput = 0;
+    long peak_rss = 0;
+};
+
+/// Read a baseline written by --json, indexed by dataset and scale
+std::map<std::pair<std::string, unsigned>, Baseline> read_baseline(const std::string& fname)
+{
+    std::map<std::pair<std::string, unsigned>, Baseline> res;
+    for (const auto& record: bench::parse_json_records(sys::read_file(fname)))
+    {
+        auto dataset = record.find("dataset");
+        auto scale = record.find("scale");
+        auto throughput = record.find("normalised_throughput");
+        auto rss = record.find("peak_rss_kib");
+        if (dataset == record.end() || scale == record.end() || throughput == record.end() || rss == record.end())
+            error_consistency::throwf("%s: results need dataset, scale, normalised_throughput and peak_rss_kib", fname.c_str());
+        Baseline& b = res[make_pair(dataset->second, (unsigned)strtoul(scale->second.c_str(), NULL, 10))];
+        b.normalised_throughput = strtod(throughput->second.c_str(), NULL);
+        b.peak_rss = strtol(rss->second.c_str(), NULL, 10);
+    }
+    return res;
+}
+
+/**
+ * Compare \a summary with \a baseline, printing the regressions beyond
+ * \a threshold, a fraction, and returning how many there were
+ */
+unsigned compare(const std::string& name, unsigned scale, const Summary& summary, double calibration, const Baseline& baseline, double threshold)
+{
+    unsigned regressions = 0;
+    double throughput = summary.normalised_throughput(calibration);
+    double change = throughput / baseline.normalised_throughput - 1;
+    if (change < -threshold)
+    {
+        printf("REGRESSION %s %ux: throughput %.0f%% below the baseline (median %.3fs, MAD %.3fs)\n",
+                name.c_str(), scale, -change * 100, summary.median.seconds, summary.seconds_mad);
+        ++regressions;
+    }
+    change = (double)summary.median.peak_rss / baseline.peak_rss - 1;
+    if (change > threshold)
+    {
+        printf("REGRESSION %s %ux: peak RSS %.0f%% above the baseline (%.1f MiB, was %.1f MiB)\n",
+                name.c_str(), scale, change * 100, summary.median.peak_rss / 1024.0, baseline.peak_rss / 1024.0);
+        ++regressions;
+    }
+    return regressions;
+}
+
+void usage(FILE* out)
+{
+    fprintf(out, "Usage: bench-convert [options] file1 [file2 [file3 ..]]\n");
+    fprintf(out, "Measure the end-to-end conversion speed of each BUFR file, with its\n");
+    fprintf(out, " messages replicated to make larger inputs.\n");
+    fprintf(out, "\n");
+    fprintf(out, "Options:\n");
+    fprintf(out, "  -h, --help                  this help message.\n");
+    fprintf(out, "  -s LIST, --scales=LIST      comma separated number of times each file is\n");
+    fprintf(out, "                              replicated (default: $B2NC_BENCH_SCALES, or 1,100).\n");
+    fprintf(out, "  -f NAME, --format=NAME      output format (default: netcdf).\n");
+    fprintf(out, "  -j N, --jobs=N              number of threads to use.\n");
+    fprintf(out, "  --json=FILE                 also write the results as JSON to FILE.\n");
+    fprintf(out, "  -r N, --repeat=N            run each conversion N times, reporting the\n");
+    fprintf(out, "                              median and its median absolute deviation\n");
+    fprintf(out, "                              (default: 1).\n");
+    fprintf(out, "  --baseline=FILE             compare with the results in FILE, written by\n");
+    fprintf(out, "                              --json, and fail if it is missing, or any\n");
+    fprintf(out, "                              dataset regressed or is not in it.\n");
+    fprintf(out, "  --threshold=PCT             slowdown or peak RSS growth over the baseline\n");
+    fprintf(out, "                              counted as a regression (default: 10).\n");
+    fprintf(out, "  --update-baseline           write the results to the --baseline file\n");
+    fprintf(out, "                              instead of comparing with it.\n");
+#ifndef HAS_GETOPT_LONG
+    fprintf(out, "NOTE: long options are not supported on this system\n");
+#endif
+}
+
+enum {
+    OPT_JSON = 256,
+    OPT_BASELINE,
+    OPT_THRESHOLD,
+    OPT_UPDATE_BASELINE,
+};
+
+}
+
+int main(int argc, char* argv[])
+{
+#ifdef HAS_GETOPT_LONG
+    static struct option long_options[] =
+    {
+        {"help",    no_argument,       NULL, 'h'},
+        {"scales",  required_argument, NULL, 's'},
+        {"format",  required_argument, NULL, 'f'},
+        {"jobs",    required_argument, NULL, 'j'},
+        {"json",    required_argument, NULL, OPT_JSON},
+        {"repeat",  required_argument, NULL, 'r'},
+        {"baseline", required_argument, NULL, OPT_BASELINE},
+        {"threshold", required_argument, NULL, OPT_THRESHOLD},
+        {"update-baseline", no_argument, NULL, OPT_UPDATE_BASELINE},
+        {0, 0, 0, 0}
+    };
+#endif
+
+    Options options;
+    const char* env_scales = getenv("B2NC_BENCH_SCALES");
+    string scales_arg = env_scales ? env_scales : "1,100";
+    string json_fname;
+    unsigned repeat = 1;
+    string baseline_fname;
+    double threshold = 10;
+    bool update_baseline = false;
+
+    while (1)
+    {
+        int option_index = 0;
+
+#ifdef HAS_GETOPT_LONG
+        int c = getopt_long(argc, argv, "s:f:j:r:h", long_options, &option_index);
+#else
+        int c = getopt(argc, argv, "s:f:j:r:h");
+#endif
+
+        if (c == -1)
+            break;
+
+        switch (c)
+        {
+            case 'h':
+                usage(stdout);
+                return 0;
+            case 's':
+                scales_arg = optarg;
+                break;
+            case 'f':
+                options.format = optarg;
+                break;
+            case 'j':
+                options.jobs = strtoul(optarg, NULL, 10);
+                if (options.jobs == 0)
+                    options.jobs = 1;
+                break;
+            case OPT_JSON:
+                json_fname = optarg;
+                break;
+            case 'r':
+                repeat = strtoul(optarg, NULL, 10);
+                if (repeat == 0)
+                    repeat = 1;
+                break;
+            case OPT_BASELINE:
+                baseline_fname = optarg;
+                break;
+            case OPT_THRESHOLD:
+                threshold = strtod(optarg, NULL);
+                break;
+            case OPT_UPDATE_BASELINE:
+                update_baseline = true;
+                break;
+            default:
+                // getopt already prints an error message
+                fputc('\n', stderr);
+                usage(stderr);
+                return 1;
+        }
+    }
+
+    if (optind >= argc || (update_baseline && baseline_fname.empty()))
+    {
+        usage(stderr);
+        return 1;
+    }
+
+    try {
+        vector<unsigned> scales = bench::parse_scales(scales_arg);
+
+        std::map<std::pair<std::string, unsigned>, Baseline> baseline;
+        if (!baseline_fname.empty() && !update_baseline)
+        {
+            // A gate without a baseline must not look like a pass or a skip
+            if (!sys::exists(baseline_fname))
+            {
+                fprintf(stderr, "%s does not exist: create it with --update-baseline"
+                        " (meson compile bench-baseline) on a quiet machine, and commit it\n", baseline_fname.c_str());
+                return 1;
+            }
+            baseline = read_baseline(baseline_fname);
+        }
+
+        // Timings are normalised by the speed of the machine when comparing
+        // them to a baseline
+        double calibration = bench::calibrate();
+        printf("calibration: %.3fs\n", calibration);
+
+        char tmpl[] = "/tmp/bench-convert.XXXXXX";
+        if (!mkdtemp(tmpl))
+            error_system::throwf("cannot create a temporary directory");
+        string workdir = tmpl;
+
+        string json;
+        JSONWriter writer(json);
+        writer.start_list();
+
+        unsigned regressions = 0;
+        unsigned missing = 0;
+        printf("%-12s %7s %10s %10s %9s %8s %7s %10s %12s %8s %9s\n",
+                "dataset", "scale", "messages", "subsets", "MB", "seconds", "MAD",
+                "msg/s", "subsets/s", "MB/s", "RSS MiB");
+        try {
+            for (int i = optind; i < argc; ++i)
+            {
+                bench::Corpus corpus(argv[i]);
+                string name = bench::dataset_name(argv[i]);
+                for (unsigned scale: scales)
+                {
+                    vector<Result> results;
+                    for (unsigned run = 0; run < repeat; ++run)
+                    {
+                        results.push_back(run_isolated(options, corpus, scale, workdir));
+
+                        // Do not let outputs of large scales fill the disk
+                        sys::rmtree(workdir);
+                        sys::makedirs(workdir);
+                    }
+                    Summary summary(results);
+                    const Result& res = summary.median;
+                    double mb = res.bytes / 1e6;
+                    printf("%-12s %7u %10zu %10zu %9.2f %8.3f %7.3f %10.0f %12.0f %8.2f %9.1f\n",
+                            name.c_str(), scale, res.messages, res.subsets, mb, res.seconds,
+                            summary.seconds_mad, res.messages / res.seconds, res.subsets / res.seconds,
+                            mb / res.seconds, res.peak_rss / 1024.0);
+
+                    if (!baseline_fname.empty() && !update_baseline)
+                    {
+                        auto b = baseline.find(make_pair(name, scale));
+                        if (b == baseline.end())
+                        {
+                            printf("MISSING %s %ux is not in the baseline\n", name.c_str(), scale);
+                            ++missing;
+                        } else
+                            regressions += compare(name, scale, summary, calibration, b->second, threshold / 100);
+                    }
+                    fflush(stdout);
+
+                    writer.start_mapping();
+                    writer.add("dataset", name);
+                    writer.add("file", string(argv[i]));
+                    writer.add("scale", scale);
+                    writer.add("runs", summary.runs);
+                    writer.add("messages", res.messages);
+                    writer.add("subsets", res.subsets);
+                    writer.add("bytes", res.bytes);
+                    writer.add("seconds", res.seconds);
+                    writer.add("seconds_mad", summary.seconds_mad);
+                    writer.add("cpu_seconds", res.cpu_seconds);
+                    writer.add("messages_per_second", res.messages / res.seconds);
+                    writer.add("subsets_per_second", res.subsets / res.seconds);
+                    writer.add("mb_per_second", mb / res.seconds);
+                    writer.add("calibration_seconds", calibration);
+                    writer.add("normalised_throughput", summary.normalised_throughput(calibration));
+                    writer.add("peak_rss_kib", res.peak_rss);
+                    writer.end_mapping();
+                }
+            }
+        } catch (...) {
+            sys::rmtree_ifexists(workdir);
+            throw;
+        }
+        sys::rmtree_ifexists(workdir);
+
+        writer.end_list();
+        if (!json_fname.empty())
+            sys::write_file(json_fname, json + "\n");
+        if (update_baseline)
+            sys::write_file_atomically(baseline_fname, json + "\n", 0666);
+
+        if (missing)
+            fprintf(stderr, "%u datasets are not in the baseline: regenerate it with --update-baseline\n", missing);
+        if (regressions)
+            fprintf(stderr, "%u regressions over the baseline\n", regressions);
+        if (missing || regressions)
+            return 1;
+    } catch (std::exception& e) {
+        fprintf(stderr, "%s\n", e.what());
+        return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,501 @@
+#include <wreport/bulletin.h>
+#include <wreport/bulletin/interpreter.h>
+#include <wreport/subset.h>
+#include <wreport/var.h>
+#include <wreport/error.h>
+#include <algorithm>
+#include <memory>
+#include <string>
+#include <vector>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+
+#include "config.h"
+
+#ifdef HAS_GETOPT_LONG
+#include <getopt.h>
+#else
+#include <unistd.h>
+#endif
+
+using namespace wreport;
+using namespace std;
+
+namespace {
+
+/**
+ * Random number generator giving the same sequence on every platform.
+ *
+ * The distributions of the standard library are implementation defined, so
+ * they are not used, to keep the output reproducible across machines.
+ */
+class Random
+{
+protected:
+    uint64_t state;
+
+public:
+    explicit Random(uint64_t seed) : state(seed) {}
+
+    /// Next 64 bit value (splitmix64)
+    uint64_t next()
+    {
+        uint64_t z = (state += 0x9e3779b97f4a7c15ULL);
+        z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+        z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+        return z ^ (z >> 31);
+    }
+
+    /// Uniform integer in [0, n)
+    uint64_t below(uint64_t n)
+    {
+        return n ? next() % n : 0;
+    }
+
+    /// Uniform double in [0, 1)
+    double uniform()
+    {
+        return (next() >> 11) * (1.0 / 9007199254740992.0);
+    }
+
+    /// Poisson distributed integer with the given mean
+    unsigned poisson(double mean)
+    {
+        // Knuth's method, splitting large means to avoid underflowing exp()
+        unsigned res = 0;
+        while (mean > 0)
+        {
+            double step = min(mean, 500.0);
+            mean -= step;
+            double limit = exp(-step);
+            double p = uniform();
+            while (p > limit)
+            {
+                ++res;
+                p *= uniform();
+            }
+        }
+        return res;
+    }
+};
+
+/// Distribution of delayed replication counts
+struct Replication
+{
+    enum Kind {
+        /// Counts found in the first subset of the template
+        TEMPLATE,
+        FIXED,
+        UNIFORM,
+        POISSON,
+    };
+    Kind kind = TEMPLATE;
+    unsigned min = 0;
+    unsigned max = 0;
+    double mean = 0;
+
+    /// Parse "template", "N", "MIN-MAX" or "poisson:MEAN"
+    static Replication parse(const std::string& str)
+    {
+        Replication res;
+        char* end;
+        if (str == "template")
+            return res;
+        if (str.compare(0, 8, "poisson:") == 0)
+        {
+            res.kind = POISSON;
+            res.mean = strtod(str.c_str() + 8, &end);
+            if (*end || res.mean < 0)
+                error_consistency::throwf("invalid poisson mean in \"%s\"", str.c_str());
+            return res;
+        }
+        res.min = strtoul(str.c_str(), &end, 10);
+        if (end == str.c_str())
+            error_consistency::throwf("invalid replication distribution \"%s\"", str.c_str());
+        if (*end == 0)
+        {
+            res.kind = FIXED;
+            res.max = res.min;
+            return res;
+        }
+        if (*end != '-')
+            error_consistency::throwf("invalid replication distribution \"%s\"", str.c_str());
+        const char* max = end + 1;
+        res.max = strtoul(max, &end, 10);
+        if (end == max || *end || res.max < res.min)
+            error_consistency::throwf("invalid replication range \"%s\"", str.c_str());
+        res.kind = UNIFORM;
+        return res;
+    }
+
+    unsigned sample(Random& random, unsigned template_count) const
+    {
+        switch (kind)
+        {
+            case TEMPLATE: return template_count;
+            case FIXED: return min;
+            case UNIFORM: return min + random.below(max - min + 1);
+            case POISSON: return random.poisson(mean);
+        }
+        return 0;
+    }
+};
+
+/// Parameters of the generated data
+struct Params
+{
+    std::string template_fname;
+    unsigned messages = 1000;
+    unsigned subsets = 1;
+    bool compressed = false;
+    Replication replication;
+    /// Fraction of values that are missing
+    double missing = 0.1;
+    /// Number of distinct dispatch keys
+    unsigned keys = 1;
+    uint64_t seed = 1;
+};
+
+bool is_replication_factor(Varcode code)
+{
+    switch (code)
+    {
+        case WR_VAR(0, 31, 0):
+        case WR_VAR(0, 31, 1):
+        case WR_VAR(0, 31, 2):
+        case WR_VAR(0, 31, 11):
+        case WR_VAR(0, 31, 12):
+            return true;
+        default:
+            return false;
+    }
+}
+
+/**
+ * Fill a subset with random values following the bulletin DDS, in the order
+ * the wreport encoder expects them
+ */
+struct SubsetGenerator : bulletin::Interpreter
+{
+    Subset& out;
+    Random& random;
+    const Params& params;
+    /// Replication counts of the template, in the order they are found
+    const std::vector<unsigned>& template_counts;
+    /// Replication counts used in this subset
+    std::vector<unsigned>& counts;
+    /**
+     * Reuse \a counts instead of generating them, as compressed messages need
+     * the same structure in all subsets
+     */
+    bool replay;
+    size_t count_pos = 0;
+
+    SubsetGenerator(const BufrBulletin& b, Subset& out, Random& random, const Params& params,
+                    const std::vector<unsigned>& template_counts, std::vector<unsigned>& counts, bool replay)
+        : Interpreter(b.tables, b.datadesc), out(out), random(random), params(params),
+          template_counts(template_counts), counts(counts), replay(replay)
+    {
+    }
+
+    void randomize(Var& var)
+    {
+        Varinfo info = var.info();
+        switch (info->type)
+        {
+            case Vartype::String: {
+                string val(info->len, ' ');
+                for (auto& c: val)
+                    c = 'A' + random.below(26);
+                var.setc(val.c_str());
+                break;
+            }
+            case Vartype::Integer:
+            case Vartype::Decimal: {
+                if (info->bit_len == 0)
+                    break;
+                // All bits set is the missing value
+                uint64_t max_raw = (1ULL << std::min(info->bit_len, 32u)) - 2;
+                var.setd(info->decode_binary(random.below(max_raw + 1)));
+                break;
+            }
+            default:
+                break;
+        }
+    }
+
+    void define_variable(Varinfo info) override
+    {
+        Var var(info);
+        if (random.uniform() >= params.missing)
+            randomize(var);
+        out.store_variable(std::move(var));
+    }
+
+    unsigned define_delayed_replication_factor(Varinfo info) override
+    {
+        unsigned count;
+        if (replay)
+        {
+            if (count_pos >= counts.size())
+                error_consistency::throwf("compressed subsets have different replications");
+            count = counts[count_pos++];
+        } else {
+            unsigned template_count = count_pos < template_counts.size() ? template_counts[count_pos] : 1;
+            ++count_pos;
+            count = params.replication.sample(random, template_count);
+            // Fit the count in the replication factor
+            if (info->bit_len < 32)
+                count = std::min(count, (unsigned)((1U << info->bit_len) - 2));
+            counts.push_back(count);
+        }
+        out.store_variable(Var(info, (int)count));
+        return count;
+    }
+
+    unsigned define_associated_field_significance(Varinfo info) override
+    {
+        // Leave the associated fields undefined
+        out.store_variable(Var(info));
+        return 63;
+    }
+
+    void define_raw_character_data(Varcode code) override
+    {
+        Var var(tables.get_chardata(code, WR_VAR_Y(code)));
+        randomize(var);
+        out.store_variable(std::move(var));
+    }
+
+    unsigned define_bitmap_delayed_replication_factor(Varinfo) override
+    {
+        throw error_unimplemented("templates with bitmaps are not supported");
+    }
+
+    void define_bitmap(unsigned) override
+    {
+        throw error_unimplemented("templates with bitmaps are not supported");
+    }
+
+    void define_substituted_value(unsigned) override
+    {
+        throw error_unimplemented("templates with substituted values are not supported");
+    }
+
+    void define_attribute(Varinfo, unsigned) override
+    {
+        throw error_unimplemented("templates with bitmap attributes are not supported");
+    }
+
+    void define_c03_refval_override(Varcode) override
+    {
+        throw error_unimplemented("templates with reference value changes are not supported");
+    }
+};
+
+/// Read and decode the first BUFR message of a file
+std::unique_ptr<BufrBulletin> read_template(const std::string& fname)
+{
+    FILE* in = fopen(fname.c_str(), "rb");
+    if (!in)
+        error_system::throwf("cannot open %s", fname.c_str());
+    string raw;
+    bool found;
+    try {
+        found = BufrBulletin::read(in, raw, fname.c_str());
+    } catch (...) {
+        fclose(in);
+        throw;
+    }
+    fclose(in);
+    if (!found)
+        error_consistency::throwf("%s contains no BUFR messages", fname.c_str());
+    return BufrBulletin::decode(raw, fname.c_str());
+}
+
+void generate(const Params& params, FILE* out)
+{
+    unique_ptr<BufrBulletin> tmpl = read_template(params.template_fname);
+
+    vector<unsigned> template_counts;
+    if (!tmpl->subsets.empty())
+        for (const auto& var: tmpl->subsets[0])
+            if (is_replication_factor(var.code()) && var.isset())
+                template_counts.push_back(var.enqi());
+
+    // Keys are made distinct by their local data subcategory
+    int base_subcategory = tmpl->data_subcategory_local == 255 ? 0 : tmpl->data_subcategory_local;
+
+    Random random(params.seed);
+    for (unsigned m = 0; m < params.messages; ++m)
+    {
+        unique_ptr<BufrBulletin> msg = BufrBulletin::create();
+        msg->edition_number = tmpl->edition_number;
+        msg->master_table_number = tmpl->master_table_number;
+        msg->originating_centre = tmpl->originating_centre;
+        msg->originating_subcentre = tmpl->originating_subcentre;
+        msg->update_sequence_number = tmpl->update_sequence_number;
+        msg->data_category = tmpl->data_category;
+        msg->data_subcategory = tmpl->data_subcategory;
+        msg->data_subcategory_local = tmpl->data_subcategory_local;
+        msg->master_table_version_number = tmpl->master_table_version_number;
+        msg->master_table_version_number_local = tmpl->master_table_version_number_local;
+        msg->rep_year = tmpl->rep_year;
+        msg->rep_month = tmpl->rep_month;
+        msg->rep_day = tmpl->rep_day;
+        msg->rep_hour = tmpl->rep_hour;
+        msg->rep_minute = tmpl->rep_minute;
+        msg->rep_second = tmpl->rep_second;
+        msg->optional_section = tmpl->optional_section;
+        msg->compression = params.compressed;
+        msg->datadesc = tmpl->datadesc;
+
+        if (unsigned key = random.below(params.keys))
+            msg->data_subcategory_local = (base_subcategory + key) % 255;
+
+        msg->load_tables();
+
+        vector<unsigned> counts;
+        for (unsigned s = 0; s < params.subsets; ++s)
+        {
+            Subset& subset = msg->obtain_subset(s);
+            SubsetGenerator gen(*msg, subset, random, params, template_counts, counts, params.compressed && s > 0);
+            gen.run();
+        }
+
+        string raw = msg->encode();
+        if (fwrite(raw.data(), raw.size(), 1, out) != 1)
+            error_system::throwf("cannot write message %u", m);
+    }
+}
+
+unsigned long parse_unsigned(const char* name, const char* val, unsigned long min, unsigned long max)
+{
+    char* end;
+    unsigned long res = strtoul(val, &end, 10);
+    if (end == val || *end || res < min || res > max)
+        error_consistency::throwf("invalid %s \"%s\": it should be between %lu and %lu", name, val, min, max);
+    return res;
+}
+
+void usage(FILE* out)
+{
+    fprintf(out, "Usage: bench-generate [options] -t template [-o file]\n");
+    fprintf(out, "Generate a stream of BUFR messages with random values, with the same Data\n");
+    fprintf(out, " Descriptor Section as the first message of the template file. The output\n");
+    fprintf(out, " is the same on every machine for the same options and seed.\n");
+    fprintf(out, "\n");
+    fprintf(out, "Options:\n");
+    fprintf(out, "  -h, --help                  this help message.\n");
+    fprintf(out, "  -t FILE, --template=FILE    BUFR file with the template message.\n");
+    fprintf(out, "  -o FILE, --outfile=FILE     output file (default: standard output).\n");
+    fprintf(out, "  -n N, --messages=N          number of messages (default: 1000).\n");
+    fprintf(out, "  -s N, --subsets=N           subsets per message (default: 1).\n");
+    fprintf(out, "  -c, --compressed            write compressed messages.\n");
+    fprintf(out, "  -r DIST, --replication=DIST delayed replication counts: \"template\" to use\n");
+    fprintf(out, "                              those of the template (default), \"N\",\n");
+    fprintf(out, "                              \"MIN-MAX\" for uniform, or \"poisson:MEAN\".\n");
+    fprintf(out, "  -m F, --missing=F           fraction of missing values (default: 0.1).\n");
+    fprintf(out, "  -k N, --keys=N              number of distinct dispatch keys, made by\n");
+    fprintf(out, "                              changing the local subcategory (default: 1).\n");
+    fprintf(out, "  --seed=N                    random seed (default: 1).\n");
+#ifndef HAS_GETOPT_LONG
+    fprintf(out, "NOTE: long options are not supported on this system\n");
+#endif
+}
+
+enum {
+    OPT_SEED = 256,
+};
+
+}
+
+int main(int argc, char* argv[])
+{
+#ifdef HAS_GETOPT_LONG
+    static struct option long_options[] =
+    {
+        {"help",        no_argument,       NULL, 'h'},
+        {"template",    required_argument, NULL, 't'},
+        {"outfile",     required_argument, NULL, 'o'},
+        {"messages",    required_argument, NULL, 'n'},
+        {"subsets",     required_argument, NULL, 's'},
+        {"compressed",  no_argument,       NULL, 'c'},
+        {"replication", required_argument, NULL, 'r'},
+        {"missing",     required_argument, NULL, 'm'},
+        {"keys",        required_argument, NULL, 'k'},
+        {"seed",        required_argument, NULL, OPT_SEED},
+        {0, 0, 0, 0}
+    };
+#endif
+
+    Params params;
+    string out_fname;
+
+    try {
+        while (1)
+        {
+            int option_index = 0;
+
+#ifdef HAS_GETOPT_LONG
+            int c = getopt_long(argc, argv, "t:o:n:s:cr:m:k:h", long_options, &option_index);
+#else
+            int c = getopt(argc, argv, "t:o:n:s:cr:m:k:h");
+#endif
+
+            if (c == -1)
+                break;
+
+            switch (c)
+            {
+                case 'h':
+                    usage(stdout);
+                    return 0;
+                case 't': params.template_fname = optarg; break;
+                case 'o': out_fname = optarg; break;
+                case 'n': params.messages = parse_unsigned("message count", optarg, 0, 0xffffffff); break;
+                case 's': params.subsets = parse_unsigned("subset count", optarg, 1, 65535); break;
+                case 'c': params.compressed = true; break;
+                case 'r': params.replication = Replication::parse(optarg); break;
+                case 'm': {
+                    char* end;
+                    params.missing = strtod(optarg, &end);
+                    if (end == optarg || *end || params.missing < 0 || params.missing > 1)
+                        error_consistency::throwf("invalid missing fraction \"%s\": it should be between 0 and 1", optarg);
+                    break;
+                }
+                case 'k': params.keys = parse_unsigned("key count", optarg, 1, 255); break;
+                case OPT_SEED: params.seed = strtoull(optarg, NULL, 10); break;
+                default:
+                    // getopt already prints an error message
+                    fputc('\n', stderr);
+                    usage(stderr);
+                    return 1;
+            }
+        }
+
+        if (params.template_fname.empty() || optind < argc)
+        {
+            usage(stderr);
+            return 1;
+        }
+
+        FILE* out = stdout;
+        if (!out_fname.empty())
+        {
+            out = fopen(out_fname.c_str(), "wb");
+            if (!out)
+                error_system::throwf("cannot open %s", out_fname.c_str());
+        }
+        generate(params, out);
+        if (out != stdout && fclose(out) != 0)
+            error_system::throwf("cannot write %s", out_fname.c_str());
+    } catch (std::exception& e) {
+        fprintf(stderr, "%s\n", e.what());
+        return 1;
+    }
+
+    return 0;
+}
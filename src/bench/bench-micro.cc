@@ -0,0 +1,387 @@
+#include "bench.h"
+#include "alloc.h"
+#include "valarray.h"
+#include "plan.h"
+#include "namer.h"
+#include "ncoutfile.h"
+#include "convert.h"
+#include "options.h"
+#include <wreport/bulletin.h>
+#include <wreport/subset.h>
+#include <wreport/var.h>
+#include <wreport/vartable.h>
+#include <wreport/tableinfo.h>
+#include <wreport/error.h>
+#include <wreport/utils/string.h>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+#include <cstdio>
+#include <cstdlib>
+
+#include "config.h"
+
+#ifdef HAS_GETOPT_LONG
+#include <getopt.h>
+#else
+#include <unistd.h>
+#endif
+
+using namespace b2nc;
+using namespace wreport;
+using namespace std;
+
+namespace {
+
+/// Records in the synthetic arrays, about a day of hourly reports from 400 stations
+const unsigned bench_records = 10000;
+/// Records in the synthetic replicated arrays, like a batch of soundings
+const unsigned bench_multi_records = 1000;
+/// Maximum replication count in the synthetic replicated arrays
+const unsigned bench_max_rep = 50;
+
+/// Replication count of record \a idx: ragged, to exercise padding
+unsigned rep_count(unsigned idx)
+{
+    return bench_max_rep / 2 + idx % (bench_max_rep / 2 + 1);
+}
+
+/// Run the benchmarks whose name contains a filter, and print their results
+class Runner
+{
+protected:
+    std::vector<std::string> filters;
+    double min_time;
+
+public:
+    Runner(const std::vector<std::string>& filters, double min_time)
+        : filters(filters), min_time(min_time) {}
+
+    bool selected(const std::string& name) const
+    {
+        if (filters.empty())
+            return true;
+        for (const auto& f: filters)
+            if (name.find(f) != string::npos)
+                return true;
+        return false;
+    }
+
+    /**
+     * Time \a func, which performs \a ops operations each time it is called,
+     * calling it until at least min_time seconds have passed
+     */
+    void run(const std::string& name, size_t ops, std::function<void()> func)
+    {
+        if (!selected(name))
+            return;
+
+        // Warm up caches and lazily initialised tables
+        func();
+
+        size_t iterations = 0;
+        double elapsed = 0;
+        bench::AllocStats allocs;
+        while (elapsed < min_time)
+        {
+            bench::AllocStats start = bench::alloc_stats();
+            bench::Timer timer;
+            func();
+            elapsed += timer.elapsed();
+            bench::AllocStats used = bench::alloc_stats() - start;
+            allocs.count += used.count;
+            allocs.bytes += used.bytes;
+            ++iterations;
+        }
+
+        double total_ops = (double)iterations * ops;
+        printf("%-32s %12.1f ns/op %10.3f allocs/op %12.1f bytes/op\n",
+                name.c_str(), elapsed * 1e9 / total_ops,
+                allocs.count / total_ops, allocs.bytes / total_ops);
+        fflush(stdout);
+    }
+};
+
+/// Variables of one type to add to arrays, with a mix of values and missing values
+struct BenchVars
+{
+    const char* type;
+    std::vector<Var> vars;
+
+    BenchVars(const char* type, const Vartable* table, Varcode code, double base, double step)
+        : type(type)
+    {
+        Varinfo info = table->query(code);
+        for (unsigned i = 0; i < 64; ++i)
+        {
+            vars.emplace_back(info);
+            // One value in 8 is missing
+            if (i % 8 == 7)
+                continue;
+            if (info->type == Vartype::String)
+            {
+                char buf[16];
+                snprintf(buf, 16, "STATION%02u", i);
+                vars.back().setc(buf);
+            } else
+                vars.back().setd(base + i * step);
+        }
+    }
+
+    const Var& get(unsigned idx) const { return vars[idx % vars.size()]; }
+};
+
+/// Fill \a arr with bench_records records
+void fill_single(ValArray& arr, const BenchVars& vars)
+{
+    for (unsigned i = 0; i < bench_records; ++i)
+        arr.add(vars.get(i), i);
+}
+
+/// Fill \a arr with bench_multi_records ragged records
+void fill_multi(ValArray& arr, const BenchVars& vars)
+{
+    for (unsigned i = 0; i < bench_multi_records; ++i)
+        for (unsigned j = 0; j < rep_count(i); ++j)
+            arr.add(vars.get(i + j), i);
+}
+
+size_t multi_add_count()
+{
+    size_t res = 0;
+    for (unsigned i = 0; i < bench_multi_records; ++i)
+        res += rep_count(i);
+    return res;
+}
+
+/// Array written to an in-memory NetCDF file, ready for putvar
+struct PutvarFixture
+{
+    Options opts;
+    LoopInfo loopinfo;
+    std::unique_ptr<ValArray> arr;
+    NCOutfile outfile;
+
+    PutvarFixture() : outfile(opts) {}
+
+    void set_array(ValArray* arr)
+    {
+        this->arr.reset(arr);
+        arr->name = "BENCH";
+        arr->mnemo = "BENCH";
+        arr->rcnt = 0;
+        arr->type = Namer::DT_DATA;
+    }
+
+    void define(size_t records)
+    {
+        outfile.open_memory("bench.nc");
+        outfile.record_count = records;
+        arr->define(outfile);
+        outfile.end_define_mode();
+    }
+};
+
+/// Read and decode the first BUFR message of a file
+std::unique_ptr<BufrBulletin> read_first_bufr(const std::string& fname)
+{
+    FILE* in = fopen(fname.c_str(), "rb");
+    if (!in)
+        error_system::throwf("cannot open %s", fname.c_str());
+    string raw;
+    bool found = BufrBulletin::read(in, raw, fname.c_str());
+    fclose(in);
+    if (!found)
+        error_consistency::throwf("%s contains no BUFR messages", fname.c_str());
+    return BufrBulletin::decode(raw, fname.c_str());
+}
+
+void bench_valarrays(Runner& runner)
+{
+    const Vartable* table = Vartable::get_bufr(BufrTableID(0, 0, 0, 14, 0));
+    vector<BenchVars> types;
+    types.emplace_back("int", table, WR_VAR(0, 7, 4), 100000, -1000);
+    types.emplace_back("float", table, WR_VAR(0, 12, 101), 290, -0.75);
+    types.emplace_back("double", table, WR_VAR(0, 5, 1), 44.5, 0.01);
+    types.emplace_back("string", table, WR_VAR(0, 1, 19), 0, 0);
+
+    for (const auto& vars: types)
+    {
+        Varinfo info = vars.vars[0].info();
+        string type = vars.type;
+
+        runner.run("SingleValArray::add/" + type, bench_records, [&] {
+            unique_ptr<ValArray> arr(ValArray::make_singlevalarray(Namer::DT_DATA, info));
+            fill_single(*arr, vars);
+        });
+
+        runner.run("MultiValArray::add/" + type, multi_add_count(), [&] {
+            LoopInfo loopinfo;
+            unique_ptr<ValArray> arr(ValArray::make_multivalarray(Namer::DT_DATA, info, loopinfo));
+            fill_multi(*arr, vars);
+        });
+
+        // ns/op is per record written
+        {
+            PutvarFixture fixture;
+            fixture.set_array(ValArray::make_singlevalarray(Namer::DT_DATA, info));
+            fill_single(*fixture.arr, vars);
+            fixture.define(bench_records);
+            runner.run("putvar/single/" + type, bench_records, [&] { fixture.arr->putvar(fixture.outfile); });
+            fixture.outfile.close();
+        }
+
+        // Multi putvar pads ragged records with to_fixed_array
+        {
+            PutvarFixture fixture;
+            fixture.set_array(ValArray::make_multivalarray(Namer::DT_DATA, info, fixture.loopinfo));
+            fill_multi(*fixture.arr, vars);
+            fixture.define(bench_multi_records);
+            runner.run("putvar/multi/" + type, bench_multi_records, [&] { fixture.arr->putvar(fixture.outfile); });
+            fixture.outfile.close();
+        }
+    }
+}
+
+void bench_plans(Runner& runner, const std::string& datadir)
+{
+    Options opts;
+    for (const char* fname: {"cdfin_synop", "cdfin_temp", "AMSUA.bufr"})
+    {
+        unique_ptr<BufrBulletin> bulletin = read_first_bufr(str::joinpath(datadir, fname));
+        runner.run(string("Plan::build/") + bench::dataset_name(fname), 1, [&] {
+            Plan plan(opts);
+            plan.build(*bulletin);
+        });
+    }
+}
+
+void bench_namer(Runner& runner, const std::string& datadir)
+{
+    // Name the variables of a sounding, as done when building its plan
+    unique_ptr<BufrBulletin> bulletin = read_first_bufr(str::joinpath(datadir, "cdfin_temp"));
+    vector<Varcode> codes;
+    for (const auto& var: bulletin->subsets[0])
+        if (WR_VAR_F(var.code()) == 0)
+            codes.push_back(var.code());
+
+    Options opts;
+    string name, mnemo;
+    runner.run("Namer::name", codes.size(), [&] {
+        unique_ptr<Namer> namer = Namer::get(opts);
+        for (Varcode code: codes)
+            namer->name(Namer::DT_DATA, code, 0, name, mnemo);
+    });
+}
+
+void bench_keys(Runner& runner, const std::string& datadir)
+{
+    const char* fnames[] = {
+        "AMSUA.bufr", "atms2.bufr", "cdfin_acars", "cdfin_amdar", "cdfin_buoy",
+        "cdfin_pilot", "cdfin_ship", "cdfin_synop", "cdfin_temp", "cdfin_wprof",
+    };
+    vector<Dispatcher::Key> keys;
+    for (const char* fname: fnames)
+        keys.emplace_back(*read_first_bufr(str::joinpath(datadir, fname)));
+
+    // Equal keys need a full comparison of their data descriptors
+    vector<Dispatcher::Key> same(4, keys[0]);
+
+    volatile unsigned sink = 0;
+    runner.run("Dispatcher::Key</distinct", keys.size() * keys.size(), [&] {
+        unsigned count = 0;
+        for (const auto& a: keys)
+            for (const auto& b: keys)
+                count += a < b;
+        sink = sink + count;
+    });
+    runner.run("Dispatcher::Key</equal", same.size() * same.size(), [&] {
+        unsigned count = 0;
+        for (const auto& a: same)
+            for (const auto& b: same)
+                count += a < b;
+        sink = sink + count;
+    });
+}
+
+void usage(FILE* out)
+{
+    fprintf(out, "Usage: bench-micro [options] [filter1 [filter2 ..]]\n");
+    fprintf(out, "Time the conversion hot paths in isolation, reporting time and heap\n");
+    fprintf(out, " allocations per operation. Only the benchmarks whose names contain one\n");
+    fprintf(out, " of the filters are run, if any are given.\n");
+    fprintf(out, "\n");
+    fprintf(out, "Options:\n");
+    fprintf(out, "  -h, --help                  this help message.\n");
+    fprintf(out, "  -d DIR, --data=DIR          directory with the test BUFR files\n");
+    fprintf(out, "                              (default: $B2NC_TESTDATA/bufr).\n");
+    fprintf(out, "  -t SEC, --min-time=SEC      minimum time to run each benchmark (default: 0.5).\n");
+#ifndef HAS_GETOPT_LONG
+    fprintf(out, "NOTE: long options are not supported on this system\n");
+#endif
+}
+
+}
+
+int main(int argc, char* argv[])
+{
+#ifdef HAS_GETOPT_LONG
+    static struct option long_options[] =
+    {
+        {"help",     no_argument,       NULL, 'h'},
+        {"data",     required_argument, NULL, 'd'},
+        {"min-time", required_argument, NULL, 't'},
+        {0, 0, 0, 0}
+    };
+#endif
+
+    const char* testdata = getenv("B2NC_TESTDATA");
+    string datadir = str::joinpath(testdata ? testdata : "test", "bufr");
+    double min_time = 0.5;
+
+    while (1)
+    {
+        int option_index = 0;
+
+#ifdef HAS_GETOPT_LONG
+        int c = getopt_long(argc, argv, "d:t:h", long_options, &option_index);
+#else
+        int c = getopt(argc, argv, "d:t:h");
+#endif
+
+        if (c == -1)
+            break;
+
+        switch (c)
+        {
+            case 'h':
+                usage(stdout);
+                return 0;
+            case 'd':
+                datadir = optarg;
+                break;
+            case 't':
+                min_time = strtod(optarg, NULL);
+                break;
+            default:
+                // getopt already prints an error message
+                fputc('\n', stderr);
+                usage(stderr);
+                return 1;
+        }
+    }
+
+    try {
+        Runner runner(vector<string>(argv + optind, argv + argc), min_time);
+        bench_valarrays(runner);
+        bench_plans(runner, datadir);
+        bench_namer(runner, datadir);
+        bench_keys(runner, datadir);
+    } catch (std::exception& e) {
+        fprintf(stderr, "%s\n", e.what());
+        return 1;
+    }
+
+    return 0;
+}
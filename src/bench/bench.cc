@@ -0,0 +1,290 @@
+/*
+ * bench - Utilities for the benchmark programs
+ *
+ * Copyright (C) 2026  ARPA-SIM <urpsim@smr.arpa.emr.it>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#include "bench.h"
+#include "msgindex.h"
+#include <wreport/bulletin.h>
+#include <wreport/error.h>
+#include <algorithm>
+#include <memory>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstdint>
+#include <cstring>
+#include <cctype>
+#include <sys/resource.h>
+
+using namespace wreport;
+using namespace std;
+
+namespace b2nc {
+namespace bench {
+
+Corpus::Corpus(const std::string& fname)
+    : fname(fname)
+{
+    FILE* in = fopen(fname.c_str(), "rb");
+    if (!in)
+        error_system::throwf("cannot open %s", fname.c_str());
+    try {
+        string raw;
+        off_t offset;
+        while (BufrBulletin::read(in, raw, fname.c_str(), &offset))
+        {
+            unique_ptr<BufrBulletin> header = BufrBulletin::decode_header(raw, fname.c_str(), offset);
+            subsets += bufr_subset_count(raw, *header);
+            bytes += raw.size();
+            messages.emplace_back(raw, offset);
+        }
+    } catch (...) {
+        fclose(in);
+        throw;
+    }
+    fclose(in);
+}
+
+std::vector<unsigned> parse_scales(const std::string& str)
+{
+    vector<unsigned> res;
+    size_t pos = 0;
+    while (pos <= str.size())
+    {
+        size_t end = str.find(',', pos);
+        if (end == string::npos)
+            end = str.size();
+        string item = str.substr(pos, end - pos);
+        char* endptr;
+        unsigned long val = strtoul(item.c_str(), &endptr, 10);
+        if (item.empty() || *endptr || val == 0)
+            error_consistency::throwf("invalid scale \"%s\" in \"%s\"", item.c_str(), str.c_str());
+        res.push_back(val);
+        pos = end + 1;
+    }
+    return res;
+}
+
+std::string dataset_name(const std::string& fname)
+{
+    string res = fname;
+    size_t pos = res.rfind('/');
+    if (pos != string::npos)
+        res = res.substr(pos + 1);
+    if (res.compare(0, 6, "cdfin_") == 0)
+        res = res.substr(6);
+    if (res.size() > 5 && res.substr(res.size() - 5) == ".bufr")
+        res = res.substr(0, res.size() - 5);
+    return res;
+}
+
+long peak_rss_self()
+{
+    struct rusage ru;
+    if (getrusage(RUSAGE_SELF, &ru) != 0)
+        error_system::throwf("cannot read resource usage");
+    return ru.ru_maxrss;
+}
+
+double median(std::vector<double>& vals)
+{
+    if (vals.empty())
+        return 0;
+    size_t mid = vals.size() / 2;
+    std::nth_element(vals.begin(), vals.begin() + mid, vals.end());
+    if (vals.size() % 2)
+        return vals[mid];
+    double lower = *std::max_element(vals.begin(), vals.begin() + mid);
+    return (lower + vals[mid]) / 2;
+}
+
+double median_abs_dev(const std::vector<double>& vals)
+{
+    vector<double> devs(vals);
+    double med = median(devs);
+    for (auto& d: devs)
+        d = fabs(d - med);
+    return median(devs);
+}
+
+namespace {
+
+/// Sort and hash pseudorandom numbers, returning a checksum
+uint64_t calibration_workload()
+{
+    // Large enough not to fit in the L2 cache, like the conversion arrays
+    const size_t size = 1 << 20;
+    vector<uint32_t> vals(size);
+    uint32_t state = 1;
+    for (auto& v: vals)
+    {
+        // Numerical Recipes linear congruential generator
+        state = state * 1664525u + 1013904223u;
+        v = state;
+    }
+    std::sort(vals.begin(), vals.end());
+
+    // FNV-1a over the sorted values
+    uint64_t hash = 14695981039346656037ull;
+    for (auto v: vals)
+    {
+        hash ^= v;
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+/// Result of the calibration workload, kept so that it is not optimised away
+volatile uint64_t calibration_sink;
+
+}
+
+double calibrate(unsigned runs)
+{
+    vector<double> times;
+    for (unsigned i = 0; i < runs; ++i)
+    {
+        Timer timer;
+        calibration_sink = calibration_workload();
+        times.push_back(timer.elapsed());
+    }
+    return median(times);
+}
+
+namespace {
+
+/// Minimal JSON tokenizer for parse_json_records
+class RecordParser
+{
+protected:
+    const std::string& json;
+    size_t pos = 0;
+
+    [[noreturn]] void fail(const char* expected)
+    {
+        error_consistency::throwf("invalid JSON at offset %zu: expected %s", pos, expected);
+    }
+
+    void skip_spaces()
+    {
+        while (pos < json.size() && isspace((unsigned char)json[pos]))
+            ++pos;
+    }
+
+    bool accept(char c)
+    {
+        skip_spaces();
+        if (pos < json.size() && json[pos] == c)
+        {
+            ++pos;
+            return true;
+        }
+        return false;
+    }
+
+    void expect(char c)
+    {
+        if (!accept(c))
+        {
+            char expected[4] = { '\'', c, '\'', 0 };
+            fail(expected);
+        }
+    }
+
+    std::string parse_string()
+    {
+        expect('"');
+        string res;
+        while (pos < json.size() && json[pos] != '"')
+        {
+            char c = json[pos++];
+            if (c == '\\' && pos < json.size())
+            {
+                c = json[pos++];
+                switch (c)
+                {
+                    case 'n': c = '\n'; break;
+                    case 't': c = '\t'; break;
+                    case 'r': c = '\r'; break;
+                    case 'b': c = '\b'; break;
+                    case 'f': c = '\f'; break;
+                    case 'u': fail("no \\u escapes");
+                }
+            }
+            res += c;
+        }
+        expect('"');
+        return res;
+    }
+
+    /// Parse a number, true, false or null, returning its text
+    std::string parse_scalar()
+    {
+        skip_spaces();
+        size_t start = pos;
+        while (pos < json.size() && (isalnum((unsigned char)json[pos]) || strchr("+-.", json[pos])))
+            ++pos;
+        if (pos == start)
+            fail("a value");
+        return json.substr(start, pos - start);
+    }
+
+public:
+    explicit RecordParser(const std::string& json) : json(json) {}
+
+    std::vector<JSONRecord> parse()
+    {
+        vector<JSONRecord> res;
+        expect('[');
+        if (accept(']'))
+            return res;
+        do {
+            JSONRecord record;
+            expect('{');
+            if (!accept('}'))
+            {
+                do {
+                    string key = parse_string();
+                    expect(':');
+                    skip_spaces();
+                    if (pos < json.size() && json[pos] == '"')
+                        record[key] = parse_string();
+                    else
+                        record[key] = parse_scalar();
+                } while (accept(','));
+                expect('}');
+            }
+            res.push_back(move(record));
+        } while (accept(','));
+        expect(']');
+        skip_spaces();
+        if (pos != json.size())
+            fail("the end of the input");
+        return res;
+    }
+};
+
+}
+
+std::vector<JSONRecord> parse_json_records(const std::string& json)
+{
+    return RecordParser(json).parse();
+}
+
+}
+}
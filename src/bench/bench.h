@@ -0,0 +1,97 @@
+/*
+ * bench - Utilities for the benchmark programs
+ *
+ * Copyright (C) 2026  ARPA-SIM <urpsim@smr.arpa.emr.it>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#ifndef B2NC_BENCH_BENCH_H
+#define B2NC_BENCH_BENCH_H
+
+#include <map>
+#include <string>
+#include <vector>
+#include <utility>
+#include <chrono>
+#include <sys/types.h>
+
+namespace b2nc {
+namespace bench {
+
+/// Wall clock stopwatch
+class Timer
+{
+protected:
+    std::chrono::steady_clock::time_point start;
+
+public:
+    Timer() : start(std::chrono::steady_clock::now()) {}
+
+    /// Seconds elapsed since construction
+    double elapsed() const
+    {
+        return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    }
+};
+
+/// BUFR messages of one input file, kept in memory
+struct Corpus
+{
+    std::string fname;
+    /// Encoded messages, with their offsets in the file
+    std::vector<std::pair<std::string, off_t>> messages;
+    size_t subsets = 0;
+    size_t bytes = 0;
+
+    explicit Corpus(const std::string& fname);
+};
+
+/// Parse a comma separated list of positive integers, like "1,100,10000"
+std::vector<unsigned> parse_scales(const std::string& str);
+
+/// Name a dataset after its test file, like "synop" for "cdfin_synop"
+std::string dataset_name(const std::string& fname);
+
+/// Peak resident set size of the current process, in KiB
+long peak_rss_self();
+
+/// Median of \a vals, which are reordered
+double median(std::vector<double>& vals);
+
+/// Median absolute deviation of \a vals from their median
+double median_abs_dev(const std::vector<double>& vals);
+
+/**
+ * Seconds taken by a fixed workload of sorting and hashing, as the median of
+ * \a runs runs.
+ *
+ * Multiplying a throughput by it gives work per unit of machine speed, which
+ * can be compared between machines.
+ */
+double calibrate(unsigned runs = 5);
+
+/// Values of a flat JSON mapping, as numbers or strings without quotes
+typedef std::map<std::string, std::string> JSONRecord;
+
+/**
+ * Parse a JSON list of flat mappings, like the one written by bench-convert
+ * --json. Nested lists and mappings are not supported.
+ */
+std::vector<JSONRecord> parse_json_records(const std::string& json);
+
+}
+}
+
+#endif
@@ -0,0 +1,98 @@
+#include "merge.h"
+#include "options.h"
+#include <wreport/error.h>
+#include <string>
+#include <vector>
+#include <cstdio>
+
+#include "config.h"
+
+#ifdef HAS_GETOPT_LONG
+#include <getopt.h>
+#else
+#include <unistd.h>
+#endif
+
+using namespace b2nc;
+using namespace std;
+
+static void usage(FILE* out)
+{
+    fprintf(out, "Usage: bufr2netcdf-merge [options] -o file shard1 [shard2 [shard3 ..]]\n");
+    fprintf(out, "Merge the NetCDF files that bufr2netcdf --shard wrote for the same BUFR\n");
+    fprintf(out, " type into one file, as if the input had been converted in one run.\n");
+    fprintf(out, "Shards are concatenated in the order they are given.\n");
+    fprintf(out, "\n");
+    fprintf(out, "Options:\n");
+    fprintf(out, "  -h, --help                  this help message.\n");
+    fprintf(out, "  -v, --verbose               verbose output.\n");
+    fprintf(out, "  -o FILE, --outfile=FILE     output file.\n");
+#ifndef HAS_GETOPT_LONG
+    fprintf(out, "NOTE: long options are not supported on this system\n");
+#endif
+}
+
+int main(int argc, char* argv[])
+{
+#ifdef HAS_GETOPT_LONG
+    static struct option long_options[] =
+    {
+        {"help",    no_argument,       NULL, 'h'},
+        {"outfile", required_argument, NULL, 'o'},
+        {"verbose", no_argument,       NULL, 'v'},
+        {0, 0, 0, 0}
+    };
+#endif
+
+    Options options;
+
+    while (1)
+    {
+        int option_index = 0;
+
+#ifdef HAS_GETOPT_LONG
+        int c = getopt_long(argc, argv, "o:vh", long_options, &option_index);
+#else
+        int c = getopt(argc, argv, "o:vh");
+#endif
+
+        if (c == -1)
+            break;
+
+        switch (c)
+        {
+            case 'h':
+                usage(stdout);
+                return 0;
+            case 'o':
+                options.out_fname = optarg;
+                break;
+            case 'v':
+                options.verbose = true;
+                break;
+            default:
+                // getopt already prints an error message
+                fputc('\n', stderr);
+                usage(stderr);
+                return 1;
+        }
+    }
+
+    if (options.out_fname.empty() || optind >= argc)
+    {
+        usage(stderr);
+        return 1;
+    }
+
+    try {
+        vector<string> inputs(argv + optind, argv + argc);
+        if (options.verbose)
+            fprintf(stderr, "Merging %zu files into %s\n", inputs.size(), options.out_fname.c_str());
+        merge_netcdf(options, inputs, options.out_fname);
+    } catch (std::exception& e) {
+        fprintf(stderr, "%s\n", e.what());
+        return 1;
+    }
+
+    return 0;
+}
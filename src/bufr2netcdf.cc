@@ -1,8 +1,23 @@
 #include "convert.h"
+#include "inventory.h"
+#include "msgindex.h"
 #include "options.h"
+#include "instruments.h"
+#include "stats.h"
+#include "trace.h"
+#include "sparsity.h"
+#include "progress.h"
+#include "input.h"
 #include <wreport/error.h>
+#include <wreport/utils/sys.h>
 #include <string>
+#include <vector>
+#include <memory>
 #include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cctype>
+#include <csignal>
 
 #include "config.h"
 
@@ -10,16 +25,122 @@
 #include <getopt.h>
 #endif
 
+#ifdef HAVE_INOTIFY
+#include "watch.h"
+#endif
+
 using namespace b2nc;
 using namespace wreport;
 using namespace std;
 
+// Codes for options that only have a long version
+enum {
+    OPT_NC_HEADER_PAD = 256,
+    OPT_NC_VAR_ALIGN,
+    OPT_ZARR_CHUNK_RECORDS,
+    OPT_ARROW_BATCH_RECORDS,
+    OPT_PLAN_CACHE,
+    OPT_ATOMIC,
+    OPT_WATCH,
+    OPT_BATCH,
+    OPT_INVENTORY,
+    OPT_INDEX,
+    OPT_SELECT,
+    OPT_KEY,
+    OPT_TIME_RANGE,
+    OPT_SHARD,
+    OPT_STATS,
+    OPT_TRACE,
+    OPT_MEMORY_REPORT,
+    OPT_SPARSITY,
+    OPT_PROGRESS,
+    OPT_PROGRESS_FORMAT,
+    OPT_PROGRESS_FILE,
+};
+
+/**
+ * Parse a size argument, returning false if it is not a valid number
+ */
+static bool parse_size(const char* arg, size_t& res)
+{
+    char* end;
+    unsigned long long val = strtoull(arg, &end, 10);
+    if (end == arg || *end != 0)
+        return false;
+    res = val;
+    return true;
+}
+
+/**
+ * Parse a time argument as YYYYMMDDHHMMSS, or a prefix of it, filling the
+ * missing digits with \a fill
+ */
+static bool parse_time(const string& arg, char fill, long long& res)
+{
+    if (arg.empty() || arg.size() > 14 || arg.find_first_not_of("0123456789") != string::npos)
+        return false;
+    res = strtoll((arg + string(14 - arg.size(), fill)).c_str(), NULL, 10);
+    return true;
+}
+
+/**
+ * Parse a FROM,TO time range argument
+ */
+static bool parse_time_range(const char* arg, IndexSelection& sel)
+{
+    const char* comma = strchr(arg, ',');
+    if (!comma)
+        return false;
+    return parse_time(string(arg, comma), '0', sel.time_min)
+        && parse_time(comma + 1, '9', sel.time_max);
+}
+
+/**
+ * Check that a --select argument is CAT, CAT-SUB or CAT-SUB-LOCAL
+ */
+static bool valid_category(const char* arg)
+{
+    unsigned numbers = 0;
+    for (const char* s = arg; ; ++s)
+    {
+        if (!isdigit(*s))
+            return false;
+        ++numbers;
+        while (isdigit(s[1])) ++s;
+        if (*++s == 0)
+            break;
+        if (*s != '-')
+            return false;
+    }
+    return numbers <= 3;
+}
+
+/**
+ * Parse a shard argument as I/N, with 0 <= I < N
+ */
+static bool parse_shard(const char* arg, IndexSelection& sel)
+{
+    char* end;
+    unsigned long shard = strtoul(arg, &end, 10);
+    if (end == arg || *end != '/')
+        return false;
+    const char* total = end + 1;
+    unsigned long shards = strtoul(total, &end, 10);
+    if (end == total || *end != 0 || shards == 0 || shard >= shards)
+        return false;
+    sel.shard = shard;
+    sel.shards = shards;
+    return true;
+}
+
 static void usage(FILE* out)
 {
     fprintf(out, "Usage: bufr2netcdf [options] file[s]\n");
     fprintf(out, "Convert BUFR files to NetCDF according to COSMO conventions\n");
     fprintf(out, "For each input file it generates one or more output files,\n");
     fprintf(out, " one for each different BUFR type encountered.\n");
+    fprintf(out, "Input files can be compressed with gzip, xz or zstd, and can be tar\n");
+    fprintf(out, " or zip archives of BUFR files.\n");
     fprintf(out, "\n");
     fprintf(out, "Options:\n");
     fprintf(out, "  -h, --help                  this help message.\n");
@@ -28,12 +149,184 @@ static void usage(FILE* out)
     fprintf(out, "  -o PFX, --outfile=PFX       prefix to use for output files.\n");
     fprintf(out, "  -n                          generate variable names in the form\n");
     fprintf(out, "                              Type_FXXYYY_RRR instead of using a mnemonic.\n");
+    fprintf(out, "  --nc-header-pad=BYTES       free space to reserve at the end of NetCDF\n");
+    fprintf(out, "                              headers, for later metadata changes (default: 4096).\n");
+    fprintf(out, "  --nc-var-align=BYTES        alignment of the start of NetCDF data\n");
+    fprintf(out, "                              sections (default: 4).\n");
+    fprintf(out, "  -f FMT, --format=FMT        output format: netcdf (default), zarr, arrow\n");
+    fprintf(out, "                              or npy.\n");
+    fprintf(out, "  -j N, --jobs=N              number of threads to use for converting\n");
+    fprintf(out, "                              bulletins with many subsets, and for writing\n");
+    fprintf(out, "                              output with formats that support it, and for\n");
+    fprintf(out, "                              decompressing xz input (default: 1).\n");
+    fprintf(out, "  --zarr-chunk-records=N      number of BUFR records in each chunk of Zarr\n");
+    fprintf(out, "                              output (default: 4096).\n");
+    fprintf(out, "  --arrow-batch-records=N     number of BUFR records in each record batch of\n");
+    fprintf(out, "                              Arrow output (default: 65536).\n");
+    fprintf(out, "  --plan-cache=DIR            cache conversion plans in DIR, to reuse them in\n");
+    fprintf(out, "                              later runs (default: $B2NC_PLAN_CACHE, if set).\n");
+    fprintf(out, "  --atomic                    write outputs under temporary names, and rename\n");
+    fprintf(out, "                              them only when complete.\n");
+    fprintf(out, "  --batch                     convert each input file to its own outputs, named\n");
+    fprintf(out, "                              after it, in the directory given with -o if any.\n");
+    fprintf(out, "                              -j sets the number of files converted in parallel.\n");
+    fprintf(out, "  --inventory                 do not convert, but print as JSON the outputs\n");
+    fprintf(out, "                              that the input files would produce, with their\n");
+    fprintf(out, "                              message and subset counts, sizes and time\n");
+    fprintf(out, "                              ranges. Only the message headers are decoded.\n");
+    fprintf(out, "  --index                     read input files through an index of their\n");
+    fprintf(out, "                              messages, stored next to each file as\n");
+    fprintf(out, "                              FILE.b2nc.idx and created if missing.\n");
+    fprintf(out, "  --select=CAT[-SUB[-LOCAL]]  only convert messages of the given data category,\n");
+    fprintf(out, "                              subcategory and local subcategory; can be given\n");
+    fprintf(out, "                              more than once. Implies --index.\n");
+    fprintf(out, "  --key=KEY                   only convert messages with the given dispatch\n");
+    fprintf(out, "                              key, as CAT-SUB-LOCAL:TABLE:FINGERPRINT listed\n");
+    fprintf(out, "                              by --inventory; can be given more than once.\n");
+    fprintf(out, "                              Implies --index.\n");
+    fprintf(out, "  --time-range=FROM,TO        only convert messages with a section 1 time in\n");
+    fprintf(out, "                              the range, given as YYYYMMDDHHMMSS or a prefix\n");
+    fprintf(out, "                              of it. Implies --index.\n");
+    fprintf(out, "  --shard=I/N                 only convert the I-th of N consecutive ranges of\n");
+    fprintf(out, "                              the selected messages, counting from 0. Outputs\n");
+    fprintf(out, "                              of all shards can be joined with\n");
+    fprintf(out, "                              bufr2netcdf-merge. Implies --index.\n");
+    fprintf(out, "  --stats=FILE                write to FILE a JSON report with the time spent\n");
+    fprintf(out, "                              in each conversion phase, and the messages,\n");
+    fprintf(out, "                              values, padding and bytes of each output.\n");
+    fprintf(out, "  --trace=FILE                write to FILE a Chrome trace event JSON with a\n");
+    fprintf(out, "                              span for each message read, decoded and added,\n");
+    fprintf(out, "                              and for each variable defined and written, to\n");
+    fprintf(out, "                              load in Perfetto or chrome://tracing.\n");
+    fprintf(out, "  --memory-report[=SEC]       print to stderr the memory used by the largest\n");
+    fprintf(out, "                              arrays of each output every SEC seconds\n");
+    fprintf(out, "                              (default: 10) and when closing, with the\n");
+    fprintf(out, "                              high-water mark.\n");
+    fprintf(out, "  --sparsity=FILE             write to FILE a JSON report with, for each\n");
+    fprintf(out, "                              output variable and loop dimension, the cells\n");
+    fprintf(out, "                              written, values and missing values, constant\n");
+    fprintf(out, "                              variables and median and longest replication.\n");
+    fprintf(out, "  --progress[=SEC]            print to stderr every SEC seconds (default: 10)\n");
+    fprintf(out, "                              the bytes read and percent of the input,\n");
+    fprintf(out, "                              messages/s, subsets/s, outputs open, RSS and\n");
+    fprintf(out, "                              estimated time left.\n");
+    fprintf(out, "  --progress-format=FMT       format of the progress reports: text (default)\n");
+    fprintf(out, "                              or json, one object per line.\n");
+    fprintf(out, "  --progress-file=FILE        write each progress report to FILE, replacing\n");
+    fprintf(out, "                              the previous one, instead of stderr. Implies\n");
+    fprintf(out, "                              --progress.\n");
+#ifdef HAVE_INOTIFY
+    fprintf(out, "  --watch=DIR                 run until interrupted, converting each file that\n");
+    fprintf(out, "                              is written or moved into DIR; can be given more\n");
+    fprintf(out, "                              than once. Outputs are written atomically to the\n");
+    fprintf(out, "                              directory given with -o, and -j sets the number\n");
+    fprintf(out, "                              of files converted in parallel.\n");
+#endif
 #ifndef HAS_GETOPT_LONG
     fprintf(out, "NOTE: long options are not supported on this system\n");
 #endif
 
 }
 
+/**
+ * Write a Stats, Trace or Sparsity report to \a fname, if it was collected.
+ *
+ * Returns \a res, or 1 if the report could not be written.
+ */
+template<typename Report>
+static int write_report(const Report* report, const std::string& fname, int res)
+{
+    if (!report)
+        return res;
+    try {
+        report->write(fname);
+    } catch (std::exception& e) {
+        fprintf(stderr, "%s\n", e.what());
+        return 1;
+    }
+    return res;
+}
+
+/**
+ * Total size of the input files, to compute the progress of their
+ * conversion, or 0 if it is not known because some are compressed
+ */
+static uint64_t input_size(char** begin, char** end)
+{
+    uint64_t res = 0;
+    for (char** i = begin; i != end; ++i)
+    {
+        std::unique_ptr<struct stat> st = sys::stat(*i);
+        if (!st)
+            return 0;
+        // Compressed files hold more BUFR data than their size
+        FILE* in = fopen(*i, "rb");
+        if (!in)
+            return 0;
+        char head[6];
+        size_t len = fread(head, 1, 6, in);
+        fclose(in);
+        if (detect_compression(string(head, len)) != Compression::NONE)
+            return 0;
+        res += st->st_size;
+    }
+    return res;
+}
+
+#ifdef HAVE_INOTIFY
+static Watcher* active_watcher = nullptr;
+
+static void stop_watcher(int)
+{
+    if (active_watcher)
+        active_watcher->stop();
+}
+
+/**
+ * Run the watch mode until interrupted by SIGINT or SIGTERM
+ */
+static int run_watch(const Options& options, const vector<string>& dirs, int extra_args)
+{
+    if (extra_args)
+    {
+        fprintf(stderr, "input files cannot be given together with --watch\n");
+        return 1;
+    }
+    if (options.out_fname.empty() || !sys::isdir(options.out_fname))
+    {
+        fprintf(stderr, "--watch requires an existing output directory given with -o\n");
+        return 1;
+    }
+
+    try {
+        Watcher watcher(options, options.out_fname);
+        for (const auto& dir: dirs)
+            watcher.add_directory(dir);
+
+        active_watcher = &watcher;
+        struct sigaction sa;
+        memset(&sa, 0, sizeof(sa));
+        sa.sa_handler = stop_watcher;
+        sigaction(SIGINT, &sa, NULL);
+        sigaction(SIGTERM, &sa, NULL);
+
+        if (options.verbose) fprintf(stderr, "Watching for new files\n");
+        try {
+            watcher.run();
+        } catch (...) {
+            active_watcher = nullptr;
+            throw;
+        }
+        active_watcher = nullptr;
+    } catch (std::exception& e) {
+        fprintf(stderr, "%s\n", e.what());
+        return 1;
+    }
+
+    return 0;
+}
+#endif
+
 int main(int argc, char* argv[])
 {
 #ifdef HAS_GETOPT_LONG
@@ -44,11 +337,49 @@ int main(int argc, char* argv[])
         {"outfile", required_argument, NULL, 'o'},
         {"verbose", no_argument,       NULL, 'v'},
         {"debug",   no_argument,       NULL, 'D'},
+        {"nc-header-pad", required_argument, NULL, OPT_NC_HEADER_PAD},
+        {"nc-var-align",  required_argument, NULL, OPT_NC_VAR_ALIGN},
+        {"format",  required_argument, NULL, 'f'},
+        {"jobs",    required_argument, NULL, 'j'},
+        {"zarr-chunk-records", required_argument, NULL, OPT_ZARR_CHUNK_RECORDS},
+        {"arrow-batch-records", required_argument, NULL, OPT_ARROW_BATCH_RECORDS},
+        {"plan-cache", required_argument, NULL, OPT_PLAN_CACHE},
+        {"atomic",  no_argument,       NULL, OPT_ATOMIC},
+        {"watch",   required_argument, NULL, OPT_WATCH},
+        {"batch",   no_argument,       NULL, OPT_BATCH},
+        {"inventory", no_argument,     NULL, OPT_INVENTORY},
+        {"index",   no_argument,       NULL, OPT_INDEX},
+        {"select",  required_argument, NULL, OPT_SELECT},
+        {"key",     required_argument, NULL, OPT_KEY},
+        {"time-range", required_argument, NULL, OPT_TIME_RANGE},
+        {"shard",   required_argument, NULL, OPT_SHARD},
+        {"stats",   required_argument, NULL, OPT_STATS},
+        {"trace",   required_argument, NULL, OPT_TRACE},
+        {"memory-report", optional_argument, NULL, OPT_MEMORY_REPORT},
+        {"sparsity", required_argument, NULL, OPT_SPARSITY},
+        {"progress", optional_argument, NULL, OPT_PROGRESS},
+        {"progress-format", required_argument, NULL, OPT_PROGRESS_FORMAT},
+        {"progress-file", required_argument, NULL, OPT_PROGRESS_FILE},
         {0, 0, 0, 0}
     };
 #endif
 
     Options options;
+    Instruments instruments;
+    options.instruments = &instruments;
+    vector<string> watch_dirs;
+    bool batch = false;
+    string stats_fname;
+    string trace_fname;
+    string sparsity_fname;
+    size_t progress_interval = 0;
+    Progress::Format progress_format = Progress::Format::TEXT;
+    string progress_fname;
+    bool inventory = false;
+    bool use_index = false;
+    IndexSelection selection;
+    if (const char* dir = getenv("B2NC_PLAN_CACHE"))
+        options.plan_cache_dir = dir;
 
     while (1)
     {
@@ -56,10 +387,10 @@ int main(int argc, char* argv[])
         int option_index = 0;
 
 #ifdef HAS_GETOPT_LONG
-        int c = getopt_long(argc, argv, "o:vhnD",
+        int c = getopt_long(argc, argv, "o:vhnDf:j:",
                 long_options, &option_index);
 #else
-        int c = getopt(argc, argv, "o:vhnD");
+        int c = getopt(argc, argv, "o:vhnDf:j:");
 #endif
 
         /* Detect the end of the options. */
@@ -83,6 +414,146 @@ int main(int argc, char* argv[])
             case 'v':
                 options.verbose = true;
                 break;
+            case OPT_NC_HEADER_PAD:
+                if (!parse_size(optarg, options.nc_header_pad))
+                {
+                    fprintf(stderr, "invalid value for --nc-header-pad: %s\n", optarg);
+                    return 1;
+                }
+                break;
+            case OPT_NC_VAR_ALIGN:
+                if (!parse_size(optarg, options.nc_var_align) || options.nc_var_align == 0)
+                {
+                    fprintf(stderr, "invalid value for --nc-var-align: %s\n", optarg);
+                    return 1;
+                }
+                break;
+            case 'f':
+                options.format = optarg;
+                break;
+            case 'j': {
+                size_t jobs;
+                if (!parse_size(optarg, jobs) || jobs == 0)
+                {
+                    fprintf(stderr, "invalid value for --jobs: %s\n", optarg);
+                    return 1;
+                }
+                options.jobs = jobs;
+                break;
+            }
+            case OPT_ZARR_CHUNK_RECORDS:
+                if (!parse_size(optarg, options.zarr_chunk_records) || options.zarr_chunk_records == 0)
+                {
+                    fprintf(stderr, "invalid value for --zarr-chunk-records: %s\n", optarg);
+                    return 1;
+                }
+                break;
+            case OPT_ARROW_BATCH_RECORDS:
+                if (!parse_size(optarg, options.arrow_batch_records) || options.arrow_batch_records == 0)
+                {
+                    fprintf(stderr, "invalid value for --arrow-batch-records: %s\n", optarg);
+                    return 1;
+                }
+                break;
+            case OPT_PLAN_CACHE:
+                options.plan_cache_dir = optarg;
+                break;
+            case OPT_ATOMIC:
+                options.atomic_output = true;
+                break;
+            case OPT_BATCH:
+                batch = true;
+                break;
+            case OPT_INVENTORY:
+                inventory = true;
+                break;
+            case OPT_INDEX:
+                use_index = true;
+                break;
+            case OPT_SELECT:
+                if (!valid_category(optarg))
+                {
+                    fprintf(stderr, "invalid value for --select: %s\n", optarg);
+                    return 1;
+                }
+                selection.categories.push_back(optarg);
+                use_index = true;
+                break;
+            case OPT_KEY: {
+                IndexKey key;
+                if (!IndexKey::parse(optarg, key))
+                {
+                    fprintf(stderr, "invalid value for --key: %s\n", optarg);
+                    return 1;
+                }
+                selection.keys.push_back(key);
+                use_index = true;
+                break;
+            }
+            case OPT_TIME_RANGE:
+                if (!parse_time_range(optarg, selection))
+                {
+                    fprintf(stderr, "invalid value for --time-range: %s\n", optarg);
+                    return 1;
+                }
+                use_index = true;
+                break;
+            case OPT_SHARD:
+                if (!parse_shard(optarg, selection))
+                {
+                    fprintf(stderr, "invalid value for --shard: %s\n", optarg);
+                    return 1;
+                }
+                use_index = true;
+                break;
+            case OPT_STATS:
+                stats_fname = optarg;
+                break;
+            case OPT_TRACE:
+                trace_fname = optarg;
+                break;
+            case OPT_SPARSITY:
+                sparsity_fname = optarg;
+                break;
+            case OPT_MEMORY_REPORT: {
+                size_t seconds = 10;
+                if (optarg && (!parse_size(optarg, seconds) || seconds == 0))
+                {
+                    fprintf(stderr, "invalid value for --memory-report: %s\n", optarg);
+                    return 1;
+                }
+                instruments.memory_report = seconds;
+                break;
+            }
+            case OPT_PROGRESS:
+                progress_interval = 10;
+                if (optarg && (!parse_size(optarg, progress_interval) || progress_interval == 0))
+                {
+                    fprintf(stderr, "invalid value for --progress: %s\n", optarg);
+                    return 1;
+                }
+                break;
+            case OPT_PROGRESS_FORMAT:
+                try {
+                    progress_format = parse_progress_format(optarg);
+                } catch (std::exception& e) {
+                    fprintf(stderr, "%s\n", e.what());
+                    return 1;
+                }
+                break;
+            case OPT_PROGRESS_FILE:
+                progress_fname = optarg;
+                if (!progress_interval)
+                    progress_interval = 10;
+                break;
+            case OPT_WATCH:
+#ifdef HAVE_INOTIFY
+                watch_dirs.push_back(optarg);
+                break;
+#else
+                fprintf(stderr, "--watch is not supported on this system\n");
+                return 1;
+#endif
             default:
                 // getopt already prints an error message
                 fputc('\n', stderr);
@@ -91,32 +562,169 @@ int main(int argc, char* argv[])
         }
     }
 
+    // Modes that convert or scan whole files, and read no index
+    const char* whole_file_mode = nullptr;
+    if (!watch_dirs.empty())
+        whole_file_mode = "--watch";
+    else if (inventory)
+        whole_file_mode = "--inventory";
+    else if (batch)
+        whole_file_mode = "--batch";
+    if (whole_file_mode && selection.shards > 1)
+    {
+        fprintf(stderr, "--shard cannot be used together with %s\n", whole_file_mode);
+        return 1;
+    }
+    if (whole_file_mode && use_index)
+    {
+        fprintf(stderr, "--index, --select, --key and --time-range cannot be used together with %s\n", whole_file_mode);
+        return 1;
+    }
+
+    // Report progress only of actual conversions
+    unique_ptr<Progress> progress;
+    if (progress_interval && !inventory)
+    {
+        progress.reset(new Progress(progress_interval, progress_format, progress_fname));
+        instruments.progress = progress.get();
+    }
+
+#ifdef HAVE_INOTIFY
+    if (!watch_dirs.empty())
+    {
+        if (!stats_fname.empty() || !trace_fname.empty() || !sparsity_fname.empty())
+        {
+            fprintf(stderr, "--stats, --trace and --sparsity cannot be used together with --watch\n");
+            return 1;
+        }
+        if (progress) progress->start();
+        int res = run_watch(options, watch_dirs, argc - optind);
+        if (progress) progress->stop(res != 0);
+        return res;
+    }
+#endif
+
     if (optind >= argc)
     {
         fprintf(stderr, "Usage: %s [-o file] file1 [file2 [file3 ..]]\n", argv[0]);
         return 1;
     }
 
-    if (options.out_fname.empty())
+    // Collect statistics and traces only of actual conversions
+    unique_ptr<Stats> stats;
+    if (!stats_fname.empty() && !inventory)
+    {
+        stats.reset(new Stats);
+        instruments.stats = stats.get();
+    }
+    unique_ptr<Trace> trace;
+    if (!trace_fname.empty() && !inventory)
+    {
+        trace.reset(new Trace);
+        instruments.trace = trace.get();
+    }
+    unique_ptr<Sparsity> sparsity;
+    if (!sparsity_fname.empty() && !inventory)
+    {
+        sparsity.reset(new Sparsity);
+        instruments.sparsity = sparsity.get();
+    }
+
+    if (inventory)
     {
-        options.out_fname = argv[optind];
-        options.out_fname += ".nc";
+        try {
+            if (options.out_fname.empty())
+            {
+                options.out_fname = argv[optind];
+                options.out_fname += Outfile::backend_extension(options.format);
+            }
+
+            Inventory inv(options);
+            while (optind < argc)
+            {
+                if (options.verbose) fprintf(stderr, "Scanning %s\n", argv[optind]);
+                inv.scan(argv[optind++]);
+            }
+
+            string json;
+            inv.to_json(json);
+            json += '\n';
+            fwrite(json.data(), json.size(), 1, stdout);
+        } catch (std::exception& e) {
+            fprintf(stderr, "%s\n", e.what());
+            return 1;
+        }
+        return 0;
     }
 
+    if (batch)
+    {
+        if (!options.out_fname.empty() && !sys::isdir(options.out_fname))
+        {
+            fprintf(stderr, "with --batch, -o must be an existing directory\n");
+            return 1;
+        }
+        int res = 0;
+        if (progress)
+        {
+            progress->set_total_bytes(input_size(argv + optind, argv + argc));
+            progress->start();
+        }
+        try {
+            vector<string> inputs(argv + optind, argv + argc);
+            unsigned failed = convert_batch(options, inputs, options.out_fname);
+            if (failed)
+            {
+                fprintf(stderr, "%u of %zu files could not be converted\n", failed, inputs.size());
+                res = 1;
+            }
+        } catch (std::exception& e) {
+            fprintf(stderr, "%s\n", e.what());
+            res = 1;
+        }
+        if (progress) progress->stop(res != 0);
+        res = write_report(stats.get(), stats_fname, res);
+        res = write_report(trace.get(), trace_fname, res);
+        return write_report(sparsity.get(), sparsity_fname, res);
+    }
+
+    int res = 0;
+    if (progress)
+    {
+        // With an index, only part of the input may be read
+        if (!use_index)
+            progress->set_total_bytes(input_size(argv + optind, argv + argc));
+        progress->start();
+    }
     try {
+        if (options.out_fname.empty())
+        {
+            options.out_fname = argv[optind];
+            // Keep the outputs of different shards apart
+            if (selection.shards > 1)
+                options.out_fname += ".shard" + to_string(selection.shard) + "of" + to_string(selection.shards);
+            options.out_fname += Outfile::backend_extension(options.format);
+        }
+
         Dispatcher dispatcher(options);
 
         while (optind < argc)
         {
             if (options.verbose) fprintf(stderr, "Reading from %s\n", argv[optind]);
-            read_bufr(argv[optind++], dispatcher);
+            if (use_index)
+                read_bufr(options, argv[optind++], selection, dispatcher);
+            else
+                read_bufr(options, argv[optind++], dispatcher);
         }
 
         dispatcher.close();
     } catch (std::exception& e) {
         fprintf(stderr, "%s\n", e.what());
-        return 1;
+        res = 1;
     }
+    if (progress) progress->stop(res != 0);
 
-    return 0;
+    res = write_report(stats.get(), stats_fname, res);
+    res = write_report(trace.get(), trace_fname, res);
+    return write_report(sparsity.get(), sparsity_fname, res);
 }
@@ -0,0 +1,163 @@
+/*
+ * capi - C interface to the bufr2netcdf library
+ *
+ * Copyright (C) 2026  ARPA-SIM <urpsim@smr.arpa.emr.it>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#include "capi.h"
+#include "converter.h"
+#include <wreport/error.h>
+#include <memory>
+#include <new>
+#include <cstdlib>
+
+using namespace b2nc;
+using namespace wreport;
+using namespace std;
+
+struct b2nc_converter
+{
+    Options opts;
+    /// Created on the first add, so that options can be set before
+    unique_ptr<Converter> converter;
+    vector<ConverterOutput> outputs;
+    string error;
+};
+
+namespace {
+
+/// Run \a func, storing the message of any exception in conv->error
+template<typename Func>
+int guarded(b2nc_converter* conv, Func func)
+{
+    try {
+        func();
+        conv->error.clear();
+        return 0;
+    } catch (std::exception& e) {
+        conv->error = e.what();
+        return -1;
+    } catch (...) {
+        conv->error = "unknown error";
+        return -1;
+    }
+}
+
+bool parse_bool(const char* name, const char* value)
+{
+    string v(value);
+    if (v == "1" || v == "true" || v == "yes") return true;
+    if (v == "0" || v == "false" || v == "no") return false;
+    error_consistency::throwf("invalid value '%s' for option %s", value, name);
+}
+
+size_t parse_size(const char* name, const char* value)
+{
+    char* end;
+    unsigned long long res = strtoull(value, &end, 10);
+    if (!*value || *end)
+        error_consistency::throwf("invalid value '%s' for option %s", value, name);
+    return res;
+}
+
+}
+
+extern "C" {
+
+b2nc_converter* b2nc_converter_new(void)
+{
+    return new (nothrow) b2nc_converter;
+}
+
+void b2nc_converter_free(b2nc_converter* conv)
+{
+    delete conv;
+}
+
+int b2nc_converter_set_option(b2nc_converter* conv, const char* name, const char* value)
+{
+    return guarded(conv, [&] {
+        if (conv->converter && conv->converter->size())
+            throw error_consistency("options cannot be changed while a conversion is in progress");
+
+        string n(name);
+        if (n == "use_mnemonic")
+            conv->opts.use_mnemonic = parse_bool(name, value);
+        else if (n == "verbose")
+            conv->opts.verbose = parse_bool(name, value);
+        else if (n == "debug")
+            conv->opts.debug = parse_bool(name, value);
+        else if (n == "nc_header_pad")
+            conv->opts.nc_header_pad = parse_size(name, value);
+        else if (n == "nc_var_align")
+            conv->opts.nc_var_align = parse_size(name, value);
+        else if (n == "plan_cache_dir")
+            conv->opts.plan_cache_dir = value;
+        else
+            error_notfound::throwf("unknown option %s", name);
+
+        // Recreate the converter with the new options
+        conv->converter.reset();
+    });
+}
+
+int b2nc_converter_add(b2nc_converter* conv, const void* data, size_t size)
+{
+    return guarded(conv, [&] {
+        if (!conv->converter)
+            conv->converter.reset(new Converter(conv->opts));
+        conv->converter->add(data, size);
+    });
+}
+
+void b2nc_converter_reset(b2nc_converter* conv)
+{
+    if (conv->converter)
+        conv->converter->reset();
+}
+
+int b2nc_converter_finish(b2nc_converter* conv, size_t* count)
+{
+    return guarded(conv, [&] {
+        conv->outputs.clear();
+        if (conv->converter)
+            conv->outputs = conv->converter->finish();
+        *count = conv->outputs.size();
+    });
+}
+
+int b2nc_converter_output(b2nc_converter* conv, size_t idx, b2nc_output* out)
+{
+    return guarded(conv, [&] {
+        if (idx >= conv->outputs.size())
+            error_notfound::throwf("output %zu requested, but there are only %zu outputs", idx, conv->outputs.size());
+        const ConverterOutput& o = conv->outputs[idx];
+        out->name = o.name.c_str();
+        out->data_category = o.data_category;
+        out->data_subcategory = o.data_subcategory;
+        out->data_subcategory_local = o.data_subcategory_local;
+        out->records = o.records;
+        out->netcdf = o.netcdf.data();
+        out->netcdf_size = o.netcdf.size();
+    });
+}
+
+const char* b2nc_converter_error(const b2nc_converter* conv)
+{
+    return conv->error.c_str();
+}
+
+}
@@ -0,0 +1,101 @@
+/*
+ * capi - C interface to the bufr2netcdf library
+ *
+ * Copyright (C) 2026  ARPA-SIM <urpsim@smr.arpa.emr.it>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#ifndef B2NC_CAPI_H
+#define B2NC_CAPI_H
+
+/*
+ * Thin C wrapper around b2nc::Converter, returning in-memory NetCDF images.
+ *
+ * Functions returning int return 0 on success and -1 on error; the error
+ * message can then be read with b2nc_converter_error().
+ */
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/// Opaque converter handle
+typedef struct b2nc_converter b2nc_converter;
+
+/// Description of one converted output
+typedef struct b2nc_output
+{
+    /// Output name, as in b2nc::ConverterOutput::name
+    const char* name;
+    int data_category;
+    int data_subcategory;
+    int data_subcategory_local;
+    /// Number of records (BUFR subsets)
+    size_t records;
+    /// NetCDF image
+    const void* netcdf;
+    size_t netcdf_size;
+} b2nc_output;
+
+/// Create a converter with default options, or return NULL on error
+b2nc_converter* b2nc_converter_new(void);
+
+/// Free a converter and all its outputs
+void b2nc_converter_free(b2nc_converter* conv);
+
+/**
+ * Set a conversion option, before adding messages.
+ *
+ * Supported options are "use_mnemonic", "verbose" and "debug" (with values
+ * "0" or "1"), "nc_header_pad", "nc_var_align" and "plan_cache_dir".
+ */
+int b2nc_converter_set_option(b2nc_converter* conv, const char* name, const char* value);
+
+/// Add all the BUFR messages found in a buffer
+int b2nc_converter_add(b2nc_converter* conv, const void* data, size_t size);
+
+/**
+ * Discard the messages added so far, for example after b2nc_converter_add()
+ * failed
+ */
+void b2nc_converter_reset(b2nc_converter* conv);
+
+/**
+ * Convert the messages added so far, storing the number of outputs in
+ * \a count.
+ *
+ * The outputs of the previous call are freed, and new messages can be added
+ * for another conversion.
+ */
+int b2nc_converter_finish(b2nc_converter* conv, size_t* count);
+
+/**
+ * Describe the output \a idx of the last b2nc_converter_finish().
+ *
+ * The pointers in \a out are valid until the next call to
+ * b2nc_converter_finish() or b2nc_converter_free().
+ */
+int b2nc_converter_output(b2nc_converter* conv, size_t idx, b2nc_output* out);
+
+/// Message of the last error, or an empty string
+const char* b2nc_converter_error(const b2nc_converter* conv);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
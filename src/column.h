@@ -0,0 +1,129 @@
+/*
+ * column - Output variables independent of the output format
+ *
+ * Copyright (C) 2026  ARPA-SIM <urpsim@smr.arpa.emr.it>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#ifndef B2NC_COLUMN_H
+#define B2NC_COLUMN_H
+
+/*
+ * This header is part of the public library API, and only depends on the
+ * standard library.
+ */
+
+#include <string>
+#include <vector>
+#include <functional>
+#include <cstddef>
+
+namespace b2nc {
+
+/// Type of the values of an output variable
+enum ValType {
+    VT_INT,
+    VT_FLOAT,
+    VT_DOUBLE,
+    /// Space padded strings, stored in NetCDF as arrays of characters
+    VT_STRING,
+    /// Raw binary data, stored in NetCDF as arrays of bytes
+    VT_BYTES,
+};
+
+/**
+ * Variable attribute, in a representation that does not depend on the output
+ * format
+ */
+struct Attribute
+{
+    std::string name;
+    /// VT_STRING for text attributes, or the type of the numeric values
+    ValType type;
+    /// Value for text attributes
+    std::string text;
+    /// Values for VT_INT attributes
+    std::vector<int> ints;
+    /// Values for VT_FLOAT and VT_DOUBLE attributes
+    std::vector<double> reals;
+
+    static Attribute make_text(const std::string& name, const std::string& value);
+    static Attribute make_int(const std::string& name, int value);
+    static Attribute make_ints(const std::string& name, const std::vector<int>& values);
+    static Attribute make_float(const std::string& name, float value);
+    static Attribute make_double(const std::string& name, double value);
+};
+
+typedef std::vector<Attribute> Attributes;
+
+/**
+ * Values of a range of records of an output variable, flattened in record
+ * order.
+ *
+ * Only the vector matching the type of the variable is used. Missing values
+ * are stored as the NetCDF fill value for their type, or as empty strings.
+ */
+struct ColumnData
+{
+    ValType type = VT_INT;
+    std::vector<int> ints;
+    std::vector<float> floats;
+    std::vector<double> doubles;
+    /// Values for VT_STRING and VT_BYTES variables
+    std::vector<std::string> strings;
+    /**
+     * Record boundaries: the values of the i-th record are found in
+     * positions [offsets[i], offsets[i + 1]).
+     *
+     * It has one element more than the number of records.
+     */
+    std::vector<size_t> offsets;
+
+    /// Reset to hold no records of values of the given type
+    void reset(ValType type);
+
+    /// Number of records
+    size_t records() const { return offsets.empty() ? 0 : offsets.size() - 1; }
+};
+
+/**
+ * Description of an output variable indexed by BUFR record, used by output
+ * backends that do not go through the NetCDF library
+ */
+struct Column
+{
+    std::string name;
+    ValType type = VT_INT;
+
+    /// Name of the loop dimension of replicated variables, empty otherwise
+    std::string loop_dim;
+    /// Maximum number of values per record (1 if not replicated)
+    size_t loop_size = 1;
+
+    /// Name of the string length dimension for VT_STRING and VT_BYTES
+    std::string strlen_dim;
+    /// Length of VT_STRING and VT_BYTES values
+    size_t strlen = 0;
+
+    /// Attributes, in the same order as they are written in NetCDF
+    Attributes attributes;
+
+    /// Read the values of \a count records starting from \a first
+    std::function<void(size_t first, size_t count, ColumnData& out)> collect;
+};
+
+}
+
+#endif
@@ -0,0 +1,88 @@
+/*
+ * columnio - Encoding shared by the column oriented output backends
+ *
+ * Copyright (C) 2026  ARPA-SIM <urpsim@smr.arpa.emr.it>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#include "columnio.h"
+#include "column.h"
+#include "json.h"
+#include <wreport/error.h>
+#include <cstdint>
+#include <cstring>
+
+using namespace wreport;
+using namespace std;
+
+namespace b2nc {
+
+bool is_little_endian()
+{
+    const uint16_t probe = 1;
+    unsigned char first;
+    memcpy(&first, &probe, 1);
+    return first == 1;
+}
+
+std::string numpy_dtype(const Column& col)
+{
+    const char* order = is_little_endian() ? "<" : ">";
+    switch (col.type)
+    {
+        case VT_INT: return string(order) + "i4";
+        case VT_FLOAT: return string(order) + "f4";
+        case VT_DOUBLE: return string(order) + "f8";
+        case VT_STRING: return "|S" + to_string(col.strlen);
+        case VT_BYTES: return "|i1";
+    }
+    throw error_consistency("unknown column type");
+}
+
+void add_attribute_value(JSONWriter& out, const Attribute& attr)
+{
+    switch (attr.type)
+    {
+        case VT_INT:
+            if (attr.ints.size() == 1)
+                out.add(attr.ints[0]);
+            else
+            {
+                out.start_list();
+                for (int val: attr.ints)
+                    out.add(val);
+                out.end_list();
+            }
+            break;
+        case VT_FLOAT:
+        case VT_DOUBLE:
+            if (attr.reals.size() == 1)
+                out.add(attr.reals[0]);
+            else
+            {
+                out.start_list();
+                for (double val: attr.reals)
+                    out.add(val);
+                out.end_list();
+            }
+            break;
+        case VT_STRING:
+        case VT_BYTES:
+            out.add(attr.text);
+            break;
+    }
+}
+
+}
@@ -0,0 +1,48 @@
+/*
+ * columnio - Encoding shared by the column oriented output backends
+ *
+ * Copyright (C) 2026  ARPA-SIM <urpsim@smr.arpa.emr.it>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#ifndef B2NC_COLUMNIO_H
+#define B2NC_COLUMNIO_H
+
+#include <string>
+
+namespace b2nc {
+
+struct Column;
+struct Attribute;
+class JSONWriter;
+
+/// Check if the host byte order is little endian
+bool is_little_endian();
+
+/**
+ * Return the numpy dtype string (like "<i4" or "|S8") for the values of a
+ * column, as used by npy and Zarr
+ */
+std::string numpy_dtype(const Column& col);
+
+/**
+ * Add the value of an attribute to a JSON document, as a single value or as
+ * a list of values
+ */
+void add_attribute_value(JSONWriter& out, const Attribute& attr);
+
+}
+
+#endif
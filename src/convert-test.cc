@@ -21,12 +21,15 @@
 #include "options.h"
 #include "utils.h"
 #include "tests/tests.h"
+#include <wreport/bulletin.h>
 #include <wreport/error.h>
 #include <wreport/utils/sys.h>
 #include <netcdf.h>
 #include <unistd.h>
 #include <cstdlib>
 #include <regex.h>
+#include <glob.h>
+#include <thread>
 
 using namespace b2nc;
 using namespace wreport;
@@ -35,6 +38,17 @@ using namespace std;
 
 namespace {
 
+/// Record the number of subsets of each bulletin received
+struct SubsetCounter : public BufrSink
+{
+    vector<size_t> subsets;
+
+    void add_bufr(std::unique_ptr<BufrBulletin>&& bulletin, const std::string&) override
+    {
+        subsets.push_back(bulletin->subsets.size());
+    }
+};
+
 struct Regexp
 {
     regex_t compiled;
@@ -357,6 +371,65 @@ class Tests : public TestCase
             Convtest t("issue7.bufr");
             t.make_netcdf();
         });
+
+        add_method("batch", []() {
+            sys::rmtree_ifexists("test-batch");
+            sys::makedirs("test-batch");
+
+            Options opts;
+            opts.jobs = 3;
+            vector<string> inputs {
+                b2nc::tests::datafile("bufr/cdfin_acars"),
+                b2nc::tests::datafile("bufr/cdfin_temp"),
+                b2nc::tests::datafile("bufr/cdfin_synop"),
+                "does-not-exist",
+            };
+            wassert(actual(output_fname(opts, inputs[0], "test-batch")) == "test-batch/cdfin_acars.nc");
+            wassert(actual(output_fname(opts, "dir/input", "")) == "dir/input.nc");
+
+            // A failed file does not stop the others
+            wassert(actual(convert_batch(opts, inputs, "test-batch")) == 1u);
+            for (const char* name: { "cdfin_acars", "cdfin_temp", "cdfin_synop" })
+            {
+                glob_t found;
+                string pattern = string("test-batch/") + name + "-*.nc";
+                wassert(actual(glob(pattern.c_str(), 0, nullptr, &found)) == 0);
+                globfree(&found);
+            }
+        });
+
+        add_method("parallel_decode", []() {
+            // Messages with different tables, some loaded for the first time
+            // while other threads are decoding
+            vector<string> raws;
+            for (const char* name: { "bufr/cdfin_acars", "bufr/cdfin_temp", "bufr/cdfin_synop", "bufr/AMSUA.bufr" })
+            {
+                string fname = b2nc::tests::datafile(name);
+                FILE* in = fopen(fname.c_str(), "rb");
+                if (!in) error_system::throwf("cannot open %s", fname.c_str());
+                string raw;
+                while (BufrBulletin::read(in, raw, fname.c_str()))
+                    raws.push_back(raw);
+                fclose(in);
+            }
+
+            // Decoding in parallel gives the same bulletins as one at a time
+            SubsetCounter serial;
+            for (const auto& raw: raws)
+                decode_bufr(raw, serial);
+
+            vector<SubsetCounter> counters(4);
+            vector<thread> threads;
+            for (auto& counter: counters)
+                threads.emplace_back([&] {
+                    for (const auto& raw: raws)
+                        decode_bufr(raw, counter);
+                });
+            for (auto& t: threads)
+                t.join();
+            for (const auto& counter: counters)
+                wassert(actual(counter.subsets == serial.subsets).istrue());
+        });
     }
 } tests("convert");
 
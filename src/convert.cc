@@ -20,12 +20,31 @@
  */
 
 #include "convert.h"
+#include "input.h"
+#include "archive.h"
 #include "options.h"
+#include "instruments.h"
 #include "ncoutfile.h"
 #include "arrays.h"
+#include "zarr.h"
+#include "npy.h"
+#include "arrow.h"
 #include "utils.h"
+#include "threads.h"
+#include "stats.h"
+#include "trace.h"
+#include "memory.h"
+#include "sparsity.h"
+#include "progress.h"
 #include <wreport/bulletin.h>
+#include <wreport/utils/sys.h>
+#include <algorithm>
+#include <atomic>
 #include <map>
+#include <mutex>
+#include <set>
+#include <shared_mutex>
+#include <tuple>
 #include <vector>
 #include <netcdf.h>
 
@@ -36,36 +55,198 @@ namespace b2nc {
 
 struct OutfileImpl;
 
+namespace {
+
+/**
+ * Decoding loads the BUFR tables into wreport's process-wide table cache,
+ * which is not documented as thread safe. Tables are loaded with this held
+ * exclusively, the first time each version is seen; messages whose tables
+ * are already in the cache are decoded in parallel, with it held shared.
+ */
+shared_mutex tables_lock;
+
+/// Header fields that select the BUFR tables of a message
+typedef std::tuple<int, unsigned, unsigned, int, int, int> TablesKey;
+
+/// Table versions already loaded in wreport's cache, protected by tables_lock
+std::set<TablesKey> loaded_tables;
+
+unique_ptr<BufrBulletin> decode_bulletin(const std::string& raw, const char* fname, off_t offset)
+{
+    static const unique_ptr<BufrCodecOptions> codec_opts = [] {
+        unique_ptr<BufrCodecOptions> res(BufrCodecOptions::create());
+        res->decode_adds_undef_attrs = true;
+        return res;
+    }();
+
+    // Sections 0 to 3 only, which do not need tables
+    unique_ptr<BufrBulletin> header = BufrBulletin::decode_header(raw, fname, offset);
+    TablesKey key(header->edition_number,
+            header->originating_centre, header->originating_subcentre,
+            header->master_table_number, header->master_table_version_number,
+            header->master_table_version_number_local);
+
+    {
+        shared_lock<shared_mutex> lock(tables_lock);
+        if (loaded_tables.find(key) != loaded_tables.end())
+            return BufrBulletin::decode(raw, *codec_opts, fname, offset);
+    }
+
+    unique_lock<shared_mutex> lock(tables_lock);
+    unique_ptr<BufrBulletin> res = BufrBulletin::decode(raw, *codec_opts, fname, offset);
+    loaded_tables.insert(key);
+    return res;
+}
+
+/**
+ * Like read_bufr(in, out, fname), timing reads and decoding in the stats and
+ * trace of instruments(opts)
+ */
+void read_stream(const Options& opts, FILE* in, BufrSink& out, const char* fname)
+{
+    string rawmsg;
+    off_t offset;
+    while (true)
+    {
+        {
+            PhaseTimer timer(instruments(opts).stats, Phase::READ);
+            TraceSpan span(instruments(opts).trace, "read", fname);
+            if (!BufrBulletin::read(in, rawmsg, fname, &offset))
+                break;
+        }
+        decode_bufr(opts, rawmsg, out, fname, offset);
+    }
+}
+
+}
+
 void read_bufr(const std::string& fname, BufrSink& out)
 {
-    // Open input file
-    FILE* in = fopen(fname.c_str(), "rb");
-    if (in == NULL)
-        error_system::throwf("cannot open %s", fname.c_str());
+    read_bufr(Options(), fname, out);
+}
 
+void read_bufr(const Options& opts, const std::string& fname, BufrSink& out)
+{
+    InputFile in(fname, opts.jobs);
     try {
-        read_bufr(in, out, fname.c_str());
-        fclose(in);
+        read_members(in, [&](FILE* member, const std::string& name) {
+            if (opts.verbose && name != fname)
+                fprintf(stderr, "Reading %s\n", name.c_str());
+            read_stream(opts, member, out, name.c_str());
+        });
     } catch (...) {
-        fclose(in);
+        // A decompression error explains a failed read better, and is
+        // thrown by close() if there was one
+        in.close();
         throw;
     }
+    in.close();
 }
 
 void read_bufr(FILE* in, BufrSink& out, const char* fname)
 {
     string rawmsg;
-    unique_ptr<BufrCodecOptions> codec_opts(BufrCodecOptions::create());
-    codec_opts->decode_adds_undef_attrs = true;
-
     off_t offset;
     while (BufrBulletin::read(in, rawmsg, fname, &offset))
+        decode_bufr(rawmsg, out, fname, offset);
+}
+
+void decode_bufr(const std::string& raw, BufrSink& out, const char* fname, off_t offset)
+{
+    out.add_bufr(decode_bulletin(raw, fname, offset), raw);
+}
+
+void decode_bufr(const Options& opts, const std::string& raw, BufrSink& out, const char* fname, off_t offset)
+{
+    unique_ptr<BufrBulletin> bulletin;
     {
-        // Decode the BUFR message
-        unique_ptr<BufrBulletin> bulletin = BufrBulletin::decode(rawmsg, *codec_opts, fname, offset);
+        PhaseTimer timer(instruments(opts).stats, Phase::DECODE);
+        TraceSpan span(instruments(opts).trace, "decode", fname, offset);
+        bulletin = decode_bulletin(raw, fname, offset);
+    }
+    if (Progress* progress = instruments(opts).progress)
+        progress->add_message(raw.size(), bulletin->subsets.size());
+    out.add_bufr(move(bulletin), raw);
+}
 
-        out.add_bufr(move(bulletin), rawmsg);
+std::string output_fname(const Options& opts, const std::string& input, const std::string& outdir)
+{
+    string res;
+    if (outdir.empty())
+        res = input;
+    else
+    {
+        size_t pos = input.rfind('/');
+        res = outdir + "/" + (pos == string::npos ? input : input.substr(pos + 1));
     }
+    return res + Outfile::backend_extension(opts.format);
+}
+
+std::string output_name(const wreport::BufrBulletin& bulletin, std::set<std::string>& used)
+{
+    char base[40];
+    snprintf(base, 40, "%d-%d-%d",
+            bulletin.data_category, bulletin.data_subcategory,
+            bulletin.data_subcategory_local);
+
+    string cand = base;
+    for (unsigned i = 1; used.find(cand) != used.end(); ++i)
+    {
+        char idx[20];
+        snprintf(idx, 20, ".%d", i);
+        cand = string(base) + idx;
+    }
+    used.insert(cand);
+    return cand;
+}
+
+std::string output_group_fname(const Options& opts, const std::string& name)
+{
+    string base = opts.out_fname;
+    string ext = Outfile::backend_extension(opts.format);
+
+    // Drop the trailing extension if it exists
+    if (base.size() >= ext.size() && base.substr(base.size() - ext.size()) == ext)
+        base = base.substr(0, base.size() - ext.size());
+    else if (base.size() >= 3 && base.substr(base.size() - 3) == ".nc")
+        base = base.substr(0, base.size() - 3);
+
+    return base + "-" + name + ext;
+}
+
+unsigned convert_batch(const Options& opts, const std::vector<std::string>& inputs, const std::string& outdir)
+{
+    // Largest files first, so that the long conversions do not end up last
+    vector<pair<off_t, string>> files;
+    for (const auto& input: inputs)
+    {
+        std::unique_ptr<struct stat> st = sys::stat(input);
+        files.push_back(make_pair(st ? st->st_size : 0, input));
+    }
+    stable_sort(files.begin(), files.end(), [](const pair<off_t, string>& a, const pair<off_t, string>& b) {
+        return a.first > b.first;
+    });
+
+    Options file_opts(opts);
+    // Parallelism is across files
+    file_opts.jobs = 1;
+
+    atomic<unsigned> failed(0);
+    parallel_for_stealing(opts.jobs, files.size(), [&](size_t i) {
+        const string& input = files[i].second;
+        Options o(file_opts);
+        o.out_fname = output_fname(opts, input, outdir);
+        try {
+            if (opts.verbose) fprintf(stderr, "Reading from %s\n", input.c_str());
+            Dispatcher dispatcher(o);
+            read_bufr(o, input, dispatcher);
+            dispatcher.close();
+        } catch (std::exception& e) {
+            fprintf(stderr, "%s: %s\n", input.c_str(), e.what());
+            ++failed;
+        }
+    });
+    return failed;
 }
 
 Dispatcher::Key::Key(const wreport::BufrBulletin& bulletin)
@@ -91,50 +272,86 @@ bool Dispatcher::Key::operator<(const Key& v) const
 }
 
 Dispatcher::Dispatcher(const Options& opts)
-    : opts(opts)
+    : opts(opts),
+      next_memory_report(std::chrono::steady_clock::now() + std::chrono::seconds(instruments(opts).memory_report))
 {
 }
 
 Dispatcher::~Dispatcher()
 {
+    vector<pair<string, string>> unfinished;
+    unfinished.swap(pending_renames);
+
     close();
+
+    for (const auto& r: unfinished)
+    {
+        if (sys::isdir(r.first))
+            sys::rmtree_ifexists(r.first);
+        else
+            sys::unlink_ifexists(r.first);
+    }
 }
 
 void Dispatcher::close()
 {
+    if (instruments(opts).memory_report && !outfiles.empty())
+    {
+        memory_report(stderr);
+        fprintf(stderr, "Memory high-water mark of the outputs: %s, peak RSS: %s\n",
+                format_bytes(memory_high_water).c_str(), format_bytes(peak_rss() * 1024).c_str());
+    }
+
+    if (Sparsity* report = instruments(opts).sparsity)
+        for (const auto& i: outfiles)
+        {
+            OutputSparsity sparsity;
+            sparsity.fname = fnames[i.first];
+            i.second->sparsity(sparsity);
+            report->add(move(sparsity));
+        }
+
     for (std::map<Key, Outfile*>::iterator i = outfiles.begin();
             i != outfiles.end(); ++i)
     {
         i->second->close();
         delete i->second;
+        if (Progress* progress = instruments(opts).progress)
+            progress->output_closed();
     }
     outfiles.clear();
+    fnames.clear();
+
+    for (const auto& r: pending_renames)
+    {
+        // Directory outputs cannot replace an existing directory
+        if (sys::isdir(r.second))
+            sys::rmtree(r.second);
+        sys::rename(r.first, r.second);
+    }
+    pending_renames.clear();
 }
 
-std::string Dispatcher::get_fname(const wreport::BufrBulletin& bulletin)
+size_t Dispatcher::memory_report(FILE* out, unsigned top)
 {
-    string base = opts.out_fname;
-
-    // Drop the trailing .nc extension if it exists
-    if (base.length() > 2)
-        if (base.substr(base.size() - 3) == ".nc")
-            base = base.substr(0, base.size() - 3);
-
-    char catstr[40];
-    snprintf(catstr, 40, "-%d-%d-%d",
-            bulletin.data_category, bulletin.data_subcategory,
-            bulletin.data_subcategory_local);
-    base += catstr;
-
-    string cand = base + ".nc";
-    for (unsigned i = 1; used_fnames.find(cand) != used_fnames.end(); ++i)
+    size_t total = 0;
+    for (const auto& i: outfiles)
     {
-        char ext[20];
-        snprintf(ext, 20, ".%d.nc", i);
-        cand = base + ext;
+        MemoryUsage usage;
+        i.second->memory_usage(usage);
+        usage.sort();
+        usage.print(out, fnames[i.first], top);
+        total += usage.total();
     }
-    used_fnames.insert(cand);
-    return cand;
+    if (total > memory_high_water)
+        memory_high_water = total;
+    fprintf(out, "Memory used by %zu outputs: %s\n", outfiles.size(), format_bytes(total).c_str());
+    return total;
+}
+
+std::string Dispatcher::get_fname(const wreport::BufrBulletin& bulletin)
+{
+    return output_group_fname(opts, output_name(bulletin, used_names));
 }
 
 Outfile& Dispatcher::get_outfile(const wreport::BufrBulletin& bulletin)
@@ -147,125 +364,49 @@ Outfile& Dispatcher::get_outfile(const wreport::BufrBulletin& bulletin)
     {
         unique_ptr<Outfile> out = Outfile::get(opts);
         Outfile& res = *out;
-        out->open(get_fname(bulletin));
+        string fname = get_fname(bulletin);
+        if (opts.atomic_output)
+        {
+            // Hidden name in the same directory, so that rename is atomic
+            size_t pos = fname.rfind('/');
+            pos = pos == string::npos ? 0 : pos + 1;
+            string tmpname = fname.substr(0, pos) + "." + fname.substr(pos) + ".tmp";
+            pending_renames.push_back(make_pair(tmpname, fname));
+            out->open(tmpname);
+        } else
+            out->open(fname);
+        if (Stats* all_stats = instruments(opts).stats)
+        {
+            KeyStats& stats = all_stats->key(fname);
+            stats.data_category = bulletin.data_category;
+            stats.data_subcategory = bulletin.data_subcategory;
+            stats.data_subcategory_local = bulletin.data_subcategory_local;
+            stats.master_table_version_number = bulletin.master_table_version_number;
+            out->set_stats(&stats);
+        }
+        fnames[key] = fname;
         outfiles.insert(make_pair(key, out.release()));
+        if (Progress* progress = instruments(opts).progress)
+            progress->output_opened();
         return res;
     }
 }
 
 void Dispatcher::add_bufr(unique_ptr<wreport::BufrBulletin>&& bulletin, const std::string& raw)
 {
+    TraceSpan span(instruments(opts).trace, "dispatch");
     get_outfile(*bulletin).add_bufr(move(bulletin), raw);
-}
-
-/**
- * Collect data from BUFR bulletins, organise them in NetCDF-style arrays, and
- * write a NetCDF file with the resulting arrays
- */
-struct NCFiller
-{
-    Arrays arrays;
-    Sections sec1;
-    Sections sec2;
-    IntArray edition;
-    IntArray s1mtn;
-    IntArray s1ce;
-    IntArray s1sc;
-    IntArray s1usn;
-    IntArray s1cat;
-    IntArray s1subcat;
-    IntArray s1localsubcat;
-    IntArray s1mtv;
-    IntArray s1ltv;
-    IntArray s1date;
-    IntArray s1time;
-
-    NCFiller(const Options& opts)
-        : arrays(opts),
-          sec1(1), sec2(2),
-          edition("edition_number"),
-          s1mtn("section1_master_table_nr"),
-          s1ce("section1_centre"),
-          s1sc("section1_subcentre"),
-          s1usn("section1_update_sequence_nr"),
-          s1cat("section1_data_category"),
-          s1subcat("section1_int_data_sub_category"),
-          s1localsubcat("section1_local_data_sub_category"),
-          s1mtv("section1_master_tables_version"),
-          s1ltv("section1_local_tables_version"),
-          s1date("section1_date"),
-          s1time("section1_time")
-    {
-        //arrays.debug = true;
-    }
 
-    void add(unique_ptr<BufrBulletin>&& bulletin, const std::string& raw)
+    if (instruments(opts).memory_report)
     {
-        for (auto& si: bulletin->subsets)
+        auto now = std::chrono::steady_clock::now();
+        if (now >= next_memory_report)
         {
-            // Add contents to the various data arrays
-            edition.add(bulletin->edition_number);
-            s1mtn.add(bulletin->master_table_number);
-            s1ce.add(bulletin->originating_centre);
-            s1sc.add(bulletin->originating_subcentre);
-            s1usn.add(bulletin->update_sequence_number);
-            s1cat.add(bulletin->data_category);
-            if (bulletin->data_subcategory == 255)
-                s1subcat.add_missing();
-            else
-                s1subcat.add(bulletin->data_subcategory);
-            s1localsubcat.add(bulletin->data_subcategory_local);
-            s1mtv.add(bulletin->master_table_version_number);
-            s1ltv.add(bulletin->master_table_version_number_local);
-            s1date.add(bulletin->rep_year * 10000 + bulletin->rep_month * 100 + bulletin->rep_day);
-            s1time.add(bulletin->rep_hour * 10000 + bulletin->rep_minute * 100 + bulletin->rep_second);
-            sec1.add(*bulletin, raw);
-            sec2.add(*bulletin, raw);
+            memory_report(stderr);
+            next_memory_report = now + std::chrono::seconds(instruments(opts).memory_report);
         }
-
-        arrays.add(move(bulletin));
     }
-
-    void define(NCOutfile& outfile)
-    {
-        // Define variables
-
-        edition.define(outfile);
-        s1mtn.define(outfile);
-        s1ce.define(outfile);
-        s1sc.define(outfile);
-        s1usn.define(outfile);
-        s1cat.define(outfile);
-        s1subcat.define(outfile);
-        s1localsubcat.define(outfile);
-        s1mtv.define(outfile);
-        s1ltv.define(outfile);
-        s1date.define(outfile);
-        s1time.define(outfile);
-        sec1.define(outfile);
-        sec2.define(outfile);
-        arrays.define(outfile);
-    }
-
-    void putvar(NCOutfile& outfile)
-    {
-        edition.putvar(outfile);
-        s1mtn.putvar(outfile);
-        s1ce.putvar(outfile);
-        s1sc.putvar(outfile);
-        s1usn.putvar(outfile);
-        s1cat.putvar(outfile);
-        s1subcat.putvar(outfile);
-        s1localsubcat.putvar(outfile);
-        s1mtv.putvar(outfile);
-        s1ltv.putvar(outfile);
-        s1date.putvar(outfile);
-        s1time.putvar(outfile);
-        sec1.putvar(outfile);
-        sec2.putvar(outfile);
-        arrays.putvar(outfile);
-    }
-};
+}
 
 struct OutfileImpl : public Outfile
 {
@@ -292,34 +433,113 @@ struct OutfileImpl : public Outfile
         if (ncout.ncid == -1)
             return;
 
-        try {
-            // Define all other dimensions, variables and attributes
-            filler.define(ncout);
+        filler.write(ncout);
+    }
 
-            // End define mode
-            ncout.end_define_mode();
+    void add_bufr(std::unique_ptr<wreport::BufrBulletin>&& bulletin, const std::string& raw) override
+    {
+        filler.add(move(bulletin), raw);
+    }
 
-            // Put variables
-            filler.putvar(ncout);
+    void set_stats(KeyStats* stats) override
+    {
+        filler.set_stats(stats);
+    }
 
-            ncout.close();
-        } catch (...) {
-            // Close the file anyway in case of error, so we don't try to write
-            // things out again in the destructor
-            ncout.close();
-            throw;
-        }
+    void memory_usage(MemoryUsage& out) const override
+    {
+        filler.memory_usage(out);
     }
 
-    void add_bufr(std::unique_ptr<wreport::BufrBulletin>&& bulletin, const std::string& raw) override
+    void sparsity(OutputSparsity& out) const override
     {
-        filler.add(move(bulletin), raw);
+        filler.sparsity(out);
     }
 };
 
+namespace {
+
+struct Backend
+{
+    std::string extension;
+    Outfile::Factory factory;
+};
+
+/// Registered backends, and the lock that protects them
+struct Registry
+{
+    std::mutex lock;
+    std::map<std::string, Backend> backends;
+
+    Registry()
+    {
+        backends["netcdf"] = Backend{".nc", [](const Options& opts) {
+            return unique_ptr<Outfile>(new OutfileImpl(opts));
+        }};
+        backends["zarr"] = Backend{".zarr", [](const Options& opts) {
+            return make_zarr_outfile(opts);
+        }};
+        backends["npy"] = Backend{".npy.d", [](const Options& opts) {
+            return make_npy_outfile(opts);
+        }};
+        backends["arrow"] = Backend{".arrow", [](const Options& opts) {
+            return make_arrow_outfile(opts);
+        }};
+    }
+};
+
+Registry& registry()
+{
+    // Initialisation of function-local statics is thread safe, and the
+    // registry is never destroyed, so that it can be used at exit
+    static Registry* res = new Registry;
+    return *res;
+}
+
+Backend get_backend(const std::string& name)
+{
+    Registry& reg = registry();
+    lock_guard<mutex> guard(reg.lock);
+    auto i = reg.backends.find(name);
+    if (i == reg.backends.end())
+        error_notfound::throwf("output format %s is not supported", name.c_str());
+    return i->second;
+}
+
+}
+
 std::unique_ptr<Outfile> Outfile::get(const Options& opts)
 {
-    return unique_ptr<Outfile>(new OutfileImpl(opts));
+    return get_backend(opts.format).factory(opts);
+}
+
+void Outfile::register_backend(const std::string& name, const std::string& extension, Factory factory)
+{
+    Registry& reg = registry();
+    lock_guard<mutex> guard(reg.lock);
+    reg.backends[name] = Backend{extension, factory};
+}
+
+void Outfile::unregister_backend(const std::string& name)
+{
+    Registry& reg = registry();
+    lock_guard<mutex> guard(reg.lock);
+    reg.backends.erase(name);
+}
+
+std::string Outfile::backend_extension(const std::string& name)
+{
+    return get_backend(name).extension;
+}
+
+std::vector<std::string> Outfile::backend_names()
+{
+    Registry& reg = registry();
+    lock_guard<mutex> guard(reg.lock);
+    std::vector<std::string> res;
+    for (const auto& i: reg.backends)
+        res.push_back(i.first);
+    return res;
 }
 
 }
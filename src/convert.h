@@ -24,11 +24,14 @@
 
 #include <wreport/varinfo.h>
 #include <string>
+#include <functional>
+#include <chrono>
 #include <memory>
 #include <map>
 #include <set>
 #include <vector>
 #include <cstdio>
+#include <sys/types.h>
 
 namespace wreport {
 struct BufrBulletin;
@@ -36,6 +39,9 @@ struct BufrBulletin;
 
 namespace b2nc {
 struct Options;
+struct KeyStats;
+struct MemoryUsage;
+struct OutputSparsity;
 
 /// Generic interface for BUFR consumers
 struct BufrSink
@@ -45,10 +51,21 @@ struct BufrSink
 };
 
 /**
- * Send all the contents of the given BUFR file to \a out
+ * Send all the contents of the given BUFR file to \a out.
+ *
+ * Files compressed with gzip, xz or zstd are decompressed on the fly (see
+ * InputFile), and the members of tar and zip archives are read in sequence
+ * (see read_members).
  */
 void read_bufr(const std::string& fname, BufrSink& out);
 
+/**
+ * Like read_bufr(fname, out), using opts.jobs threads for decompression
+ * where supported, and logging the archive members read if opts.verbose is
+ * set
+ */
+void read_bufr(const Options& opts, const std::string& fname, BufrSink& out);
+
 /**
  * Send all the condents of the given BUFR stream to \a out
  *
@@ -57,13 +74,68 @@ void read_bufr(const std::string& fname, BufrSink& out);
  */
 void read_bufr(FILE* in, BufrSink& out, const char* fname = 0);
 
+/**
+ * Decode one encoded BUFR message and send it to \a out
+ *
+ * @param fname
+ *   if provided, it is used as the file name in error messages
+ * @param offset
+ *   position of the message in the file, used in error messages
+ */
+void decode_bufr(const std::string& raw, BufrSink& out, const char* fname = 0, off_t offset = 0);
+
+/**
+ * Like decode_bufr(raw, out, fname, offset), recording the decoding in the
+ * instruments of opts, if it has any
+ */
+void decode_bufr(const Options& opts, const std::string& raw, BufrSink& out, const char* fname, off_t offset);
+
+/**
+ * Name outputs after an input file, like the command line does: the input
+ * file name plus the output extension, in \a outdir if it is not empty, or
+ * next to the input file otherwise
+ */
+std::string output_fname(const Options& opts, const std::string& input, const std::string& outdir);
+
+/**
+ * Name the output of a group of bulletins after their categories, as
+ * "category-subcategory-localsubcategory", adding ".N" if the name is already
+ * in \a used. The name is then added to \a used.
+ */
+std::string output_name(const wreport::BufrBulletin& bulletin, std::set<std::string>& used);
+
+/**
+ * Return the name of the output file for the output named \a name (see
+ * output_name()), built from opts.out_fname and the extension of
+ * opts.format
+ */
+std::string output_group_fname(const Options& opts, const std::string& name);
 
 /**
- * One output NetCDF file
+ * Convert each input file to its own set of outputs, named with
+ * output_fname().
+ *
+ * Files are converted in parallel by opts.jobs threads, largest first,
+ * sharing table and plan caches. Errors are reported on standard error
+ * without stopping the conversion of the other files.
+ *
+ * @returns the number of files that could not be converted
+ */
+unsigned convert_batch(const Options& opts, const std::vector<std::string>& inputs, const std::string& outdir);
+
+
+/**
+ * One output file.
+ *
+ * The output format is implemented by backends, registered by name with
+ * register_backend()
  */
 struct Outfile : public BufrSink
 {
 public:
+    /// Function creating an Outfile for a backend
+    typedef std::function<std::unique_ptr<Outfile>(const Options&)> Factory;
+
     virtual ~Outfile() {}
 
     /**
@@ -82,9 +154,56 @@ public:
     void add_bufr(std::unique_ptr<wreport::BufrBulletin>&& bulletin, const std::string& raw) override = 0;
 
     /**
-     * Create an Outfile
+     * Collect timings and counters of this output in the given KeyStats.
+     *
+     * The default implementation ignores them, for backends that do not
+     * support it.
+     */
+    virtual void set_stats(KeyStats*) {}
+
+    /**
+     * Add to the given MemoryUsage the heap memory used by the data collected
+     * so far.
+     *
+     * The default implementation adds nothing, for backends that do not
+     * support it.
+     */
+    virtual void memory_usage(MemoryUsage&) const {}
+
+    /**
+     * Analyse into the given OutputSparsity the padding and missing values of
+     * the data collected so far.
+     *
+     * The default implementation leaves it empty, for backends that do not
+     * support it.
+     */
+    virtual void sparsity(OutputSparsity&) const {}
+
+    /**
+     * Create an Outfile for the backend selected in opts.format
      */
     static std::unique_ptr<Outfile> get(const Options& opts);
+
+    /**
+     * Register a new output backend.
+     *
+     * @param name
+     *   Name used to select the backend in Options::format
+     * @param extension
+     *   Extension, including the leading dot, of the output file names
+     * @param factory
+     *   Function used to create the Outfile
+     */
+    static void register_backend(const std::string& name, const std::string& extension, Factory factory);
+
+    /// Remove a backend registered with register_backend()
+    static void unregister_backend(const std::string& name);
+
+    /// Return the output file extension for the given backend
+    static std::string backend_extension(const std::string& name);
+
+    /// Return the names of all the registered backends
+    static std::vector<std::string> backend_names();
 };
 
 /**
@@ -95,7 +214,7 @@ public:
  */
 class Dispatcher : public BufrSink
 {
-protected:
+public:
     /**
      * Bulletin dispatch key.
      *
@@ -113,19 +232,49 @@ protected:
         Key(const wreport::BufrBulletin& bulletin);
         bool operator<(const Key& v) const;
     };
+
+protected:
     const Options& opts;
     std::map<Key, Outfile*> outfiles;
-    std::set<std::string> used_fnames;
+    /// Names returned by output_name() for the outputs so far
+    std::set<std::string> used_names;
+    /// Temporary and final names of outputs written with atomic_output
+    std::vector<std::pair<std::string, std::string>> pending_renames;
+    /// Names of the outputs, used in memory reports
+    std::map<Key, std::string> fnames;
+    /// Time of the next periodic memory report
+    std::chrono::steady_clock::time_point next_memory_report;
+    /// Largest total memory seen by memory_report()
+    size_t memory_high_water = 0;
 
     std::string get_fname(const wreport::BufrBulletin& bulletin);
     Outfile& get_outfile(const wreport::BufrBulletin& bulletin);
 
 public:
     Dispatcher(const Options& opts);
+
+    /**
+     * Close all outputs.
+     *
+     * With Options::atomic_output, outputs are removed instead of being
+     * renamed to their final names, unless close() has been called.
+     */
     virtual ~Dispatcher();
 
+    /// Close all outputs, moving them to their final names if needed
     void close();
 
+    /**
+     * Print to \a out the heap memory used by each output, with its
+     * \a top largest arrays, and the total.
+     *
+     * Returns the total, which also updates the high-water mark.
+     */
+    size_t memory_report(FILE* out, unsigned top = 10);
+
+    /// Largest total memory found by memory_report() so far
+    size_t get_memory_high_water() const { return memory_high_water; }
+
     void add_bufr(std::unique_ptr<wreport::BufrBulletin>&& bulletin, const std::string& raw) override;
 };
 
@@ -0,0 +1,186 @@
+/*
+ * Copyright (C) 2026  ARPA-SIM <urpsim@smr.arpa.emr.it>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#include "converter.h"
+#include "capi.h"
+#include "utils.h"
+#include "tests/tests.h"
+#include <wreport/utils/sys.h>
+#include <netcdf.h>
+#include <map>
+
+using namespace b2nc;
+using namespace wreport;
+using namespace wreport::tests;
+using namespace std;
+
+namespace {
+
+/// Return the length of the BUFR_records dimension of a NetCDF image
+size_t image_records(const std::string& image)
+{
+    string buf(image);
+    int ncid;
+    int res = nc_open_mem("test", NC_NOWRITE, buf.size(), &buf[0], &ncid);
+    error_netcdf::throwf_iferror(res, "opening in-memory NetCDF image");
+    int dimid;
+    res = nc_inq_dimid(ncid, "BUFR_records", &dimid);
+    error_netcdf::throwf_iferror(res, "looking up BUFR_records");
+    size_t len;
+    res = nc_inq_dimlen(ncid, dimid, &len);
+    error_netcdf::throwf_iferror(res, "reading the length of BUFR_records");
+    nc_close(ncid);
+    return len;
+}
+
+class Tests : public TestCase
+{
+    using TestCase::TestCase;
+
+    void register_tests() override
+    {
+        add_method("netcdf", []() {
+            string data = sys::read_file(b2nc::tests::datafile("bufr/cdfin_acars"));
+            Converter conv;
+            conv.add(data);
+            wassert(actual(conv.size()) > 0u);
+
+            vector<ConverterOutput> outputs = conv.finish();
+            wassert(actual(outputs.size()) > 0u);
+            wassert(actual(conv.size()) == 0u);
+            for (const auto& o: outputs)
+            {
+                wassert(actual(o.netcdf.substr(0, 3)) == "CDF");
+                wassert(actual(o.records) > 0u);
+                wassert(actual(image_records(o.netcdf)) == o.records);
+            }
+        });
+
+        add_method("columns", []() {
+            string data = sys::read_file(b2nc::tests::datafile("bufr/cdfin_acars"));
+            Converter conv;
+            conv.add(data);
+
+            unsigned calls = 0;
+            conv.finish([&](const ConverterOutput& o, const vector<Column>& columns) {
+                ++calls;
+                wassert(actual(o.netcdf.size()) == 0u);
+                wassert(actual(columns.size()) > 0u);
+                wassert(actual(columns[0].name) == "edition_number");
+                ColumnData values;
+                columns[0].collect(0, o.records, values);
+                wassert(actual(values.records()) == o.records);
+            });
+            wassert(actual(calls) > 0u);
+            wassert(actual(conv.size()) == 0u);
+        });
+
+        add_method("reuse", []() {
+            string acars = sys::read_file(b2nc::tests::datafile("bufr/cdfin_acars"));
+            string temp = sys::read_file(b2nc::tests::datafile("bufr/cdfin_temp"));
+            Converter conv;
+
+            conv.add(acars);
+            vector<ConverterOutput> first = conv.finish();
+
+            // A different conversion in between does not affect the results
+            conv.add(temp);
+            conv.finish();
+
+            conv.add(acars);
+            vector<ConverterOutput> second = conv.finish();
+
+            wassert(actual(second.size()) == first.size());
+            for (size_t i = 0; i < first.size(); ++i)
+            {
+                wassert(actual(second[i].name) == first[i].name);
+                wassert_true(second[i].netcdf == first[i].netcdf);
+            }
+        });
+
+        add_method("stream", []() {
+            string data = sys::read_file(b2nc::tests::datafile("bufr/cdfin_acars"));
+            Converter conv;
+            conv.add(data);
+            vector<ConverterOutput> outputs = conv.finish();
+
+            // Batches of one message each add up to the whole outputs
+            map<string, size_t> records;
+            unsigned batches = 0;
+            conv.stream(1, [&](const ConverterBatch& batch) {
+                ++batches;
+                wassert(actual(batch.output.netcdf.size()) == 0u);
+                wassert(actual(batch.first_record) == records[batch.output.name]);
+                records[batch.output.name] += batch.output.records;
+                wassert(actual(batch.values.size()) == batch.columns.size());
+                wassert(actual(batch.columns[0].name) == "edition_number");
+                for (const auto& values: batch.values)
+                    wassert(actual(values.records()) == batch.output.records);
+            });
+            conv.add(data);
+            wassert(actual(batches) > 0u);
+            wassert(actual(conv.size()) == outputs.size());
+            wassert(actual(conv.finish().size()) == 0u);
+            wassert(actual(conv.size()) == 0u);
+
+            wassert(actual(records.size()) == outputs.size());
+            for (const auto& o: outputs)
+                wassert(actual(records[o.name]) == o.records);
+
+            // Going back to whole outputs
+            conv.stream(0, nullptr);
+            conv.add(data);
+            wassert(actual(conv.finish().size()) == outputs.size());
+        });
+
+        add_method("error", []() {
+            string data = sys::read_file(b2nc::tests::datafile("bufr/cdfin_acars"));
+            Converter conv;
+            wassert_throws(wreport::error, conv.add(data + data.substr(0, 100)));
+            conv.reset();
+            wassert(actual(conv.size()) == 0u);
+            conv.add(data);
+            wassert(actual(conv.finish().size()) > 0u);
+        });
+
+        add_method("capi", []() {
+            string data = sys::read_file(b2nc::tests::datafile("bufr/cdfin_acars"));
+            b2nc_converter* conv = b2nc_converter_new();
+            wassert_true(conv != nullptr);
+
+            wassert(actual(b2nc_converter_set_option(conv, "use_mnemonic", "1")) == 0);
+            wassert(actual(b2nc_converter_set_option(conv, "nonexistent", "1")) == -1);
+            wassert(actual(string(b2nc_converter_error(conv))) == "unknown option nonexistent");
+
+            wassert(actual(b2nc_converter_add(conv, data.data(), data.size())) == 0);
+            size_t count = 0;
+            wassert(actual(b2nc_converter_finish(conv, &count)) == 0);
+            wassert(actual(count) > 0u);
+
+            b2nc_output out;
+            wassert(actual(b2nc_converter_output(conv, 0, &out)) == 0);
+            wassert(actual(out.records) > 0u);
+            string image((const char*)out.netcdf, out.netcdf_size);
+            wassert(actual(image_records(image)) == out.records);
+            wassert(actual(b2nc_converter_output(conv, count, &out)) == -1);
+
+            b2nc_converter_free(conv);
+        });
+    }
+} test("converter");
+
+}
@@ -0,0 +1,227 @@
+/*
+ * converter - Library interface converting BUFR messages held in memory
+ *
+ * Copyright (C) 2026  ARPA-SIM <urpsim@smr.arpa.emr.it>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#include "converter.h"
+#include "convert.h"
+#include "arrays.h"
+#include "batch.h"
+#include "ncoutfile.h"
+#include <wreport/bulletin.h>
+#include <wreport/error.h>
+#include <map>
+#include <set>
+#include <cstdio>
+
+using namespace wreport;
+using namespace std;
+
+namespace b2nc {
+
+struct Converter::Impl : public BufrSink, public BatchSink
+{
+    struct Group
+    {
+        ConverterOutput output;
+        NCFiller filler;
+
+        Group(const Options& opts) : filler(opts) {}
+    };
+
+    Options opts;
+    std::map<Dispatcher::Key, size_t> index;
+    std::vector<std::unique_ptr<Group>> groups;
+    std::set<std::string> used_names;
+
+    /// Streaming mode, if batch_records is not 0
+    size_t batch_records = 0;
+    BatchCallback batch_callback;
+    std::unique_ptr<BatchDispatcher> batches;
+
+    Impl(const Options& opts) : opts(opts) {}
+
+    /// Sink for the messages added: batches in streaming mode, or groups
+    BufrSink& sink()
+    {
+        if (batches)
+            return *batches;
+        return *this;
+    }
+
+    void add_bufr(std::unique_ptr<BufrBulletin>&& bulletin, const std::string& raw) override
+    {
+        Dispatcher::Key key(*bulletin);
+        auto i = index.find(key);
+        Group* group;
+        if (i == index.end())
+        {
+            unique_ptr<Group> g(new Group(opts));
+            g->output.name = output_name(*bulletin, used_names);
+            g->output.data_category = bulletin->data_category;
+            g->output.data_subcategory = bulletin->data_subcategory;
+            g->output.data_subcategory_local = bulletin->data_subcategory_local;
+            group = g.get();
+            index.insert(make_pair(key, groups.size()));
+            groups.emplace_back(move(g));
+        } else
+            group = groups[i->second].get();
+        group->filler.add(move(bulletin), raw);
+    }
+
+    void add_batch(ColumnBatch& batch) override
+    {
+        ConverterBatch res;
+        res.output.name = batch.name;
+        res.output.data_category = batch.data_category;
+        res.output.data_subcategory = batch.data_subcategory;
+        res.output.data_subcategory_local = batch.data_subcategory_local;
+        res.output.records = batch.records;
+        res.first_record = batch.first_record;
+        res.columns.reserve(batch.columns.size());
+        res.values.reserve(batch.columns.size());
+        for (auto& col: batch.columns)
+        {
+            res.columns.emplace_back(move(col.column));
+            res.values.emplace_back(move(col.values));
+        }
+        batch_callback(res);
+    }
+
+    /// Send the pending records of streaming mode, and start a new stream
+    void flush_batches()
+    {
+        unique_ptr<BatchDispatcher> old(move(batches));
+        batches.reset(new BatchDispatcher(opts, *this, batch_records));
+        old->flush();
+    }
+
+    void reset()
+    {
+        index.clear();
+        groups.clear();
+        used_names.clear();
+        if (batches)
+            batches.reset(new BatchDispatcher(opts, *this, batch_records));
+    }
+};
+
+Converter::Converter(const Options& opts)
+    : impl(new Impl(opts))
+{
+}
+
+Converter::~Converter()
+{
+}
+
+void Converter::add(const void* data, size_t size, const char* name)
+{
+    if (size == 0)
+        return;
+
+    // The buffer is opened read only, so it is never written to
+    FILE* in = fmemopen(const_cast<void*>(data), size, "rb");
+    if (in == NULL)
+        throw error_system("cannot open memory buffer");
+
+    try {
+        read_bufr(in, impl->sink(), name);
+        fclose(in);
+    } catch (...) {
+        fclose(in);
+        throw;
+    }
+}
+
+void Converter::add(const std::string& data, const char* name)
+{
+    add(data.data(), data.size(), name);
+}
+
+size_t Converter::size() const
+{
+    if (impl->batches)
+        return impl->batches->size();
+    return impl->groups.size();
+}
+
+std::vector<ConverterOutput> Converter::finish()
+{
+    std::vector<ConverterOutput> res;
+    if (impl->batches)
+    {
+        impl->flush_batches();
+        return res;
+    }
+    try {
+        for (auto& g: impl->groups)
+        {
+            NCOutfile ncout(impl->opts);
+            ncout.open_memory(g->output.name);
+            g->filler.write(ncout);
+            g->output.records = g->filler.record_count();
+            g->output.netcdf.swap(ncout.image);
+            res.emplace_back(move(g->output));
+        }
+    } catch (...) {
+        impl->reset();
+        throw;
+    }
+    impl->reset();
+    return res;
+}
+
+void Converter::finish(ColumnCallback callback)
+{
+    if (impl->batches)
+    {
+        impl->flush_batches();
+        return;
+    }
+    try {
+        std::vector<Column> columns;
+        for (auto& g: impl->groups)
+        {
+            columns.clear();
+            g->filler.columns(columns);
+            g->output.records = g->filler.record_count();
+            callback(g->output, columns);
+        }
+    } catch (...) {
+        impl->reset();
+        throw;
+    }
+    impl->reset();
+}
+
+void Converter::reset()
+{
+    impl->reset();
+}
+
+void Converter::stream(size_t batch_records, BatchCallback callback)
+{
+    impl->reset();
+    impl->batches.reset();
+    impl->batch_records = batch_records;
+    impl->batch_callback = callback;
+    if (batch_records)
+        impl->batches.reset(new BatchDispatcher(impl->opts, *impl, batch_records));
+}
+
+}
@@ -0,0 +1,175 @@
+/*
+ * converter - Library interface converting BUFR messages held in memory
+ *
+ * Copyright (C) 2026  ARPA-SIM <urpsim@smr.arpa.emr.it>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#ifndef B2NC_CONVERTER_H
+#define B2NC_CONVERTER_H
+
+/*
+ * This header is part of the public library API, installed together with
+ * options.h and column.h. It only depends on the standard library.
+ */
+
+#include "options.h"
+#include "column.h"
+#include <string>
+#include <vector>
+#include <functional>
+#include <memory>
+#include <cstddef>
+
+namespace b2nc {
+
+/**
+ * Result of the conversion of all the BUFR messages with the same dispatch
+ * key: data category and subcategories, master table version and Data
+ * Description Section.
+ */
+struct ConverterOutput
+{
+    /**
+     * Name identifying the output, as "category-subcategory-localsubcategory"
+     * followed by ".N" if more outputs have the same categories.
+     *
+     * The command line tool uses the same name as suffix for output files.
+     */
+    std::string name;
+    int data_category = 0;
+    int data_subcategory = 0;
+    int data_subcategory_local = 0;
+    /// Number of records (BUFR subsets)
+    size_t records = 0;
+    /// Contents of the NetCDF file, if requested
+    std::string netcdf;
+};
+
+/**
+ * Range of consecutive records of an output, sent by a Converter in
+ * streaming mode (see Converter::stream())
+ */
+struct ConverterBatch
+{
+    /**
+     * Output the records belong to. Its records member is the number of
+     * records of the batch, and netcdf is empty.
+     */
+    ConverterOutput output;
+    /// Position of the first record of the batch in its output
+    size_t first_record = 0;
+    /// Description of the output variables; their collect functions are not set
+    std::vector<Column> columns;
+    /// Values of all the records of the batch, one for each column
+    std::vector<ColumnData> values;
+};
+
+/**
+ * Convert BUFR messages held in memory, without using temporary files.
+ *
+ * Messages are grouped like the command line tool does, and each group can
+ * be returned as an in-memory NetCDF image, or as columns of values.
+ *
+ * A Converter can be reused: finish() and reset() leave it ready to convert a
+ * new set of messages. Tables and conversion plans are cached across
+ * conversions.
+ *
+ * A Converter must not be used by more than one thread at a time, but
+ * different Converters can be used concurrently.
+ */
+class Converter
+{
+public:
+    /// Function receiving the columns of an output
+    typedef std::function<void(const ConverterOutput& output, const std::vector<Column>& columns)> ColumnCallback;
+
+    /// Function receiving a batch of records in streaming mode
+    typedef std::function<void(const ConverterBatch& batch)> BatchCallback;
+
+    /**
+     * @param opts
+     *   Conversion options. out_fname, format, atomic_output and jobs are
+     *   ignored.
+     */
+    explicit Converter(const Options& opts = Options());
+    ~Converter();
+    Converter(const Converter&) = delete;
+    Converter& operator=(const Converter&) = delete;
+
+    /**
+     * Add all the BUFR messages found in a buffer.
+     *
+     * Data before, between and after the messages is skipped, like in BUFR
+     * files. If decoding fails, an exception is thrown and the messages
+     * added so far are still pending: call reset() to discard them.
+     *
+     * @param name
+     *   If provided, it is used as the input name in error messages
+     */
+    void add(const void* data, size_t size, const char* name = nullptr);
+
+    /// Add all the BUFR messages found in a buffer
+    void add(const std::string& data, const char* name = nullptr);
+
+    /// Number of outputs that the messages added so far will produce
+    size_t size() const;
+
+    /**
+     * Encode the pending outputs as NetCDF images, in the order in which
+     * their first message was added, and reset the converter.
+     */
+    std::vector<ConverterOutput> finish();
+
+    /**
+     * Call \a callback with the columns of each pending output, in the order
+     * in which their first message was added, and reset the converter.
+     *
+     * The ConverterOutput passed to the callback has an empty netcdf member.
+     * The columns, and their collect functions, are only valid during the
+     * callback.
+     */
+    void finish(ColumnCallback callback);
+
+    /// Discard all pending outputs
+    void reset();
+
+    /**
+     * Send converted records to \a callback while messages are added,
+     * instead of keeping whole outputs until finish().
+     *
+     * The records of an output are sent as soon as at least \a batch_records
+     * of them are pending, and are then freed, so that memory use is bounded
+     * by the batch size rather than by the input size. Messages are not split
+     * across batches, so a batch can be larger than \a batch_records. finish()
+     * sends the remaining records of all outputs and returns no outputs.
+     *
+     * Each batch is converted on its own: replicated variables in different
+     * batches of the same output can have a different loop size, and
+     * variables without values in a batch are not included in it.
+     *
+     * Pending messages are discarded. If \a batch_records is 0, the
+     * converter goes back to converting whole outputs.
+     */
+    void stream(size_t batch_records, BatchCallback callback);
+
+private:
+    struct Impl;
+    std::unique_ptr<Impl> impl;
+};
+
+}
+
+#endif
@@ -0,0 +1,196 @@
+/*
+ * Copyright (C) 2026  ARPA-SIM <urpsim@smr.arpa.emr.it>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#include "input.h"
+#include "convert.h"
+#include "options.h"
+#include "tests/tests.h"
+#include <wreport/bulletin.h>
+#include <wreport/utils/sys.h>
+#include <thread>
+#include <unistd.h>
+
+#include "config.h"
+
+#ifdef HAVE_ZLIB
+#include <zlib.h>
+#endif
+#ifdef HAVE_LZMA
+#include <lzma.h>
+#endif
+#ifdef HAVE_ZSTD
+#include <zstd.h>
+#endif
+
+using namespace b2nc;
+using namespace wreport;
+using namespace wreport::tests;
+using namespace std;
+
+namespace {
+
+/// Record the offsets and sizes of the bulletins received
+struct OffsetSink : public BufrSink
+{
+    vector<pair<off_t, size_t>> messages;
+
+    void add_bufr(std::unique_ptr<wreport::BufrBulletin>&& bulletin, const std::string& raw) override
+    {
+        messages.push_back(make_pair(bulletin->offset, raw.size()));
+    }
+};
+
+/// Check that reading \a fname gives the same messages as the test file
+void check_same_messages(const string& fname, unsigned threads=1)
+{
+    OffsetSink plain;
+    read_bufr(b2nc::tests::datafile("bufr/cdfin_acars"), plain);
+    Options opts;
+    opts.jobs = threads;
+    OffsetSink compressed;
+    read_bufr(opts, fname, compressed);
+    wassert(actual(compressed.messages.size()) == plain.messages.size());
+    wassert_true(compressed.messages == plain.messages);
+}
+
+/**
+ * Check that reading \a data through a pipe, which cannot seek, gives the
+ * same messages as the test file
+ */
+void check_pipe(const string& data)
+{
+    int fds[2];
+    wassert(actual(pipe(fds)) == 0);
+    std::thread writer([&] {
+        size_t pos = 0;
+        while (pos < data.size())
+        {
+            ssize_t res = write(fds[1], data.data() + pos, data.size() - pos);
+            if (res <= 0)
+                break;
+            pos += res;
+        }
+        ::close(fds[1]);
+    });
+    try {
+        wassert(check_same_messages("/dev/fd/" + to_string(fds[0])));
+    } catch (...) {
+        ::close(fds[0]);
+        writer.join();
+        throw;
+    }
+    ::close(fds[0]);
+    writer.join();
+}
+
+class Tests : public TestCase
+{
+    using TestCase::TestCase;
+
+    void register_tests() override
+    {
+        add_method("detect", []() {
+            wassert_true(detect_compression("BUFR") == Compression::NONE);
+            wassert_true(detect_compression("") == Compression::NONE);
+            wassert_true(detect_compression(string("\x1f\x8b\x08\x00", 4)) == Compression::GZIP);
+            wassert_true(detect_compression(string("\xfd" "7zXZ\0", 6)) == Compression::XZ);
+            wassert_true(detect_compression(string("\x28\xb5\x2f\xfd", 4)) == Compression::ZSTD);
+        });
+
+        add_method("plain", []() {
+            InputFile in(b2nc::tests::datafile("bufr/cdfin_acars"));
+            wassert_true(in.compression() == Compression::NONE);
+            in.close();
+        });
+
+        add_method("pipe", []() {
+            string data = sys::read_file(b2nc::tests::datafile("bufr/cdfin_acars"));
+            wassert(check_pipe(data));
+        });
+
+#ifdef HAVE_ZLIB
+        add_method("gzip", []() {
+            string data = sys::read_file(b2nc::tests::datafile("bufr/cdfin_acars"));
+            // Write two gzip members, to test concatenated files
+            size_t half = data.size() / 2;
+            for (const char* mode: {"wb", "ab"})
+            {
+                gzFile out = gzopen("input-test.bufr.gz", mode);
+                wassert_true(out != nullptr);
+                if (mode[0] == 'w')
+                    gzwrite(out, data.data(), half);
+                else
+                    gzwrite(out, data.data() + half, data.size() - half);
+                gzclose(out);
+            }
+            wassert(check_same_messages("input-test.bufr.gz"));
+            wassert(check_pipe(sys::read_file("input-test.bufr.gz")));
+
+            // Truncated data is reported
+            string gz = sys::read_file("input-test.bufr.gz");
+            sys::write_file("input-test-truncated.bufr.gz", gz.substr(0, gz.size() / 3), 0666);
+            OffsetSink sink;
+            wassert_throws(wreport::error, read_bufr("input-test-truncated.bufr.gz", sink));
+        });
+#endif
+
+#ifdef HAVE_LZMA
+        add_method("xz", []() {
+            string data = sys::read_file(b2nc::tests::datafile("bufr/cdfin_acars"));
+            vector<uint8_t> buf(lzma_stream_buffer_bound(data.size()));
+            size_t size = 0;
+            lzma_ret ret = lzma_easy_buffer_encode(6, LZMA_CHECK_CRC64, nullptr,
+                    (const uint8_t*)data.data(), data.size(), buf.data(), &size, buf.size());
+            wassert(actual((int)ret) == (int)LZMA_OK);
+            sys::write_file("input-test.bufr.xz", buf.data(), size, 0666);
+            wassert(check_same_messages("input-test.bufr.xz"));
+            wassert(check_same_messages("input-test.bufr.xz", 4));
+        });
+#endif
+
+#ifdef HAVE_ZSTD
+        add_method("zstd", []() {
+            string data = sys::read_file(b2nc::tests::datafile("bufr/cdfin_acars"));
+            vector<char> buf(ZSTD_compressBound(data.size()));
+            size_t size = ZSTD_compress(buf.data(), buf.size(), data.data(), data.size(), 3);
+            wassert_false(ZSTD_isError(size));
+            sys::write_file("input-test.bufr.zst", buf.data(), size, 0666);
+            wassert(check_same_messages("input-test.bufr.zst"));
+        });
+#endif
+
+#ifdef HAVE_ZLIB
+        add_method("early_close", []() {
+            // Closing before the end stops the decompression thread cleanly
+            string data = sys::read_file(b2nc::tests::datafile("bufr/cdfin_acars"));
+            gzFile out = gzopen("input-test-close.bufr.gz", "wb");
+            for (unsigned i = 0; i < 50; ++i)
+                gzwrite(out, data.data(), data.size());
+            gzclose(out);
+
+            InputFile in("input-test-close.bufr.gz");
+            wassert_true(in.compression() == Compression::GZIP);
+            char buf[4];
+            wassert(actual(fread(buf, 1, 4, in.file())) == 4u);
+            wassert(actual(string(buf, 4)) == "BUFR");
+            in.close();
+        });
+#endif
+    }
+} test("input");
+
+}
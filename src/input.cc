@@ -0,0 +1,567 @@
+/*
+ * input - Open BUFR input files, decompressing them if needed
+ *
+ * Copyright (C) 2026  ARPA-SIM <urpsim@smr.arpa.emr.it>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#include "input.h"
+#include <wreport/error.h>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <cerrno>
+#include <cstring>
+#include <cstdint>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "config.h"
+
+#ifdef HAVE_ZLIB
+#include <zlib.h>
+#endif
+#ifdef HAVE_LZMA
+#include <lzma.h>
+#endif
+#ifdef HAVE_ZSTD
+#include <zstd.h>
+#endif
+
+using namespace wreport;
+using namespace std;
+
+namespace b2nc {
+
+Compression detect_compression(const std::string& head)
+{
+    if (head.size() >= 2 && head.compare(0, 2, "\x1f\x8b", 2) == 0)
+        return Compression::GZIP;
+    if (head.size() >= 6 && head.compare(0, 6, "\xfd" "7zXZ\0", 6) == 0)
+        return Compression::XZ;
+    if (head.size() >= 4 && head.compare(0, 4, "\x28\xb5\x2f\xfd", 4) == 0)
+        return Compression::ZSTD;
+    return Compression::NONE;
+}
+
+const char* compression_name(Compression compression)
+{
+    switch (compression)
+    {
+        case Compression::NONE: return "none";
+        case Compression::GZIP: return "gzip";
+        case Compression::XZ: return "xz";
+        case Compression::ZSTD: return "zstd";
+    }
+    return "unknown";
+}
+
+/**
+ * Unbuffered reader of an input file, that can look ahead at its first bytes
+ * and then replay them.
+ *
+ * This detects the format of the input without seeking back to its start,
+ * which pipes and FIFOs cannot do.
+ */
+struct RawInput
+{
+    std::string fname;
+    int fd;
+    /// Bytes read ahead by peek() and not yet returned by read()
+    std::string pending;
+    size_t pending_pos = 0;
+    /// Offset in the file of the next byte returned by read()
+    off_t position = 0;
+
+    explicit RawInput(const std::string& fname)
+        : fname(fname)
+    {
+        fd = ::open(fname.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd == -1)
+            error_system::throwf("cannot open %s", fname.c_str());
+    }
+
+    ~RawInput()
+    {
+        ::close(fd);
+    }
+
+    /// Read from the file, returning -1 with errno set on error
+    ssize_t read_fd(char* buf, size_t size)
+    {
+        while (true)
+        {
+            ssize_t res = ::read(fd, buf, size);
+            if (res != -1 || errno != EINTR)
+                return res;
+        }
+    }
+
+    /// Return the next \a size bytes, or less at the end, without consuming them
+    std::string peek(size_t size)
+    {
+        char buf[4096];
+        while (pending.size() - pending_pos < size)
+        {
+            ssize_t res = read_fd(buf, min(sizeof(buf), size - (pending.size() - pending_pos)));
+            if (res == -1)
+                error_system::throwf("cannot read %s", fname.c_str());
+            if (res == 0)
+                break;
+            pending.append(buf, res);
+        }
+        return pending.substr(pending_pos, size);
+    }
+
+    /// Read data, replaying what was peeked first; returns -1 on error
+    ssize_t read(char* buf, size_t size)
+    {
+        ssize_t res;
+        if (pending_pos < pending.size())
+        {
+            res = min(size, pending.size() - pending_pos);
+            memcpy(buf, pending.data() + pending_pos, res);
+            pending_pos += res;
+            if (pending_pos == pending.size())
+            {
+                pending.clear();
+                pending_pos = 0;
+            }
+        } else {
+            res = read_fd(buf, size);
+            if (res == -1)
+                return -1;
+        }
+        position += res;
+        return res;
+    }
+
+    /// Seek if the file supports it, dropping the peeked data
+    int seek(off64_t* pos, int whence)
+    {
+        if (whence == SEEK_CUR && *pos == 0)
+        {
+            // Only querying the position, as ftell does
+            *pos = position;
+            return 0;
+        }
+        off_t res;
+        if (whence == SEEK_END)
+            res = lseek(fd, *pos, SEEK_END);
+        else
+            res = lseek(fd, whence == SEEK_CUR ? position + *pos : *pos, SEEK_SET);
+        if (res == -1)
+            return -1;
+        pending.clear();
+        pending_pos = 0;
+        position = res;
+        *pos = res;
+        return 0;
+    }
+
+    static ssize_t cookie_read(void* cookie, char* buf, size_t size)
+    {
+        return static_cast<RawInput*>(cookie)->read(buf, size);
+    }
+
+    static int cookie_seek(void* cookie, off64_t* pos, int whence)
+    {
+        return static_cast<RawInput*>(cookie)->seek(pos, whence);
+    }
+
+    /// Open a stream reading from this file
+    FILE* open_stream()
+    {
+        cookie_io_functions_t funcs;
+        memset(&funcs, 0, sizeof(funcs));
+        funcs.read = cookie_read;
+        funcs.seek = cookie_seek;
+        FILE* res = fopencookie(this, "rb", funcs);
+        if (!res)
+            error_system::throwf("cannot open stream for %s", fname.c_str());
+        return res;
+    }
+};
+
+/**
+ * Decompress a file in a separate thread, handing decompressed data to a
+ * reading stream through a bounded queue of chunks
+ */
+struct Decompressor
+{
+    /// Size of the decompressed chunks
+    static const size_t chunk_size = 256 * 1024;
+    /// Chunks decompressed ahead of the reader
+    static const size_t max_chunks = 8;
+
+    std::string fname;
+    FILE* raw;
+    Compression compression;
+    unsigned threads;
+
+    std::mutex mutex;
+    std::condition_variable cond;
+    std::deque<std::string> chunks;
+    /// Set by the decompression thread when it has no more data
+    bool finished = false;
+    /// Set by the reader when it does not want more data
+    bool cancelled = false;
+    std::exception_ptr error;
+    std::thread thread;
+
+    /// Chunk being read, only accessed by the reader
+    std::string current;
+    size_t current_pos = 0;
+    /// Decompressed bytes read so far, only accessed by the reader
+    off_t position = 0;
+
+    Decompressor(const std::string& fname, FILE* raw, Compression compression, unsigned threads)
+        : fname(fname), raw(raw), compression(compression), threads(threads)
+    {
+        thread = std::thread([this] { run(); });
+    }
+
+    ~Decompressor()
+    {
+        stop();
+        fclose(raw);
+    }
+
+    /// Ask the decompression thread to stop, and wait for it
+    void stop()
+    {
+        {
+            lock_guard<std::mutex> lock(mutex);
+            cancelled = true;
+        }
+        cond.notify_all();
+        if (thread.joinable())
+            thread.join();
+    }
+
+    /// Queue a decompressed chunk; returns false if the reader is gone
+    bool emit(std::string&& chunk)
+    {
+        unique_lock<std::mutex> lock(mutex);
+        cond.wait(lock, [&] { return chunks.size() < max_chunks || cancelled; });
+        if (cancelled)
+            return false;
+        chunks.push_back(move(chunk));
+        cond.notify_all();
+        return true;
+    }
+
+    /// Read compressed data, returning 0 at end of file
+    size_t read_raw(void* buf, size_t size)
+    {
+        size_t res = fread(buf, 1, size, raw);
+        if (res == 0 && ferror(raw))
+            error_system::throwf("cannot read %s", fname.c_str());
+        return res;
+    }
+
+    void run()
+    {
+        try {
+            switch (compression)
+            {
+                case Compression::GZIP: run_gzip(); break;
+                case Compression::XZ: run_xz(); break;
+                case Compression::ZSTD: run_zstd(); break;
+                case Compression::NONE: break;
+            }
+        } catch (...) {
+            lock_guard<std::mutex> lock(mutex);
+            error = current_exception();
+        }
+
+        {
+            lock_guard<std::mutex> lock(mutex);
+            finished = true;
+        }
+        cond.notify_all();
+    }
+
+    void run_gzip()
+    {
+#ifdef HAVE_ZLIB
+        z_stream zs;
+        memset(&zs, 0, sizeof(zs));
+        // 32 enables gzip header detection
+        if (inflateInit2(&zs, 15 + 32) != Z_OK)
+            error_consistency::throwf("%s: cannot initialise gzip decompression", fname.c_str());
+        struct Guard { z_stream& zs; ~Guard() { inflateEnd(&zs); } } guard{zs};
+
+        vector<unsigned char> inbuf(chunk_size);
+        bool eof = false;
+        while (true)
+        {
+            if (zs.avail_in == 0 && !eof)
+            {
+                zs.avail_in = read_raw(inbuf.data(), inbuf.size());
+                zs.next_in = inbuf.data();
+                eof = zs.avail_in == 0;
+            }
+
+            string out(chunk_size, 0);
+            zs.next_out = (Bytef*)&out[0];
+            zs.avail_out = chunk_size;
+            int res = inflate(&zs, Z_NO_FLUSH);
+            out.resize(chunk_size - zs.avail_out);
+            if (!out.empty() && !emit(move(out)))
+                return;
+
+            if (res == Z_STREAM_END)
+            {
+                // Continue with the next member of concatenated gzip files
+                if (zs.avail_in == 0 && !eof)
+                {
+                    zs.avail_in = read_raw(inbuf.data(), inbuf.size());
+                    zs.next_in = inbuf.data();
+                    eof = zs.avail_in == 0;
+                }
+                if (zs.avail_in == 0)
+                    return;
+                inflateReset(&zs);
+            } else if (res == Z_BUF_ERROR) {
+                if (eof)
+                    error_consistency::throwf("%s: compressed data is truncated", fname.c_str());
+            } else if (res != Z_OK)
+                error_consistency::throwf("%s: gzip decompression failed: %s", fname.c_str(), zs.msg ? zs.msg : "unknown error");
+        }
+#else
+        error_unimplemented::throwf("%s: this build cannot read gzip compressed files", fname.c_str());
+#endif
+    }
+
+    void run_xz()
+    {
+#ifdef HAVE_LZMA
+        lzma_stream strm = LZMA_STREAM_INIT;
+        lzma_ret ret;
+#ifdef HAVE_LZMA_MT
+        if (threads > 1)
+        {
+            lzma_mt mt;
+            memset(&mt, 0, sizeof(mt));
+            mt.flags = LZMA_CONCATENATED;
+            mt.threads = threads;
+            mt.memlimit_threading = UINT64_MAX;
+            mt.memlimit_stop = UINT64_MAX;
+            ret = lzma_stream_decoder_mt(&strm, &mt);
+        } else
+#endif
+            ret = lzma_stream_decoder(&strm, UINT64_MAX, LZMA_CONCATENATED);
+        if (ret != LZMA_OK)
+            error_consistency::throwf("%s: cannot initialise xz decompression (error %d)", fname.c_str(), (int)ret);
+        struct Guard { lzma_stream& strm; ~Guard() { lzma_end(&strm); } } guard{strm};
+
+        vector<uint8_t> inbuf(chunk_size);
+        lzma_action action = LZMA_RUN;
+        while (true)
+        {
+            if (strm.avail_in == 0 && action == LZMA_RUN)
+            {
+                strm.avail_in = read_raw(inbuf.data(), inbuf.size());
+                strm.next_in = inbuf.data();
+                if (strm.avail_in == 0)
+                    action = LZMA_FINISH;
+            }
+
+            string out(chunk_size, 0);
+            strm.next_out = (uint8_t*)&out[0];
+            strm.avail_out = chunk_size;
+            ret = lzma_code(&strm, action);
+            out.resize(chunk_size - strm.avail_out);
+            if (!out.empty() && !emit(move(out)))
+                return;
+
+            if (ret == LZMA_STREAM_END)
+                return;
+            if (ret == LZMA_BUF_ERROR)
+                error_consistency::throwf("%s: compressed data is truncated", fname.c_str());
+            if (ret != LZMA_OK)
+                error_consistency::throwf("%s: xz decompression failed (error %d)", fname.c_str(), (int)ret);
+        }
+#else
+        error_unimplemented::throwf("%s: this build cannot read xz compressed files", fname.c_str());
+#endif
+    }
+
+    void run_zstd()
+    {
+#ifdef HAVE_ZSTD
+        // libzstd only decompresses in a single thread
+        ZSTD_DCtx* dctx = ZSTD_createDCtx();
+        if (!dctx)
+            error_consistency::throwf("%s: cannot initialise zstd decompression", fname.c_str());
+        struct Guard { ZSTD_DCtx* dctx; ~Guard() { ZSTD_freeDCtx(dctx); } } guard{dctx};
+
+        vector<char> inbuf(ZSTD_DStreamInSize());
+        size_t out_size = ZSTD_DStreamOutSize();
+        size_t last_ret = 0;
+        while (size_t size = read_raw(inbuf.data(), inbuf.size()))
+        {
+            ZSTD_inBuffer input = { inbuf.data(), size, 0 };
+            bool output_full = false;
+            while (input.pos < input.size || output_full)
+            {
+                string out(out_size, 0);
+                ZSTD_outBuffer output = { &out[0], out_size, 0 };
+                last_ret = ZSTD_decompressStream(dctx, &output, &input);
+                if (ZSTD_isError(last_ret))
+                    error_consistency::throwf("%s: zstd decompression failed: %s", fname.c_str(), ZSTD_getErrorName(last_ret));
+                output_full = output.pos == output.size;
+                out.resize(output.pos);
+                if (!out.empty() && !emit(move(out)))
+                    return;
+            }
+        }
+        if (last_ret != 0)
+            error_consistency::throwf("%s: compressed data is truncated", fname.c_str());
+#else
+        error_unimplemented::throwf("%s: this build cannot read zstd compressed files", fname.c_str());
+#endif
+    }
+
+    /// Read decompressed data, returning 0 at the end
+    size_t read(char* buf, size_t size)
+    {
+        size_t done = 0;
+        while (done < size)
+        {
+            if (current_pos == current.size())
+            {
+                unique_lock<std::mutex> lock(mutex);
+                cond.wait(lock, [&] { return !chunks.empty() || finished; });
+                if (chunks.empty())
+                    break;
+                current = move(chunks.front());
+                chunks.pop_front();
+                current_pos = 0;
+                cond.notify_all();
+            }
+            size_t len = min(size - done, current.size() - current_pos);
+            memcpy(buf + done, current.data() + current_pos, len);
+            current_pos += len;
+            done += len;
+        }
+        position += done;
+        return done;
+    }
+
+    /// Return the next \a size bytes of decompressed data, without consuming them
+    std::string peek(size_t size)
+    {
+        while (current.size() - current_pos < size)
+        {
+            unique_lock<std::mutex> lock(mutex);
+            cond.wait(lock, [&] { return !chunks.empty() || finished; });
+            if (chunks.empty())
+                break;
+            current += chunks.front();
+            chunks.pop_front();
+            cond.notify_all();
+        }
+        return current.substr(current_pos, size);
+    }
+
+    static ssize_t cookie_read(void* cookie, char* buf, size_t size)
+    {
+        return static_cast<Decompressor*>(cookie)->read(buf, size);
+    }
+
+    /// Only support querying the position, so that ftell works
+    static int cookie_seek(void* cookie, off64_t* pos, int whence)
+    {
+        if (whence != SEEK_CUR || *pos != 0)
+        {
+            errno = ESPIPE;
+            return -1;
+        }
+        *pos = static_cast<Decompressor*>(cookie)->position;
+        return 0;
+    }
+
+    FILE* open_stream()
+    {
+        cookie_io_functions_t funcs;
+        memset(&funcs, 0, sizeof(funcs));
+        funcs.read = cookie_read;
+        funcs.seek = cookie_seek;
+        FILE* res = fopencookie(this, "rb", funcs);
+        if (!res)
+            error_system::throwf("cannot open decompressed stream for %s", fname.c_str());
+        return res;
+    }
+};
+
+InputFile::InputFile(const std::string& fname, unsigned threads)
+    : fname(fname)
+{
+    raw.reset(new RawInput(fname));
+    m_compression = detect_compression(raw->peek(6));
+    FILE* stream = raw->open_stream();
+
+    if (m_compression == Compression::NONE)
+    {
+        in = stream;
+        return;
+    }
+
+    decompressor.reset(new Decompressor(fname, stream, m_compression, threads));
+    in = decompressor->open_stream();
+}
+
+std::string InputFile::head(size_t size)
+{
+    if (decompressor)
+        return decompressor->peek(size);
+    return raw->peek(size);
+}
+
+InputFile::~InputFile()
+{
+    try {
+        close();
+    } catch (...) {
+        // Errors are only reported by an explicit close()
+    }
+}
+
+void InputFile::close()
+{
+    if (in)
+    {
+        fclose(in);
+        in = nullptr;
+    }
+
+    std::exception_ptr error;
+    if (decompressor)
+    {
+        decompressor->stop();
+        error = decompressor->error;
+        decompressor.reset();
+    }
+    raw.reset();
+    if (error)
+        rethrow_exception(error);
+}
+
+}
@@ -0,0 +1,103 @@
+/*
+ * input - Open BUFR input files, decompressing them if needed
+ *
+ * Copyright (C) 2026  ARPA-SIM <urpsim@smr.arpa.emr.it>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#ifndef B2NC_INPUT_H
+#define B2NC_INPUT_H
+
+#include <string>
+#include <memory>
+#include <cstdio>
+
+namespace b2nc {
+
+/// Compression format of an input file
+enum class Compression
+{
+    NONE,
+    GZIP,
+    XZ,
+    ZSTD,
+};
+
+/// Detect the compression format of data starting with \a head
+Compression detect_compression(const std::string& head);
+
+/// Return the name of a compression format
+const char* compression_name(Compression compression);
+
+struct RawInput;
+struct Decompressor;
+
+/**
+ * Input file opened for reading BUFR data.
+ *
+ * Files compressed with gzip, xz or zstd are detected by their magic bytes
+ * and decompressed on the fly by a separate thread, so that decompression
+ * overlaps with decoding and no temporary files are needed. In that case
+ * file() reads the decompressed data, and ftell on it gives offsets in the
+ * decompressed data.
+ *
+ * The format is detected without seeking, so that pipes and FIFOs can be
+ * read too.
+ */
+class InputFile
+{
+protected:
+    std::string fname;
+    FILE* in = nullptr;
+    Compression m_compression = Compression::NONE;
+    std::unique_ptr<RawInput> raw;
+    std::unique_ptr<Decompressor> decompressor;
+
+public:
+    /**
+     * @param threads
+     *   Number of threads to use for formats that support parallel
+     *   decompression
+     */
+    explicit InputFile(const std::string& fname, unsigned threads = 1);
+    InputFile(const InputFile&) = delete;
+    InputFile& operator=(const InputFile&) = delete;
+    ~InputFile();
+
+    const std::string& name() const { return fname; }
+    Compression compression() const { return m_compression; }
+
+    /// Stream to read the (decompressed) contents of the file
+    FILE* file() { return in; }
+
+    /**
+     * Return the first \a size bytes of the (decompressed) contents of the
+     * file, or less if the file is shorter, without consuming them.
+     *
+     * It can only be called before reading from file().
+     */
+    std::string head(size_t size);
+
+    /**
+     * Close the file, stopping decompression if it is still running.
+     *
+     * If decompression failed, its error is thrown here.
+     */
+    void close();
+};
+
+}
+
+#endif
@@ -0,0 +1,69 @@
+/*
+ * instruments - Internal instrumentation hooks of a conversion
+ *
+ * Copyright (C) 2026  ARPA-SIM <urpsim@smr.arpa.emr.it>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#ifndef B2NC_INSTRUMENTS_H
+#define B2NC_INSTRUMENTS_H
+
+#include "options.h"
+
+namespace b2nc {
+
+class Stats;
+class Trace;
+class Sparsity;
+class Progress;
+
+/**
+ * Reports and counters collected during a conversion, for the command line
+ * tools.
+ *
+ * They are attached to a conversion with Options::instruments. This header
+ * is not installed, and its contents can change between releases.
+ * Everything is optional, and nothing is owned by Instruments.
+ */
+struct Instruments
+{
+    /**
+     * If nonzero, print to stderr the heap memory used by each output every
+     * this many seconds, and when the outputs are closed
+     */
+    unsigned memory_report = 0;
+    /// If set, collect timings and counters of the conversion (see Stats)
+    Stats* stats = nullptr;
+    /// If set, record spans of work of the conversion (see Trace)
+    Trace* trace = nullptr;
+    /**
+     * If set, analyse the padding and missing values of each output when it
+     * is closed (see Sparsity)
+     */
+    Sparsity* sparsity = nullptr;
+    /// If set, count the messages read and the outputs open (see Progress)
+    Progress* progress = nullptr;
+};
+
+/// Return the instruments of \a opts, or an empty set if it has none
+inline const Instruments& instruments(const Options& opts)
+{
+    static const Instruments none;
+    return opts.instruments ? *opts.instruments : none;
+}
+
+}
+
+#endif
@@ -0,0 +1,83 @@
+/*
+ * Copyright (C) 2026  ARPA-SIM <urpsim@smr.arpa.emr.it>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#include "inventory.h"
+#include "converter.h"
+#include "options.h"
+#include "tests/tests.h"
+#include <wreport/utils/sys.h>
+
+using namespace b2nc;
+using namespace wreport;
+using namespace wreport::tests;
+using namespace std;
+
+namespace {
+
+class Tests : public TestCase
+{
+    using TestCase::TestCase;
+
+    void register_tests() override
+    {
+        add_method("acars", []() {
+            string fname = b2nc::tests::datafile("bufr/cdfin_acars");
+            Options opts;
+            opts.out_fname = "out.nc";
+            Inventory inventory(opts);
+            inventory.scan(fname);
+
+            // The inventory matches what a conversion produces
+            Converter conv(opts);
+            conv.add(sys::read_file(fname));
+            vector<ConverterOutput> outputs = conv.finish();
+
+            wassert(actual(inventory.entries.size()) == outputs.size());
+            unsigned messages = 0;
+            size_t bytes = 0;
+            for (size_t i = 0; i < outputs.size(); ++i)
+            {
+                const InventoryEntry& e = inventory.entries[i];
+                wassert(actual(e.name) == outputs[i].name);
+                wassert(actual(e.fname) == "out-" + outputs[i].name + ".nc");
+                wassert(actual(e.subsets) == outputs[i].records);
+                wassert(actual(e.time_min) <= e.time_max);
+                messages += e.messages;
+                bytes += e.bytes;
+            }
+            wassert(actual(messages) == 133u);
+            wassert(actual(bytes) == sys::read_file(fname).size());
+
+            string json;
+            inventory.to_json(json);
+            wassert(actual(json).contains("\"outputs\":["));
+            wassert(actual(json).contains("\"fname\":\"out-"));
+            wassert(actual(json).contains("\"key\":\"" + inventory.entries[0].key + "\""));
+        });
+
+        add_method("subset_count", []() {
+            Options opts;
+            Inventory inventory(opts);
+            inventory.scan(b2nc::tests::datafile("bufr/AMSUA.bufr"));
+            wassert(actual(inventory.entries.size()) == 1u);
+            wassert(actual(inventory.entries[0].messages) == 1u);
+            wassert(actual(inventory.entries[0].subsets) == 1350u);
+        });
+    }
+} test("inventory");
+
+}
@@ -0,0 +1,163 @@
+/*
+ * inventory - Summarise the contents of BUFR files without decoding them
+ *
+ * Copyright (C) 2026  ARPA-SIM <urpsim@smr.arpa.emr.it>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#include "inventory.h"
+#include "input.h"
+#include "archive.h"
+#include "msgindex.h"
+#include "options.h"
+#include "json.h"
+#include <wreport/bulletin.h>
+#include <wreport/error.h>
+
+using namespace wreport;
+using namespace std;
+
+namespace b2nc {
+
+namespace {
+
+/// Format a YYYYMMDDHHMMSS time as ISO8601
+std::string format_time(long long t)
+{
+    char buf[32];
+    snprintf(buf, 32, "%04lld-%02lld-%02lldT%02lld:%02lld:%02lldZ",
+            t / 10000000000, t / 100000000 % 100, t / 1000000 % 100,
+            t / 10000 % 100, t / 100 % 100, t % 100);
+    return buf;
+}
+
+}
+
+Inventory::Inventory(const Options& opts)
+    : opts(opts)
+{
+}
+
+void Inventory::scan(const std::string& fname)
+{
+    InputFile in(fname);
+    try {
+        read_members(in, [&](FILE* member, const std::string& name) {
+            scan(member, name.c_str());
+        });
+    } catch (...) {
+        in.close();
+        throw;
+    }
+    in.close();
+}
+
+void Inventory::scan(FILE* in, const char* fname)
+{
+    files.push_back(fname ? fname : "(stream)");
+
+    string rawmsg;
+    off_t offset;
+    while (BufrBulletin::read(in, rawmsg, fname, &offset))
+    {
+        unique_ptr<BufrBulletin> header = BufrBulletin::decode_header(rawmsg, fname, offset);
+        add(rawmsg, *header);
+    }
+}
+
+void Inventory::add(const std::string& raw, const wreport::BufrBulletin& header)
+{
+    Dispatcher::Key key(header);
+    auto i = index.find(key);
+    InventoryEntry* entry;
+    if (i == index.end())
+    {
+        entries.emplace_back();
+        entry = &entries.back();
+        entry->name = output_name(header, used_names);
+        entry->fname = output_group_fname(opts, entry->name);
+        entry->data_category = header.data_category;
+        entry->data_subcategory = header.data_subcategory;
+        entry->data_subcategory_local = header.data_subcategory_local;
+        entry->master_table_version_number = header.master_table_version_number;
+        entry->datadesc = header.datadesc;
+        entry->key = IndexKey(header).to_string();
+        index.insert(make_pair(key, entries.size() - 1));
+    } else
+        entry = &entries[i->second];
+
+    long long time = bufr_time(header);
+    if (entry->messages == 0 || time < entry->time_min)
+        entry->time_min = time;
+    if (entry->messages == 0 || time > entry->time_max)
+        entry->time_max = time;
+
+    ++entry->messages;
+    entry->subsets += bufr_subset_count(raw, header);
+    entry->bytes += raw.size();
+}
+
+void Inventory::to_json(std::string& out) const
+{
+    unsigned messages = 0;
+    size_t subsets = 0;
+    size_t bytes = 0;
+    for (const auto& e: entries)
+    {
+        messages += e.messages;
+        subsets += e.subsets;
+        bytes += e.bytes;
+    }
+
+    JSONWriter json(out);
+    json.start_mapping();
+    json.add_cstring("files");
+    json.start_list();
+    for (const auto& f: files)
+        json.add(f);
+    json.end_list();
+    json.add("messages", messages);
+    json.add("subsets", subsets);
+    json.add("bytes", bytes);
+
+    json.add_cstring("outputs");
+    json.start_list();
+    for (const auto& e: entries)
+    {
+        json.start_mapping();
+        json.add("name", e.name);
+        json.add("fname", e.fname);
+        json.add("key", e.key);
+        json.add("data_category", e.data_category);
+        json.add("data_subcategory", e.data_subcategory);
+        json.add("data_subcategory_local", e.data_subcategory_local);
+        json.add("master_table_version_number", e.master_table_version_number);
+        json.add_cstring("datadesc");
+        json.start_list();
+        for (const auto& code: e.datadesc)
+            json.add(varcode_format(code));
+        json.end_list();
+        json.add("messages", e.messages);
+        json.add("subsets", e.subsets);
+        json.add("bytes", e.bytes);
+        json.add("time_min", format_time(e.time_min));
+        json.add("time_max", format_time(e.time_max));
+        json.end_mapping();
+    }
+    json.end_list();
+    json.end_mapping();
+}
+
+}
@@ -0,0 +1,101 @@
+/*
+ * inventory - Summarise the contents of BUFR files without decoding them
+ *
+ * Copyright (C) 2026  ARPA-SIM <urpsim@smr.arpa.emr.it>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#ifndef B2NC_INVENTORY_H
+#define B2NC_INVENTORY_H
+
+#include "convert.h"
+#include <wreport/varinfo.h>
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+#include <cstdio>
+
+namespace b2nc {
+
+struct Options;
+
+/// Statistics about the messages with the same dispatch key
+struct InventoryEntry
+{
+    /// Output name (see output_name())
+    std::string name;
+    /// Output file name, as Dispatcher would create it
+    std::string fname;
+    int data_category = 0;
+    int data_subcategory = 0;
+    int data_subcategory_local = 0;
+    int master_table_version_number = 0;
+    std::vector<wreport::Varcode> datadesc;
+    /// Dispatch key, as accepted by --key (see IndexKey)
+    std::string key;
+    /// Number of messages
+    unsigned messages = 0;
+    /// Number of subsets, which become output records
+    size_t subsets = 0;
+    /// Total size of the messages
+    size_t bytes = 0;
+    /// Earliest and latest section 1 time, as YYYYMMDDHHMMSS
+    long long time_min = 0;
+    long long time_max = 0;
+};
+
+/**
+ * Group BUFR messages like Dispatcher, reading only their sections 0 to 3,
+ * and collect statistics for each output they would produce
+ */
+class Inventory
+{
+protected:
+    const Options& opts;
+    std::map<Dispatcher::Key, size_t> index;
+    std::set<std::string> used_names;
+
+public:
+    /// Entries, in the order in which their first message was found
+    std::vector<InventoryEntry> entries;
+    /// Files scanned
+    std::vector<std::string> files;
+
+    explicit Inventory(const Options& opts);
+
+    /// Scan all the messages in a file
+    void scan(const std::string& fname);
+
+    /// Scan all the messages in a stream
+    void scan(FILE* in, const char* fname);
+
+    /**
+     * Account for one message.
+     *
+     * @param raw
+     *   The encoded message
+     * @param header
+     *   The message, decoded with BufrBulletin::decode_header
+     */
+    void add(const std::string& raw, const wreport::BufrBulletin& header);
+
+    /// Append the inventory as JSON to \a out
+    void to_json(std::string& out) const;
+};
+
+}
+
+#endif
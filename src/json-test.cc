@@ -0,0 +1,77 @@
+/*
+ * Copyright (C) 2026  ARPA-SIM <urpsim@smr.arpa.emr.it>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#include "json.h"
+#include "tests/tests.h"
+#include <wreport/error.h>
+#include <cmath>
+
+using namespace b2nc;
+using namespace wreport;
+using namespace wreport::tests;
+using namespace std;
+
+namespace {
+
+class Tests : public TestCase
+{
+    using TestCase::TestCase;
+
+    void register_tests() override
+    {
+        add_method("values", []() {
+            string out;
+            JSONWriter json(out);
+            json.start_list();
+            json.add_null();
+            json.add(true);
+            json.add(-3);
+            json.add(12u);
+            json.add(1.5);
+            json.add(NAN);
+            json.add("a\"b\n");
+            json.end_list();
+            wassert(actual(out) == "[null,true,-3,12,1.5,null,\"a\\\"b\\n\"]");
+        });
+
+        add_method("nested", []() {
+            string out;
+            JSONWriter json(out);
+            json.start_mapping();
+            json.add("a", 1);
+            json.add_cstring("b");
+            json.start_list();
+            json.start_mapping();
+            json.end_mapping();
+            json.start_list();
+            json.end_list();
+            json.end_list();
+            json.add("c", string("d"));
+            json.end_mapping();
+            wassert(actual(out) == "{\"a\":1,\"b\":[{},[]],\"c\":\"d\"}");
+        });
+
+        add_method("mismatched", []() {
+            string out;
+            JSONWriter json(out);
+            json.start_list();
+            wassert_throws(error_consistency, json.end_mapping());
+        });
+    }
+} tests("json");
+
+}
@@ -0,0 +1,174 @@
+/*
+ * json - JSON output
+ *
+ * Copyright (C) 2026  ARPA-SIM <urpsim@smr.arpa.emr.it>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#include "json.h"
+#include <wreport/error.h>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+
+using namespace wreport;
+using namespace std;
+
+namespace b2nc {
+
+JSONWriter::JSONWriter(std::string& out)
+    : out(out)
+{
+}
+
+JSONWriter::~JSONWriter()
+{
+}
+
+void JSONWriter::val_head()
+{
+    if (stack.empty()) return;
+    switch (stack.back())
+    {
+        case LIST_FIRST: stack.back() = LIST; break;
+        case LIST: out += ','; break;
+        case MAPPING_KEY_FIRST: stack.back() = MAPPING_VAL; break;
+        case MAPPING_KEY: out += ','; stack.back() = MAPPING_VAL; break;
+        case MAPPING_VAL: out += ':'; stack.back() = MAPPING_KEY; break;
+    }
+}
+
+void JSONWriter::start_list()
+{
+    val_head();
+    out += '[';
+    stack.push_back(LIST_FIRST);
+}
+
+void JSONWriter::end_list()
+{
+    if (stack.empty() || (stack.back() != LIST_FIRST && stack.back() != LIST))
+        throw error_consistency("JSON list closed outside of a list");
+    out += ']';
+    stack.pop_back();
+}
+
+void JSONWriter::start_mapping()
+{
+    val_head();
+    out += '{';
+    stack.push_back(MAPPING_KEY_FIRST);
+}
+
+void JSONWriter::end_mapping()
+{
+    if (stack.empty() || (stack.back() != MAPPING_KEY_FIRST && stack.back() != MAPPING_KEY))
+        throw error_consistency("JSON mapping closed outside of a mapping, or after a key without value");
+    out += '}';
+    stack.pop_back();
+}
+
+void JSONWriter::add_null()
+{
+    val_head();
+    out += "null";
+}
+
+void JSONWriter::add_bool(bool val)
+{
+    val_head();
+    out += val ? "true" : "false";
+}
+
+void JSONWriter::add_int(long long val)
+{
+    val_head();
+    out += to_string(val);
+}
+
+void JSONWriter::add_unsigned(unsigned long long val)
+{
+    val_head();
+    out += to_string(val);
+}
+
+void JSONWriter::add_double(double val)
+{
+    if (!std::isfinite(val))
+    {
+        add_null();
+        return;
+    }
+    val_head();
+    char buf[32];
+    snprintf(buf, 32, "%.17g", val);
+    out += buf;
+}
+
+void JSONWriter::add_float(float val)
+{
+    if (!std::isfinite(val))
+    {
+        add_null();
+        return;
+    }
+    val_head();
+    char buf[32];
+    snprintf(buf, 32, "%.9g", (double)val);
+    out += buf;
+}
+
+void JSONWriter::add_cstring(const char* val)
+{
+    val_head();
+    escape(val, strlen(val), out);
+}
+
+void JSONWriter::add_string(const std::string& val)
+{
+    val_head();
+    escape(val.data(), val.size(), out);
+}
+
+void JSONWriter::escape(const char* val, size_t size, std::string& out)
+{
+    out += '"';
+    for (size_t i = 0; i < size; ++i)
+    {
+        unsigned char c = val[i];
+        switch (c)
+        {
+            case '"': out += "\\\""; break;
+            case '\\': out += "\\\\"; break;
+            case '\b': out += "\\b"; break;
+            case '\f': out += "\\f"; break;
+            case '\n': out += "\\n"; break;
+            case '\r': out += "\\r"; break;
+            case '\t': out += "\\t"; break;
+            default:
+                if (c < 0x20)
+                {
+                    char buf[8];
+                    snprintf(buf, 8, "\\u%04x", (unsigned)c);
+                    out += buf;
+                } else
+                    out += c;
+                break;
+        }
+    }
+    out += '"';
+}
+
+}
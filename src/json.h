@@ -0,0 +1,99 @@
+/*
+ * json - JSON output
+ *
+ * Copyright (C) 2026  ARPA-SIM <urpsim@smr.arpa.emr.it>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#ifndef B2NC_JSON_H
+#define B2NC_JSON_H
+
+#include <string>
+#include <vector>
+
+namespace b2nc {
+
+/**
+ * Serialize values to JSON.
+ *
+ * Mappings and lists are opened and closed explicitly, and the writer takes
+ * care of inserting separators. Inside a mapping, keys and values are added
+ * alternately.
+ */
+class JSONWriter
+{
+protected:
+    enum State {
+        LIST_FIRST,
+        LIST,
+        MAPPING_KEY_FIRST,
+        MAPPING_KEY,
+        MAPPING_VAL,
+    };
+    std::string& out;
+    std::vector<State> stack;
+
+    /// Emit the separator needed before a new value
+    void val_head();
+
+public:
+    /// Append the JSON output to \a out
+    explicit JSONWriter(std::string& out);
+    ~JSONWriter();
+
+    void start_list();
+    void end_list();
+
+    void start_mapping();
+    void end_mapping();
+
+    void add_null();
+    void add_bool(bool val);
+    void add_int(long long val);
+    void add_unsigned(unsigned long long val);
+    /// Add a floating point value; non-finite values are written as null
+    void add_double(double val);
+    /// Add a float, using only as many digits as needed for a float
+    void add_float(float val);
+    void add_cstring(const char* val);
+    void add_string(const std::string& val);
+
+    void add(bool val) { add_bool(val); }
+    void add(int val) { add_int(val); }
+    void add(long val) { add_int(val); }
+    void add(long long val) { add_int(val); }
+    void add(unsigned val) { add_unsigned(val); }
+    void add(unsigned long val) { add_unsigned(val); }
+    void add(unsigned long long val) { add_unsigned(val); }
+    void add(float val) { add_float(val); }
+    void add(double val) { add_double(val); }
+    void add(const char* val) { add_cstring(val); }
+    void add(const std::string& val) { add_string(val); }
+
+    /// Add a key and its value to the current mapping
+    template<typename T>
+    void add(const char* key, const T& val)
+    {
+        add_cstring(key);
+        add(val);
+    }
+
+    /// Append a JSON-escaped version of \a val, with quotes, to \a out
+    static void escape(const char* val, size_t size, std::string& out);
+};
+
+}
+
+#endif
@@ -0,0 +1,105 @@
+/*
+ * Copyright (C) 2026  ARPA-SIM <urpsim@smr.arpa.emr.it>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#include "memory.h"
+#include "convert.h"
+#include "options.h"
+#include "tests/tests.h"
+
+using namespace b2nc;
+using namespace wreport;
+using namespace wreport::tests;
+using namespace std;
+
+namespace {
+
+class Tests : public TestCase
+{
+    using TestCase::TestCase;
+
+    void register_tests() override
+    {
+        add_method("heap_size_of", []() {
+            wassert(actual(heap_size_of(3)) == 0u);
+            wassert(actual(heap_size_of(string("short"))) == 0u);
+            string longstr(100, 'x');
+            wassert(actual(heap_size_of(longstr)) > 100u);
+
+            // Slack is counted
+            vector<int> ints;
+            ints.reserve(100);
+            ints.push_back(1);
+            wassert(actual(heap_size_of(ints)) == 100 * sizeof(int));
+
+            // So are the contents
+            vector<string> strings { longstr, "short" };
+            wassert(actual(heap_size_of(strings)) == strings.capacity() * sizeof(string) + heap_size_of(longstr));
+        });
+
+        add_method("usage", []() {
+            MemoryUsage usage;
+            usage.add("small", 10);
+            usage.add("large", 3 << 20);
+            usage.add("medium", 2048);
+            wassert(actual(usage.total()) == (3u << 20) + 2058u);
+            usage.sort();
+            wassert(actual(usage.items[0].name) == "large");
+            wassert(actual(usage.items[2].name) == "small");
+            wassert(actual(format_bytes(10)) == "10 B");
+            wassert(actual(format_bytes(2048)) == "2.0 KiB");
+            wassert(actual(format_bytes(3 << 20)) == "3.0 MiB");
+        });
+
+        add_method("outfile", []() {
+            Options opts;
+            unique_ptr<Outfile> outfile = Outfile::get(opts);
+            outfile->open("test-memory.nc");
+            read_bufr(b2nc::tests::datafile("bufr/cdfin_temp"), *outfile);
+
+            MemoryUsage usage;
+            outfile->memory_usage(usage);
+            outfile->close();
+
+            usage.sort();
+            wassert(actual(usage.total()) > 0u);
+            bool found_plan = false, found_mpn = false;
+            for (const auto& i: usage.items)
+            {
+                if (i.name == "(plan)") found_plan = i.bytes > 0;
+                if (i.name == "MPN") found_mpn = i.bytes > 0;
+            }
+            wassert_true(found_plan);
+            wassert_true(found_mpn);
+        });
+
+        add_method("dispatcher", []() {
+            Options opts;
+            opts.out_fname = "test-memory.nc";
+            Dispatcher dispatcher(opts);
+            read_bufr(b2nc::tests::datafile("bufr/cdfin_synop"), dispatcher);
+
+            FILE* out = tmpfile();
+            size_t total = dispatcher.memory_report(out, 3);
+            fclose(out);
+            wassert(actual(total) > 0u);
+            wassert(actual(dispatcher.get_memory_high_water()) == total);
+            dispatcher.close();
+        });
+    }
+} test("memory");
+
+}
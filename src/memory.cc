@@ -0,0 +1,107 @@
+/*
+ * memory - Accounting of the memory used by the conversion
+ *
+ * Copyright (C) 2026  ARPA-SIM <urpsim@smr.arpa.emr.it>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#include "memory.h"
+#include <algorithm>
+#include <sys/resource.h>
+#include <unistd.h>
+
+using namespace std;
+
+namespace b2nc {
+
+size_t heap_size_of(const std::string& val)
+{
+    // Capacity of the buffer inside the string object
+    static const size_t local_capacity = std::string().capacity();
+    if (val.capacity() <= local_capacity)
+        return 0;
+    // Include the space for the terminating zero
+    return val.capacity() + 1;
+}
+
+void MemoryUsage::add(const std::string& name, size_t bytes)
+{
+    items.push_back(Item{name, bytes});
+}
+
+size_t MemoryUsage::total() const
+{
+    size_t res = 0;
+    for (const auto& i: items)
+        res += i.bytes;
+    return res;
+}
+
+void MemoryUsage::sort()
+{
+    std::stable_sort(items.begin(), items.end(), [](const Item& a, const Item& b) {
+        return a.bytes > b.bytes;
+    });
+}
+
+void MemoryUsage::print(FILE* out, const std::string& name, unsigned top) const
+{
+    fprintf(out, "%s: %s in %zu items\n", name.c_str(), format_bytes(total()).c_str(), items.size());
+    for (size_t i = 0; i < items.size() && i < top; ++i)
+        fprintf(out, "  %12s  %s\n", format_bytes(items[i].bytes).c_str(), items[i].name.c_str());
+}
+
+std::string format_bytes(size_t bytes)
+{
+    static const char* units[] = { "B", "KiB", "MiB", "GiB", "TiB" };
+    double val = bytes;
+    unsigned unit = 0;
+    while (val >= 1024 && unit < 4)
+    {
+        val /= 1024;
+        ++unit;
+    }
+    char buf[32];
+    if (unit == 0)
+        snprintf(buf, 32, "%zu B", bytes);
+    else
+        snprintf(buf, 32, "%.1f %s", val, units[unit]);
+    return buf;
+}
+
+long peak_rss()
+{
+    struct rusage ru;
+    if (getrusage(RUSAGE_SELF, &ru) != 0)
+        return 0;
+    // ru_maxrss is in KiB on Linux
+    return ru.ru_maxrss;
+}
+
+long current_rss()
+{
+    // The second field of statm is the resident set size, in pages
+    FILE* in = fopen("/proc/self/statm", "r");
+    if (!in)
+        return 0;
+    long size, resident;
+    int found = fscanf(in, "%ld %ld", &size, &resident);
+    fclose(in);
+    if (found != 2)
+        return 0;
+    return resident * (sysconf(_SC_PAGESIZE) / 1024);
+}
+
+}
@@ -0,0 +1,89 @@
+/*
+ * memory - Accounting of the memory used by the conversion
+ *
+ * Copyright (C) 2026  ARPA-SIM <urpsim@smr.arpa.emr.it>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#ifndef B2NC_MEMORY_H
+#define B2NC_MEMORY_H
+
+#include <string>
+#include <vector>
+#include <cstdio>
+
+namespace b2nc {
+
+/**
+ * Heap memory allocated by a value, not counting the value itself.
+ *
+ * Values without heap storage, like numbers, use none.
+ */
+template<typename T>
+inline size_t heap_size_of(const T&) { return 0; }
+
+/**
+ * Heap memory allocated by a string: nothing if it fits in the string object
+ * itself, or its whole capacity otherwise
+ */
+size_t heap_size_of(const std::string& val);
+
+/// Heap memory allocated by a vector, including unused capacity
+template<typename T>
+size_t heap_size_of(const std::vector<T>& val)
+{
+    size_t res = val.capacity() * sizeof(T);
+    for (const auto& i: val)
+        res += heap_size_of(i);
+    return res;
+}
+
+/// Heap memory used by the parts of an output
+struct MemoryUsage
+{
+    struct Item
+    {
+        std::string name;
+        size_t bytes;
+    };
+    std::vector<Item> items;
+
+    void add(const std::string& name, size_t bytes);
+
+    /// Total bytes of all items
+    size_t total() const;
+
+    /// Sort items by decreasing size
+    void sort();
+
+    /**
+     * Print the total and the \a top largest items to \a out, under the
+     * title \a name
+     */
+    void print(FILE* out, const std::string& name, unsigned top) const;
+};
+
+/// Format a size in bytes for people, like "1.5 MiB"
+std::string format_bytes(size_t bytes);
+
+/// Peak resident set size of the process, in KiB, or 0 if unknown
+long peak_rss();
+
+/// Current resident set size of the process, in KiB, or 0 if unknown
+long current_rss();
+
+}
+
+#endif
@@ -0,0 +1,188 @@
+/*
+ * Copyright (C) 2026  ARPA-SIM <urpsim@smr.arpa.emr.it>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#include "merge.h"
+#include "msgindex.h"
+#include "convert.h"
+#include "options.h"
+#include "utils.h"
+#include "tests/tests.h"
+#include <wreport/error.h>
+#include <wreport/utils/sys.h>
+#include <netcdf.h>
+#include <cstdlib>
+
+using namespace b2nc;
+using namespace wreport;
+using namespace wreport::tests;
+using namespace std;
+
+namespace {
+
+/// Convert the messages of \a fname chosen by \a sel to a single file
+void convert(const string& fname, const IndexSelection& sel, const string& outname)
+{
+    Options opts;
+    unique_ptr<Outfile> outfile = Outfile::get(opts);
+    outfile->open(outname);
+    read_bufr(opts, fname, sel, *outfile);
+    outfile->close();
+}
+
+/// Return the length of a dimension of a NetCDF file
+size_t dim_len(const string& fname, const char* name)
+{
+    int ncid, dimid;
+    size_t len;
+    int res = nc_open(fname.c_str(), NC_NOWRITE, &ncid);
+    error_netcdf::throwf_iferror(res, "opening %s", fname.c_str());
+    res = nc_inq_dimid(ncid, name, &dimid);
+    if (res == NC_NOERR)
+        res = nc_inq_dimlen(ncid, dimid, &len);
+    nc_close(ncid);
+    error_netcdf::throwf_iferror(res, "reading dimension %s of %s", name, fname.c_str());
+    return len;
+}
+
+/// Return the names of the variables of a NetCDF file, in order
+vector<string> var_names(const string& fname)
+{
+    int ncid, nvars;
+    int res = nc_open(fname.c_str(), NC_NOWRITE, &ncid);
+    error_netcdf::throwf_iferror(res, "opening %s", fname.c_str());
+    vector<string> names;
+    res = nc_inq_nvars(ncid, &nvars);
+    for (int v = 0; res == NC_NOERR && v < nvars; ++v)
+    {
+        char name[NC_MAX_NAME + 1];
+        res = nc_inq_varname(ncid, v, name);
+        names.push_back(name);
+    }
+    nc_close(ncid);
+    error_netcdf::throwf_iferror(res, "reading the variables of %s", fname.c_str());
+    return names;
+}
+
+/// Return the data differences between two NetCDF files reported by nccmp
+vector<string> compare_data(const string& file1, const string& file2)
+{
+    const char* nccmp = getenv("B2NC_NCCMP");
+    if (!nccmp)
+        nccmp = "./nccmp";
+    char cmd[1024];
+    snprintf(cmd, 1024, "%s -d -f %s %s 2>&1", nccmp, file1.c_str(), file2.c_str());
+    FILE* cmpres = popen(cmd, "r");
+    if (cmpres == NULL)
+        error_system::throwf("opening pipe from \"%s\"", cmd);
+
+    vector<string> problems;
+    char line[1024];
+    while (fgets(line, 1024, cmpres) != NULL)
+    {
+        problems.push_back(line);
+        fprintf(stderr, "%s", line);
+    }
+    pclose(cmpres);
+    return problems;
+}
+
+class Tests : public TestCase
+{
+    using TestCase::TestCase;
+
+    void register_tests() override
+    {
+        add_method("temp", []() {
+            string fname = "merge-temp.bufr";
+            sys::write_file(fname, sys::read_file(b2nc::tests::datafile("bufr/cdfin_temp")), 0666);
+            sys::unlink_ifexists(MessageIndex::pathname(fname));
+
+            IndexSelection sel;
+            convert(fname, sel, "merge-whole.nc");
+
+            vector<string> shards;
+            sel.shards = 3;
+            for (sel.shard = 0; sel.shard < sel.shards; ++sel.shard)
+            {
+                shards.push_back("merge-shard" + to_string(sel.shard) + ".nc");
+                convert(fname, sel, shards.back());
+            }
+
+            Options opts;
+            merge_netcdf(opts, shards, "merge-merged.nc");
+
+            wassert(actual(dim_len("merge-merged.nc", "BUFR_records")) == dim_len("merge-whole.nc", "BUFR_records"));
+            wassert(actual(dim_len("merge-merged.nc", "Loop_000_maxlen")) == dim_len("merge-whole.nc", "Loop_000_maxlen"));
+            wassert(actual(compare_data("merge-whole.nc", "merge-merged.nc").size()) == 0u);
+        });
+
+        add_method("two_shards", []() {
+            string fname = "merge-acars.bufr";
+            sys::write_file(fname, sys::read_file(b2nc::tests::datafile("bufr/cdfin_acars")), 0666);
+            sys::unlink_ifexists(MessageIndex::pathname(fname));
+
+            // Convert the messages of one output, as a single run would
+            Options opts;
+            MessageIndex index;
+            index.get(opts, fname);
+            IndexSelection sel;
+            sel.keys.push_back(index.keys()[0]);
+            convert(fname, sel, "merge-acars-whole.nc");
+
+            sel.shards = 2;
+            vector<string> shards;
+            for (sel.shard = 0; sel.shard < sel.shards; ++sel.shard)
+            {
+                shards.push_back("merge-acars-shard" + to_string(sel.shard) + ".nc");
+                convert(fname, sel, shards.back());
+            }
+            merge_netcdf(opts, shards, "merge-acars-merged.nc");
+
+            wassert(actual(dim_len("merge-acars-merged.nc", "BUFR_records")) == dim_len("merge-acars-whole.nc", "BUFR_records"));
+            wassert_true(var_names("merge-acars-merged.nc") == var_names("merge-acars-whole.nc"));
+            wassert(actual(compare_data("merge-acars-whole.nc", "merge-acars-merged.nc").size()) == 0u);
+        });
+
+        add_method("mismatch", []() {
+            // Outputs of different kinds of messages cannot be merged
+            IndexSelection sel;
+            string temp = "merge-mismatch-temp.bufr";
+            sys::write_file(temp, sys::read_file(b2nc::tests::datafile("bufr/cdfin_temp")), 0666);
+            sys::unlink_ifexists(MessageIndex::pathname(temp));
+            convert(temp, sel, "merge-mismatch-temp.nc");
+
+            string acars = "merge-mismatch-acars.bufr";
+            sys::write_file(acars, sys::read_file(b2nc::tests::datafile("bufr/cdfin_acars")), 0666);
+            sys::unlink_ifexists(MessageIndex::pathname(acars));
+            Options opts;
+            MessageIndex index;
+            index.get(opts, acars);
+            sel.keys.push_back(index.keys()[0]);
+            convert(acars, sel, "merge-mismatch-acars.nc");
+
+            wassert_throws(wreport::error_consistency, merge_netcdf(opts,
+                        vector<string>{"merge-mismatch-temp.nc", "merge-mismatch-acars.nc"}, "merge-mismatch.nc"));
+        });
+
+        add_method("empty", []() {
+            Options opts;
+            wassert_throws(wreport::error_consistency, merge_netcdf(opts, vector<string>(), "merge-empty.nc"));
+        });
+    }
+} test("merge");
+
+}
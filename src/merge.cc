@@ -0,0 +1,515 @@
+/*
+ * merge - Merge NetCDF outputs of sharded conversions
+ *
+ * Copyright (C) 2026  ARPA-SIM <urpsim@smr.arpa.emr.it>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#include "merge.h"
+#include "ncoutfile.h"
+#include "options.h"
+#include "utils.h"
+#include <wreport/error.h>
+#include <netcdf.h>
+#include <map>
+#include <memory>
+#include <cstring>
+
+using namespace wreport;
+using namespace std;
+
+namespace b2nc {
+
+namespace {
+
+/// One input file, open for reading
+struct MergeInput
+{
+    std::string fname;
+    int ncid = -1;
+    int unlimdim = -1;
+    size_t records = 0;
+
+    explicit MergeInput(const std::string& fname)
+        : fname(fname)
+    {
+        int res = nc_open(fname.c_str(), NC_NOWRITE, &ncid);
+        error_netcdf::throwf_iferror(res, "opening %s", fname.c_str());
+        res = nc_inq_unlimdim(ncid, &unlimdim);
+        error_netcdf::throwf_iferror(res, "looking for the record dimension of %s", fname.c_str());
+        if (unlimdim != -1)
+        {
+            res = nc_inq_dimlen(ncid, unlimdim, &records);
+            error_netcdf::throwf_iferror(res, "reading the number of records of %s", fname.c_str());
+        }
+    }
+    MergeInput(const MergeInput&) = delete;
+    MergeInput& operator=(const MergeInput&) = delete;
+    ~MergeInput()
+    {
+        if (ncid != -1)
+            nc_close(ncid);
+    }
+
+    std::string dim_name(int dimid) const
+    {
+        char name[NC_MAX_NAME + 1];
+        int res = nc_inq_dim(ncid, dimid, name, NULL);
+        error_netcdf::throwf_iferror(res, "reading dimension %d of %s", dimid, fname.c_str());
+        return name;
+    }
+
+    size_t dim_len(const std::string& name) const
+    {
+        int dimid;
+        size_t len;
+        int res = nc_inq_dimid(ncid, name.c_str(), &dimid);
+        error_netcdf::throwf_iferror(res, "looking for dimension %s in %s", name.c_str(), fname.c_str());
+        res = nc_inq_dimlen(ncid, dimid, &len);
+        error_netcdf::throwf_iferror(res, "reading dimension %s of %s", name.c_str(), fname.c_str());
+        return len;
+    }
+
+    /// Return the text value of a variable attribute, or "" if it is missing
+    std::string text_attribute(int varid, const char* name) const
+    {
+        nc_type type;
+        size_t len;
+        if (nc_inq_att(ncid, varid, name, &type, &len) != NC_NOERR || type != NC_CHAR)
+            return std::string();
+        std::string res(len, 0);
+        int res_code = nc_get_att_text(ncid, varid, name, &res[0]);
+        error_netcdf::throwf_iferror(res_code, "reading attribute %s of %s", name, fname.c_str());
+        return res;
+    }
+
+    /**
+     * Read the value of a single integer variable attribute in \a out.
+     *
+     * Returns false if the attribute is missing or is not a single integer.
+     */
+    bool int_attribute(int varid, const char* name, int& out) const
+    {
+        nc_type type;
+        size_t len;
+        if (nc_inq_att(ncid, varid, name, &type, &len) != NC_NOERR || type != NC_INT || len != 1)
+            return false;
+        int res = nc_get_att_int(ncid, varid, name, &out);
+        error_netcdf::throwf_iferror(res, "reading attribute %s of %s", name, fname.c_str());
+        return true;
+    }
+
+    /**
+     * Read the value of an integer record variable for the first record in
+     * \a out.
+     *
+     * Returns false if there are no records or the variable is missing.
+     */
+    bool first_record(const char* name, int& out) const
+    {
+        int varid;
+        if (records == 0 || nc_inq_varid(ncid, name, &varid) != NC_NOERR)
+            return false;
+        size_t start = 0;
+        int res = nc_get_var1_int(ncid, varid, &start, &out);
+        error_netcdf::throwf_iferror(res, "reading %s from %s", name, fname.c_str());
+        return true;
+    }
+};
+
+/**
+ * Section 1 variables that are the same for all the messages of an output,
+ * since they are part of the key that dispatches messages to outputs (see
+ * Dispatcher::Key).
+ *
+ * The local tables version is not part of the key, and can change across
+ * the records of one output.
+ */
+const char* key_variables[] = {
+    "section1_data_category",
+    "section1_int_data_sub_category",
+    "section1_local_data_sub_category",
+    "section1_master_tables_version",
+};
+
+/**
+ * Check that all inputs have records of the same category, subcategory and
+ * master tables version
+ */
+void check_same_key(const std::vector<std::unique_ptr<MergeInput>>& ins)
+{
+    for (const char* name: key_variables)
+    {
+        const MergeInput* first = nullptr;
+        int first_val = 0;
+        for (const auto& in: ins)
+        {
+            int val;
+            if (!in->first_record(name, val))
+                continue;
+            if (!first)
+            {
+                first = in.get();
+                first_val = val;
+            } else if (val != first_val)
+                error_consistency::throwf("%s: %s is %d, but it is %d in %s: the inputs do not come from the same kind of messages",
+                        in->fname.c_str(), name, val, first_val, first->fname.c_str());
+        }
+    }
+}
+
+/// Fixed dimension of the merged file
+struct MergeDim
+{
+    std::string name;
+    size_t len = 0;
+    int dimid = -1;
+};
+
+/// Variable of the merged file
+struct MergeVar
+{
+    std::string name;
+    nc_type type = NC_NAT;
+    /// True if the first dimension is the record dimension
+    bool records = false;
+    /// Names of the fixed dimensions
+    std::vector<std::string> dims;
+    /// Descriptor of the variable, from its ifxy attribute, or -1 if it has none
+    int ifxy = -1;
+    /// Index of the first input with this variable
+    unsigned first_input = 0;
+    int varid = -1;
+};
+
+/// Write the default NetCDF fill value for \a type in \a out
+void default_fill(nc_type type, std::vector<char>& out)
+{
+    switch (type)
+    {
+        case NC_BYTE: { signed char v = NC_FILL_BYTE; memcpy(out.data(), &v, sizeof(v)); break; }
+        case NC_CHAR: { char v = NC_FILL_CHAR; memcpy(out.data(), &v, sizeof(v)); break; }
+        case NC_SHORT: { short v = NC_FILL_SHORT; memcpy(out.data(), &v, sizeof(v)); break; }
+        case NC_INT: { int v = NC_FILL_INT; memcpy(out.data(), &v, sizeof(v)); break; }
+        case NC_FLOAT: { float v = NC_FILL_FLOAT; memcpy(out.data(), &v, sizeof(v)); break; }
+        case NC_DOUBLE: { double v = NC_FILL_DOUBLE; memcpy(out.data(), &v, sizeof(v)); break; }
+        default: error_consistency::throwf("cannot merge variables of NetCDF type %d", (int)type);
+    }
+}
+
+/**
+ * Copy \a in, of shape \a in_shape, into \a out, of shape \a out_shape,
+ * which is at least as large in every dimension and is already filled with
+ * fill values.
+ *
+ * If \a text is true, rows of the last dimension that hold a value are
+ * padded with spaces instead, as the converter does for strings.
+ */
+void widen(const char* in, const std::vector<size_t>& in_shape,
+           char* out, const std::vector<size_t>& out_shape,
+           size_t elsize, bool text, char text_fill)
+{
+    size_t n = in_shape.size();
+    if (n == 0)
+    {
+        memcpy(out, in, elsize);
+        return;
+    }
+
+    vector<size_t> in_stride(n, 1), out_stride(n, 1);
+    size_t rows = 1;
+    for (size_t k = n - 1; k > 0; --k)
+    {
+        in_stride[k - 1] = in_stride[k] * in_shape[k];
+        out_stride[k - 1] = out_stride[k] * out_shape[k];
+        rows *= in_shape[k - 1];
+    }
+    size_t in_row = in_shape[n - 1];
+    size_t out_row = out_shape[n - 1];
+    if (in_row == 0)
+        return;
+
+    vector<size_t> idx(n, 0);
+    for (size_t r = 0; r < rows; ++r)
+    {
+        size_t in_off = 0, out_off = 0;
+        for (size_t k = 0; k + 1 < n; ++k)
+        {
+            in_off += idx[k] * in_stride[k];
+            out_off += idx[k] * out_stride[k];
+        }
+        const char* src = in + in_off * elsize;
+        char* dst = out + out_off * elsize;
+        memcpy(dst, src, in_row * elsize);
+
+        if (text && out_row > in_row)
+        {
+            bool has_value = false;
+            for (size_t i = 0; i < in_row && !has_value; ++i)
+                has_value = src[i] != text_fill;
+            if (has_value)
+                memset(dst + in_row, ' ', out_row - in_row);
+        }
+
+        // Move to the next row
+        for (size_t k = n - 1; k > 0; --k)
+        {
+            if (++idx[k - 1] < in_shape[k - 1])
+                break;
+            idx[k - 1] = 0;
+        }
+    }
+}
+
+}
+
+void merge_netcdf(const Options& opts, const std::vector<std::string>& inputs, const std::string& output)
+{
+    if (inputs.empty())
+        error_consistency::throwf("no files to merge into %s", output.c_str());
+
+    vector<unique_ptr<MergeInput>> ins;
+    vector<MergeDim> dims;
+    map<string, size_t> dim_index;
+    vector<MergeVar> vars;
+    map<string, size_t> var_index;
+
+    // Collect the union of dimensions and variables. Both are kept in order
+    // of first appearance, scanning inputs in order: since shards are
+    // consecutive, this is the order in which a conversion of the whole
+    // input creates them
+    for (unsigned i = 0; i < inputs.size(); ++i)
+    {
+        ins.emplace_back(new MergeInput(inputs[i]));
+        const MergeInput& in = *ins.back();
+
+        int ndims, nvars;
+        int res = nc_inq(in.ncid, &ndims, &nvars, NULL, NULL);
+        error_netcdf::throwf_iferror(res, "reading the contents of %s", in.fname.c_str());
+
+        for (int d = 0; d < ndims; ++d)
+        {
+            if (d == in.unlimdim) continue;
+            char name[NC_MAX_NAME + 1];
+            size_t len;
+            res = nc_inq_dim(in.ncid, d, name, &len);
+            error_netcdf::throwf_iferror(res, "reading dimension %d of %s", d, in.fname.c_str());
+            auto di = dim_index.find(name);
+            if (di == dim_index.end())
+            {
+                dim_index.insert(make_pair(name, dims.size()));
+                dims.emplace_back();
+                dims.back().name = name;
+                dims.back().len = len;
+            } else if (len > dims[di->second].len)
+                dims[di->second].len = len;
+        }
+
+        for (int v = 0; v < nvars; ++v)
+        {
+            MergeVar var;
+            char name[NC_MAX_NAME + 1];
+            int var_ndims;
+            int dimids[NC_MAX_VAR_DIMS];
+            res = nc_inq_var(in.ncid, v, name, &var.type, &var_ndims, dimids, NULL);
+            error_netcdf::throwf_iferror(res, "reading variable %d of %s", v, in.fname.c_str());
+            var.name = name;
+            var.first_input = i;
+            in.int_attribute(v, "ifxy", var.ifxy);
+            for (int k = 0; k < var_ndims; ++k)
+            {
+                if (dimids[k] == in.unlimdim)
+                {
+                    if (k != 0)
+                        error_consistency::throwf("%s: variable %s does not have the record dimension first",
+                                in.fname.c_str(), name);
+                    var.records = true;
+                } else
+                    var.dims.push_back(in.dim_name(dimids[k]));
+            }
+
+            auto vi = var_index.find(var.name);
+            if (vi == var_index.end())
+            {
+                var_index.insert(make_pair(var.name, vars.size()));
+                vars.push_back(var);
+                continue;
+            }
+            const MergeVar& old = vars[vi->second];
+            if (old.type != var.type || old.records != var.records || old.dims != var.dims)
+                error_consistency::throwf("%s: variable %s has a different type or shape than in %s",
+                        in.fname.c_str(), name, inputs[old.first_input].c_str());
+            // The same name for a different descriptor means a different DDS
+            if (old.ifxy != var.ifxy)
+                error_consistency::throwf("%s: variable %s has descriptor %06d, but %06d in %s: the inputs do not have the same data descriptors",
+                        in.fname.c_str(), name, var.ifxy, old.ifxy, inputs[old.first_input].c_str());
+        }
+    }
+
+    check_same_key(ins);
+
+    NCOutfile out(opts);
+    out.open(output);
+
+    for (auto& dim: dims)
+    {
+        int res = nc_def_dim(out.ncid, dim.name.c_str(), dim.len, &dim.dimid);
+        error_netcdf::throwf_iferror(res, "creating %s dimension", dim.name.c_str());
+    }
+
+    // Global attributes come from the first input
+    {
+        const MergeInput& in = *ins[0];
+        int natts;
+        int res = nc_inq(in.ncid, NULL, NULL, &natts, NULL);
+        error_netcdf::throwf_iferror(res, "reading the attributes of %s", in.fname.c_str());
+        for (int a = 0; a < natts; ++a)
+        {
+            char name[NC_MAX_NAME + 1];
+            res = nc_inq_attname(in.ncid, NC_GLOBAL, a, name);
+            error_netcdf::throwf_iferror(res, "reading global attribute %d of %s", a, in.fname.c_str());
+            res = nc_copy_att(in.ncid, NC_GLOBAL, name, out.ncid, NC_GLOBAL);
+            error_netcdf::throwf_iferror(res, "copying global attribute %s", name);
+        }
+    }
+
+    for (auto& var: vars)
+    {
+        vector<int> dimids;
+        if (var.records)
+            dimids.push_back(out.dim_bufr_records);
+        for (const auto& name: var.dims)
+            dimids.push_back(dims[dim_index[name]].dimid);
+        var.varid = out.def_var(var.name.c_str(), var.type, dimids.size(), dimids.data());
+
+        const MergeInput& in = *ins[var.first_input];
+        int in_varid, natts;
+        int res = nc_inq_varid(in.ncid, var.name.c_str(), &in_varid);
+        error_netcdf::throwf_iferror(res, "looking for variable %s in %s", var.name.c_str(), in.fname.c_str());
+        res = nc_inq_var(in.ncid, in_varid, NULL, NULL, NULL, NULL, &natts);
+        error_netcdf::throwf_iferror(res, "reading variable %s in %s", var.name.c_str(), in.fname.c_str());
+        for (int a = 0; a < natts; ++a)
+        {
+            char name[NC_MAX_NAME + 1];
+            res = nc_inq_attname(in.ncid, in_varid, a, name);
+            error_netcdf::throwf_iferror(res, "reading attribute %d of %s", a, var.name.c_str());
+            res = nc_copy_att(in.ncid, in_varid, name, out.ncid, var.varid);
+            error_netcdf::throwf_iferror(res, "copying attribute %s of %s", name, var.name.c_str());
+        }
+
+        // The loop length is not constant if it varies in any shard
+        if (in.text_attribute(in_varid, "dim1_length") == "_constant")
+            for (unsigned i = var.first_input + 1; i < ins.size(); ++i)
+            {
+                int varid;
+                if (nc_inq_varid(ins[i]->ncid, var.name.c_str(), &varid) != NC_NOERR)
+                    continue;
+                string val = ins[i]->text_attribute(varid, "dim1_length");
+                if (val.empty() || val == "_constant")
+                    continue;
+                res = nc_put_att_text(out.ncid, var.varid, "dim1_length", val.size(), val.data());
+                error_netcdf::throwf_iferror(res, "setting dim1_length attribute of %s", var.name.c_str());
+                break;
+            }
+    }
+
+    out.end_define_mode();
+
+    for (const auto& var: vars)
+    {
+        size_t elsize;
+        int res = nc_inq_type(out.ncid, var.type, NULL, &elsize);
+        error_netcdf::throwf_iferror(res, "reading the size of the type of %s", var.name.c_str());
+
+        vector<char> fill(elsize);
+        nc_type fill_type;
+        size_t fill_len;
+        if (nc_inq_att(out.ncid, var.varid, "_FillValue", &fill_type, &fill_len) == NC_NOERR
+                && fill_type == var.type && fill_len == 1)
+        {
+            res = nc_get_att(out.ncid, var.varid, "_FillValue", fill.data());
+            error_netcdf::throwf_iferror(res, "reading _FillValue of %s", var.name.c_str());
+        } else
+            default_fill(var.type, fill);
+
+        vector<size_t> out_shape;
+        for (const auto& name: var.dims)
+            out_shape.push_back(dims[dim_index[name]].len);
+        size_t out_row = 1;
+        for (size_t len: out_shape)
+            out_row *= len;
+
+        // The file is written in NC_NOFILL mode, so every record is written,
+        // including those of inputs without the variable
+        size_t first_record = 0;
+        for (unsigned i = 0; i < ins.size(); ++i)
+        {
+            const MergeInput& in = *ins[i];
+            if (!var.records && i != var.first_input)
+                continue;
+            size_t records = var.records ? in.records : 1;
+            if (records == 0)
+                continue;
+
+            vector<char> buf(records * out_row * elsize);
+            for (size_t pos = 0; pos < buf.size(); pos += elsize)
+                memcpy(buf.data() + pos, fill.data(), elsize);
+
+            int in_varid;
+            if (nc_inq_varid(in.ncid, var.name.c_str(), &in_varid) == NC_NOERR)
+            {
+                vector<size_t> in_shape;
+                vector<size_t> full_out_shape;
+                if (var.records)
+                {
+                    in_shape.push_back(records);
+                    full_out_shape.push_back(records);
+                }
+                size_t in_size = records;
+                for (const auto& name: var.dims)
+                {
+                    in_shape.push_back(in.dim_len(name));
+                    in_size *= in_shape.back();
+                }
+                full_out_shape.insert(full_out_shape.end(), out_shape.begin(), out_shape.end());
+
+                vector<size_t> start(in_shape.size(), 0);
+                vector<char> in_buf(in_size * elsize);
+                res = nc_get_vara(in.ncid, in_varid, start.data(), in_shape.data(), in_buf.data());
+                error_netcdf::throwf_iferror(res, "reading %s from %s", var.name.c_str(), in.fname.c_str());
+
+                widen(in_buf.data(), in_shape, buf.data(), full_out_shape, elsize,
+                        var.type == NC_CHAR, fill[0]);
+            }
+
+            vector<size_t> start;
+            vector<size_t> count;
+            if (var.records)
+            {
+                start.push_back(first_record);
+                count.push_back(records);
+            }
+            start.resize(start.size() + out_shape.size(), 0);
+            count.insert(count.end(), out_shape.begin(), out_shape.end());
+            res = nc_put_vara(out.ncid, var.varid, start.data(), count.data(), buf.data());
+            error_netcdf::throwf_iferror(res, "storing %zd records of %s", records, var.name.c_str());
+            first_record += records;
+        }
+    }
+
+    out.close();
+}
+
+}
@@ -0,0 +1,56 @@
+/*
+ * merge - Merge NetCDF outputs of sharded conversions
+ *
+ * Copyright (C) 2026  ARPA-SIM <urpsim@smr.arpa.emr.it>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#ifndef B2NC_MERGE_H
+#define B2NC_MERGE_H
+
+#include <string>
+#include <vector>
+
+namespace b2nc {
+
+struct Options;
+
+/**
+ * Merge NetCDF files converted from consecutive shards of the same input
+ * (see IndexSelection::shards) into \a output.
+ *
+ * All inputs must have records of the same data category, subcategory, local
+ * subcategory and master tables version, and variables with the same name
+ * must have the same descriptor, type and dimensions, or error_consistency
+ * is thrown.
+ *
+ * Records are concatenated in the order of \a inputs. Loop_NNN_maxlen,
+ * string length and section length dimensions are widened to their largest
+ * size in any input, padding values like a conversion of the whole input
+ * would. Variables missing from some inputs are filled with missing values
+ * for their records.
+ *
+ * Dimensions and variables are defined in order of first appearance in
+ * \a inputs, which for shards given in order is the order of a conversion of
+ * the whole input.
+ *
+ * Variable attributes are taken from the first input that has the variable,
+ * except that dim1_length names the loop counter if any input does.
+ */
+void merge_netcdf(const Options& opts, const std::vector<std::string>& inputs, const std::string& output);
+
+}
+
+#endif
@@ -0,0 +1,263 @@
+/*
+ * mnemo-compile - Compile mnemonic tables into C++ source code
+ *
+ * Copyright (C) 2026  ARPA-SIM <urpsim@smr.arpa.emr.it>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+/*
+ * Usage: mnemo-compile output.cc tables/mnem_NNN...
+ *
+ * Generates the definitions of mnemo::BuiltinTable::get and
+ * mnemo::BUILTIN_CHECKSUM, with each table stored as constexpr arrays
+ * indexed by a perfect hash.
+ *
+ * This runs on the build machine, and only depends on the standard library.
+ */
+
+#include "mnemo-hash.h"
+#include <algorithm>
+#include <map>
+#include <string>
+#include <vector>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+using namespace std;
+using namespace b2nc::mnemo;
+
+namespace {
+
+struct Entry
+{
+    uint16_t code;
+    string name;
+};
+
+struct CompiledTable
+{
+    int version;
+    vector<Entry> entries;
+    vector<uint16_t> codes;
+    vector<string> names;
+    vector<uint32_t> displacements;
+};
+
+[[noreturn]] void fail(const char* fmt, const char* arg)
+{
+    fprintf(stderr, "mnemo-compile: ");
+    fprintf(stderr, fmt, arg);
+    fputc('\n', stderr);
+    exit(1);
+}
+
+/// Parse a table file, in the same way as mnemo::Table::load
+void read_table(const char* pathname, CompiledTable& table)
+{
+    const char* base = strrchr(pathname, '/');
+    base = base ? base + 1 : pathname;
+    if (sscanf(base, "mnem_%d", &table.version) != 1)
+        fail("cannot find the table version in file name %s", pathname);
+
+    FILE* in = fopen(pathname, "rt");
+    if (in == NULL)
+        fail("cannot open %s", pathname);
+    char line[256];
+    map<uint16_t, string> seen;
+    while (fgets(line, 256, in))
+    {
+        if (line[0] == '#')
+            continue;
+        int f, x, y;
+        char name[10];
+        if (sscanf(line, "%01d%02d%03d\t%9s", &f, &x, &y, name) != 4)
+            fail("%s: line has an unknown format", pathname);
+        uint16_t code = (f << 14) | (x << 8) | y;
+        if (!seen.insert(make_pair(code, name)).second)
+            fail("%s: duplicate variable code", pathname);
+    }
+    if (ferror(in))
+        fail("cannot read %s", pathname);
+    fclose(in);
+
+    for (const auto& i: seen)
+        table.entries.push_back(Entry{i.first, i.second});
+}
+
+/**
+ * Try to build a hash-and-displace perfect hash with the given number of
+ * slots, returning false if no displacement could be found for some bucket
+ */
+bool try_build(CompiledTable& table, unsigned size)
+{
+    unsigned buckets = table.entries.size() / 4 + 1;
+    vector<vector<const Entry*>> by_bucket(buckets);
+    for (const auto& e: table.entries)
+        by_bucket[code_hash(e.code, 0) % buckets].push_back(&e);
+
+    // Place the largest buckets first, while there is more room
+    vector<unsigned> order;
+    for (unsigned i = 0; i < buckets; ++i)
+        order.push_back(i);
+    stable_sort(order.begin(), order.end(), [&](unsigned a, unsigned b) {
+        return by_bucket[a].size() > by_bucket[b].size();
+    });
+
+    table.codes.assign(size, 0);
+    table.names.assign(size, string());
+    table.displacements.assign(buckets, 0);
+    vector<bool> used(size, false);
+    vector<unsigned> slots;
+    for (unsigned b: order)
+    {
+        const auto& keys = by_bucket[b];
+        if (keys.empty())
+            break;
+        bool placed = false;
+        for (uint32_t d = 1; !placed && d < 100000; ++d)
+        {
+            slots.clear();
+            placed = true;
+            for (const Entry* e: keys)
+            {
+                unsigned slot = code_hash(e->code, d) % size;
+                if (used[slot] || find(slots.begin(), slots.end(), slot) != slots.end())
+                {
+                    placed = false;
+                    break;
+                }
+                slots.push_back(slot);
+            }
+            if (placed)
+            {
+                table.displacements[b] = d;
+                for (size_t i = 0; i < keys.size(); ++i)
+                {
+                    used[slots[i]] = true;
+                    table.codes[slots[i]] = keys[i]->code;
+                    table.names[slots[i]] = keys[i]->name;
+                }
+            }
+        }
+        if (!placed)
+            return false;
+    }
+    return true;
+}
+
+void build(CompiledTable& table)
+{
+    // Start with a load factor of about 90%, and add room until it works
+    unsigned size = table.entries.size() + table.entries.size() / 8 + 1;
+    while (!try_build(table, size))
+        size += size / 8 + 1;
+}
+
+}
+
+int main(int argc, const char* argv[])
+{
+    if (argc < 3)
+    {
+        fprintf(stderr, "Usage: %s output.cc mnem_NNN...\n", argv[0]);
+        return 1;
+    }
+
+    vector<CompiledTable> tables(argc - 2);
+    for (int i = 2; i < argc; ++i)
+    {
+        read_table(argv[i], tables[i - 2]);
+        build(tables[i - 2]);
+    }
+    sort(tables.begin(), tables.end(), [](const CompiledTable& a, const CompiledTable& b) {
+        return a.version < b.version;
+    });
+
+    // 64 bit FNV-1a hash of the contents of all tables
+    uint64_t checksum = 0xcbf29ce484222325ULL;
+    auto add_checksum = [&](const string& s) {
+        for (unsigned char c: s)
+        {
+            checksum ^= c;
+            checksum *= 0x100000001b3ULL;
+        }
+    };
+
+    string out;
+    char buf[128];
+    out += "// Generated by mnemo-compile: do not edit\n\n";
+    out += "#include \"mnemo.h\"\n\n";
+    out += "namespace b2nc {\nnamespace mnemo {\n\nnamespace {\n";
+    for (const auto& t: tables)
+    {
+        snprintf(buf, 128, "%03d", t.version);
+        string v(buf);
+        add_checksum("mnem_" + v + "\n");
+
+        out += "\nconstexpr uint16_t codes_" + v + "[] = {";
+        for (size_t i = 0; i < t.codes.size(); ++i)
+        {
+            out += i % 12 ? " " : "\n    ";
+            out += to_string(t.codes[i]) + ",";
+        }
+        out += "\n};\n";
+
+        out += "constexpr char names_" + v + "[][10] = {";
+        for (size_t i = 0; i < t.names.size(); ++i)
+        {
+            out += i % 8 ? " " : "\n    ";
+            out += "\"" + t.names[i] + "\",";
+        }
+        out += "\n};\n";
+
+        out += "constexpr uint32_t displacements_" + v + "[] = {";
+        for (size_t i = 0; i < t.displacements.size(); ++i)
+        {
+            out += i % 12 ? " " : "\n    ";
+            out += to_string(t.displacements[i]) + ",";
+        }
+        out += "\n};\n";
+
+        for (const auto& e: t.entries)
+            add_checksum(to_string(e.code) + "\t" + e.name + "\n");
+    }
+
+    out += "\nconstexpr BuiltinTable tables[] = {\n";
+    for (const auto& t: tables)
+    {
+        snprintf(buf, 128, "%03d", t.version);
+        string v(buf);
+        out += "    { " + to_string(t.version) + ", " + to_string(t.codes.size()) + ", "
+            + to_string(t.displacements.size()) + ", codes_" + v + ", names_" + v
+            + ", displacements_" + v + " },\n";
+    }
+    out += "};\n\n}\n\n";
+
+    snprintf(buf, 128, "const char* BUILTIN_CHECKSUM = \"%016llx\";\n\n", (unsigned long long)checksum);
+    out += buf;
+    out += "const BuiltinTable* BuiltinTable::get(int version)\n{\n";
+    out += "    for (const auto& t: tables)\n";
+    out += "        if (t.version == version)\n";
+    out += "            return &t;\n";
+    out += "    return NULL;\n}\n\n}\n}\n";
+
+    FILE* outfd = fopen(argv[1], "wt");
+    if (outfd == NULL)
+        fail("cannot create %s", argv[1]);
+    if (fwrite(out.data(), out.size(), 1, outfd) != 1 || fclose(outfd) != 0)
+        fail("cannot write %s", argv[1]);
+    return 0;
+}
@@ -0,0 +1,52 @@
+/*
+ * mnemo-hash - Hash function for the compiled mnemonic tables
+ *
+ * Copyright (C) 2026  ARPA-SIM <urpsim@smr.arpa.emr.it>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#ifndef B2NC_MNEMO_HASH_H
+#define B2NC_MNEMO_HASH_H
+
+/*
+ * This header has no dependencies, since it is also used by mnemo-compile,
+ * which is built for the build machine.
+ */
+
+#include <cstdint>
+
+namespace b2nc {
+namespace mnemo {
+
+/**
+ * Hash a variable code with the given seed.
+ *
+ * The compiled tables use hash-and-displace perfect hashing: a code is
+ * assigned to bucket code_hash(code, 0) % buckets, and found in slot
+ * code_hash(code, displacement[bucket]) % size.
+ */
+constexpr uint32_t code_hash(uint16_t code, uint32_t seed)
+{
+    uint32_t h = (code ^ (seed * 0x9e3779b9u)) * 0x85ebca6bu;
+    h ^= h >> 13;
+    h *= 0xc2b2ae35u;
+    h ^= h >> 16;
+    return h;
+}
+
+}
+}
+
+#endif
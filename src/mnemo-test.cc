@@ -19,6 +19,7 @@
 
 #include "mnemo.h"
 #include <tests/tests.h>
+#include <wreport/utils/sys.h>
 
 using namespace b2nc;
 using namespace wreport;
@@ -53,6 +54,40 @@ class Tests : public TestCase
             val = t->find(WR_VAR(2, 5, 0));
             wassert(actual(val) == "YSUPL");
         });
+
+        add_method("builtin", []() {
+            // The compiled tables match the table files
+            for (int version = 1; version <= 41; ++version)
+            {
+                WREPORT_TEST_INFO(info);
+                info() << "mnem_" << version;
+
+                const mnemo::BuiltinTable* builtin = mnemo::BuiltinTable::get(version);
+                wassert_true(builtin != nullptr);
+                wassert_true(sys::exists(mnemo::Table::pathname(version)));
+                mnemo::Table file(version);
+                for (unsigned code = 0; code < 0x10000; ++code)
+                {
+                    // C05YYY mnemonics are hardcoded in Table::find
+                    if (WR_VAR_F(code) == 2) continue;
+                    const char* expected = file.find(code);
+                    const char* val = builtin->find(code);
+                    if (!expected)
+                        wassert(actual(val).isfalse());
+                    else
+                        wassert(actual(val) == expected);
+                }
+            }
+            wassert_true(mnemo::BuiltinTable::get(0) == nullptr);
+
+            // Without $B2NC_TABLES, the compiled tables are used
+            b2nc::tests::LocalEnv env(mnemo::ENV_TABLE_DIR, "");
+            wassert(actual(mnemo::Table::pathname(14)) == "");
+            mnemo::Table t(14);
+            wassert(actual(t.find(WR_VAR(0, 10, 1))) == "MHHA");
+            wassert(actual(t.find(WR_VAR(2, 5, 0))) == "YSUPL");
+            wassert(actual(t.find(WR_VAR(0, 0, 0))).isfalse());
+        });
     }
 
 } tests("mnemo");
@@ -22,6 +22,7 @@
 #include "mnemo.h"
 #include <wreport/error.h>
 #include <map>
+#include <mutex>
 #include <vector>
 #include <algorithm>
 #include <cstdio>
@@ -55,7 +56,7 @@ bool Record::operator<(const Record& r) const
 }
 
 Table::Table(int version)
-    : version(version)
+    : version(version), builtin(NULL)
 {
     load();
 }
@@ -64,15 +65,13 @@ void Table::load()
 {
     clear();
 
-    char fname[10];
-    snprintf(fname, 10, "mnem_%03d", version);
-    const char* dir = getenv(ENV_TABLE_DIR);
-    if (dir == NULL)
-        dir = DEFAULT_TABLE_DIR;
-    string pathname(dir);
-    if (pathname[pathname.size() - 1] != '/')
-        pathname += '/';
-    pathname += fname;
+    string pathname = Table::pathname(version);
+    if (pathname.empty())
+    {
+        builtin = BuiltinTable::get(version);
+        return;
+    }
+    builtin = NULL;
 
     FILE* in = fopen(pathname.c_str(), "rt");
     if (in == NULL)
@@ -97,6 +96,24 @@ void Table::load()
     std::sort(begin(), end());
 }
 
+std::string Table::pathname(int version)
+{
+    char fname[10];
+    snprintf(fname, 10, "mnem_%03d", version);
+    const char* dir = getenv(ENV_TABLE_DIR);
+    if (dir == NULL || *dir == 0)
+    {
+        if (BuiltinTable::get(version))
+            return string();
+        dir = DEFAULT_TABLE_DIR;
+    }
+    string pathname(dir);
+    if (pathname[pathname.size() - 1] != '/')
+        pathname += '/';
+    pathname += fname;
+    return pathname;
+}
+
 const char* Table::find(Varcode code) const
 {
     // This code is not in the tables, so we need to hardcode it
@@ -106,6 +123,9 @@ const char* Table::find(Varcode code) const
             case 5: return "YSUPL";
         }
 
+    if (builtin)
+        return builtin->find(code);
+
     Record sample(code, "");
     const_iterator i = lower_bound(begin(), end(), sample);
     if (i == end() || i->code != code)
@@ -117,6 +137,8 @@ const char* Table::find(Varcode code) const
 const Table* Table::get(int version)
 {
     static map<int, Table*> table_cache;
+    static mutex table_cache_lock;
+    lock_guard<mutex> lock(table_cache_lock);
 
     map<int, Table*>::const_iterator i = table_cache.find(version);
     if (i != table_cache.end())
@@ -22,8 +22,10 @@
 #ifndef B2NC_MNEMO_H
 #define B2NC_MNEMO_H
 
+#include "mnemo-hash.h"
 #include <wreport/varinfo.h>
 #include <vector>
+#include <string>
 
 namespace b2nc {
 namespace mnemo {
@@ -39,6 +41,44 @@ extern const char* ENV_TABLE_DIR;
  */
 extern const char* DEFAULT_TABLE_DIR;
 
+/**
+ * Mnemonic table compiled into the program by mnemo-compile, indexed with a
+ * perfect hash
+ */
+struct BuiltinTable
+{
+    int version;
+    /// Number of slots
+    unsigned size;
+    /// Number of buckets
+    unsigned buckets;
+    /// Variable code in each slot
+    const uint16_t* codes;
+    /// Mnemonic in each slot, empty for unused slots
+    const char (*names)[10];
+    /// Hash seed of each bucket
+    const uint32_t* displacements;
+
+    /// Look up the mnemonic for a code, returning NULL if not found
+    const char* find(wreport::Varcode code) const
+    {
+        uint32_t d = displacements[code_hash(code, 0) % buckets];
+        unsigned slot = code_hash(code, d) % size;
+        if (codes[slot] != code || names[slot][0] == 0)
+            return NULL;
+        return names[slot];
+    }
+
+    /// Get the compiled table for a version, or NULL if it was not compiled in
+    static const BuiltinTable* get(int version);
+};
+
+/**
+ * Checksum of the contents of all compiled tables, that changes whenever
+ * the program is built with different tables
+ */
+extern const char* BUILTIN_CHECKSUM;
+
 struct Record
 {
     wreport::Varcode code;
@@ -49,10 +89,19 @@ struct Record
     bool operator<(const Record& r) const;
 };
 
+/**
+ * Mnemonic table.
+ *
+ * The table is read from $B2NC_TABLES/mnem_NNN if the environment variable is
+ * set, otherwise the table compiled into the program is used, falling back to
+ * the installed table files for versions that have not been compiled in.
+ */
 class Table : protected std::vector<Record>
 {
 protected:
     int version;
+    /// Compiled table in use, or NULL if the table was read from a file
+    const BuiltinTable* builtin;
 
     void load();
 
@@ -62,6 +111,12 @@ public:
     const char* find(wreport::Varcode code) const;
 
     static const Table* get(int version);
+
+    /**
+     * Pathname of the file from which the given version of the table is
+     * read, or an empty string if the compiled table is used
+     */
+    static std::string pathname(int version);
 };
 
 }
@@ -0,0 +1,221 @@
+/*
+ * Copyright (C) 2026  ARPA-SIM <urpsim@smr.arpa.emr.it>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#include "msgindex.h"
+#include "convert.h"
+#include "options.h"
+#include "tests/tests.h"
+#include <wreport/bulletin.h>
+#include <wreport/error.h>
+#include <wreport/utils/sys.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+
+using namespace b2nc;
+using namespace wreport;
+using namespace wreport::tests;
+using namespace std;
+
+namespace {
+
+/// Record the offsets of the bulletins received
+struct OffsetSink : public BufrSink
+{
+    vector<off_t> offsets;
+
+    void add_bufr(std::unique_ptr<wreport::BufrBulletin>&& bulletin, const std::string&) override
+    {
+        offsets.push_back(bulletin->offset);
+    }
+};
+
+/// Copy a test file to the current directory, where its index can be written
+string copy_datafile(const string& name, const string& dest)
+{
+    sys::write_file(dest, sys::read_file(b2nc::tests::datafile(name)), 0666);
+    sys::unlink_ifexists(MessageIndex::pathname(dest));
+    return dest;
+}
+
+class Tests : public TestCase
+{
+    using TestCase::TestCase;
+
+    void register_tests() override
+    {
+        add_method("index", []() {
+            string fname = copy_datafile("bufr/cdfin_acars", "msgindex-acars.bufr");
+            Options opts;
+
+            MessageIndex index;
+            wassert_false(index.load(fname));
+            index.get(opts, fname);
+            wassert(actual(index.entries.size()) == 133u);
+            wassert_true(sys::exists(MessageIndex::pathname(fname)));
+
+            // Offsets and lengths match a sequential scan
+            OffsetSink all;
+            read_bufr(fname, all);
+            wassert(actual(all.offsets.size()) == index.entries.size());
+            size_t size = 0;
+            for (size_t i = 0; i < index.entries.size(); ++i)
+            {
+                wassert(actual(index.entries[i].offset) == all.offsets[i]);
+                wassert(actual(index.entries[i].subsets) == 1u);
+                size += index.entries[i].length;
+            }
+            wassert(actual(size) == sys::read_file(fname).size());
+
+            // The saved index loads back the same
+            MessageIndex loaded;
+            wassert_true(loaded.load(fname));
+            wassert(actual(loaded.entries.size()) == index.entries.size());
+            for (size_t i = 0; i < index.entries.size(); ++i)
+            {
+                const IndexEntry& a = index.entries[i];
+                const IndexEntry& b = loaded.entries[i];
+                wassert(actual(b.offset) == a.offset);
+                wassert(actual(b.length) == a.length);
+                wassert(actual(b.data_category) == a.data_category);
+                wassert_true(b.dds_fingerprint == a.dds_fingerprint);
+                wassert(actual(b.time) == a.time);
+            }
+
+            // Rewriting the file within the same second invalidates the index
+            auto set_mtime = [&](long nsec) {
+                struct timespec times[2] = {{1700000000, nsec}, {1700000000, nsec}};
+                if (utimensat(AT_FDCWD, fname.c_str(), times, 0) != 0)
+                    error_system::throwf("cannot set the time of %s", fname.c_str());
+            };
+            set_mtime(100);
+            index.build(fname);
+            index.save(fname);
+            wassert_true(loaded.load(fname));
+            sys::write_file(fname, sys::read_file(fname), 0666);
+            set_mtime(200);
+            wassert_false(loaded.load(fname));
+
+            // Changing the file invalidates the index
+            sys::write_file(fname, sys::read_file(fname) + "garbage", 0666);
+            wassert_false(loaded.load(fname));
+        });
+
+        add_method("select", []() {
+            string fname = copy_datafile("bufr/cdfin_acars", "msgindex-select.bufr");
+            Options opts;
+            MessageIndex index;
+            index.get(opts, fname);
+            const IndexEntry& first = index.entries[0];
+
+            IndexSelection sel;
+            wassert(actual(index.select(sel).size()) == index.entries.size());
+
+            // Select by category
+            sel.categories.push_back(to_string(first.data_category));
+            size_t by_category = index.select(sel).size();
+            wassert(actual(by_category) > 0u);
+            sel.categories[0] = "255";
+            wassert(actual(index.select(sel).size()) == 0u);
+            sel.categories.clear();
+
+            // Select by time
+            sel.time_min = sel.time_max = first.time;
+            vector<IndexEntry> by_time = index.select(sel);
+            wassert(actual(by_time.size()) > 0u);
+            for (const auto& e: by_time)
+                wassert(actual(e.time) == first.time);
+
+            // Only the selected messages are decoded
+            OffsetSink selected;
+            read_bufr(opts, fname, sel, selected);
+            wassert(actual(selected.offsets.size()) == by_time.size());
+            for (size_t i = 0; i < by_time.size(); ++i)
+                wassert(actual(selected.offsets[i]) == by_time[i].offset);
+        });
+
+        add_method("keys", []() {
+            string fname = copy_datafile("bufr/cdfin_acars", "msgindex-keys.bufr");
+            Options opts;
+            MessageIndex index;
+            index.get(opts, fname);
+
+            // Keys survive a round trip through their string form
+            vector<IndexKey> keys = index.keys();
+            wassert(actual(keys.size()) > 0u);
+            for (const auto& k: keys)
+            {
+                IndexKey parsed;
+                wassert_true(IndexKey::parse(k.to_string(), parsed));
+                wassert_true(parsed == k);
+            }
+            IndexKey parsed;
+            wassert_false(IndexKey::parse("", parsed));
+            wassert_false(IndexKey::parse("0-4-0:13", parsed));
+            wassert_false(IndexKey::parse("0-4-0:13:a1b2c3d4e5f60718x", parsed));
+
+            // Selecting each key in turn gives all messages once
+            IndexSelection sel;
+            size_t total = 0;
+            for (const auto& k: keys)
+            {
+                sel.keys.assign(1, k);
+                vector<IndexEntry> selected = index.select(sel);
+                wassert(actual(selected.size()) > 0u);
+                for (const auto& e: selected)
+                    wassert_true(IndexKey(e) == k);
+                total += selected.size();
+            }
+            wassert(actual(total) == index.entries.size());
+
+            // Keys combine with the other criteria
+            sel.keys.assign(1, keys[0]);
+            sel.categories.push_back("255");
+            wassert(actual(index.select(sel).size()) == 0u);
+
+            IndexKey other = keys[0];
+            other.dds_fingerprint ^= 1;
+            sel.keys.assign(1, other);
+            sel.categories.clear();
+            wassert(actual(index.select(sel).size()) == 0u);
+        });
+
+        add_method("shards", []() {
+            string fname = copy_datafile("bufr/cdfin_acars", "msgindex-shards.bufr");
+            Options opts;
+            MessageIndex index;
+            index.get(opts, fname);
+
+            // Shards are contiguous and cover all the messages in order
+            IndexSelection sel;
+            sel.shards = 4;
+            vector<off_t> offsets;
+            for (sel.shard = 0; sel.shard < sel.shards; ++sel.shard)
+            {
+                OffsetSink shard;
+                read_bufr(opts, fname, sel, shard);
+                wassert(actual(shard.offsets.size()) >= 133u / 4);
+                wassert(actual(shard.offsets.size()) <= 133u / 4 + 1);
+                offsets.insert(offsets.end(), shard.offsets.begin(), shard.offsets.end());
+            }
+            wassert(actual(offsets.size()) == index.entries.size());
+            for (size_t i = 0; i < offsets.size(); ++i)
+                wassert(actual(offsets[i]) == index.entries[i].offset);
+        });
+    }
+} test("msgindex");
+
+}
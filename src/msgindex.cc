@@ -0,0 +1,401 @@
+/*
+ * msgindex - Index of the messages in a BUFR file
+ *
+ * Copyright (C) 2026  ARPA-SIM <urpsim@smr.arpa.emr.it>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#include "msgindex.h"
+#include "convert.h"
+#include "input.h"
+#include "archive.h"
+#include "options.h"
+#include "instruments.h"
+#include "stats.h"
+#include "trace.h"
+#include <wreport/bulletin.h>
+#include <wreport/error.h>
+#include <wreport/utils/sys.h>
+#include <algorithm>
+#include <memory>
+#include <set>
+#include <sstream>
+#include <cstring>
+
+using namespace wreport;
+using namespace std;
+
+namespace b2nc {
+
+namespace {
+
+const char* index_header = "bufr2netcdf index 2";
+
+/**
+ * Identify the current contents of a file by its size and modification time.
+ *
+ * The time has nanoseconds, so that a file rewritten within the same second
+ * as its index was built does not keep a stale index.
+ */
+std::string file_stamp(const std::string& fname)
+{
+    std::unique_ptr<struct stat> st = sys::stat(fname);
+    if (!st)
+        error_system::throwf("cannot stat %s", fname.c_str());
+    char buf[64];
+    snprintf(buf, 64, "%lld %lld.%09ld", (long long)st->st_size,
+            (long long)st->st_mtim.tv_sec, (long)st->st_mtim.tv_nsec);
+    return buf;
+}
+
+}
+
+unsigned bufr_subset_count(const std::string& raw, const wreport::BufrBulletin& header)
+{
+    auto fail = [&](const char* what) {
+        error_consistency::throwf("%s:%zd: %s", header.fname.c_str(), (size_t)header.offset, what);
+    };
+    auto u8 = [&](size_t pos) { return (unsigned)(unsigned char)raw[pos]; };
+    auto u24 = [&](size_t pos) { return (u8(pos) << 16) | (u8(pos + 1) << 8) | u8(pos + 2); };
+
+    if (raw.size() < 8)
+        fail("message is too short to contain section 0");
+
+    // Section 0 is 8 bytes long since edition 2
+    size_t sec1 = header.edition_number >= 2 ? 8 : 4;
+    if (sec1 + 10 > raw.size())
+        fail("section 1 is truncated");
+
+    // The flag of the presence of section 2 moved in edition 4
+    unsigned flags = u8(sec1 + (header.edition_number >= 4 ? 9 : 7));
+    size_t sec3 = sec1 + u24(sec1);
+    if (flags & 0x80)
+    {
+        if (sec3 + 3 > raw.size())
+            fail("section 2 is truncated");
+        sec3 += u24(sec3);
+    }
+
+    // Section 3 starts with its length (3 bytes), a reserved byte and the
+    // number of subsets (2 bytes)
+    if (sec3 + 6 > raw.size())
+        fail("section 3 is truncated");
+    return (u8(sec3 + 4) << 8) | u8(sec3 + 5);
+}
+
+long long bufr_time(const wreport::BufrBulletin& header)
+{
+    return header.rep_year * 10000000000LL + header.rep_month * 100000000LL
+         + header.rep_day * 1000000LL + header.rep_hour * 10000LL
+         + header.rep_minute * 100LL + header.rep_second;
+}
+
+uint64_t bufr_dds_fingerprint(const wreport::BufrBulletin& header)
+{
+    // 64 bit FNV-1a hash of the descriptors
+    uint64_t hash = 0xcbf29ce484222325ULL;
+    for (Varcode code: header.datadesc)
+    {
+        hash ^= code;
+        hash *= 0x100000001b3ULL;
+    }
+    return hash;
+}
+
+void IndexEntry::set(const std::string& raw, const wreport::BufrBulletin& header, off_t offset)
+{
+    this->offset = offset;
+    length = raw.size();
+    edition = header.edition_number;
+    data_category = header.data_category;
+    data_subcategory = header.data_subcategory;
+    data_subcategory_local = header.data_subcategory_local;
+    master_table_version_number = header.master_table_version_number;
+    master_table_version_number_local = header.master_table_version_number_local;
+    dds_fingerprint = bufr_dds_fingerprint(header);
+    subsets = bufr_subset_count(raw, header);
+    time = bufr_time(header);
+}
+
+IndexKey::IndexKey(const IndexEntry& entry)
+    : data_category(entry.data_category),
+      data_subcategory(entry.data_subcategory),
+      data_subcategory_local(entry.data_subcategory_local),
+      master_table_version_number(entry.master_table_version_number),
+      dds_fingerprint(entry.dds_fingerprint)
+{
+}
+
+IndexKey::IndexKey(const wreport::BufrBulletin& header)
+    : data_category(header.data_category),
+      data_subcategory(header.data_subcategory),
+      data_subcategory_local(header.data_subcategory_local),
+      master_table_version_number(header.master_table_version_number),
+      dds_fingerprint(bufr_dds_fingerprint(header))
+{
+}
+
+bool IndexKey::operator==(const IndexKey& o) const
+{
+    return data_category == o.data_category
+        && data_subcategory == o.data_subcategory
+        && data_subcategory_local == o.data_subcategory_local
+        && master_table_version_number == o.master_table_version_number
+        && dds_fingerprint == o.dds_fingerprint;
+}
+
+std::string IndexKey::to_string() const
+{
+    char buf[80];
+    snprintf(buf, 80, "%d-%d-%d:%d:%016llx",
+            data_category, data_subcategory, data_subcategory_local,
+            master_table_version_number, (unsigned long long)dds_fingerprint);
+    return buf;
+}
+
+bool IndexKey::parse(const std::string& str, IndexKey& out)
+{
+    IndexKey res;
+    unsigned long long fingerprint;
+    int end = 0;
+    if (sscanf(str.c_str(), "%d-%d-%d:%d:%16llx%n",
+                &res.data_category, &res.data_subcategory, &res.data_subcategory_local,
+                &res.master_table_version_number, &fingerprint, &end) != 5)
+        return false;
+    if ((size_t)end != str.size())
+        return false;
+    res.dds_fingerprint = fingerprint;
+    out = res;
+    return true;
+}
+
+bool IndexSelection::matches(const IndexEntry& entry) const
+{
+    if (entry.time < time_min || entry.time > time_max)
+        return false;
+    if (!keys.empty() && std::find(keys.begin(), keys.end(), IndexKey(entry)) == keys.end())
+        return false;
+    if (categories.empty())
+        return true;
+
+    char buf[3][32];
+    snprintf(buf[0], 32, "%d", entry.data_category);
+    snprintf(buf[1], 32, "%d-%d", entry.data_category, entry.data_subcategory);
+    snprintf(buf[2], 32, "%d-%d-%d", entry.data_category, entry.data_subcategory, entry.data_subcategory_local);
+    for (const auto& c: categories)
+    {
+        // Compare with the entry categories up to the same level of detail
+        unsigned level = 0;
+        for (char ch: c)
+            if (ch == '-') ++level;
+        if (level < 3 && c == buf[level])
+            return true;
+    }
+    return false;
+}
+
+bool IndexSelection::in_shard(size_t pos, size_t count) const
+{
+    if (shards <= 1)
+        return true;
+    return pos * shards / count == shard;
+}
+
+std::string MessageIndex::pathname(const std::string& fname)
+{
+    return fname + ".b2nc.idx";
+}
+
+void MessageIndex::build(const std::string& fname)
+{
+    entries.clear();
+    stamp = file_stamp(fname);
+
+    InputFile in(fname);
+    if (detect_archive(in.head(archive_head_size)) != ArchiveFormat::NONE)
+        error_unimplemented::throwf("%s: archives cannot be indexed", fname.c_str());
+    try {
+        string rawmsg;
+        off_t offset;
+        while (BufrBulletin::read(in.file(), rawmsg, fname.c_str(), &offset))
+        {
+            unique_ptr<BufrBulletin> header = BufrBulletin::decode_header(rawmsg, fname.c_str(), offset);
+            entries.emplace_back();
+            entries.back().set(rawmsg, *header, offset);
+        }
+    } catch (...) {
+        in.close();
+        throw;
+    }
+    in.close();
+}
+
+bool MessageIndex::load(const std::string& fname)
+{
+    entries.clear();
+    stamp.clear();
+
+    string idxname = pathname(fname);
+    if (!sys::exists(idxname))
+        return false;
+
+    string cur_stamp = file_stamp(fname);
+    istringstream in(sys::read_file(idxname));
+    string line;
+    if (!getline(in, line) || line != index_header)
+        return false;
+    if (!getline(in, line) || line != cur_stamp)
+        return false;
+
+    while (getline(in, line))
+    {
+        IndexEntry e;
+        long long offset;
+        unsigned long long fingerprint;
+        if (sscanf(line.c_str(), "%lld %zu %d %d %d %d %d %d %llx %u %lld",
+                    &offset, &e.length, &e.edition,
+                    &e.data_category, &e.data_subcategory, &e.data_subcategory_local,
+                    &e.master_table_version_number, &e.master_table_version_number_local,
+                    &fingerprint, &e.subsets, &e.time) != 11)
+        {
+            entries.clear();
+            return false;
+        }
+        e.offset = offset;
+        e.dds_fingerprint = fingerprint;
+        entries.push_back(e);
+    }
+
+    stamp = cur_stamp;
+    return true;
+}
+
+void MessageIndex::save(const std::string& fname) const
+{
+    string out = index_header;
+    out += '\n';
+    out += stamp;
+    out += '\n';
+    char buf[256];
+    for (const auto& e: entries)
+    {
+        snprintf(buf, 256, "%lld %zu %d %d %d %d %d %d %016llx %u %lld\n",
+                (long long)e.offset, e.length, e.edition,
+                e.data_category, e.data_subcategory, e.data_subcategory_local,
+                e.master_table_version_number, e.master_table_version_number_local,
+                (unsigned long long)e.dds_fingerprint, e.subsets, e.time);
+        out += buf;
+    }
+    sys::write_file_atomically(pathname(fname), out, 0666);
+}
+
+void MessageIndex::get(const Options& opts, const std::string& fname)
+{
+    if (load(fname))
+        return;
+
+    if (opts.verbose) fprintf(stderr, "Indexing %s\n", fname.c_str());
+    build(fname);
+
+    try {
+        save(fname);
+    } catch (std::exception& e) {
+        if (opts.verbose)
+            fprintf(stderr, "cannot store index of %s: %s\n", fname.c_str(), e.what());
+    }
+}
+
+std::vector<IndexEntry> MessageIndex::select(const IndexSelection& sel) const
+{
+    vector<IndexEntry> res;
+    for (const auto& e: entries)
+        if (sel.matches(e))
+            res.push_back(e);
+
+    if (sel.shards <= 1)
+        return res;
+
+    // Shard after filtering, so that shards have similar sizes
+    vector<IndexEntry> shard;
+    for (size_t i = 0; i < res.size(); ++i)
+        if (sel.in_shard(i, res.size()))
+            shard.push_back(res[i]);
+    return shard;
+}
+
+std::vector<IndexKey> MessageIndex::keys() const
+{
+    vector<IndexKey> res;
+    for (const auto& e: entries)
+    {
+        IndexKey key(e);
+        if (std::find(res.begin(), res.end(), key) == res.end())
+            res.push_back(key);
+    }
+    return res;
+}
+
+void read_bufr(const Options& opts, const std::string& fname, const IndexSelection& sel, BufrSink& out)
+{
+    MessageIndex index;
+    index.get(opts, fname);
+    vector<IndexEntry> selected = index.select(sel);
+
+    InputFile in(fname, opts.jobs);
+    try {
+        string rawmsg;
+        if (in.compression() != Compression::NONE)
+        {
+            // Compressed data cannot be seeked: read it all, decoding only
+            // the selected messages
+            set<off_t> wanted;
+            for (const auto& e: selected)
+                wanted.insert(e.offset);
+            off_t offset;
+            while (!wanted.empty())
+            {
+                {
+                    PhaseTimer timer(instruments(opts).stats, Phase::READ);
+                    TraceSpan span(instruments(opts).trace, "read", fname);
+                    if (!BufrBulletin::read(in.file(), rawmsg, fname.c_str(), &offset))
+                        break;
+                }
+                if (wanted.erase(offset))
+                    decode_bufr(opts, rawmsg, out, fname.c_str(), offset);
+            }
+        } else {
+            for (const auto& e: selected)
+            {
+                {
+                    PhaseTimer timer(instruments(opts).stats, Phase::READ);
+                    TraceSpan span(instruments(opts).trace, "read", fname.c_str(), e.offset);
+                    if (fseeko(in.file(), e.offset, SEEK_SET) != 0)
+                        error_system::throwf("cannot seek to offset %lld in %s", (long long)e.offset, fname.c_str());
+                    rawmsg.resize(e.length);
+                    if (fread(&rawmsg[0], 1, e.length, in.file()) != e.length)
+                        error_consistency::throwf("%s:%lld: message is truncated, the index may be out of date",
+                                fname.c_str(), (long long)e.offset);
+                }
+                decode_bufr(opts, rawmsg, out, fname.c_str(), e.offset);
+            }
+        }
+    } catch (...) {
+        in.close();
+        throw;
+    }
+    in.close();
+}
+
+}
@@ -0,0 +1,195 @@
+/*
+ * msgindex - Index of the messages in a BUFR file
+ *
+ * Copyright (C) 2026  ARPA-SIM <urpsim@smr.arpa.emr.it>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#ifndef B2NC_MSGINDEX_H
+#define B2NC_MSGINDEX_H
+
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <cstdio>
+#include <sys/types.h>
+
+namespace wreport {
+struct BufrBulletin;
+}
+
+namespace b2nc {
+
+struct Options;
+struct BufrSink;
+
+/// Return the number of subsets of an encoded message, read from section 3
+unsigned bufr_subset_count(const std::string& raw, const wreport::BufrBulletin& header);
+
+/// Return the section 1 time of a bulletin as YYYYMMDDHHMMSS
+long long bufr_time(const wreport::BufrBulletin& header);
+
+/// Fingerprint of the Data Description Section of a bulletin
+uint64_t bufr_dds_fingerprint(const wreport::BufrBulletin& header);
+
+/// Position and header information of one message
+struct IndexEntry
+{
+    /// Position of the message, in the decompressed data for compressed files
+    off_t offset = 0;
+    size_t length = 0;
+    int edition = 0;
+    int data_category = 0;
+    int data_subcategory = 0;
+    int data_subcategory_local = 0;
+    int master_table_version_number = 0;
+    int master_table_version_number_local = 0;
+    /// See bufr_dds_fingerprint()
+    uint64_t dds_fingerprint = 0;
+    unsigned subsets = 0;
+    /// Section 1 time as YYYYMMDDHHMMSS
+    long long time = 0;
+
+    /// Fill from a message and its header decoded with decode_header
+    void set(const std::string& raw, const wreport::BufrBulletin& header, off_t offset);
+};
+
+/**
+ * Dispatch key of a message: the messages with the same key go to the same
+ * output (see Dispatcher::Key), with the DDS identified by its fingerprint.
+ *
+ * As a string it is written as CAT-SUB-LOCAL:TABLE:FINGERPRINT, with the
+ * master table version number and the fingerprint in hexadecimal, as in
+ * "0-4-0:13:a1b2c3d4e5f60718".
+ */
+struct IndexKey
+{
+    int data_category = 0;
+    int data_subcategory = 0;
+    int data_subcategory_local = 0;
+    int master_table_version_number = 0;
+    uint64_t dds_fingerprint = 0;
+
+    IndexKey() = default;
+    explicit IndexKey(const IndexEntry& entry);
+    explicit IndexKey(const wreport::BufrBulletin& header);
+
+    bool operator==(const IndexKey& o) const;
+    bool operator!=(const IndexKey& o) const { return !operator==(o); }
+
+    /// Format as CAT-SUB-LOCAL:TABLE:FINGERPRINT
+    std::string to_string() const;
+
+    /**
+     * Parse a string written by to_string().
+     *
+     * Returns false if \a str is not a valid key.
+     */
+    static bool parse(const std::string& str, IndexKey& out);
+};
+
+/**
+ * Choice of the messages to read from an indexed file
+ */
+struct IndexSelection
+{
+    /**
+     * Categories to read, as "category", "category-subcategory" or
+     * "category-subcategory-localsubcategory". If empty, read all.
+     */
+    std::vector<std::string> categories;
+    /// Dispatch keys to read. If empty, read all.
+    std::vector<IndexKey> keys;
+    /// Earliest section 1 time to read, as YYYYMMDDHHMMSS
+    long long time_min = 0;
+    /// Latest section 1 time to read, as YYYYMMDDHHMMSS
+    long long time_max = 99999999999999LL;
+    /**
+     * Read only the messages of shard number \a shard out of \a shards.
+     *
+     * Messages are split in \a shards contiguous ranges of about the same
+     * number of messages, so that concatenating the outputs of all shards
+     * in order gives the records in the same order as reading the whole
+     * file.
+     */
+    unsigned shard = 0;
+    unsigned shards = 1;
+
+    /// Check if a message matches the categories, the keys and the time range
+    bool matches(const IndexEntry& entry) const;
+
+    /// Check if the \a pos-th of \a count matching messages is in the shard
+    bool in_shard(size_t pos, size_t count) const;
+};
+
+/**
+ * Index of the messages of a BUFR file.
+ *
+ * Indices are stored as sidecar files next to the file they describe, and
+ * are ignored if the size or the modification time, with nanoseconds, of
+ * the file changed.
+ */
+class MessageIndex
+{
+protected:
+    /// Size and modification time in nanoseconds of the indexed file
+    std::string stamp;
+
+public:
+    std::vector<IndexEntry> entries;
+
+    /// Pathname of the sidecar index file for \a fname
+    static std::string pathname(const std::string& fname);
+
+    /// Scan \a fname to build its index
+    void build(const std::string& fname);
+
+    /**
+     * Load the sidecar index of \a fname.
+     *
+     * Returns false if there is none, or if it is not valid for the current
+     * contents of \a fname.
+     */
+    bool load(const std::string& fname);
+
+    /// Write the sidecar index of \a fname
+    void save(const std::string& fname) const;
+
+    /**
+     * Load the index of \a fname, or build it and try to save it.
+     *
+     * Failures to save the index are only reported in verbose mode.
+     */
+    void get(const Options& opts, const std::string& fname);
+
+    /// Return the entries chosen by \a sel, in file order
+    std::vector<IndexEntry> select(const IndexSelection& sel) const;
+
+    /// Return the dispatch keys of the entries, in order of first appearance
+    std::vector<IndexKey> keys() const;
+};
+
+/**
+ * Send the messages of \a fname chosen by \a sel to \a out, using the
+ * sidecar index to seek directly to them. The index is created if missing.
+ *
+ * Compressed files cannot be seeked, and are read through, decoding only
+ * the chosen messages.
+ */
+void read_bufr(const Options& opts, const std::string& fname, const IndexSelection& sel, BufrSink& out);
+
+}
+
+#endif
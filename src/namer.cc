@@ -40,6 +40,9 @@ const char* Namer::DEFAULT_TABLE_DIR = "/usr/share/bufr2netcdf";
 
 namespace {
 
+/// Version of the mnemonic table used to name variables
+const int MNEMO_TABLE_VERSION = 14;
+
 static const char* type_names[] = {
     "Data",
     "QBits",
@@ -121,7 +124,7 @@ public:
     PlainNamer()
     {
         // TODO: choose after first BUFR in the bunch?
-        table = mnemo::Table::get(14);
+        table = mnemo::Table::get(MNEMO_TABLE_VERSION);
     }
 
     unsigned name(DataType type, Varcode code, size_t tag, std::string& name, std::string& mnemo) override
@@ -196,4 +199,9 @@ unique_ptr<Namer> Namer::get(const Options& opts)
         return unique_ptr<Namer>(new PlainNamer);
 }
 
+std::string Namer::table_pathname()
+{
+    return mnemo::Table::pathname(MNEMO_TABLE_VERSION);
+}
+
 }
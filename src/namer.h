@@ -74,6 +74,12 @@ struct Namer
      */
     static std::unique_ptr<Namer> get(const Options& opts);
 
+    /**
+     * Pathname of the mnemonic table file used by the namers, or an empty
+     * string if they use the table compiled into the program
+     */
+    static std::string table_pathname();
+
     /**
      * Get the string name for a type
      */
@@ -65,6 +65,32 @@ class Tests : public TestCase
 
             wassert(actual(sys::exists(testfname)).istrue());
         });
+
+        add_method("nofill", []() {
+            // Test that files are written without prefilling variables
+            Options opts;
+            NCOutfile out(opts);
+
+            out.open(testfname);
+            out.end_define_mode();
+
+            int old_mode;
+            int res = nc_set_fill(out.ncid, NC_NOFILL, &old_mode);
+            error_netcdf::throwf_iferror(res, "setting fill mode for %s", testfname);
+            wassert(actual(old_mode) == NC_NOFILL);
+
+            out.close();
+        });
+
+        add_method("records_to_write", []() {
+            Options opts;
+            NCOutfile out(opts);
+
+            wassert(actual(out.records_to_write(3)) == 3u);
+            out.record_count = 5;
+            wassert(actual(out.records_to_write(3)) == 5u);
+            wassert(actual(out.records_to_write(7)) == 7u);
+        });
     }
 } tests("ncoutfile");
 
@@ -20,33 +20,64 @@
  */
 
 #include "ncoutfile.h"
+#include "options.h"
+#include "instruments.h"
+#include "valarray.h"
 #include "utils.h"
 #include <cstdio>
+#include <cstdlib>
 
 using namespace wreport;
 using namespace std;
 
 namespace b2nc {
 
-NCOutfile::NCOutfile(const Options&)
-    : ncid(-1), dim_bufr_records(-1) {}
+NCOutfile::NCOutfile(const Options& opts)
+    : ncid(-1), dim_bufr_records(-1), record_count(0),
+      header_pad(opts.nc_header_pad), var_align(opts.nc_var_align),
+      trace(instruments(opts).trace) {}
 
 NCOutfile::~NCOutfile()
 {
     close();
 }
 
+namespace {
+
+/// Initialise the parts common to all output files
+void init_file(int ncid, const std::string& fname, int& dim_bufr_records)
+{
+    // All variables are written in full by their putvar methods, so there is
+    // no need to have the library prefill them with fill values first
+    int old_fill_mode;
+    int res = nc_set_fill(ncid, NC_NOFILL, &old_fill_mode);
+    error_netcdf::throwf_iferror(res, "setting NC_NOFILL mode for file %s", fname.c_str());
+
+    // Define BUFR_records dimension, which is always present and UNLIMITED
+    res = nc_def_dim(ncid, "BUFR_records", NC_UNLIMITED, &dim_bufr_records);
+    error_netcdf::throwf_iferror(res, "creating BUFR_records dimension for file %s", fname.c_str());
+}
+
+}
+
 void NCOutfile::open(const std::string& fname)
 {
     // Create output file
     this->fname = fname;
+    in_memory = false;
     int res = nc_create(fname.c_str(), NC_CLOBBER, &ncid);
     error_netcdf::throwf_iferror(res, "creating file %s", fname.c_str());
+    init_file(ncid, fname, dim_bufr_records);
+}
 
-    // Define BUFR_records dimension, which is always present and UNLIMITED
-    res = nc_def_dim(ncid, "BUFR_records", NC_UNLIMITED, &dim_bufr_records);
-    error_netcdf::throwf_iferror(res, "creating BUFR_records dimension for file %s", fname.c_str());
-
+void NCOutfile::open_memory(const std::string& name)
+{
+    fname = name;
+    in_memory = true;
+    image.clear();
+    int res = nc_create_mem(name.c_str(), NC_CLOBBER, header_pad + 4096, &ncid);
+    error_netcdf::throwf_iferror(res, "creating in-memory file %s", name.c_str());
+    init_file(ncid, fname, dim_bufr_records);
 }
 
 void NCOutfile::close()
@@ -54,6 +85,17 @@ void NCOutfile::close()
     if (ncid == -1)
         return;
 
+    if (in_memory)
+    {
+        NC_memio memio;
+        int res = nc_close_memio(ncid, &memio);
+        ncid = -1;
+        error_netcdf::throwf_iferror(res, "closing in-memory file %s", fname.c_str());
+        image.assign((const char*)memio.memory, memio.size);
+        free(memio.memory);
+        return;
+    }
+
     // Close file
     int res = nc_close(ncid);
     error_netcdf::throwf_iferror(res, "closing file %s", fname.c_str());
@@ -62,7 +104,7 @@ void NCOutfile::close()
 
 void NCOutfile::end_define_mode()
 {
-    int res = nc_enddef(ncid);
+    int res = nc__enddef(ncid, header_pad, var_align, 0, 4);
     error_netcdf::throwf_iferror(res, "leaving define mode for file %s", fname.c_str());
 }
 
@@ -74,4 +116,31 @@ int NCOutfile::def_var(const char* name, nc_type xtype, int ndims, const int *di
     return varid;
 }
 
+void NCOutfile::put_attributes(int varid, const std::string& varname, const std::vector<Attribute>& attrs)
+{
+    for (const auto& attr: attrs)
+    {
+        int res = NC_NOERR;
+        switch (attr.type)
+        {
+            case VT_INT:
+                res = nc_put_att_int(ncid, varid, attr.name.c_str(), NC_INT, attr.ints.size(), attr.ints.data());
+                break;
+            case VT_FLOAT: {
+                vector<float> values(attr.reals.begin(), attr.reals.end());
+                res = nc_put_att_float(ncid, varid, attr.name.c_str(), NC_FLOAT, values.size(), values.data());
+                break;
+            }
+            case VT_DOUBLE:
+                res = nc_put_att_double(ncid, varid, attr.name.c_str(), NC_DOUBLE, attr.reals.size(), attr.reals.data());
+                break;
+            case VT_STRING:
+            case VT_BYTES:
+                res = nc_put_att_text(ncid, varid, attr.name.c_str(), attr.text.size(), attr.text.data());
+                break;
+        }
+        error_netcdf::throwf_iferror(res, "setting %s attribute for %s", attr.name.c_str(), varname.c_str());
+    }
+}
+
 }
@@ -23,6 +23,7 @@
 #define B2NC_NCOUTFILE_H
 
 #include <string>
+#include <vector>
 #include <netcdf.h>
 
 namespace wreport {
@@ -32,6 +33,8 @@ struct BufrBulletin;
 namespace b2nc {
 
 struct Options;
+struct Attribute;
+class Trace;
 
 /**
  * One output NetCDF file
@@ -43,12 +46,45 @@ public:
     int ncid;
     int dim_bufr_records;
 
+    /**
+     * Number of BUFR records that will be written to the file.
+     *
+     * The file is written in NC_NOFILL mode, so putvar implementations need
+     * to explicitly write all the elements up to this number of records,
+     * padding their data with fill values if they hold fewer records.
+     */
+    size_t record_count;
+
+    /// Free space to reserve at the end of the header when leaving define mode
+    size_t header_pad;
+    /// Alignment of the start of the data section when leaving define mode
+    size_t var_align;
+
+    /// If set, record the definition and writing of each variable
+    Trace* trace;
+
+    /// True if the file is being written in memory by open_memory()
+    bool in_memory = false;
+    /// Contents of the file created by open_memory(), filled by close()
+    std::string image;
+
     NCOutfile(const Options& opts);
     ~NCOutfile();
 
     // Open the NetCDF file for writing, and initialise common parts
     void open(const std::string& fname);
 
+    /**
+     * Create the NetCDF file in memory instead of on disk, and initialise
+     * common parts.
+     *
+     * After close(), the file contents are found in image.
+     *
+     * @param name
+     *   Name used for the file in error messages
+     */
+    void open_memory(const std::string& name);
+
     /**
      * Finalise and close the file
      *
@@ -58,14 +94,33 @@ public:
     void close();
 
     /**
-     * End NetCDF define mode
+     * End NetCDF define mode, reserving header_pad bytes of free space at the
+     * end of the header so that later metadata changes do not need to move
+     * the data section
      */
     void end_define_mode();
 
+    /**
+     * Return the number of records to write for an array holding \a size
+     * records
+     */
+    size_t records_to_write(size_t size) const
+    {
+        return size > record_count ? size : record_count;
+    }
+
     /**
      * Wrapper around nc_def_var
      */
     int def_var(const char* name, nc_type xtype, int ndims, const int *dimidsp);
+
+    /**
+     * Set the given attributes on a variable
+     *
+     * @param varname
+     *   The variable name, used in error messages
+     */
+    void put_attributes(int varid, const std::string& varname, const std::vector<Attribute>& attrs);
 };
 
 }
@@ -0,0 +1,70 @@
+/*
+ * Copyright (C) 2026  ARPA-SIM <urpsim@smr.arpa.emr.it>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#include "npy.h"
+#include "convert.h"
+#include "options.h"
+#include "tests/tests.h"
+#include <wreport/utils/sys.h>
+
+using namespace b2nc;
+using namespace wreport;
+using namespace wreport::tests;
+using namespace std;
+
+namespace {
+
+static const char* testdir = "test-npy.npy.d";
+
+class Tests : public TestCase
+{
+    using TestCase::TestCase;
+
+    void register_tests() override
+    {
+        add_method("encode", []() {
+            string npy = npy_encode("<i4", { 2 }, string(8, 0));
+            wassert(actual(npy.substr(0, 8)) == string("\x93NUMPY\x01\x00", 8));
+            wassert(actual(npy.size()) == 128u + 8u);
+            wassert(actual(npy).contains("{'descr': '<i4', 'fortran_order': False, 'shape': (2, ), }"));
+            wassert(actual(npy[127]) == '\n');
+        });
+
+        add_method("temp", []() {
+            Options opts;
+            opts.format = "npy";
+            unique_ptr<Outfile> outfile = Outfile::get(opts);
+            outfile->open(testdir);
+            read_bufr(b2nc::tests::datafile("bufr/cdfin_temp"), *outfile);
+            outfile->close();
+
+            string manifest = sys::read_file(string(testdir) + "/manifest.json");
+            wassert(actual(manifest).contains("\"name\":\"edition_number\""));
+            wassert(actual(manifest).contains("\"offsets\":\"MPN.offsets.npy\""));
+            // Replicated values are described as they are stored: flat, with offsets
+            wassert(actual(manifest).contains("\"layout\":\"ragged\""));
+            wassert(actual(manifest).contains("\"layout\":\"dense\",\"dimensions\":[\"BUFR_records\"]"));
+            wassert(actual(manifest).contains("\"dimensions\":[\"values\"]"));
+            wassert(actual(manifest).contains("\"mnemonic\":\"MPN\""));
+            wassert(actual_file(string(testdir) + "/edition_number.npy").exists());
+            wassert(actual_file(string(testdir) + "/MPN.npy").exists());
+            wassert(actual_file(string(testdir) + "/MPN.offsets.npy").exists());
+        });
+    }
+} tests("npy");
+
+}
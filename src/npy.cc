@@ -0,0 +1,295 @@
+/*
+ * npy - Write converted data as a directory of numpy arrays
+ *
+ * Copyright (C) 2026  ARPA-SIM <urpsim@smr.arpa.emr.it>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#include "npy.h"
+#include "columnio.h"
+#include "convert.h"
+#include "arrays.h"
+#include "options.h"
+#include "instruments.h"
+#include "json.h"
+#include "stats.h"
+#include "threads.h"
+#include "trace.h"
+#include <wreport/error.h>
+#include <wreport/bulletin.h>
+#include <wreport/utils/sys.h>
+#include <netcdf.h>
+#include <cstdint>
+#include <cstring>
+
+using namespace wreport;
+using namespace std;
+
+namespace b2nc {
+
+std::string npy_encode(const std::string& dtype, const std::vector<size_t>& shape, const std::string& data)
+{
+    string header = "{'descr': '" + dtype + "', 'fortran_order': False, 'shape': (";
+    for (size_t s: shape)
+        header += to_string(s) + ", ";
+    header += "), }";
+
+    // Pad with spaces and a final newline, so that data starts at a multiple
+    // of 64 bytes
+    size_t total = 10 + header.size() + 1;
+    if (total % 64)
+        header.append(64 - total % 64, ' ');
+    header += '\n';
+    if (header.size() > 65535)
+        error_consistency::throwf("npy header too long (%zu bytes)", header.size());
+
+    string res("\x93NUMPY\x01\x00", 8);
+    res += (char)(header.size() & 0xff);
+    res += (char)(header.size() >> 8);
+    res += header;
+    res += data;
+    return res;
+}
+
+namespace {
+
+template<typename T>
+void append_raw(std::string& out, const T& val)
+{
+    out.append((const char*)&val, sizeof(T));
+}
+
+/**
+ * Write an output file as a directory of .npy files.
+ *
+ * Data is accumulated by an NCFiller, and everything is written on close().
+ */
+struct NpyOutfile : public Outfile
+{
+    const Options& opts;
+    NCFiller filler;
+    std::string dirname;
+
+    explicit NpyOutfile(const Options& opts)
+        : opts(opts), filler(opts)
+    {
+    }
+
+    ~NpyOutfile()
+    {
+        close();
+    }
+
+    void open(const std::string& fname) override
+    {
+        dirname = fname;
+        sys::rmtree_ifexists(dirname);
+        sys::makedirs(dirname);
+    }
+
+    void close() override
+    {
+        if (dirname.empty())
+            return;
+        // Do not try to write things out again in the destructor in case of
+        // errors
+        std::string dir = dirname;
+        dirname.clear();
+        write(dir);
+    }
+
+    void add_bufr(std::unique_ptr<wreport::BufrBulletin>&& bulletin, const std::string& raw) override
+    {
+        filler.add(move(bulletin), raw);
+    }
+
+    void set_stats(KeyStats* stats) override
+    {
+        filler.set_stats(stats);
+    }
+
+    void memory_usage(MemoryUsage& out) const override
+    {
+        filler.memory_usage(out);
+    }
+
+    void sparsity(OutputSparsity& out) const override
+    {
+        filler.sparsity(out);
+    }
+
+    /**
+     * Encode values [begin, end) of \a data, with \a size values per
+     * record, padding records with fill values
+     */
+    static void encode_values(const Column& col, const ColumnData& data, size_t begin, size_t end, size_t size, std::string& out)
+    {
+        for (size_t i = begin; i < begin + size; ++i)
+        {
+            bool present = i < end;
+            switch (col.type)
+            {
+                case VT_INT: append_raw(out, present ? data.ints[i] : NC_FILL_INT); break;
+                case VT_FLOAT: append_raw(out, present ? data.floats[i] : NC_FILL_FLOAT); break;
+                case VT_DOUBLE: append_raw(out, present ? data.doubles[i] : NC_FILL_DOUBLE); break;
+                case VT_STRING: {
+                    // NUL padded, and missing values are all NULs
+                    size_t len = present ? min(data.strings[i].size(), col.strlen) : 0;
+                    if (len) out.append(data.strings[i].data(), len);
+                    out.append(col.strlen - len, 0);
+                    break;
+                }
+                case VT_BYTES: {
+                    // Fill padded like in NetCDF
+                    size_t len = present ? min(data.strings[i].size(), col.strlen) : 0;
+                    if (len) out.append(data.strings[i].data(), len);
+                    out.append(col.strlen - len, (char)NC_FILL_BYTE);
+                    break;
+                }
+            }
+        }
+    }
+
+    /// Write a .npy file of a column, counting its size in the statistics
+    void write_npy(const std::string& fname, const Column& col, const std::string& encoded) const
+    {
+        sys::write_file(fname, encoded);
+        if (filler.stats)
+            filler.stats->add_variable_bytes(col.name, encoded.size());
+    }
+
+    /// Write the .npy files of a column, returning the shape of its values
+    std::vector<size_t> write_column(const std::string& dir, const Column& col, size_t records) const
+    {
+        ColumnData data;
+        col.collect(0, records, data);
+
+        string values;
+        if (col.loop_dim.empty())
+        {
+            // One value per record
+            for (size_t r = 0; r < records; ++r)
+                encode_values(col, data, data.offsets[r], data.offsets[r + 1], 1, values);
+            write_npy(dir + "/" + col.name + ".npy", col, npy_encode(numpy_dtype(col), shape(col, records), values));
+            return shape(col, records);
+        } else {
+            // Flat values, and offsets
+            size_t total = data.offsets.back();
+            encode_values(col, data, 0, total, total, values);
+            write_npy(dir + "/" + col.name + ".npy", col, npy_encode(numpy_dtype(col), shape(col, total), values));
+
+            string offsets;
+            for (size_t o: data.offsets)
+                append_raw(offsets, (int64_t)o);
+            write_npy(dir + "/" + col.name + ".offsets.npy", col, npy_encode(is_little_endian() ? "<i8" : ">i8", { records + 1 }, offsets));
+            return shape(col, total);
+        }
+    }
+
+    static std::vector<size_t> shape(const Column& col, size_t size)
+    {
+        std::vector<size_t> res { size };
+        if (col.type == VT_BYTES)
+            res.push_back(col.strlen);
+        return res;
+    }
+
+    /**
+     * Write the manifest, given the columns and the shapes of their .npy
+     * files
+     */
+    void write_manifest(const std::string& dir, const std::vector<Column>& columns, const std::vector<std::vector<size_t>>& shapes, size_t records) const
+    {
+        string buf;
+        JSONWriter out(buf);
+        out.start_mapping();
+        out.add("records", records);
+        out.add_cstring("columns");
+        out.start_list();
+        for (size_t i = 0; i < columns.size(); ++i)
+        {
+            const Column& col = columns[i];
+            out.start_mapping();
+            out.add("name", col.name);
+            out.add("file", col.name + ".npy");
+            out.add("dtype", numpy_dtype(col));
+            out.add_cstring("shape");
+            out.start_list();
+            for (size_t size: shapes[i])
+                out.add(size);
+            out.end_list();
+            if (col.loop_dim.empty())
+            {
+                out.add("layout", "dense");
+                out.add_cstring("dimensions");
+                out.start_list();
+                out.add("BUFR_records");
+            } else {
+                // The values of all records one after the other, and the
+                // start of each record in the offsets file
+                out.add("layout", "ragged");
+                out.add("offsets", col.name + ".offsets.npy");
+                out.add("loop_dimension", col.loop_dim);
+                out.add("max_length", col.loop_size);
+                out.add_cstring("dimensions");
+                out.start_list();
+                out.add("values");
+            }
+            if (col.type == VT_BYTES)
+                out.add(col.strlen_dim);
+            out.end_list();
+            out.add_cstring("attributes");
+            out.start_mapping();
+            for (const auto& attr: col.attributes)
+            {
+                out.add_string(attr.name);
+                add_attribute_value(out, attr);
+            }
+            out.end_mapping();
+            out.end_mapping();
+        }
+        out.end_list();
+        out.end_mapping();
+        buf += '\n';
+        sys::write_file(dir + "/manifest.json", buf);
+    }
+
+    void write(const std::string& dir) const
+    {
+        TraceSpan span(instruments(opts).trace, "write", dir);
+        std::vector<Column> columns;
+        filler.columns(columns);
+        size_t records = filler.record_count();
+        filler.count_stats();
+
+        std::vector<std::vector<size_t>> shapes(columns.size());
+        parallel_for(opts.jobs, columns.size(), [&](size_t i) {
+            TraceSpan span(instruments(opts).trace, "putvar", columns[i].name);
+            shapes[i] = write_column(dir, columns[i], records);
+        });
+
+        // Write the manifest last, so its presence marks a complete output
+        write_manifest(dir, columns, shapes, records);
+    }
+};
+
+}
+
+std::unique_ptr<Outfile> make_npy_outfile(const Options& opts)
+{
+    return unique_ptr<Outfile>(new NpyOutfile(opts));
+}
+
+}
@@ -0,0 +1,52 @@
+/*
+ * npy - Write converted data as a directory of numpy arrays
+ *
+ * Copyright (C) 2026  ARPA-SIM <urpsim@smr.arpa.emr.it>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#ifndef B2NC_NPY_H
+#define B2NC_NPY_H
+
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace b2nc {
+
+struct Options;
+struct Outfile;
+
+/**
+ * Build the contents of a .npy file, given the numpy dtype string, the array
+ * shape, and the raw array data in C order
+ */
+std::string npy_encode(const std::string& dtype, const std::vector<size_t>& shape, const std::string& data);
+
+/**
+ * Create an Outfile that writes a directory with one .npy file for each
+ * output variable, and a manifest.json file describing them.
+ *
+ * Replicated variables are stored as a flat array of all their values, plus
+ * an array of int64 offsets with the start of the values of each record.
+ * The manifest gives the shape of each file, and describes these variables
+ * with a "ragged" layout and a "values" dimension instead of their loop
+ * dimension.
+ */
+std::unique_ptr<Outfile> make_npy_outfile(const Options& opts);
+
+}
+
+#endif
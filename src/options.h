@@ -23,9 +23,12 @@
 #define B2NC_OPTIONS_H
 
 #include <string>
+#include <cstddef>
 
 namespace b2nc {
 
+struct Instruments;
+
 /**
  * Configuration for the conversion process
  */
@@ -35,9 +38,40 @@ struct Options
     bool debug;
     bool use_mnemonic;
     std::string out_fname;
+    /// Free space to reserve at the end of NetCDF headers (see nc__enddef)
+    size_t nc_header_pad;
+    /// Alignment of the start of NetCDF data sections (see nc__enddef)
+    size_t nc_var_align;
+    /// Name of the output backend (see Outfile::register_backend)
+    std::string format;
+    /**
+     * Number of threads used to convert bulletins with many subsets, and
+     * that output backends can use
+     */
+    unsigned jobs;
+    /// Number of BUFR records in each chunk of Zarr output
+    size_t zarr_chunk_records;
+    /// Number of BUFR records in each record batch of Arrow output
+    size_t arrow_batch_records;
+    /// Directory where conversion plans are cached across runs; empty to disable
+    std::string plan_cache_dir;
+    /**
+     * Write each output to a hidden temporary name, and rename it to its
+     * final name only once it is complete
+     */
+    bool atomic_output;
+    /**
+     * Internal instrumentation used by the command line tools (see
+     * Instruments). It is not part of the stable API: library users should
+     * leave it unset. It is not owned by Options.
+     */
+    Instruments* instruments;
 
     Options()
-        : verbose(false), debug(false), use_mnemonic(true)
+        : verbose(false), debug(false), use_mnemonic(true),
+          nc_header_pad(4096), nc_var_align(4), format("netcdf"), jobs(1),
+          zarr_chunk_records(4096), arrow_batch_records(65536),
+          atomic_output(false), instruments(nullptr)
     {
     }
 };
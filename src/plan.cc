@@ -24,6 +24,8 @@
 #include "options.h"
 #include "ncoutfile.h"
 #include "utils.h"
+#include "trace.h"
+#include "memory.h"
 //#include "mnemo.h"
 #include <wreport/var.h>
 #include <wreport/vartable.h>
@@ -33,6 +35,7 @@
 #include <stack>
 #include <map>
 #include <cstring>
+#include <cstdlib>
 
 using namespace wreport;
 using namespace std;
@@ -66,7 +69,7 @@ void Variable::print(FILE* out)
 }
 
 
-Section::Section(size_t id) : id(id), cursor(0) {}
+Section::Section(size_t id) : id(id) {}
 Section::~Section()
 {
     for (vector<Variable*>::iterator i = entries.begin();
@@ -74,20 +77,22 @@ Section::~Section()
         delete *i;
 }
 
-Variable& Section::current() const
+Variable& Section::at(unsigned pos) const
 {
-    if (cursor >= entries.size())
+    if (pos >= entries.size())
         error_consistency::throwf("trying to read section %zd past its end (%u/%zd)",
-                id, cursor, entries.size());
-    return *entries[cursor];
+                id, pos, entries.size());
+    return *entries[pos];
 }
 
-Variable& Section::current(unsigned idx) const
+std::vector<const ValArray*> Section::written_arrays() const
 {
-    if (cursor + idx >= entries.size())
-        error_consistency::throwf("trying to read section %zd past its end (%u/%zd)",
-                id, cursor + idx, entries.size());
-    return *entries[cursor + idx];
+    vector<const ValArray*> res;
+    for (const auto* entry: entries)
+        for (const ValArray* arr: { entry->data, entry->qbits })
+            if (arr && arr->get_size() > 0)
+                res.push_back(arr);
+    return res;
 }
 
 void Section::define(NCOutfile& outfile)
@@ -96,8 +101,16 @@ void Section::define(NCOutfile& outfile)
             i != entries.end(); ++i)
     {
         Variable& v = **i;
-        if (v.data) v.data->define(outfile);
-        if (v.qbits) v.qbits->define(outfile);
+        if (v.data)
+        {
+            TraceSpan span(outfile.trace, "define", v.data->name);
+            v.data->define(outfile);
+        }
+        if (v.qbits)
+        {
+            TraceSpan span(outfile.trace, "define", v.qbits->name);
+            v.qbits->define(outfile);
+        }
     }
 }
 
@@ -107,8 +120,16 @@ void Section::putvar(NCOutfile& outfile) const
             i != entries.end(); ++i)
     {
         Variable& v = **i;
-        if (v.data) v.data->putvar(outfile);
-        if (v.qbits) v.qbits->putvar(outfile);
+        if (v.data)
+        {
+            TraceSpan span(outfile.trace, "putvar", v.data->name);
+            v.data->putvar(outfile);
+        }
+        if (v.qbits)
+        {
+            TraceSpan span(outfile.trace, "putvar", v.qbits->name);
+            v.qbits->putvar(outfile);
+        }
     }
 }
 
@@ -500,6 +521,231 @@ private:
     PlanMaker& operator=(const PlanMaker&);
 };
 
+/**
+ * Encoder for the serialized form of a plan.
+ *
+ * Values are separated by spaces or newlines, and strings are encoded as
+ * "length:bytes" so that they can contain any character.
+ */
+struct PlanWriter
+{
+    string& out;
+    // Position of each array in the order they are written
+    map<const ValArray*, long> ids;
+
+    PlanWriter(string& out) : out(out) {}
+
+    void add_int(long val)
+    {
+        out += to_string(val);
+        out += ' ';
+    }
+
+    void add_double(double val)
+    {
+        char buf[32];
+        snprintf(buf, 32, "%.17g", val);
+        out += buf;
+        out += ' ';
+    }
+
+    void add_string(const string& val)
+    {
+        out += to_string(val.size());
+        out += ':';
+        out += val;
+        out += ' ';
+    }
+
+    void end_line()
+    {
+        if (!out.empty() && out.back() == ' ')
+            out.back() = '\n';
+        else
+            out += '\n';
+    }
+
+    long id(const ValArray* arr) const
+    {
+        if (!arr) return -1;
+        map<const ValArray*, long>::const_iterator i = ids.find(arr);
+        if (i == ids.end())
+            error_consistency::throwf("variable %s does not belong to the plan being serialized", arr->name.c_str());
+        return i->second;
+    }
+
+    void add_array(const Plan& plan, const ValArray& arr)
+    {
+        add_int(arr.type);
+        add_string(arr.name);
+        add_string(arr.mnemo);
+        add_int(arr.rcnt);
+        if (arr.info == &plan.qbits_info)
+            add_int(0);
+        else
+        {
+            add_int(1);
+            add_int(arr.info->code);
+            add_int((int)arr.info->type);
+            add_string(arr.info->desc);
+            add_string(arr.info->unit);
+            add_int(arr.info->scale);
+            add_int(arr.info->len);
+            add_int(arr.info->bit_ref);
+            add_int(arr.info->bit_len);
+            add_int(arr.info->imin);
+            add_int(arr.info->imax);
+            add_double(arr.info->dmin);
+            add_double(arr.info->dmax);
+        }
+        add_int(arr.references.size());
+        for (const auto& r: arr.references)
+        {
+            add_int(r.first);
+            add_int(id(r.second));
+        }
+    }
+};
+
+/// Decoder for the output of PlanWriter
+struct PlanReader
+{
+    const string& in;
+    size_t pos = 0;
+
+    PlanReader(const string& in) : in(in) {}
+
+    [[noreturn]] void fail(const char* what)
+    {
+        char buf[128];
+        snprintf(buf, 128, "invalid serialized plan: %s at offset %zu", what, pos);
+        throw error_parse(buf);
+    }
+
+    void skip_space()
+    {
+        while (pos < in.size() && (in[pos] == ' ' || in[pos] == '\n'))
+            ++pos;
+    }
+
+    long get_int()
+    {
+        skip_space();
+        const char* start = in.c_str() + pos;
+        char* end;
+        long res = strtol(start, &end, 10);
+        if (end == start) fail("integer expected");
+        pos += end - start;
+        return res;
+    }
+
+    long get_int(long min, long max)
+    {
+        long res = get_int();
+        if (res < min || res > max) fail("value out of range");
+        return res;
+    }
+
+    double get_double()
+    {
+        skip_space();
+        const char* start = in.c_str() + pos;
+        char* end;
+        double res = strtod(start, &end);
+        if (end == start) fail("number expected");
+        pos += end - start;
+        return res;
+    }
+
+    string get_string()
+    {
+        size_t len = get_int(0, in.size());
+        if (pos >= in.size() || in[pos] != ':') fail("string expected");
+        ++pos;
+        if (len > in.size() - pos) fail("truncated string");
+        string res = in.substr(pos, len);
+        pos += len;
+        return res;
+    }
+
+    void expect(const char* word)
+    {
+        skip_space();
+        size_t len = strlen(word);
+        if (in.compare(pos, len, word) != 0) fail(word);
+        pos += len;
+    }
+};
+
+/// Array references and loop counters to resolve once all arrays are loaded
+struct PendingLinks
+{
+    vector<ValArray*> arrays;
+    vector<pair<ValArray*, vector<pair<Varcode, long>>>> references;
+    vector<pair<plan::Section*, long>> loops;
+
+    ValArray* resolve(PlanReader& in, long id)
+    {
+        if (id < 0 || (size_t)id >= arrays.size())
+            in.fail("reference to unknown variable");
+        return arrays[id];
+    }
+};
+
+unique_ptr<ValArray> read_array(Plan& plan, PlanReader& in, plan::Section& section, PendingLinks& links)
+{
+    Namer::DataType type = (Namer::DataType)in.get_int(0, Namer::DT_MAX - 1);
+    string name = in.get_string();
+    string mnemo = in.get_string();
+    unsigned rcnt = in.get_int(0, 0xffffffffL);
+
+    Varinfo info;
+    if (in.get_int(0, 1) == 0)
+        info = &plan.qbits_info;
+    else
+    {
+        unique_ptr<_Varinfo> i(new _Varinfo());
+        i->code = in.get_int(0, 0xffff);
+        i->type = (Vartype)in.get_int(0, (long)Vartype::Binary);
+        string desc = in.get_string();
+        strncpy(i->desc, desc.c_str(), sizeof(i->desc) - 1);
+        string unit = in.get_string();
+        strncpy(i->unit, unit.c_str(), sizeof(i->unit) - 1);
+        i->scale = in.get_int();
+        i->len = in.get_int(0, 0xffffffffL);
+        i->bit_ref = in.get_int();
+        i->bit_len = in.get_int(0, 0xffffffffL);
+        i->imin = in.get_int();
+        i->imax = in.get_int();
+        i->dmin = in.get_double();
+        i->dmax = in.get_double();
+        info = i.get();
+        plan.owned_infos.push_back(move(i));
+    }
+
+    unique_ptr<ValArray> arr;
+    if (section.id == 0)
+        arr.reset(ValArray::make_singlevalarray(type, info));
+    else
+        arr.reset(ValArray::make_multivalarray(type, info, section.loop));
+    arr->name = name;
+    arr->mnemo = mnemo;
+    arr->rcnt = rcnt;
+    arr->type = type;
+
+    size_t refcount = in.get_int(0, in.in.size());
+    vector<pair<Varcode, long>> refs;
+    for (size_t i = 0; i < refcount; ++i)
+    {
+        Varcode code = in.get_int(0, 0xffff);
+        refs.push_back(make_pair(code, in.get_int()));
+    }
+    links.arrays.push_back(arr.get());
+    if (!refs.empty())
+        links.references.push_back(make_pair(arr.get(), move(refs)));
+    return arr;
+}
+
 }
 
 
@@ -510,10 +756,27 @@ Plan::Plan(const Options& opts) : opts(opts)
 }
 
 Plan::~Plan()
+{
+    clear();
+}
+
+void Plan::clear()
 {
     for (vector<plan::Section*>::iterator i = sections.begin();
             i != sections.end(); ++i)
         delete *i;
+    sections.clear();
+    owned_infos.clear();
+}
+
+size_t Plan::heap_size() const
+{
+    size_t res = heap_size_of(sections) + heap_size_of(owned_infos);
+    for (const auto* section: sections)
+        res += sizeof(plan::Section) + heap_size_of(section->entries)
+             + section->entries.size() * sizeof(plan::Variable);
+    res += owned_infos.size() * sizeof(wreport::_Varinfo);
+    return res;
 }
 
 void Plan::build(const wreport::Bulletin& bulletin)
@@ -522,6 +785,98 @@ void Plan::build(const wreport::Bulletin& bulletin)
     pm.run();
 }
 
+std::string Plan::serialize() const
+{
+    string res;
+    PlanWriter out(res);
+
+    // Number arrays in the order in which they are written
+    for (const auto& section: sections)
+        for (const auto& entry: section->entries)
+        {
+            if (entry->data) out.ids.insert(make_pair(entry->data, out.ids.size()));
+            if (entry->qbits) out.ids.insert(make_pair(entry->qbits, out.ids.size()));
+        }
+
+    res += "plan ";
+    out.add_int(sections.size());
+    out.end_line();
+    for (const auto& section: sections)
+    {
+        res += "section ";
+        out.add_int(section->loop.index);
+        out.add_int(out.id(section->loop.var));
+        out.add_int(section->entries.size());
+        out.end_line();
+        for (const auto& entry: section->entries)
+        {
+            out.add_int(entry->subsection ? (long)entry->subsection->id : -1);
+            out.add_int(entry->data ? 1 : 0);
+            if (entry->data)
+                out.add_array(*this, *entry->data);
+            out.add_int(entry->qbits ? 1 : 0);
+            if (entry->qbits)
+                out.add_array(*this, *entry->qbits);
+            out.end_line();
+        }
+    }
+    return res;
+}
+
+void Plan::deserialize(const std::string& data)
+{
+    clear();
+    try {
+        PlanReader in(data);
+        PendingLinks links;
+
+        in.expect("plan");
+        size_t count = in.get_int(1, data.size());
+        // Create all sections first, so that entries can refer to them
+        for (size_t i = 0; i < count; ++i)
+            create_section();
+
+        for (const auto& section: sections)
+        {
+            in.expect("section");
+            section->loop.index = in.get_int(0, 0xffffffffL);
+            long loopvar = in.get_int();
+            if (loopvar >= 0)
+                links.loops.push_back(make_pair(section, loopvar));
+            size_t entries = in.get_int(0, data.size());
+            for (size_t i = 0; i < entries; ++i)
+            {
+                section->entries.push_back(new plan::Variable);
+                plan::Variable& v = *section->entries.back();
+                long subsection = in.get_int(-1, count - 1);
+                if (subsection >= 0)
+                    v.subsection = sections[subsection];
+                if (in.get_int(0, 1))
+                    v.data = read_array(*this, in, *section, links).release();
+                if (in.get_int(0, 1))
+                {
+                    if (!v.data) in.fail("qbits without data");
+                    v.qbits = read_array(*this, in, *section, links).release();
+                    v.qbits->master = v.data;
+                    v.data->slaves.push_back(v.qbits);
+                }
+            }
+        }
+        in.skip_space();
+        if (in.pos != data.size())
+            in.fail("trailing data");
+
+        for (auto& r: links.references)
+            for (const auto& ref: r.second)
+                r.first->references.push_back(make_pair(ref.first, links.resolve(in, ref.second)));
+        for (auto& l: links.loops)
+            l.first->loop.var = links.resolve(in, l.second);
+    } catch (...) {
+        clear();
+        throw;
+    }
+}
+
 plan::Section& Plan::create_section()
 {
     sections.push_back(new plan::Section(sections.size()));
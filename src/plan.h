@@ -28,6 +28,7 @@
 //#include <string>
 #include <vector>
 //#include <map>
+#include <memory>
 #include <cstdio>
 
 namespace wreport {
@@ -101,19 +102,23 @@ struct Section
      */
     LoopInfo loop;
 
-    /**
-     * Cursor used when iterating the structure mapping decoded data to the
-     * plan
-     */
-    unsigned cursor;
-
     Section(size_t id);
     ~Section();
 
-    // Get the variable pointed by the cursor
-    Variable& current() const;
-    // Get the idx-th variable after the cursor
-    Variable& current(unsigned idx) const;
+    /**
+     * Get the variable at position \a pos, throwing error_consistency if it
+     * is past the end of the section.
+     *
+     * Sections have no iteration state, so that different threads can map
+     * decoded data to the same plan.
+     */
+    Variable& at(unsigned pos) const;
+
+    /**
+     * Arrays of data and quality bits of the section that are written to
+     * the output, skipping those that never got a value
+     */
+    std::vector<const ValArray*> written_arrays() const;
 
     void define(NCOutfile& outfile);
     void putvar(NCOutfile& outfile) const;
@@ -152,6 +157,12 @@ struct Plan
      * This is stored here to guarantee it the same lifetime as the plan.
      */
     wreport::_Varinfo qbits_info;
+    /**
+     * Varinfo of the variables of a plan loaded with deserialize().
+     *
+     * Plans computed by build() use the Varinfo of the bulletin instead.
+     */
+    std::vector<std::unique_ptr<wreport::_Varinfo>> owned_infos;
 
     Plan(const Options& opts);
     ~Plan();
@@ -164,6 +175,30 @@ struct Plan
     const plan::Variable* get_variable(unsigned section, unsigned pos) const;
 
     void build(const wreport::Bulletin& bulletin);
+
+    /**
+     * Encode the plan as a string, from which deserialize() can rebuild it
+     * without access to the bulletin or the tables
+     */
+    std::string serialize() const;
+
+    /**
+     * Replace the contents of the plan with the one encoded by serialize().
+     *
+     * Throws error_parse if \a data is not a valid plan encoding: in that
+     * case the plan is left empty.
+     */
+    void deserialize(const std::string& data);
+
+    /// Remove all the sections of the plan
+    void clear();
+
+    /**
+     * Returns the heap memory used by the sections and variables of the
+     * plan, not including their ValArrays
+     */
+    size_t heap_size() const;
+
     void define(NCOutfile& outfile);
     void putvar(NCOutfile& outfile) const;
 
@@ -0,0 +1,168 @@
+/*
+ * Copyright (C) 2026  ARPA-SIM <urpsim@smr.arpa.emr.it>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#include "plancache.h"
+#include "plan.h"
+#include "namer.h"
+#include "options.h"
+#include "valarray.h"
+#include "tests/tests.h"
+#include <wreport/bulletin.h>
+#include <wreport/utils/sys.h>
+#include <cstdio>
+
+using namespace b2nc;
+using namespace wreport;
+using namespace wreport::tests;
+using namespace std;
+
+namespace {
+
+static const char* cachedir = "test-plancache";
+
+static unique_ptr<BufrBulletin> read_first_bufr(const std::string& testname)
+{
+    string srcfile(b2nc::tests::datafile("bufr/" + testname));
+    FILE* infd = fopen(srcfile.c_str(), "rb");
+    if (infd == NULL)
+        error_system::throwf("cannot open %s", srcfile.c_str());
+
+    string rawmsg;
+    unique_ptr<BufrBulletin> res;
+    if (BufrBulletin::read(infd, rawmsg, srcfile.c_str()))
+        res = BufrBulletin::decode(rawmsg);
+    fclose(infd);
+    if (!res)
+        error_consistency::throwf("%s contains no BUFR messages", srcfile.c_str());
+    return res;
+}
+
+class Tests : public TestCase
+{
+    using TestCase::TestCase;
+
+    void register_tests() override
+    {
+        add_method("serialize", []() {
+            Options opts;
+            for (const char* name: { "cdfin_acars", "cdfin_temp", "cdfin_synop", "cdfin_radar_vad" })
+            {
+                WREPORT_TEST_INFO(info);
+                info() << name;
+
+                unique_ptr<BufrBulletin> bulletin = read_first_bufr(name);
+                Plan plan(opts);
+                plan.build(*bulletin);
+                string encoded = plan.serialize();
+
+                Plan loaded(opts);
+                wassert(loaded.deserialize(encoded));
+                wassert(actual(loaded.sections.size()) == plan.sections.size());
+                wassert(actual(loaded.serialize()) == encoded);
+
+                // Loop information is restored
+                for (size_t i = 1; i < plan.sections.size(); ++i)
+                {
+                    const plan::Section* orig = plan.sections[i];
+                    const plan::Section* copy = loaded.sections[i];
+                    wassert(actual(copy->loop.index) == orig->loop.index);
+                    if (orig->loop.var)
+                    {
+                        wassert_true(copy->loop.var != nullptr);
+                        wassert(actual(copy->loop.var->name) == orig->loop.var->name);
+                    } else
+                        wassert_true(copy->loop.var == nullptr);
+                }
+            }
+        });
+
+        add_method("invalid", []() {
+            Options opts;
+            Plan plan(opts);
+            wassert_throws(error_parse, plan.deserialize(""));
+            wassert_throws(error_parse, plan.deserialize("plan 1\nsection 0 -1 1\n-1 1 0 3:foo"));
+            wassert_throws(error_parse, plan.deserialize("plan 1\nsection 0 5 0\n"));
+            wassert(actual(plan.sections.size()) == 0u);
+        });
+
+        add_method("disk", []() {
+            sys::rmtree_ifexists(cachedir);
+            PlanCache::clear_memory();
+
+            Options opts;
+            opts.plan_cache_dir = cachedir;
+            PlanCache cache(opts);
+            unique_ptr<BufrBulletin> bulletin = read_first_bufr("cdfin_temp");
+
+            Plan plan(opts);
+            wassert_false(cache.load(plan, *bulletin));
+            plan.build(*bulletin);
+            cache.save(plan, *bulletin);
+            wassert_true(sys::exists(cache.pathname(cache.key(*bulletin))));
+
+            // Load from disk
+            PlanCache::clear_memory();
+            Plan loaded(opts);
+            wassert_true(cache.load(loaded, *bulletin));
+            wassert(actual(loaded.serialize()) == plan.serialize());
+
+            // A different namer gives a different plan
+            Options plain_opts(opts);
+            plain_opts.use_mnemonic = false;
+            PlanCache plain_cache(plain_opts);
+            wassert(actual(plain_cache.key(*bulletin)) != cache.key(*bulletin));
+            Plan plain(plain_opts);
+            wassert_false(plain_cache.load(plain, *bulletin));
+        });
+
+        add_method("invalidate", []() {
+            sys::rmtree_ifexists(cachedir);
+            PlanCache::clear_memory();
+
+            // Use a copy of the mnemonic tables that we can modify
+            string tabledir = string(cachedir) + "-tables";
+            sys::rmtree_ifexists(tabledir);
+            sys::makedirs(tabledir);
+            string table = sys::read_file(Namer::table_pathname());
+            b2nc::tests::LocalEnv env(Namer::ENV_TABLE_DIR, tabledir);
+            sys::write_file(Namer::table_pathname(), table);
+
+            Options opts;
+            opts.plan_cache_dir = cachedir;
+            PlanCache cache(opts);
+            unique_ptr<BufrBulletin> bulletin = read_first_bufr("cdfin_acars");
+
+            Plan plan(opts);
+            plan.build(*bulletin);
+            cache.save(plan, *bulletin);
+
+            Plan loaded(opts);
+            wassert_true(cache.load(loaded, *bulletin));
+
+            // Changing the table invalidates both the memory and the disk
+            // cache
+            sys::write_file(Namer::table_pathname(), table + "# changed\n");
+            Plan stale(opts);
+            wassert_false(cache.load(stale, *bulletin));
+            PlanCache::clear_memory();
+            wassert_false(cache.load(stale, *bulletin));
+            wassert(actual(stale.sections.size()) == 0u);
+        });
+    }
+} test("plancache");
+
+}
@@ -0,0 +1,257 @@
+/*
+ * plancache - Persistent cache of conversion plans
+ *
+ * Copyright (C) 2026  ARPA-SIM <urpsim@smr.arpa.emr.it>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#include "config.h"
+#include "plancache.h"
+#include "plan.h"
+#include "options.h"
+#include "namer.h"
+#include "mnemo.h"
+#include <wreport/bulletin.h>
+#include <wreport/vartable.h>
+#include <wreport/dtable.h>
+#include <wreport/utils/sys.h>
+#include <wreport/error.h>
+#include <map>
+#include <mutex>
+#include <cstdio>
+#include <cstdint>
+
+using namespace wreport;
+using namespace std;
+
+namespace b2nc {
+
+namespace {
+
+/**
+ * First line of cache entries, identifying the program version and the
+ * compiled mnemonic tables
+ */
+string cache_header()
+{
+    return string("bufr2netcdf plan cache " PACKAGE_VERSION " ") + mnemo::BUILTIN_CHECKSUM + "\n";
+}
+
+mutex memory_lock;
+map<string, string> memory_cache;
+
+/**
+ * Describe the current state of the table files a plan depends on, so that
+ * changes to them can be detected
+ */
+string table_stamp(const Bulletin& bulletin)
+{
+    string res;
+    const string pathnames[] = {
+        bulletin.tables.btable->pathname(),
+        bulletin.tables.dtable->pathname(),
+        Namer::table_pathname(),
+    };
+    for (const auto& pathname: pathnames)
+    {
+        // The compiled mnemonic table is identified by cache_header()
+        if (pathname.empty())
+            continue;
+        res += pathname;
+        std::unique_ptr<struct stat> st = sys::stat(pathname);
+        if (!st)
+            res += " missing\n";
+        else
+        {
+            char buf[80];
+            snprintf(buf, 80, " %lld %lld.%09ld\n",
+                    (long long)st->st_size, (long long)st->st_mtim.tv_sec, (long)st->st_mtim.tv_nsec);
+            res += buf;
+        }
+    }
+    return res;
+}
+
+void add_string(string& out, const string& val)
+{
+    out += to_string(val.size());
+    out += ':';
+    out += val;
+    out += '\n';
+}
+
+/// Read a string written by add_string, returning false if it is not valid
+bool get_string(const string& in, size_t& pos, string& val)
+{
+    size_t colon = in.find(':', pos);
+    if (colon == string::npos || colon == pos)
+        return false;
+    size_t len = 0;
+    for (size_t i = pos; i < colon; ++i)
+    {
+        if (in[i] < '0' || in[i] > '9')
+            return false;
+        len = len * 10 + in[i] - '0';
+    }
+    if (len >= in.size() - colon || in[colon + 1 + len] != '\n')
+        return false;
+    val = in.substr(colon + 1, len);
+    pos = colon + len + 2;
+    return true;
+}
+
+/**
+ * Check that \a entry has been stored for \a key with tables in state
+ * \a stamp, and return the position of the serialized plan inside it, or
+ * string::npos if it is not valid
+ */
+size_t check_entry(const string& entry, const string& key, const string& stamp)
+{
+    string header = cache_header();
+    size_t pos = header.size();
+    if (entry.compare(0, pos, header) != 0)
+        return string::npos;
+    string val;
+    if (!get_string(entry, pos, val) || val != key)
+        return string::npos;
+    if (!get_string(entry, pos, val) || val != stamp)
+        return string::npos;
+    return pos;
+}
+
+}
+
+PlanCache::PlanCache(const Options& opts)
+    : opts(opts)
+{
+}
+
+std::string PlanCache::key(const wreport::Bulletin& bulletin) const
+{
+    string res;
+    char buf[64];
+    snprintf(buf, 64, "%d %d %d %s\n",
+            bulletin.data_category, bulletin.data_subcategory, bulletin.data_subcategory_local,
+            opts.use_mnemonic ? "mnemonic" : "plain");
+    res += buf;
+    for (auto code: bulletin.datadesc)
+    {
+        res += varcode_format(code);
+        res += ' ';
+    }
+    res += '\n';
+    res += bulletin.tables.btable->pathname();
+    res += '\n';
+    res += bulletin.tables.dtable->pathname();
+    res += '\n';
+    res += Namer::table_pathname();
+    return res;
+}
+
+std::string PlanCache::pathname(const std::string& key) const
+{
+    // 64 bit FNV-1a hash of the key
+    uint64_t hash = 0xcbf29ce484222325ULL;
+    for (unsigned char c: key)
+    {
+        hash ^= c;
+        hash *= 0x100000001b3ULL;
+    }
+    char buf[32];
+    snprintf(buf, 32, "%016llx.plan", (unsigned long long)hash);
+    return opts.plan_cache_dir + "/" + buf;
+}
+
+bool PlanCache::load(Plan& plan, const wreport::Bulletin& bulletin) const
+{
+    if (!bulletin.tables.btable || !bulletin.tables.dtable)
+        return false;
+
+    string k = key(bulletin);
+    string stamp = table_stamp(bulletin);
+
+    string entry;
+    bool from_disk = false;
+    {
+        lock_guard<mutex> lock(memory_lock);
+        auto i = memory_cache.find(k);
+        if (i != memory_cache.end())
+            entry = i->second;
+    }
+    if (entry.empty() && !opts.plan_cache_dir.empty())
+    {
+        string fname = pathname(k);
+        if (!sys::exists(fname))
+            return false;
+        entry = sys::read_file(fname);
+        from_disk = true;
+    }
+
+    size_t pos = check_entry(entry, k, stamp);
+    if (pos == string::npos)
+        return false;
+
+    try {
+        plan.deserialize(entry.substr(pos));
+    } catch (std::exception& e) {
+        if (opts.verbose)
+            fprintf(stderr, "ignoring invalid cached plan: %s\n", e.what());
+        return false;
+    }
+
+    if (from_disk)
+    {
+        lock_guard<mutex> lock(memory_lock);
+        memory_cache[k] = entry;
+    }
+    return true;
+}
+
+void PlanCache::save(const Plan& plan, const wreport::Bulletin& bulletin) const
+{
+    if (!bulletin.tables.btable || !bulletin.tables.dtable)
+        return;
+
+    string k = key(bulletin);
+    string entry = cache_header();
+    add_string(entry, k);
+    add_string(entry, table_stamp(bulletin));
+    entry += plan.serialize();
+
+    {
+        lock_guard<mutex> lock(memory_lock);
+        memory_cache[k] = entry;
+    }
+
+    if (opts.plan_cache_dir.empty())
+        return;
+
+    try {
+        sys::makedirs(opts.plan_cache_dir);
+        sys::write_file_atomically(pathname(k), entry, 0666);
+    } catch (std::exception& e) {
+        if (opts.verbose)
+            fprintf(stderr, "cannot store plan in cache directory %s: %s\n",
+                    opts.plan_cache_dir.c_str(), e.what());
+    }
+}
+
+void PlanCache::clear_memory()
+{
+    lock_guard<mutex> lock(memory_lock);
+    memory_cache.clear();
+}
+
+}
@@ -0,0 +1,83 @@
+/*
+ * plancache - Persistent cache of conversion plans
+ *
+ * Copyright (C) 2026  ARPA-SIM <urpsim@smr.arpa.emr.it>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#ifndef B2NC_PLANCACHE_H
+#define B2NC_PLANCACHE_H
+
+#include <string>
+
+namespace wreport {
+struct Bulletin;
+}
+
+namespace b2nc {
+
+struct Options;
+struct Plan;
+
+/**
+ * Cache of conversion plans, keyed by the bulletin header fields used to
+ * dispatch bulletins, their Data Description Section, the tables used to
+ * decode them and the namer configuration.
+ *
+ * Plans are always cached in memory for the lifetime of the process, and if
+ * Options::plan_cache_dir is set they are also stored on disk, one file per
+ * plan, to be reused by later runs.
+ *
+ * Each cached plan records the size and modification time of the B and D
+ * tables and of the mnemonic table file it was built with, or the checksum of
+ * the compiled mnemonic tables, and it is ignored if any of them changed.
+ */
+class PlanCache
+{
+protected:
+    const Options& opts;
+
+public:
+    PlanCache(const Options& opts);
+
+    /**
+     * Fill \a plan with the cached plan for \a bulletin.
+     *
+     * Returns false, leaving the plan empty, if there is no valid cached
+     * plan.
+     */
+    bool load(Plan& plan, const wreport::Bulletin& bulletin) const;
+
+    /**
+     * Store \a plan, built from \a bulletin, in the cache.
+     *
+     * Failures to write the disk cache are not fatal, and are only reported
+     * in verbose mode.
+     */
+    void save(const Plan& plan, const wreport::Bulletin& bulletin) const;
+
+    /// Identity of the plan for \a bulletin
+    std::string key(const wreport::Bulletin& bulletin) const;
+
+    /// Pathname of the disk cache file for the given key
+    std::string pathname(const std::string& key) const;
+
+    /// Remove all plans cached in memory
+    static void clear_memory();
+};
+
+}
+
+#endif
@@ -0,0 +1,126 @@
+/*
+ * Copyright (C) 2026  ARPA-SIM <urpsim@smr.arpa.emr.it>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#include "progress.h"
+#include "convert.h"
+#include "options.h"
+#include "instruments.h"
+#include "json.h"
+#include "tests/tests.h"
+#include <wreport/utils/sys.h>
+
+using namespace b2nc;
+using namespace wreport;
+using namespace wreport::tests;
+using namespace std;
+
+namespace {
+
+class Tests : public TestCase
+{
+    using TestCase::TestCase;
+
+    void register_tests() override
+    {
+        add_method("report", []() {
+            ProgressReport report;
+            report.elapsed = 10;
+            report.bytes = 1000;
+            report.messages = 10;
+            report.subsets = 200;
+            wassert(actual(report.percent()) < 0);
+            wassert(actual(report.eta()) < 0);
+            wassert(actual(report.to_text()).contains("10 messages"));
+            wassert(actual(report.to_text().find("ETA")) == string::npos);
+
+            report.total_bytes = 4000;
+            wassert(actual(report.percent()) == 25.0);
+            // 3000 bytes left at 100 bytes/s
+            wassert(actual(report.eta()) == 30.0);
+            wassert(actual(report.to_text()).contains("(25.0%)"));
+            wassert(actual(report.to_text()).contains("ETA 0:30"));
+
+            string json;
+            {
+                JSONWriter writer(json);
+                report.to_json(writer);
+            }
+            wassert(actual(json).startswith("{\"elapsed\":10"));
+            wassert(actual(json).contains("\"percent\":25"));
+            wassert(actual(json).contains("\"done\":false"));
+            wassert(actual(json).contains("\"status\":\"running\""));
+
+            report.done = true;
+            wassert(actual(report.percent()) == 100.0);
+            wassert(actual(report.to_text()).endswith(", done"));
+
+            // A failed conversion does not claim to have read everything
+            report.failed = true;
+            wassert(actual(report.percent()) == 25.0);
+            wassert(actual(report.to_text()).endswith(", failed"));
+            json.clear();
+            {
+                JSONWriter writer(json);
+                report.to_json(writer);
+            }
+            wassert(actual(json).contains("\"done\":true,\"status\":\"failed\""));
+        });
+
+        add_method("convert", []() {
+            Options opts;
+            // Counters are checked while the outputs are still open
+            b2nc::tests::reset_output(opts, "test-progress");
+            Progress progress(3600, Progress::Format::JSON, "test-progress/status");
+            Instruments instruments;
+            instruments.progress = &progress;
+            opts.instruments = &instruments;
+            progress.start();
+            {
+                Dispatcher dispatcher(opts);
+                read_bufr(opts, b2nc::tests::datafile("bufr/cdfin_synop"), dispatcher);
+
+                ProgressReport report = progress.report();
+                wassert(actual(report.messages) > 0u);
+                wassert(actual(report.subsets) >= report.messages);
+                wassert(actual(report.bytes) > 0u);
+                wassert(actual(report.open_outputs) > 0);
+
+                dispatcher.close();
+            }
+            progress.stop();
+
+            wassert(actual(progress.report().open_outputs) == 0);
+            string status = sys::read_file("test-progress/status");
+            wassert(actual(status).startswith("{\"elapsed\":"));
+            wassert(actual(status).contains("\"done\":true"));
+            wassert(actual(status).contains("\"status\":\"done\""));
+            wassert(actual(status).endswith("}\n"));
+
+            progress.stop(true);
+            status = sys::read_file("test-progress/status");
+            wassert(actual(status).contains("\"status\":\"failed\""));
+        });
+
+        add_method("format", []() {
+            wassert(actual(parse_progress_format("text") == Progress::Format::TEXT).istrue());
+            wassert(actual(parse_progress_format("json") == Progress::Format::JSON).istrue());
+            wassert_throws(wreport::error_consistency, parse_progress_format("xml"));
+        });
+    }
+} test("progress");
+
+}
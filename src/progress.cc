@@ -0,0 +1,236 @@
+/*
+ * progress - Periodic progress reports of long conversions
+ *
+ * Copyright (C) 2026  ARPA-SIM <urpsim@smr.arpa.emr.it>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#include "progress.h"
+#include "memory.h"
+#include "json.h"
+#include <wreport/error.h>
+#include <wreport/utils/sys.h>
+
+using namespace wreport;
+using namespace std;
+
+namespace b2nc {
+
+namespace {
+
+/// Format a duration like "1:02:03", or "2:03" if shorter than an hour
+std::string format_duration(double seconds)
+{
+    unsigned long secs = seconds + 0.5;
+    char buf[32];
+    if (secs >= 3600)
+        snprintf(buf, 32, "%lu:%02lu:%02lu", secs / 3600, secs / 60 % 60, secs % 60);
+    else
+        snprintf(buf, 32, "%lu:%02lu", secs / 60, secs % 60);
+    return buf;
+}
+
+}
+
+double ProgressReport::percent() const
+{
+    if (!total_bytes)
+        return -1;
+    // Messages are a little smaller than their files, so do not claim to be
+    // done before the end
+    double res = 100.0 * bytes / total_bytes;
+    return done && !failed ? 100 : min(res, 99.9);
+}
+
+const char* ProgressReport::status() const
+{
+    if (!done)
+        return "running";
+    return failed ? "failed" : "done";
+}
+
+double ProgressReport::eta() const
+{
+    if (done)
+        return 0;
+    if (!total_bytes || !bytes || elapsed <= 0)
+        return -1;
+    if (bytes >= total_bytes)
+        return 0;
+    return (total_bytes - bytes) / (bytes / elapsed);
+}
+
+std::string ProgressReport::to_text() const
+{
+    string res = "[" + format_duration(elapsed) + "] read " + format_bytes(bytes);
+    char buf[256];
+    if (total_bytes)
+    {
+        snprintf(buf, 256, " of %s (%.1f%%)", format_bytes(total_bytes).c_str(), percent());
+        res += buf;
+    }
+    snprintf(buf, 256, ", %llu messages (%.0f/s), %llu subsets (%.0f/s), %lld outputs open, RSS %s",
+            (unsigned long long)messages, messages_per_second,
+            (unsigned long long)subsets, subsets_per_second,
+            (long long)open_outputs, format_bytes(rss * 1024).c_str());
+    res += buf;
+    if (done)
+        res += string(", ") + status();
+    else if (eta() >= 0)
+        res += ", ETA " + format_duration(eta());
+    return res;
+}
+
+void ProgressReport::to_json(JSONWriter& json) const
+{
+    json.start_mapping();
+    json.add("elapsed", elapsed);
+    json.add("bytes", (unsigned long long)bytes);
+    json.add_cstring("total_bytes");
+    if (total_bytes)
+        json.add((unsigned long long)total_bytes);
+    else
+        json.add_null();
+    json.add_cstring("percent");
+    if (percent() >= 0)
+        json.add(percent());
+    else
+        json.add_null();
+    json.add("messages", (unsigned long long)messages);
+    json.add("subsets", (unsigned long long)subsets);
+    json.add("messages_per_second", messages_per_second);
+    json.add("subsets_per_second", subsets_per_second);
+    json.add("open_outputs", (long long)open_outputs);
+    json.add("rss_kib", rss);
+    json.add_cstring("eta");
+    if (eta() >= 0)
+        json.add(eta());
+    else
+        json.add_null();
+    json.add("done", done);
+    json.add("status", status());
+    json.end_mapping();
+}
+
+Progress::Progress(unsigned interval, Format format, const std::string& status_fname)
+    : start_time(std::chrono::steady_clock::now()), interval(interval),
+      format(format), status_fname(status_fname)
+{
+}
+
+Progress::~Progress()
+{
+    join_reporter();
+}
+
+void Progress::join_reporter()
+{
+    if (reporter.joinable())
+    {
+        {
+            lock_guard<mutex> guard(lock);
+            stopping = true;
+        }
+        cond.notify_all();
+        reporter.join();
+    }
+}
+
+ProgressReport Progress::report()
+{
+    ProgressReport res;
+    res.elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start_time).count();
+    res.bytes = bytes;
+    res.total_bytes = total_bytes;
+    res.messages = messages;
+    res.subsets = subsets;
+    res.open_outputs = open_outputs;
+    res.rss = current_rss();
+
+    lock_guard<mutex> guard(lock);
+    double span = res.elapsed - last_elapsed;
+    if (span > 0)
+    {
+        res.messages_per_second = (res.messages - last_messages) / span;
+        res.subsets_per_second = (res.subsets - last_subsets) / span;
+    }
+    last_elapsed = res.elapsed;
+    last_messages = res.messages;
+    last_subsets = res.subsets;
+    return res;
+}
+
+void Progress::emit(const ProgressReport& report)
+{
+    string line;
+    if (format == Format::JSON)
+    {
+        JSONWriter json(line);
+        report.to_json(json);
+    } else
+        line = report.to_text();
+    line += '\n';
+
+    if (status_fname.empty())
+    {
+        fputs(line.c_str(), stderr);
+        fflush(stderr);
+        return;
+    }
+
+    try {
+        sys::write_file_atomically(status_fname, line, 0666);
+    } catch (std::exception& e) {
+        // Progress reports are not worth failing the conversion for
+        fprintf(stderr, "cannot write progress to %s: %s\n", status_fname.c_str(), e.what());
+    }
+}
+
+void Progress::start()
+{
+    if (reporter.joinable())
+        return;
+    stopping = false;
+    reporter = std::thread([this] {
+        unique_lock<mutex> guard(lock);
+        while (!cond.wait_for(guard, std::chrono::seconds(interval), [this] { return stopping; }))
+        {
+            guard.unlock();
+            emit(report());
+            guard.lock();
+        }
+    });
+}
+
+void Progress::stop(bool failed)
+{
+    join_reporter();
+
+    ProgressReport res = report();
+    res.done = true;
+    res.failed = failed;
+    emit(res);
+}
+
+Progress::Format parse_progress_format(const std::string& name)
+{
+    if (name == "text")
+        return Progress::Format::TEXT;
+    if (name == "json")
+        return Progress::Format::JSON;
+    error_consistency::throwf("unknown progress format \"%s\": use text or json", name.c_str());
+}
+
+}
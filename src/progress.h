@@ -0,0 +1,173 @@
+/*
+ * progress - Periodic progress reports of long conversions
+ *
+ * Copyright (C) 2026  ARPA-SIM <urpsim@smr.arpa.emr.it>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#ifndef B2NC_PROGRESS_H
+#define B2NC_PROGRESS_H
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <cstdint>
+#include <cstdio>
+
+namespace b2nc {
+
+class JSONWriter;
+
+/// State of a conversion at one point in time
+struct ProgressReport
+{
+    /// Seconds since the conversion started
+    double elapsed = 0;
+    /// Bytes of BUFR messages read
+    uint64_t bytes = 0;
+    /// Bytes of BUFR messages in the input, or 0 if not known
+    uint64_t total_bytes = 0;
+    uint64_t messages = 0;
+    uint64_t subsets = 0;
+    /// Outputs open at the time of the report
+    int64_t open_outputs = 0;
+    /// Resident set size, in KiB
+    long rss = 0;
+    /// Messages and subsets per second since the previous report
+    double messages_per_second = 0;
+    double subsets_per_second = 0;
+    /// True for the report made when the conversion ended
+    bool done = false;
+    /// True if the conversion ended with errors
+    bool failed = false;
+
+    /// "running", "done" or "failed"
+    const char* status() const;
+
+    /// Percentage of the input read, or a negative value if not known
+    double percent() const;
+
+    /**
+     * Estimated seconds to the end of the input, at the average speed so
+     * far, or a negative value if not known
+     */
+    double eta() const;
+
+    /// Format as a line for people, without a trailing newline
+    std::string to_text() const;
+
+    void to_json(JSONWriter& json) const;
+};
+
+/**
+ * Report the progress of a conversion every few seconds, from a separate
+ * thread, so that reports continue if the conversion stalls.
+ *
+ * It is enabled by setting Instruments::progress, and counters can be updated
+ * by many threads at the same time.
+ */
+class Progress
+{
+public:
+    enum class Format
+    {
+        /// Lines for people
+        TEXT,
+        /// One JSON object per line
+        JSON,
+    };
+
+protected:
+    std::chrono::steady_clock::time_point start_time;
+    unsigned interval;
+    Format format;
+    /// File rewritten with the latest report; if empty, reports go to stderr
+    std::string status_fname;
+
+    std::atomic<uint64_t> bytes{0};
+    std::atomic<uint64_t> messages{0};
+    std::atomic<uint64_t> subsets{0};
+    std::atomic<int64_t> open_outputs{0};
+    std::atomic<uint64_t> total_bytes{0};
+
+    std::mutex lock;
+    std::condition_variable cond;
+    std::thread reporter;
+    bool stopping = false;
+    /// Counters and time of the previous report, used to compute rates
+    uint64_t last_messages = 0;
+    uint64_t last_subsets = 0;
+    double last_elapsed = 0;
+
+    /**
+     * Send a report to stderr or to the status file. Errors writing the
+     * status file are printed to stderr, and do not stop the conversion.
+     */
+    void emit(const ProgressReport& report);
+
+    /// Stop the reporting thread, if it is running
+    void join_reporter();
+
+public:
+    /**
+     * @param interval
+     *   Seconds between reports
+     * @param status_fname
+     *   If not empty, write each report to this file, replacing the
+     *   previous one, instead of appending it to stderr
+     */
+    Progress(unsigned interval, Format format = Format::TEXT, const std::string& status_fname = std::string());
+    Progress(const Progress&) = delete;
+    Progress& operator=(const Progress&) = delete;
+    ~Progress();
+
+    /// Set the size of the input, to compute percentages and ETA
+    void set_total_bytes(uint64_t bytes) { total_bytes = bytes; }
+
+    /// Count a message of \a size bytes with \a subsets subsets
+    void add_message(size_t size, size_t subsets)
+    {
+        bytes += size;
+        messages += 1;
+        this->subsets += subsets;
+    }
+
+    void output_opened() { ++open_outputs; }
+    void output_closed() { --open_outputs; }
+
+    /**
+     * Return the current state, computing rates since the previous call
+     */
+    ProgressReport report();
+
+    /// Start reporting every interval seconds
+    void start();
+
+    /**
+     * Stop the periodic reports, and emit a final one, saying whether the
+     * conversion \a failed
+     */
+    void stop(bool failed = false);
+};
+
+/// Parse the name of a progress format, "text" or "json"
+Progress::Format parse_progress_format(const std::string& name);
+
+}
+
+#endif
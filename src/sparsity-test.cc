@@ -0,0 +1,99 @@
+/*
+ * Copyright (C) 2026  ARPA-SIM <urpsim@smr.arpa.emr.it>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#include "sparsity.h"
+#include "options.h"
+#include "instruments.h"
+#include "tests/tests.h"
+
+using namespace b2nc;
+using namespace wreport;
+using namespace wreport::tests;
+using namespace std;
+
+namespace {
+
+class Tests : public TestCase
+{
+    using TestCase::TestCase;
+
+    void register_tests() override
+    {
+        add_method("suggestion", []() {
+            VariableSparsity var;
+            var.cells = 100;
+            var.values = 100;
+            wassert(actual(var.suggestion()) == "dense");
+            var.missing = 60;
+            wassert(actual(var.suggestion()) == "sparse");
+            var.constant = true;
+            wassert(actual(var.suggestion()) == "scalar");
+
+            VariableSparsity rep;
+            rep.loop = "Loop_000_maxlen";
+            rep.cells = 100;
+            rep.values = 30;
+            wassert(actual(rep.padding()) == 70u);
+            wassert(actual(rep.suggestion()) == "ragged");
+        });
+
+        add_method("temp", []() {
+            Sparsity sparsity;
+            Options opts;
+            Instruments instruments;
+            instruments.sparsity = &sparsity;
+            opts.instruments = &instruments;
+            b2nc::tests::convert_datafile(opts, "test-sparsity", "bufr/cdfin_temp");
+
+            vector<OutputSparsity> outputs = sparsity.get_outputs();
+            wassert(actual(outputs.size()) > 0u);
+            bool found_loop = false;
+            bool found_mpn = false;
+            for (const auto& o: outputs)
+            {
+                wassert(actual(o.fname).startswith("test-sparsity/out-"));
+                wassert(actual(o.records) > 0u);
+                for (const auto& l: o.loops)
+                {
+                    found_loop = true;
+                    wassert(actual(l.median_rep) <= (double)l.max_rep);
+                    wassert(actual(l.repetitions) <= o.records * l.max_rep);
+                }
+                for (const auto& v: o.variables)
+                {
+                    wassert(actual(v.values) <= v.cells);
+                    wassert(actual(v.missing) <= v.values);
+                    if (v.name != "MPN") continue;
+                    // Soundings have different numbers of levels
+                    found_mpn = true;
+                    wassert(actual(v.loop).startswith("Loop_"));
+                    wassert(actual(v.padding()) > 0u);
+                }
+            }
+            wassert_true(found_loop);
+            wassert_true(found_mpn);
+
+            string json;
+            sparsity.to_json(json);
+            wassert(actual(json).startswith("{\"outputs\":[{\"fname\":"));
+            wassert(actual(json).contains("\"median_rep\":"));
+            wassert(actual(json).contains("\"suggestion\":\""));
+        });
+    }
+} test("sparsity");
+
+}
@@ -0,0 +1,210 @@
+/*
+ * sparsity - Analysis of padding and missing values in the outputs
+ *
+ * Copyright (C) 2026  ARPA-SIM <urpsim@smr.arpa.emr.it>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#include "sparsity.h"
+#include "plan.h"
+#include "valarray.h"
+#include "json.h"
+#include <wreport/utils/sys.h>
+#include <algorithm>
+
+using namespace wreport;
+using namespace std;
+
+namespace b2nc {
+
+namespace {
+
+/// Median of \a vals, which is reordered
+double median(std::vector<size_t>& vals)
+{
+    if (vals.empty())
+        return 0;
+    size_t mid = vals.size() / 2;
+    std::nth_element(vals.begin(), vals.begin() + mid, vals.end());
+    if (vals.size() % 2)
+        return vals[mid];
+    size_t upper = vals[mid];
+    size_t lower = *std::max_element(vals.begin(), vals.begin() + mid);
+    return (lower + upper) / 2.0;
+}
+
+double fraction(size_t part, size_t total)
+{
+    return total ? (double)part / total : 0;
+}
+
+}
+
+const char* VariableSparsity::suggestion() const
+{
+    if (constant && values > 0)
+        return "scalar";
+    if (missing * 2 >= values && values > 0)
+        return "sparse";
+    if (!loop.empty() && padding() * 2 >= cells)
+        return "ragged";
+    return "dense";
+}
+
+void OutputSparsity::analyse(const Plan& plan, size_t records)
+{
+    this->records = records;
+    for (const auto* section: plan.sections)
+    {
+        vector<const ValArray*> arrays = section->written_arrays();
+        if (arrays.empty())
+            continue;
+
+        // All arrays of a replicated section share its loop dimension
+        LoopSparsity loop;
+        for (const ValArray* arr: arrays)
+        {
+            if (!arr->get_loopinfo())
+                continue;
+            if (loop.dim.empty())
+            {
+                loop.dim = arr->get_loopinfo()->dim_name();
+                vector<size_t> reps(records);
+                for (size_t i = 0; i < records; ++i)
+                {
+                    reps[i] = arr->get_rep_count(i);
+                    loop.repetitions += reps[i];
+                }
+                loop.median_rep = median(reps);
+            }
+            loop.max_rep = max(loop.max_rep, arr->get_max_rep());
+        }
+        if (!loop.dim.empty())
+            loops.push_back(loop);
+
+        for (const ValArray* arr: arrays)
+        {
+            VariableSparsity var;
+            var.name = arr->name;
+            var.cells = arr->written_cells(records);
+            if (arr->get_loopinfo())
+                var.loop = loop.dim;
+            var.values = arr->get_stored_count();
+            var.missing = arr->get_missing_count();
+            var.constant = arr->is_constant;
+            variables.push_back(var);
+        }
+    }
+}
+
+void OutputSparsity::to_json(JSONWriter& json) const
+{
+    size_t cells = 0, values = 0, missing = 0;
+    for (const auto& v: variables)
+    {
+        cells += v.cells;
+        values += v.values;
+        missing += v.missing;
+    }
+
+    json.start_mapping();
+    json.add("fname", fname);
+    json.add("records", records);
+    json.add("cells", cells);
+    json.add("values", values);
+    json.add("missing", missing);
+    json.add("padding_fraction", fraction(cells - values, cells));
+    json.add("missing_fraction", fraction(missing, values));
+
+    json.add_cstring("loops");
+    json.start_list();
+    for (const auto& l: loops)
+    {
+        json.start_mapping();
+        json.add("dim", l.dim);
+        json.add("max_rep", l.max_rep);
+        json.add("median_rep", l.median_rep);
+        json.add("mean_rep", records ? (double)l.repetitions / records : 0.0);
+        json.add("repetitions", l.repetitions);
+        json.add("padding_fraction", fraction(records * l.max_rep - l.repetitions, records * l.max_rep));
+        json.end_mapping();
+    }
+    json.end_list();
+
+    json.add_cstring("variables");
+    json.start_list();
+    for (const auto& v: variables)
+    {
+        json.start_mapping();
+        json.add("name", v.name);
+        json.add_cstring("loop");
+        if (v.loop.empty())
+            json.add_null();
+        else
+            json.add(v.loop);
+        json.add("cells", v.cells);
+        json.add("values", v.values);
+        json.add("missing", v.missing);
+        json.add("padding", v.padding());
+        json.add("missing_fraction", fraction(v.missing, v.values));
+        json.add("wasted_fraction", fraction(v.wasted(), v.cells));
+        json.add("constant", v.constant);
+        json.add("suggestion", v.suggestion());
+        json.end_mapping();
+    }
+    json.end_list();
+    json.end_mapping();
+}
+
+void Sparsity::add(OutputSparsity&& output)
+{
+    lock_guard<mutex> guard(lock);
+    outputs.push_back(move(output));
+}
+
+std::vector<OutputSparsity> Sparsity::get_outputs() const
+{
+    vector<OutputSparsity> res;
+    {
+        lock_guard<mutex> guard(lock);
+        res = outputs;
+    }
+    std::stable_sort(res.begin(), res.end(), [](const OutputSparsity& a, const OutputSparsity& b) {
+        return a.fname < b.fname;
+    });
+    return res;
+}
+
+void Sparsity::to_json(std::string& out) const
+{
+    JSONWriter json(out);
+    json.start_mapping();
+    json.add_cstring("outputs");
+    json.start_list();
+    for (const auto& o: get_outputs())
+        o.to_json(json);
+    json.end_list();
+    json.end_mapping();
+}
+
+void Sparsity::write(const std::string& fname) const
+{
+    string out;
+    to_json(out);
+    out += '\n';
+    sys::write_file_atomically(fname, out, 0666);
+}
+
+}
@@ -0,0 +1,117 @@
+/*
+ * sparsity - Analysis of padding and missing values in the outputs
+ *
+ * Copyright (C) 2026  ARPA-SIM <urpsim@smr.arpa.emr.it>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#ifndef B2NC_SPARSITY_H
+#define B2NC_SPARSITY_H
+
+#include <mutex>
+#include <string>
+#include <vector>
+#include <cstddef>
+
+namespace b2nc {
+
+struct Plan;
+class JSONWriter;
+
+/// Loop dimension of a replicated section
+struct LoopSparsity
+{
+    /// Name of the NetCDF dimension
+    std::string dim;
+    /// Size of the dimension: the longest replication
+    size_t max_rep = 0;
+    /// Median replication over all records, counting those without the section as 0
+    double median_rep = 0;
+    /// Total number of repetitions in all records
+    size_t repetitions = 0;
+};
+
+/// Cells written and values held by one output variable
+struct VariableSparsity
+{
+    std::string name;
+    /// Loop dimension, or empty if the variable is not replicated
+    std::string loop;
+    /// Cells written, including padding
+    size_t cells = 0;
+    /// Values found in the input, either set or missing
+    size_t values = 0;
+    /// Values found in the input, or filling gaps between records, that are missing
+    size_t missing = 0;
+    /// True if all the values are the same
+    bool constant = false;
+
+    /// Cells written only to pad records to the loop or output size
+    size_t padding() const { return cells - values; }
+
+    /// Cells that do not hold a set value
+    size_t wasted() const { return padding() + missing; }
+
+    /**
+     * Representation that would save the most cells: "scalar" for constant
+     * variables, "sparse" for variables that are mostly missing, "ragged"
+     * for replicated variables that are mostly padding, or "dense"
+     */
+    const char* suggestion() const;
+};
+
+/// Padding and missing values in one output
+struct OutputSparsity
+{
+    std::string fname;
+    size_t records = 0;
+    std::vector<LoopSparsity> loops;
+    std::vector<VariableSparsity> variables;
+
+    /// Analyse the arrays of \a plan, to be written as \a records records
+    void analyse(const Plan& plan, size_t records);
+
+    void to_json(JSONWriter& json) const;
+};
+
+/**
+ * Collect the padding and missing value analysis of all the outputs of a
+ * conversion.
+ *
+ * It is enabled by setting Instruments::sparsity, and outputs can be added by
+ * many threads at the same time.
+ */
+class Sparsity
+{
+protected:
+    mutable std::mutex lock;
+    std::vector<OutputSparsity> outputs;
+
+public:
+    void add(OutputSparsity&& output);
+
+    /// Return a copy of the analysis of all outputs, sorted by file name
+    std::vector<OutputSparsity> get_outputs() const;
+
+    /// Append the JSON report to \a out
+    void to_json(std::string& out) const;
+
+    /// Write the JSON report to \a fname
+    void write(const std::string& fname) const;
+};
+
+}
+
+#endif
@@ -0,0 +1,114 @@
+/*
+ * Copyright (C) 2026  ARPA-SIM <urpsim@smr.arpa.emr.it>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#include "stats.h"
+#include "options.h"
+#include "instruments.h"
+#include "tests/tests.h"
+
+using namespace b2nc;
+using namespace wreport;
+using namespace wreport::tests;
+using namespace std;
+
+namespace {
+
+class Tests : public TestCase
+{
+    using TestCase::TestCase;
+
+    void register_tests() override
+    {
+        add_method("temp", []() {
+            Stats stats;
+            Options opts;
+            Instruments instruments;
+            instruments.stats = &stats;
+            opts.instruments = &instruments;
+            b2nc::tests::convert_datafile(opts, "test-stats", "bufr/cdfin_temp");
+
+            wassert(actual(stats.phases[(unsigned)Phase::READ].calls.load()) > 0u);
+            wassert(actual(stats.phases[(unsigned)Phase::DECODE].calls.load()) > 0u);
+            wassert(actual(stats.phases[(unsigned)Phase::PUTVAR].calls.load()) > 0u);
+
+            // Soundings are replicated and padded to the longest one
+            vector<const KeyStats*> outputs = stats.outputs();
+            wassert(actual(outputs.size()) > 0u);
+            uint64_t messages = 0, replications = 0, padding = 0;
+            for (const KeyStats* key: outputs)
+            {
+                wassert(actual(key->messages.load()) > 0u);
+                wassert(actual(key->subsets.load()) >= key->messages.load());
+                wassert(actual(key->values.load()) > 0u);
+                wassert(actual(key->variable_bytes.empty()).isfalse());
+                wassert(actual(key->phases[(unsigned)Phase::ARRAYS].calls.load()) == key->messages.load());
+                wassert(actual(key->phases[(unsigned)Phase::CLOSE].calls.load()) == 1u);
+                messages += key->messages.load();
+                replications += key->replications.load();
+                padding += key->padding_cells.load();
+            }
+            wassert(actual(messages) == stats.phases[(unsigned)Phase::DECODE].calls.load());
+            wassert(actual(replications) > 0u);
+            wassert(actual(padding) > 0u);
+
+            string json;
+            stats.to_json(json);
+            wassert(actual(json).contains("\"phases\":{\"read\":{\"calls\":"));
+            wassert(actual(json).contains("\"fname\":\"test-stats/out-"));
+            wassert(actual(json).contains("\"padding_cells\":"));
+            wassert(actual(json).contains("\"bytes_written\":"));
+        });
+
+        add_method("backends", []() {
+            // Backends that do not write through NetCDF report the bytes of
+            // each column they write
+            for (const char* format: { "zarr", "npy", "arrow" })
+            {
+                Stats stats;
+                Options opts;
+                opts.format = format;
+                opts.jobs = 2;
+                Instruments instruments;
+                instruments.stats = &stats;
+                opts.instruments = &instruments;
+                b2nc::tests::convert_datafile(opts, "test-stats", "bufr/cdfin_temp");
+
+                vector<const KeyStats*> outputs = stats.outputs();
+                wassert(actual(outputs.size()) > 0u);
+                for (const KeyStats* key: outputs)
+                {
+                    wassert(actual(key->variable_bytes.empty()).isfalse());
+                    for (const auto& v: key->variable_bytes)
+                        wassert(actual(v.second) > 0u);
+                }
+            }
+        });
+
+        add_method("disabled", []() {
+            // Timers with nowhere to add time do nothing
+            PhaseTimer t1((Stats*)nullptr, Phase::READ);
+            PhaseTimer t2((KeyStats*)nullptr, Phase::PLAN);
+
+            Stats stats;
+            string json;
+            stats.to_json(json);
+            wassert(actual(json).contains("\"outputs\":[]"));
+        });
+    }
+} test("stats");
+
+}
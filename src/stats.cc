@@ -0,0 +1,258 @@
+/*
+ * stats - Timings and counters of a conversion
+ *
+ * Copyright (C) 2026  ARPA-SIM <urpsim@smr.arpa.emr.it>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#include "stats.h"
+#include "plan.h"
+#include "json.h"
+#include "utils.h"
+#include <wreport/utils/sys.h>
+#include <netcdf.h>
+#include <ctime>
+#include <sys/resource.h>
+
+using namespace wreport;
+using namespace std;
+
+namespace b2nc {
+
+namespace {
+
+const char* phase_names[phase_count] = {
+    "read",
+    "decode",
+    "plan",
+    "arrays",
+    "define",
+    "enddef",
+    "putvar",
+    "close",
+};
+
+void phases_to_json(const PhaseTime* phases, JSONWriter& json)
+{
+    json.start_mapping();
+    for (unsigned i = 0; i < phase_count; ++i)
+    {
+        json.add_cstring(phase_names[i]);
+        json.start_mapping();
+        json.add("calls", (unsigned long long)phases[i].calls);
+        json.add("wall_seconds", phases[i].wall_ns / 1e9);
+        json.add("cpu_seconds", phases[i].cpu_ns / 1e9);
+        json.end_mapping();
+    }
+    json.end_mapping();
+}
+
+void add_time(PhaseTime* time, uint64_t wall_ns, uint64_t cpu_ns)
+{
+    if (!time) return;
+    ++time->calls;
+    time->wall_ns += wall_ns;
+    time->cpu_ns += cpu_ns;
+}
+
+}
+
+const char* phase_name(Phase phase)
+{
+    return phase_names[(unsigned)phase];
+}
+
+void KeyStats::add_cpu(Phase phase, uint64_t cpu_ns)
+{
+    phases[(unsigned)phase].cpu_ns += cpu_ns;
+    owner.phases[(unsigned)phase].cpu_ns += cpu_ns;
+}
+
+void KeyStats::count_cells(const Plan& plan, size_t records)
+{
+    for (const auto* section: plan.sections)
+    {
+        bool counted_replications = section->id == 0;
+        for (const ValArray* arr: section->written_arrays())
+        {
+            size_t stored = arr->get_stored_count();
+            values += stored;
+            padding_cells += arr->written_cells(records) - stored;
+
+            // Each repetition adds one value to all the arrays of the
+            // replicated section
+            if (!counted_replications)
+            {
+                replications += stored;
+                counted_replications = true;
+            }
+        }
+    }
+}
+
+void KeyStats::count_variable_bytes(int ncid)
+{
+    int nvars;
+    int res = nc_inq_nvars(ncid, &nvars);
+    error_netcdf::throwf_iferror(res, "reading the number of variables of %s", fname.c_str());
+    for (int v = 0; v < nvars; ++v)
+    {
+        char name[NC_MAX_NAME + 1];
+        nc_type type;
+        int ndims;
+        int dimids[NC_MAX_VAR_DIMS];
+        res = nc_inq_var(ncid, v, name, &type, &ndims, dimids, NULL);
+        error_netcdf::throwf_iferror(res, "reading variable %d of %s", v, fname.c_str());
+
+        size_t size;
+        res = nc_inq_type(ncid, type, NULL, &size);
+        error_netcdf::throwf_iferror(res, "reading the type of variable %s", name);
+        for (int d = 0; d < ndims; ++d)
+        {
+            size_t len;
+            res = nc_inq_dimlen(ncid, dimids[d], &len);
+            error_netcdf::throwf_iferror(res, "reading a dimension of variable %s", name);
+            size *= len;
+        }
+        lock_guard<mutex> guard(variable_lock);
+        variable_bytes[name] = size;
+    }
+}
+
+void KeyStats::add_variable_bytes(const std::string& name, uint64_t bytes)
+{
+    lock_guard<mutex> guard(variable_lock);
+    variable_bytes[name] += bytes;
+}
+
+Stats::Stats()
+    : start(std::chrono::steady_clock::now())
+{
+}
+
+KeyStats& Stats::key(const std::string& fname)
+{
+    lock_guard<mutex> guard(lock);
+    unique_ptr<KeyStats>& res = keys[fname];
+    if (!res)
+        res.reset(new KeyStats(*this, fname));
+    return *res;
+}
+
+std::vector<const KeyStats*> Stats::outputs() const
+{
+    lock_guard<mutex> guard(lock);
+    vector<const KeyStats*> res;
+    for (const auto& i: keys)
+        res.push_back(i.second.get());
+    return res;
+}
+
+void Stats::to_json(std::string& out) const
+{
+    JSONWriter json(out);
+    json.start_mapping();
+
+    double wall = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    json.add("wall_seconds", wall);
+    struct rusage ru;
+    if (getrusage(RUSAGE_SELF, &ru) == 0)
+    {
+        json.add("cpu_seconds", ru.ru_utime.tv_sec + ru.ru_utime.tv_usec / 1e6
+                              + ru.ru_stime.tv_sec + ru.ru_stime.tv_usec / 1e6);
+        json.add("max_rss_kb", (long)ru.ru_maxrss);
+    }
+
+    json.add_cstring("phases");
+    phases_to_json(phases, json);
+
+    json.add_cstring("outputs");
+    json.start_list();
+    for (const KeyStats* i: outputs())
+    {
+        const KeyStats& k = *i;
+        uint64_t bytes = 0;
+        for (const auto& v: k.variable_bytes)
+            bytes += v.second;
+
+        json.start_mapping();
+        json.add("fname", k.fname);
+        json.add("data_category", k.data_category);
+        json.add("data_subcategory", k.data_subcategory);
+        json.add("data_subcategory_local", k.data_subcategory_local);
+        json.add("master_table_version_number", k.master_table_version_number);
+        json.add("messages", (unsigned long long)k.messages);
+        json.add("subsets", (unsigned long long)k.subsets);
+        json.add("values", (unsigned long long)k.values);
+        json.add("replications", (unsigned long long)k.replications);
+        json.add("padding_cells", (unsigned long long)k.padding_cells);
+        json.add("bytes_written", (unsigned long long)bytes);
+        json.add_cstring("phases");
+        phases_to_json(k.phases, json);
+        json.add_cstring("variables");
+        json.start_mapping();
+        for (const auto& v: k.variable_bytes)
+            json.add(v.first.c_str(), (unsigned long long)v.second);
+        json.end_mapping();
+        json.end_mapping();
+    }
+    json.end_list();
+
+    json.end_mapping();
+}
+
+void Stats::write(const std::string& fname) const
+{
+    string out;
+    to_json(out);
+    out += '\n';
+    sys::write_file_atomically(fname, out, 0666);
+}
+
+PhaseTimer::PhaseTimer(Stats* stats, Phase phase)
+{
+    if (!stats) return;
+    total = &stats->phases[(unsigned)phase];
+    start_wall = std::chrono::steady_clock::now();
+    start_cpu = thread_cpu_ns();
+}
+
+PhaseTimer::PhaseTimer(KeyStats* key, Phase phase)
+{
+    if (!key) return;
+    total = &key->owner.phases[(unsigned)phase];
+    this->key = &key->phases[(unsigned)phase];
+    start_wall = std::chrono::steady_clock::now();
+    start_cpu = thread_cpu_ns();
+}
+
+PhaseTimer::~PhaseTimer()
+{
+    if (!total) return;
+    uint64_t wall = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start_wall).count();
+    uint64_t cpu = thread_cpu_ns() - start_cpu;
+    add_time(total, wall, cpu);
+    add_time(key, wall, cpu);
+}
+
+uint64_t PhaseTimer::thread_cpu_ns()
+{
+    struct timespec ts;
+    if (clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts) != 0)
+        return 0;
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+}
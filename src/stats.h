@@ -0,0 +1,184 @@
+/*
+ * stats - Timings and counters of a conversion
+ *
+ * Copyright (C) 2026  ARPA-SIM <urpsim@smr.arpa.emr.it>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#ifndef B2NC_STATS_H
+#define B2NC_STATS_H
+
+#include <atomic>
+#include <chrono>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <cstdint>
+
+namespace b2nc {
+
+struct Plan;
+class Stats;
+
+/// Phases of a conversion timed by Stats
+enum class Phase
+{
+    /// Reading encoded messages from the input
+    READ,
+    /// Decoding messages with wreport
+    DECODE,
+    /// Building conversion plans, or loading them from the cache
+    PLAN,
+    /// Adding decoded subsets to the output arrays
+    ARRAYS,
+    /// Defining NetCDF dimensions, variables and attributes
+    DEFINE,
+    /// Leaving NetCDF define mode
+    ENDDEF,
+    /// Writing NetCDF variables
+    PUTVAR,
+    /// Closing the output file
+    CLOSE,
+};
+
+/// Number of values in Phase
+static const unsigned phase_count = 8;
+
+/// Name of a phase, as used in the JSON report
+const char* phase_name(Phase phase);
+
+/// Time spent in a phase
+struct PhaseTime
+{
+    std::atomic<uint64_t> calls{0};
+    std::atomic<uint64_t> wall_ns{0};
+    /// CPU time of the threads that ran the phase
+    std::atomic<uint64_t> cpu_ns{0};
+};
+
+/// Timings and counters of the output of one dispatch key
+struct KeyStats
+{
+    Stats& owner;
+    /// Output file name
+    std::string fname;
+    int data_category = 0;
+    int data_subcategory = 0;
+    int data_subcategory_local = 0;
+    int master_table_version_number = 0;
+
+    PhaseTime phases[phase_count];
+    std::atomic<uint64_t> messages{0};
+    std::atomic<uint64_t> subsets{0};
+    /// Values stored in the output arrays
+    std::atomic<uint64_t> values{0};
+    /// Repetitions of replicated sections
+    std::atomic<uint64_t> replications{0};
+    /// Cells written with fill values to pad arrays to a fixed size
+    std::atomic<uint64_t> padding_cells{0};
+    /// Bytes written for each output variable
+    std::map<std::string, uint64_t> variable_bytes;
+    /// Protects variable_bytes from backends writing columns in parallel
+    std::mutex variable_lock;
+
+    KeyStats(Stats& owner, const std::string& fname) : owner(owner), fname(fname) {}
+
+    /**
+     * Add CPU time spent in \a phase by a helper thread, whose wall time is
+     * already accounted for by the thread that waited for it
+     */
+    void add_cpu(Phase phase, uint64_t cpu_ns);
+
+    /**
+     * Count the values, replications and padding of the arrays of \a plan,
+     * to be written as \a records records
+     */
+    void count_cells(const Plan& plan, size_t records);
+
+    /// Record the size of all the variables of a NetCDF file in data mode
+    void count_variable_bytes(int ncid);
+
+    /**
+     * Add \a bytes to the size written for the variable \a name, for
+     * backends that do not write through NetCDF. It can be called by many
+     * threads at the same time.
+     */
+    void add_variable_bytes(const std::string& name, uint64_t bytes);
+};
+
+/**
+ * Collect wall and CPU time of each conversion phase, and counters of the
+ * data converted for each dispatch key.
+ *
+ * It is enabled by setting Instruments::stats, and it can be used by many
+ * threads at the same time.
+ */
+class Stats
+{
+protected:
+    std::chrono::steady_clock::time_point start;
+    mutable std::mutex lock;
+    std::map<std::string, std::unique_ptr<KeyStats>> keys;
+
+public:
+    /// Totals of all phases, including those not attributed to a key
+    PhaseTime phases[phase_count];
+
+    Stats();
+
+    /// Return the statistics for the output file \a fname, creating them if needed
+    KeyStats& key(const std::string& fname);
+
+    /// Return the statistics of all output files, sorted by file name
+    std::vector<const KeyStats*> outputs() const;
+
+    /// Append the JSON report to \a out
+    void to_json(std::string& out) const;
+
+    /// Write the JSON report to \a fname
+    void write(const std::string& fname) const;
+};
+
+/**
+ * Add the time from construction to destruction to a phase.
+ *
+ * It does nothing if there is nowhere to add the time.
+ */
+class PhaseTimer
+{
+protected:
+    PhaseTime* total = nullptr;
+    PhaseTime* key = nullptr;
+    std::chrono::steady_clock::time_point start_wall;
+    uint64_t start_cpu = 0;
+
+public:
+    /// Time a phase not attributed to a dispatch key
+    PhaseTimer(Stats* stats, Phase phase);
+    /// Time a phase of the output of \a key
+    PhaseTimer(KeyStats* key, Phase phase);
+    PhaseTimer(const PhaseTimer&) = delete;
+    PhaseTimer& operator=(const PhaseTimer&) = delete;
+    ~PhaseTimer();
+
+    /// CPU time used by the calling thread, in nanoseconds
+    static uint64_t thread_cpu_ns();
+};
+
+}
+
+#endif
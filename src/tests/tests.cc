@@ -20,8 +20,11 @@
  */
 
 #include "tests/tests.h"
+#include "convert.h"
+#include "options.h"
 #include <wreport/error.h>
 #include <wreport/utils/string.h>
+#include <wreport/utils/sys.h>
 #include <iostream>
 #include <cstdlib>
 #include <cstdio>
@@ -62,6 +65,21 @@ std::string slurpfile(const std::string& name)
     return res;
 }
 
+void reset_output(Options& opts, const std::string& dir)
+{
+    sys::rmtree_ifexists(dir);
+    sys::makedirs(dir);
+    opts.out_fname = str::joinpath(dir, "out") + Outfile::backend_extension(opts.format);
+}
+
+void convert_datafile(Options& opts, const std::string& dir, const std::string& name)
+{
+    reset_output(opts, dir);
+    Dispatcher dispatcher(opts);
+    read_bufr(opts, datafile(name), dispatcher);
+    dispatcher.close();
+}
+
 LocalEnv::LocalEnv(const std::string& key, const std::string& val)
     : key(key)
 {
@@ -23,6 +23,8 @@
 #include <string>
 
 namespace b2nc {
+struct Options;
+
 namespace tests {
 
 /**
@@ -37,6 +39,17 @@ std::string datafile(const std::string& fname);
  */
 std::string slurpfile(const std::string& name);
 
+/**
+ * Recreate the directory \a dir empty, and set opts.out_fname to write
+ * outputs in it, named "out" plus the extension of opts.format
+ */
+void reset_output(Options& opts, const std::string& dir);
+
+/**
+ * Convert the test file \a name with \a opts, to outputs in \a dir set up
+ * with reset_output()
+ */
+void convert_datafile(Options& opts, const std::string& dir, const std::string& name);
 
 /// RAII-style override of an environment variable
 class LocalEnv
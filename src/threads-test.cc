@@ -0,0 +1,74 @@
+/*
+ * Copyright (C) 2026  ARPA-SIM <urpsim@smr.arpa.emr.it>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#include "threads.h"
+#include "tests/tests.h"
+#include <atomic>
+#include <stdexcept>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+using namespace b2nc;
+using namespace wreport::tests;
+using namespace std;
+
+namespace {
+
+class Tests : public TestCase
+{
+    using TestCase::TestCase;
+
+    void register_tests() override
+    {
+        add_method("parallel_for", []() {
+            for (unsigned jobs: { 0u, 1u, 4u })
+            {
+                vector<atomic<unsigned>> seen(100);
+                parallel_for(jobs, seen.size(), [&](size_t i) { ++seen[i]; });
+                for (const auto& s: seen)
+                    wassert(actual(s.load()) == 1u);
+            }
+        });
+
+        add_method("exceptions", []() {
+            auto func = [](size_t i) {
+                if (i == 10) throw std::runtime_error("test");
+            };
+            wassert_throws(std::runtime_error, parallel_for(4, 100, func));
+            wassert_throws(std::runtime_error, parallel_for(1, 100, func));
+            wassert_throws(std::runtime_error, parallel_for_stealing(4, 100, func));
+        });
+
+        add_method("parallel_for_stealing", []() {
+            for (unsigned jobs: { 0u, 1u, 3u, 8u })
+            {
+                vector<atomic<unsigned>> seen(100);
+                // Uneven task durations, to exercise stealing
+                parallel_for_stealing(jobs, seen.size(), [&](size_t i) {
+                    if (i % 7 == 0)
+                        this_thread::sleep_for(chrono::milliseconds(2));
+                    ++seen[i];
+                });
+                for (const auto& s: seen)
+                    wassert(actual(s.load()) == 1u);
+            }
+        });
+    }
+} tests("threads");
+
+}
@@ -0,0 +1,171 @@
+/*
+ * threads - Multithreading utilities
+ *
+ * Copyright (C) 2026  ARPA-SIM <urpsim@smr.arpa.emr.it>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#include "threads.h"
+#include <atomic>
+#include <deque>
+#include <exception>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+namespace b2nc {
+
+void parallel_for(unsigned jobs, size_t count, std::function<void(size_t)> func)
+{
+    if (jobs <= 1 || count <= 1)
+    {
+        for (size_t i = 0; i < count; ++i)
+            func(i);
+        return;
+    }
+
+    if (jobs > count)
+        jobs = count;
+
+    atomic<size_t> next(0);
+    atomic<bool> failed(false);
+    mutex error_lock;
+    exception_ptr error;
+
+    auto worker = [&]() {
+        while (!failed)
+        {
+            size_t i = next++;
+            if (i >= count)
+                break;
+            try {
+                func(i);
+            } catch (...) {
+                lock_guard<mutex> lock(error_lock);
+                if (!error)
+                    error = current_exception();
+                failed = true;
+            }
+        }
+    };
+
+    vector<thread> threads;
+    threads.reserve(jobs - 1);
+    for (unsigned i = 1; i < jobs; ++i)
+        threads.emplace_back(worker);
+    // The calling thread works too
+    worker();
+    for (auto& t: threads)
+        t.join();
+
+    if (error)
+        rethrow_exception(error);
+}
+
+void parallel_for_stealing(unsigned jobs, size_t count, std::function<void(size_t)> func)
+{
+    if (jobs <= 1 || count <= 1)
+    {
+        for (size_t i = 0; i < count; ++i)
+            func(i);
+        return;
+    }
+
+    if (jobs > count)
+        jobs = count;
+
+    struct Queue
+    {
+        mutex lock;
+        deque<size_t> tasks;
+    };
+    vector<Queue> queues(jobs);
+    for (size_t i = 0; i < count; ++i)
+        queues[i % jobs].tasks.push_back(i);
+
+    atomic<bool> failed(false);
+    mutex error_lock;
+    exception_ptr error;
+
+    // Take the next task of queue \a own, or steal one from another queue
+    auto next_task = [&](unsigned own, size_t& task) {
+        {
+            lock_guard<mutex> lock(queues[own].lock);
+            if (!queues[own].tasks.empty())
+            {
+                task = queues[own].tasks.front();
+                queues[own].tasks.pop_front();
+                return true;
+            }
+        }
+        while (true)
+        {
+            // Queue sizes may change after we looked at them, so retry
+            // until a steal succeeds or all queues are seen empty
+            unsigned victim = own;
+            size_t victim_size = 0;
+            for (unsigned i = 0; i < jobs; ++i)
+            {
+                if (i == own) continue;
+                lock_guard<mutex> lock(queues[i].lock);
+                if (queues[i].tasks.size() > victim_size)
+                {
+                    victim = i;
+                    victim_size = queues[i].tasks.size();
+                }
+            }
+            if (victim == own)
+                return false;
+            lock_guard<mutex> lock(queues[victim].lock);
+            if (!queues[victim].tasks.empty())
+            {
+                task = queues[victim].tasks.back();
+                queues[victim].tasks.pop_back();
+                return true;
+            }
+        }
+    };
+
+    auto worker = [&](unsigned own) {
+        size_t task;
+        while (!failed && next_task(own, task))
+        {
+            try {
+                func(task);
+            } catch (...) {
+                lock_guard<mutex> lock(error_lock);
+                if (!error)
+                    error = current_exception();
+                failed = true;
+            }
+        }
+    };
+
+    vector<thread> threads;
+    threads.reserve(jobs - 1);
+    for (unsigned i = 1; i < jobs; ++i)
+        threads.emplace_back(worker, i);
+    // The calling thread works too
+    worker(0);
+    for (auto& t: threads)
+        t.join();
+
+    if (error)
+        rethrow_exception(error);
+}
+
+}
@@ -0,0 +1,53 @@
+/*
+ * threads - Multithreading utilities
+ *
+ * Copyright (C) 2026  ARPA-SIM <urpsim@smr.arpa.emr.it>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#ifndef B2NC_THREADS_H
+#define B2NC_THREADS_H
+
+#include <functional>
+#include <cstddef>
+
+namespace b2nc {
+
+/**
+ * Call \a func for all the integers in [0, count), distributing the calls
+ * among up to \a jobs threads.
+ *
+ * If jobs is 1 or less, everything runs in the calling thread.
+ *
+ * If a call raises an exception, no new calls are started, and the first
+ * exception raised is rethrown in the calling thread once all threads have
+ * finished.
+ */
+void parallel_for(unsigned jobs, size_t count, std::function<void(size_t)> func);
+
+/**
+ * Like parallel_for, but scheduling the calls with work stealing, for tasks
+ * of very different duration.
+ *
+ * The integers are dealt round robin to one queue per thread. Each thread
+ * runs its own queue in increasing order, and when it is empty it steals the
+ * highest integer left in the longest of the other queues. Passing the
+ * longest tasks first gives a good balance with little contention.
+ */
+void parallel_for_stealing(unsigned jobs, size_t count, std::function<void(size_t)> func);
+
+}
+
+#endif
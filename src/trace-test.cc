@@ -0,0 +1,82 @@
+/*
+ * Copyright (C) 2026  ARPA-SIM <urpsim@smr.arpa.emr.it>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#include "trace.h"
+#include "options.h"
+#include "instruments.h"
+#include "tests/tests.h"
+#include <thread>
+
+using namespace b2nc;
+using namespace wreport;
+using namespace wreport::tests;
+using namespace std;
+
+namespace {
+
+class Tests : public TestCase
+{
+    using TestCase::TestCase;
+
+    void register_tests() override
+    {
+        add_method("convert", []() {
+            Trace trace;
+            Options opts;
+            Instruments instruments;
+            instruments.trace = &trace;
+            opts.instruments = &instruments;
+            b2nc::tests::convert_datafile(opts, "test-trace", "bufr/cdfin_temp");
+            wassert(actual(trace.size()) > 0u);
+
+            string json;
+            trace.to_json(json);
+            wassert(actual(json).startswith("{\"displayTimeUnit\":\"ms\",\"traceEvents\":[{"));
+            for (const char* kind: { "read", "decode", "dispatch", "arrays", "plan", "write", "define", "putvar", "close" })
+                wassert(actual(json).contains(string("\"cat\":\"") + kind + "\""));
+            wassert(actual(json).contains("\"ph\":\"X\""));
+            // Messages are named by file and offset, variables by name
+            wassert(actual(json).contains("cdfin_temp:0\""));
+            wassert(actual(json).contains("\"name\":\"MPN\""));
+        });
+
+        add_method("threads", []() {
+            Trace trace;
+            {
+                TraceSpan span(&trace, "main");
+                std::thread worker([&] {
+                    TraceSpan span(&trace, "worker", "w");
+                });
+                worker.join();
+            }
+            wassert(actual(trace.size()) == 2u);
+            wassert(actual(Trace::thread_id()) == Trace::thread_id());
+
+            string json;
+            trace.to_json(json);
+            wassert(actual(json).contains("\"name\":\"w\",\"cat\":\"worker\""));
+            wassert(actual(json).contains("\"name\":\"main\",\"cat\":\"main\""));
+        });
+
+        add_method("disabled", []() {
+            // Spans with no trace do nothing
+            TraceSpan span(nullptr, "read", "file", 0);
+        });
+    }
+} test("trace");
+
+}
@@ -0,0 +1,139 @@
+/*
+ * trace - Trace events of a conversion, for Chrome and Perfetto
+ *
+ * Copyright (C) 2026  ARPA-SIM <urpsim@smr.arpa.emr.it>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#include "trace.h"
+#include "json.h"
+#include <wreport/utils/sys.h>
+#include <atomic>
+#include <unistd.h>
+
+using namespace wreport;
+using namespace std;
+
+namespace b2nc {
+
+namespace {
+
+std::atomic<unsigned> next_thread_id{1};
+
+}
+
+Trace::Trace()
+    : start(std::chrono::steady_clock::now())
+{
+}
+
+uint64_t Trace::now() const
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+}
+
+void Trace::add(const char* kind, std::string&& detail, uint64_t start_ns)
+{
+    uint64_t end_ns = now();
+    unsigned tid = thread_id();
+    lock_guard<mutex> guard(lock);
+    events.push_back(TraceEvent{kind, move(detail), start_ns, end_ns - start_ns, tid});
+}
+
+size_t Trace::size() const
+{
+    lock_guard<mutex> guard(lock);
+    return events.size();
+}
+
+void Trace::to_json(std::string& out) const
+{
+    lock_guard<mutex> guard(lock);
+    long pid = getpid();
+    JSONWriter json(out);
+    json.start_mapping();
+    json.add("displayTimeUnit", "ms");
+    json.add_cstring("traceEvents");
+    json.start_list();
+    for (const auto& e: events)
+    {
+        json.start_mapping();
+        json.add("name", e.detail.empty() ? string(e.kind) : e.detail);
+        json.add("cat", e.kind);
+        json.add("ph", "X");
+        // Timestamps are in microseconds
+        json.add("ts", e.start_ns / 1e3);
+        json.add("dur", e.duration_ns / 1e3);
+        json.add("pid", pid);
+        json.add("tid", e.tid);
+        json.end_mapping();
+    }
+    json.end_list();
+    json.end_mapping();
+}
+
+void Trace::write(const std::string& fname) const
+{
+    string out;
+    to_json(out);
+    out += '\n';
+    sys::write_file_atomically(fname, out, 0666);
+}
+
+unsigned Trace::thread_id()
+{
+    thread_local unsigned id = next_thread_id++;
+    return id;
+}
+
+TraceSpan::TraceSpan(Trace* trace, const char* kind)
+    : trace(trace), kind(kind)
+{
+    if (trace) start_ns = trace->now();
+}
+
+TraceSpan::TraceSpan(Trace* trace, const char* kind, const std::string& detail)
+    : trace(trace), kind(kind)
+{
+    if (!trace) return;
+    this->detail = detail;
+    start_ns = trace->now();
+}
+
+TraceSpan::TraceSpan(Trace* trace, const char* kind, const char* detail)
+    : trace(trace), kind(kind)
+{
+    if (!trace) return;
+    if (detail) this->detail = detail;
+    start_ns = trace->now();
+}
+
+TraceSpan::TraceSpan(Trace* trace, const char* kind, const char* fname, off_t offset)
+    : trace(trace), kind(kind)
+{
+    if (!trace) return;
+    detail = fname ? fname : "(memory)";
+    detail += ':';
+    detail += to_string((long long)offset);
+    start_ns = trace->now();
+}
+
+TraceSpan::~TraceSpan()
+{
+    if (trace)
+        trace->add(kind, move(detail), start_ns);
+}
+
+}
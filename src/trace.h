@@ -0,0 +1,109 @@
+/*
+ * trace - Trace events of a conversion, for Chrome and Perfetto
+ *
+ * Copyright (C) 2026  ARPA-SIM <urpsim@smr.arpa.emr.it>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#ifndef B2NC_TRACE_H
+#define B2NC_TRACE_H
+
+#include <chrono>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <sys/types.h>
+
+namespace b2nc {
+
+/// A timed span of work in one thread
+struct TraceEvent
+{
+    /// Kind of work, like "decode" or "putvar"
+    const char* kind;
+    /// What was worked on, like a file name or a variable name
+    std::string detail;
+    /// Start time, in nanoseconds since the start of the trace
+    uint64_t start_ns;
+    uint64_t duration_ns;
+    /// Small integer identifying the thread
+    unsigned tid;
+};
+
+/**
+ * Collect spans of work of a conversion, to be written as a Chrome trace
+ * event file that can be loaded in chrome://tracing or Perfetto.
+ *
+ * It is enabled by setting Instruments::trace, and it can be used by many
+ * threads at the same time. Events are kept in memory until written.
+ */
+class Trace
+{
+protected:
+    std::chrono::steady_clock::time_point start;
+    mutable std::mutex lock;
+    std::vector<TraceEvent> events;
+
+public:
+    Trace();
+
+    /// Nanoseconds elapsed since the start of the trace
+    uint64_t now() const;
+
+    /// Add a span of work that started at \a start_ns and ended now
+    void add(const char* kind, std::string&& detail, uint64_t start_ns);
+
+    /// Number of events collected so far
+    size_t size() const;
+
+    /// Append the trace event JSON to \a out
+    void to_json(std::string& out) const;
+
+    /// Write the trace event JSON to \a fname
+    void write(const std::string& fname) const;
+
+    /// Identifier of the calling thread in the trace
+    static unsigned thread_id();
+};
+
+/**
+ * Add to a Trace a span from construction to destruction.
+ *
+ * It does nothing if there is no Trace, and in that case it does not build
+ * its detail string either.
+ */
+class TraceSpan
+{
+protected:
+    Trace* trace;
+    const char* kind;
+    std::string detail;
+    uint64_t start_ns = 0;
+
+public:
+    TraceSpan(Trace* trace, const char* kind);
+    TraceSpan(Trace* trace, const char* kind, const std::string& detail);
+    TraceSpan(Trace* trace, const char* kind, const char* detail);
+    /// Span about the message at \a offset in \a fname
+    TraceSpan(Trace* trace, const char* kind, const char* fname, off_t offset);
+    TraceSpan(const TraceSpan&) = delete;
+    TraceSpan& operator=(const TraceSpan&) = delete;
+    ~TraceSpan();
+};
+
+}
+
+#endif
@@ -112,6 +112,45 @@ class Tests : public TestCase
 
             outfile.close();
         });
+
+        add_method("padding", []() {
+            // Test that records with no values are written with fill values
+            const Vartable* table = Vartable::get_bufr(BufrTableID(0, 0, 0, 14, 0));
+            wassert(actual(table).istrue());
+
+            LoopInfo loopinfo;
+            Var var(table->query(WR_VAR(0, 7, 4)));
+            unique_ptr<ValArray> arr(ValArray::make_multivalarray(Namer::DT_DATA, var.info(), loopinfo));
+            arr->name = "TEST";
+            arr->mnemo = "TEST";
+            arr->rcnt = 0;
+            arr->type = Namer::DT_DATA;
+
+            // Only the first of two records has values
+            var.set(85000.0);
+            arr->add(var, 0);
+            var.set(70000.0);
+            arr->add(var, 0);
+
+            Options opts;
+            NCOutfile outfile(opts);
+            outfile.open(testfname);
+            outfile.record_count = 2;
+
+            arr->define(outfile);
+            outfile.end_define_mode();
+            arr->putvar(outfile);
+
+            size_t start[] = {1, 0};
+            size_t count[] = {1, 2};
+            float buf[2];
+            int res = nc_get_vara(outfile.ncid, arr->nc_varid, start, count, buf);
+            error_netcdf::throwf_iferror(res, "reading variable from %s", testfname);
+            wassert(actual(buf[0]) == NC_FILL_FLOAT);
+            wassert(actual(buf[1]) == NC_FILL_FLOAT);
+
+            outfile.close();
+        });
     }
 } tests("valarray");
 
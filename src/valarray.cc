@@ -24,10 +24,12 @@
 #include "mnemo.h"
 #include "ncoutfile.h"
 #include "plan.h"
+#include "memory.h"
 #include <wreport/error.h>
 #include <wreport/var.h>
 #include <wreport/utils/sys.h>
 #include <netcdf.h>
+#include <algorithm>
 #include <cstring>
 
 using namespace wreport;
@@ -50,35 +52,112 @@ template<> inline nc_type get_nc_type<double>() { return NC_DOUBLE; }
 template<> inline nc_type get_nc_type<std::string>() { return NC_CHAR; }
 
 template<typename TYPE>
-static inline void nc_put_att(int ncid, int nc_varid, const char* name, const TYPE& value) { throw error_consistency("nc_put_att called for unknown type"); }
-template<> inline void nc_put_att<std::string>(int ncid, int nc_varid, const char* name, const std::string& value)
+static inline ValType value_type_of() { throw error_consistency("requested value type for unknown type"); }
+template<> inline ValType value_type_of<int>() { return VT_INT; }
+template<> inline ValType value_type_of<float>() { return VT_FLOAT; }
+template<> inline ValType value_type_of<double>() { return VT_DOUBLE; }
+template<> inline ValType value_type_of<std::string>() { return VT_STRING; }
+
+template<typename TYPE>
+static inline Attribute make_fill_attribute() { throw error_consistency("requested fill value attribute for unknown type"); }
+template<> inline Attribute make_fill_attribute<std::string>() { return Attribute::make_text("_FillValue", string(1, NC_FILL_CHAR)); }
+template<> inline Attribute make_fill_attribute<int>() { return Attribute::make_int("_FillValue", NC_FILL_INT); }
+template<> inline Attribute make_fill_attribute<float>() { return Attribute::make_float("_FillValue", NC_FILL_FLOAT); }
+template<> inline Attribute make_fill_attribute<double>() { return Attribute::make_double("_FillValue", NC_FILL_DOUBLE); }
+
+/// Return the vector in \a data that holds values of the given type
+template<typename TYPE>
+static inline std::vector<TYPE>& column_values(ColumnData& data);
+template<> inline std::vector<int>& column_values(ColumnData& data) { return data.ints; }
+template<> inline std::vector<float>& column_values(ColumnData& data) { return data.floats; }
+template<> inline std::vector<double>& column_values(ColumnData& data) { return data.doubles; }
+template<> inline std::vector<std::string>& column_values(ColumnData& data) { return data.strings; }
+
+
+Attribute Attribute::make_text(const std::string& name, const std::string& value)
 {
-    int res = nc_put_att_text(ncid, nc_varid, name, 1, value.c_str());
-    error_netcdf::throwf_iferror(res, "setting %s text attribute", name);
+    Attribute res;
+    res.name = name;
+    res.type = VT_STRING;
+    res.text = value;
+    return res;
 }
-template<> inline void nc_put_att<int>(int ncid, int nc_varid, const char* name, const int& value)
+
+Attribute Attribute::make_int(const std::string& name, int value)
 {
-    int res = nc_put_att_int(ncid, nc_varid, name, NC_INT, 1, &value);
-    error_netcdf::throwf_iferror(res, "setting %s int attribute", name);
+    return make_ints(name, vector<int>{value});
 }
-template<> inline void nc_put_att<float>(int ncid, int nc_varid, const char* name, const float& value)
+
+Attribute Attribute::make_ints(const std::string& name, const std::vector<int>& values)
 {
-    int res = nc_put_att_float(ncid, nc_varid, name, NC_FLOAT, 1, &value);
-    error_netcdf::throwf_iferror(res, "setting %s float attribute", name);
+    Attribute res;
+    res.name = name;
+    res.type = VT_INT;
+    res.ints = values;
+    return res;
 }
-template<> inline void nc_put_att<double>(int ncid, int nc_varid, const char* name, const double& value)
+
+Attribute Attribute::make_float(const std::string& name, float value)
 {
-    int res = nc_put_att_double(ncid, nc_varid, name, NC_DOUBLE, 1, &value);
-    error_netcdf::throwf_iferror(res, "setting %s double attribute", name);
+    Attribute res;
+    res.name = name;
+    res.type = VT_FLOAT;
+    res.reals.push_back(value);
+    return res;
 }
 
+Attribute Attribute::make_double(const std::string& name, double value)
+{
+    Attribute res;
+    res.name = name;
+    res.type = VT_DOUBLE;
+    res.reals.push_back(value);
+    return res;
+}
 
-void LoopInfo::define(NCOutfile& outfile, size_t size)
+void ColumnData::reset(ValType type)
+{
+    this->type = type;
+    ints.clear();
+    floats.clear();
+    doubles.clear();
+    strings.clear();
+    offsets.clear();
+    offsets.push_back(0);
+}
+
+
+/**
+ * Write fill values in records [first, outfile.record_count) of a
+ * one-dimensional variable, so that no element is left unwritten in
+ * NC_NOFILL mode
+ */
+template<typename TYPE>
+static void put_fill_records(NCOutfile& outfile, int nc_varid, size_t first)
+{
+    if (first >= outfile.record_count) return;
+    size_t size = outfile.record_count - first;
+    sys::TempBuffer<TYPE> missing(size);
+    for (size_t i = 0; i < size; ++i)
+        missing[i] = nc_fill<TYPE>();
+    size_t start[] = {first};
+    size_t count[] = {size};
+    int res = nc_put_vara(outfile.ncid, nc_varid, start, count, missing);
+    error_netcdf::throwf_iferror(res, "storing %zd padding values", size);
+}
+
+std::string LoopInfo::dim_name() const
 {
     char dn[20];
     snprintf(dn, 20, "Loop_%03u_maxlen", index);
-    int res = nc_def_dim(outfile.ncid, dn, size, &nc_dimid);
-    error_netcdf::throwf_iferror(res, "creating %s dimension", dn);
+    return dn;
+}
+
+void LoopInfo::define(NCOutfile& outfile, size_t size)
+{
+    string dn = dim_name();
+    int res = nc_def_dim(outfile.ncid, dn.c_str(), size, &nc_dimid);
+    error_netcdf::throwf_iferror(res, "creating %s dimension", dn.c_str());
 }
 
 ValArray::ValArray(wreport::Varinfo info)
@@ -86,45 +165,37 @@ ValArray::ValArray(wreport::Varinfo info)
 {
 }
 
+size_t ValArray::written_cells(size_t records) const
+{
+    size_t res = std::max(records, get_size());
+    if (get_loopinfo())
+        res *= get_max_rep();
+    return res;
+}
+
 namespace {
 
 struct BaseValArray : public ValArray
 {
     explicit BaseValArray(Varinfo info) : ValArray(info) {}
 
-    virtual void add_common_attributes(int ncid)
+    void get_attributes(Attributes& out) const override
     {
-        int res;
-
-        res = nc_put_att_text(ncid, nc_varid, "long_name", strlen(info->desc), info->desc);
-        error_netcdf::throwf_iferror(res, "setting long_name attribute for %s", name.c_str());
-
-        res = nc_put_att_text(ncid, nc_varid, "units", strlen(info->unit), info->unit);
-        error_netcdf::throwf_iferror(res, "setting unit attribute for %s", name.c_str());
-
-        res = nc_put_att_text(ncid, nc_varid, "mnemonic", mnemo.size(), mnemo.data());
-        error_netcdf::throwf_iferror(res, "setting mnemonic attribute for %s", name.c_str());
-
-        const char* tname = Namer::type_name(type);
-        res = nc_put_att_text(ncid, nc_varid, "type", strlen(tname), tname);
-        error_netcdf::throwf_iferror(res, "setting type attribute for %s", name.c_str());
+        out.push_back(Attribute::make_text("long_name", info->desc));
+        out.push_back(Attribute::make_text("units", info->unit));
+        out.push_back(Attribute::make_text("mnemonic", mnemo));
+        out.push_back(Attribute::make_text("type", Namer::type_name(type)));
 
         int ifxy;
         if (master)
             ifxy = WR_VAR_F(master->info->code) * 100000 + WR_VAR_X(master->info->code) * 1000 + WR_VAR_Y(master->info->code);
         else
             ifxy = WR_VAR_F(info->code) * 100000 + WR_VAR_X(info->code) * 1000 + WR_VAR_Y(info->code);
-        res = nc_put_att_int(ncid, nc_varid, "ifxy", NC_INT, 1, &ifxy);
-        error_netcdf::throwf_iferror(res, "setting ifxy attribute for %s", name.c_str());
+        out.push_back(Attribute::make_int("ifxy", ifxy));
 
-        {
-            int rcnt = this->rcnt;
-            res = nc_put_att_int(ncid, nc_varid, "rcnt", NC_INT, 1, &rcnt);
-            error_netcdf::throwf_iferror(res, "setting rcnt attribute for %s", name.c_str());
-        }
+        out.push_back(Attribute::make_int("rcnt", rcnt));
 
-        res = nc_put_att_text(ncid, nc_varid, "dim0_length", strlen("_constant"), "_constant"); // TODO
-        error_netcdf::throwf_iferror(res, "setting dim0_length attribute for %s", name.c_str());
+        out.push_back(Attribute::make_text("dim0_length", "_constant")); // TODO
 
         if (!slaves.empty())
         {
@@ -136,15 +207,13 @@ struct BaseValArray : public ValArray
             //for (size_t i = 0; i < slaves.size(); ++i)
             //    fnames[i] = slaves[i]->name.c_str();
             //res = nc_put_att_string(ncid, nc_varid, "associated_field", slaves.size(), fnames);
-            res = nc_put_att_text(ncid, nc_varid, "associated_field", slaves[0]->name.size(), slaves[0]->name.data());
-            error_netcdf::throwf_iferror(res, "setting associated_field attribute for %s", this->name.c_str());
+            out.push_back(Attribute::make_text("associated_field", slaves[0]->name));
         }
 
         // Refrences attributes
         if (!references.empty())
         {
-            sys::TempBuffer<int> ref_codes(references.size());
-            unsigned rsize = 0;
+            vector<int> ref_codes;
             for (size_t i = 0; i < references.size(); ++i)
             {
                 Varcode code = references[i].first;
@@ -159,9 +228,9 @@ struct BaseValArray : public ValArray
                     continue;
 
                 if (WR_VAR_F(code) == 0)
-                    ref_codes[rsize++] = WR_VAR_F(code) * 100000
-                                       + WR_VAR_X(code) * 1000
-                                       + WR_VAR_Y(code);
+                    ref_codes.push_back(WR_VAR_F(code) * 100000
+                                      + WR_VAR_X(code) * 1000
+                                      + WR_VAR_Y(code));
 
                 char att_name[20];
                 if (WR_VAR_F(code) > 0)
@@ -173,17 +242,28 @@ struct BaseValArray : public ValArray
                 else
                     snprintf(att_name, 20, "reference_%01d%02d%03d", WR_VAR_FXY(code));
 
-                res = nc_put_att_text(ncid, nc_varid, att_name, arr->name.size(), arr->name.data());
-                error_netcdf::throwf_iferror(res, "setting %s attribute for %s", att_name, this->name.c_str());
+                out.push_back(Attribute::make_text(att_name, arr->name));
             }
 
-            if (rsize > 0)
-            {
-                res = nc_put_att_int(ncid, nc_varid, "references", NC_INT, rsize, ref_codes);
-                error_netcdf::throwf_iferror(res, "setting references attribute for %s", name.c_str());
-            }
+            if (!ref_codes.empty())
+                out.push_back(Attribute::make_ints("references", ref_codes));
         }
     }
+
+    /// Heap memory used by the members common to all arrays
+    size_t common_heap_size() const
+    {
+        return heap_size_of(name) + heap_size_of(mnemo)
+             + heap_size_of(references) + heap_size_of(slaves);
+    }
+
+    /// Write the attributes of the variable to a NetCDF file in define mode
+    void add_common_attributes(NCOutfile& outfile) const
+    {
+        Attributes attrs;
+        get_attributes(attrs);
+        outfile.put_attributes(nc_varid, name, attrs);
+    }
 };
 
 template<typename TYPE>
@@ -191,11 +271,12 @@ struct TypedValArray : public BaseValArray
 {
     using BaseValArray::BaseValArray;
 
-    void add_common_attributes(int ncid) override
+    ValType value_type() const override { return value_type_of<TYPE>(); }
+
+    void get_attributes(Attributes& out) const override
     {
-        TYPE missing = nc_fill<TYPE>();
-        nc_put_att(ncid, nc_varid, "_FillValue", missing);
-        BaseValArray::add_common_attributes(ncid);
+        out.push_back(make_fill_attribute<TYPE>());
+        BaseValArray::get_attributes(out);
     }
 };
 
@@ -209,6 +290,18 @@ struct SingleValArray : public TypedValArray<TYPE>
 
     size_t get_size() const override { return vars.size(); }
     size_t get_max_rep() const override { return 1; }
+    size_t get_stored_count() const override { return vars.size(); }
+
+    size_t get_missing_count() const override
+    {
+        return std::count(vars.begin(), vars.end(), nc_fill<TYPE>());
+    }
+
+    size_t heap_size() const override
+    {
+        return sizeof(*this) + this->common_heap_size()
+             + heap_size_of(vars) + heap_size_of(last_val);
+    }
 
     bool has_values() const override
     {
@@ -232,6 +325,28 @@ struct SingleValArray : public TypedValArray<TYPE>
             this->is_constant = false;
     }
 
+    void merge(const ValArray& other, unsigned offset) override
+    {
+        const SingleValArray<TYPE>& o = dynamic_cast<const SingleValArray<TYPE>&>(other);
+        if (o.vars.empty())
+            return;
+
+        bool is_first = vars.empty();
+
+        if (offset + o.vars.size() > vars.size())
+            vars.resize(offset + o.vars.size(), nc_fill<TYPE>());
+        std::copy(o.vars.begin(), o.vars.end(), vars.begin() + offset);
+
+        // Both arrays compare their values with the first one they were given
+        if (is_first)
+        {
+            last_val = o.last_val;
+            this->is_constant = o.is_constant;
+        }
+        else if (this->is_constant && (!o.is_constant || o.last_val != last_val))
+            this->is_constant = false;
+    }
+
     Var get_var(unsigned bufr_idx, unsigned rep) const override
     {
         Var res(this->info);
@@ -240,6 +355,19 @@ struct SingleValArray : public TypedValArray<TYPE>
         return res;
     }
 
+    void collect(size_t first, size_t count, ColumnData& out) const override
+    {
+        out.reset(value_type_of<TYPE>());
+        std::vector<TYPE>& values = column_values<TYPE>(out);
+        values.reserve(count);
+        out.offsets.reserve(count + 1);
+        for (size_t i = first; i < first + count; ++i)
+        {
+            values.push_back(i < vars.size() ? vars[i] : nc_fill<TYPE>());
+            out.offsets.push_back(values.size());
+        }
+    }
+
     void dump(FILE* out) override
     {
         for (size_t i = 0; i < vars.size(); ++i)
@@ -269,7 +397,7 @@ struct SingleNumberArray : public SingleValArray<TYPE>
 
         this->nc_varid = outfile.def_var(this->name.c_str(), get_nc_type<TYPE>(), 1, &bufrdim);
 
-        this->add_common_attributes(outfile.ncid);
+        this->add_common_attributes(outfile);
 
         return true;
     }
@@ -295,6 +423,7 @@ struct SingleIntValArray : public SingleNumberArray<int>
         error_netcdf::throwf_iferror(res, "storing %zd integer values", vars.size());
         delete[] temp;
 #endif
+        put_fill_records<int>(outfile, nc_varid, vars.size());
     }
 };
 
@@ -318,6 +447,7 @@ struct SingleFloatValArray : public SingleNumberArray<float>
         error_netcdf::throwf_iferror(res, "storing %zd float values", vars.size());
         delete[] temp;
 #endif
+        put_fill_records<float>(outfile, nc_varid, vars.size());
     }
 };
 
@@ -341,6 +471,7 @@ struct SingleDoubleValArray : public SingleNumberArray<double>
         error_netcdf::throwf_iferror(res, "storing %zd double values", vars.size());
         delete[] temp;
 #endif
+        put_fill_records<double>(outfile, nc_varid, vars.size());
     }
 };
 
@@ -366,7 +497,7 @@ struct SingleStringValArray : public SingleValArray<std::string>
 
         nc_varid = outfile.def_var(name.c_str(), NC_CHAR, 2, dims);
 
-        add_common_attributes(ncid);
+        add_common_attributes(outfile);
 
         return true;
     }
@@ -380,11 +511,12 @@ struct SingleStringValArray : public SingleValArray<std::string>
         sys::TempBuffer<char> missing(info->len); // Missing value
         memset(missing, NC_FILL_CHAR, info->len);
         sys::TempBuffer<char> value(info->len); // Space-padded value
-        for (size_t i = 0; i < vars.size(); ++i)
+        size_t records = outfile.records_to_write(vars.size());
+        for (size_t i = 0; i < records; ++i)
         {
             int res;
             start[0] = i;
-            if (!vars[i].empty())
+            if (i < vars.size() && !vars[i].empty())
             {
                 size_t len = vars[i].size();
                 memcpy(value, vars[i].data(), len);
@@ -441,6 +573,24 @@ struct MultiValArray : public TypedValArray<TYPE>
             this->is_constant = false;
     }
 
+    void merge(const ValArray& other, unsigned offset) override
+    {
+        const MultiValArray<TYPE>& o = dynamic_cast<const MultiValArray<TYPE>&>(other);
+        if (o.arrs.empty())
+            return;
+
+        if (offset + o.arrs.size() > arrs.size())
+            arrs.resize(offset + o.arrs.size());
+        for (size_t i = 0; i < o.arrs.size(); ++i)
+        {
+            vector<TYPE>& dest = arrs[offset + i];
+            dest.insert(dest.end(), o.arrs[i].begin(), o.arrs[i].end());
+        }
+
+        if (this->is_constant && (!o.is_constant || o.last_val != last_val))
+            this->is_constant = false;
+    }
+
     Var get_var(unsigned bufr_idx, unsigned rep=0) const override
     {
         Var res(this->info);
@@ -449,6 +599,32 @@ struct MultiValArray : public TypedValArray<TYPE>
         return res;
     }
 
+    const LoopInfo* get_loopinfo() const override { return &loopinfo; }
+
+    void get_attributes(Attributes& out) const override
+    {
+        TypedValArray<TYPE>::get_attributes(out);
+
+        // Only set to non-const if it changes across BUFRs
+        string dimlenname = "_constant";
+        if (this->loopinfo.var && !this->loopinfo.var->is_constant)
+            dimlenname = this->loopinfo.var->name;
+        out.push_back(Attribute::make_text("dim1_length", dimlenname));
+    }
+
+    void collect(size_t first, size_t count, ColumnData& out) const override
+    {
+        out.reset(value_type_of<TYPE>());
+        std::vector<TYPE>& values = column_values<TYPE>(out);
+        out.offsets.reserve(count + 1);
+        for (size_t i = first; i < first + count; ++i)
+        {
+            if (i < arrs.size())
+                values.insert(values.end(), arrs[i].begin(), arrs[i].end());
+            out.offsets.push_back(values.size());
+        }
+    }
+
     size_t get_size() const override
     {
         return arrs.size();
@@ -466,6 +642,33 @@ struct MultiValArray : public TypedValArray<TYPE>
         return res;
     }
 
+    size_t get_stored_count() const override
+    {
+        size_t res = 0;
+        for (const auto& a: arrs)
+            res += a.size();
+        return res;
+    }
+
+    size_t get_missing_count() const override
+    {
+        size_t res = 0;
+        for (const auto& a: arrs)
+            res += std::count(a.begin(), a.end(), nc_fill<TYPE>());
+        return res;
+    }
+
+    size_t get_rep_count(size_t bufr_idx) const override
+    {
+        return bufr_idx < arrs.size() ? arrs[bufr_idx].size() : 0;
+    }
+
+    size_t heap_size() const override
+    {
+        return sizeof(*this) + this->common_heap_size()
+             + heap_size_of(arrs) + heap_size_of(last_val);
+    }
+
     bool define(NCOutfile& outfile) override
     {
         // Skip variable if it's never been found
@@ -504,19 +707,10 @@ struct MultiNumberValArray : public MultiValArray<TYPE>
         if (!MultiValArray<TYPE>::define(outfile))
             return false;
 
-        int ncid = outfile.ncid;
-
         int dims[] = { outfile.dim_bufr_records, this->loopinfo.nc_dimid };
         this->nc_varid = outfile.def_var(this->name.c_str(), get_nc_type<TYPE>(), 2, dims);
 
-        this->add_common_attributes(ncid);
-
-        // Only set to non-const if it changes across BUFRs
-        string dimlenname = "_constant";
-        if (this->loopinfo.var && !this->loopinfo.var->is_constant)
-            dimlenname = this->loopinfo.var->name;
-        int res = nc_put_att_text(ncid, this->nc_varid, "dim1_length", dimlenname.size(), dimlenname.data());
-        error_netcdf::throwf_iferror(res, "setting dim1_length attribute for %s", this->name.c_str());
+        this->add_common_attributes(outfile);
 
         return true;
     }
@@ -526,10 +720,19 @@ struct MultiNumberValArray : public MultiValArray<TYPE>
      * to its data.
      *
      * Else, copy its values to \a storage, padding with fill values, and
-     * returns \a storage
+     * returns \a storage.
+     *
+     * If arr_idx is past the end of arrs, \a storage is filled entirely with
+     * fill values.
      */
     const TYPE* to_fixed_array(size_t arr_idx, TYPE* storage, size_t storage_size) const
     {
+        if (arr_idx >= this->arrs.size())
+        {
+            for (size_t i = 0; i < storage_size; ++i)
+                storage[i] = nc_fill<TYPE>();
+            return storage;
+        }
         const vector<TYPE>& vals = this->arrs[arr_idx];
 #ifdef HAVE_VECTOR_DATA
         if (vals.size() < storage_size)
@@ -564,7 +767,8 @@ struct MultiIntValArray : public MultiNumberValArray<int>
         size_t count[] = {1, arrsize};
         sys::TempBuffer<int> clean_vals(arrsize);
 
-        for (unsigned i = 0; i < arrs.size(); ++i)
+        size_t records = outfile.records_to_write(arrs.size());
+        for (unsigned i = 0; i < records; ++i)
         {
             const int* to_nc = to_fixed_array(i, clean_vals, arrsize);
             start[0] = i;
@@ -588,7 +792,8 @@ struct MultiFloatValArray : public MultiNumberValArray<float>
         size_t count[] = {1, arrsize};
         sys::TempBuffer<float> clean_vals(arrsize);
 
-        for (unsigned i = 0; i < arrs.size(); ++i)
+        size_t records = outfile.records_to_write(arrs.size());
+        for (unsigned i = 0; i < records; ++i)
         {
             const float* to_nc = to_fixed_array(i, clean_vals, arrsize);
             start[0] = i;
@@ -612,7 +817,8 @@ struct MultiDoubleValArray : public MultiNumberValArray<double>
         size_t count[] = {1, arrsize};
         sys::TempBuffer<double> clean_vals(arrsize);
 
-        for (unsigned i = 0; i < arrs.size(); ++i)
+        size_t records = outfile.records_to_write(arrs.size());
+        for (unsigned i = 0; i < records; ++i)
         {
             const double* to_nc = to_fixed_array(i, clean_vals, arrsize);
             start[0] = i;
@@ -641,14 +847,7 @@ struct MultiStringValArray : public MultiValArray<std::string>
 
         nc_varid = outfile.def_var(name.c_str(), NC_CHAR, 3, dims);
 
-        add_common_attributes(ncid);
-
-        // Only set to non-const if it changes across BUFRs
-        string dimlenname = "_constant";
-        if (this->loopinfo.var && !this->loopinfo.var->is_constant)
-            dimlenname = this->loopinfo.var->name;
-        res = nc_put_att_text(ncid, this->nc_varid, "dim1_length", dimlenname.size(), dimlenname.data());
-        error_netcdf::throwf_iferror(res, "setting dim1_length attribute for %s", this->name.c_str());
+        add_common_attributes(outfile);
 
         return true;
     }
@@ -665,9 +864,11 @@ struct MultiStringValArray : public MultiValArray<std::string>
         memset(missing, NC_FILL_CHAR, info->len);
 
         sys::TempBuffer<char> value(info->len); // Space-padded value
-        for (size_t i = 0; i < arrs.size(); ++i)
+        const vector<string> no_values;
+        size_t records = outfile.records_to_write(arrs.size());
+        for (size_t i = 0; i < records; ++i)
         {
-            const vector<string>& v = arrs[i];
+            const vector<string>& v = i < arrs.size() ? arrs[i] : no_values;
             start[0] = i;
             for (size_t j = 0; j < arrsize; ++j)
             {
@@ -23,6 +23,7 @@
 #define B2NC_VALARRAY_H
 
 #include "namer.h"
+#include "column.h"
 #include <wreport/varinfo.h>
 #include <string>
 #include <vector>
@@ -56,6 +57,9 @@ struct LoopInfo
     LoopInfo()
         : var(0), index(0), nc_dimid(-1) {}
 
+    /// Name of the loop dimension
+    std::string dim_name() const;
+
     void define(NCOutfile& outfile, size_t size);
 };
 
@@ -86,10 +90,67 @@ struct ValArray
     /// Returns the maximum number of repetition instances found
     virtual size_t get_max_rep() const = 0;
 
+    /**
+     * Returns the number of values stored, before padding records to
+     * get_max_rep() values and the array to the number of output records
+     */
+    virtual size_t get_stored_count() const = 0;
+
+    /**
+     * Returns the number of stored values that are missing, including those
+     * added to fill records where the variable was not found
+     */
+    virtual size_t get_missing_count() const = 0;
+
+    /**
+     * Returns the number of cells written for the array in an output of
+     * \a records records, including the padding of records to get_max_rep()
+     * values and of the array to the number of records
+     */
+    size_t written_cells(size_t records) const;
+
+    /// Returns the number of repetition instances stored for a record
+    virtual size_t get_rep_count(size_t bufr_idx) const { return bufr_idx < get_size() ? 1 : 0; }
+
+    /**
+     * Returns the heap memory used by the array, including the array object
+     * itself and the unused capacity of its buffers
+     */
+    virtual size_t heap_size() const = 0;
+
     /// Returns true if the array contains some defined values, false if it's
     /// all undefined values
     virtual bool has_values() const = 0;
 
+    /// Returns the type of the values in the array
+    virtual ValType value_type() const = 0;
+
+    /// Returns the loop of replicated variables, or NULL if not replicated
+    virtual const LoopInfo* get_loopinfo() const { return nullptr; }
+
+    /**
+     * Append the attributes of the output variable to \a out
+     */
+    virtual void get_attributes(Attributes& out) const = 0;
+
+    /**
+     * Store the values of \a count records starting from \a first into
+     * \a out, which is reset first.
+     *
+     * Records past the end of the array are returned as missing.
+     */
+    virtual void collect(size_t first, size_t count, ColumnData& out) const = 0;
+
+    /**
+     * Add the values of \a other, an array of the same kind built from an
+     * identical plan, with their record indices shifted by \a offset.
+     *
+     * The result is the same as if the values had been added to this array
+     * directly. This is used to join arrays filled in parallel from different
+     * ranges of subsets.
+     */
+    virtual void merge(const ValArray& other, unsigned offset) = 0;
+
     virtual bool define(NCOutfile& outfile) = 0;
     virtual void putvar(NCOutfile& outfile) const = 0;
 
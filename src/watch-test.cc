@@ -0,0 +1,165 @@
+/*
+ * Copyright (C) 2026  ARPA-SIM <urpsim@smr.arpa.emr.it>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#include "watch.h"
+#include "options.h"
+#include "tests/tests.h"
+#include <wreport/utils/sys.h>
+#include <thread>
+#include <vector>
+#include <dirent.h>
+#include <unistd.h>
+
+using namespace b2nc;
+using namespace wreport;
+using namespace wreport::tests;
+using namespace std;
+
+namespace {
+
+static const char* indir = "test-watch-in";
+static const char* outdir = "test-watch-out";
+
+/// Recreate the test directories
+void reset_dirs()
+{
+    sys::rmtree_ifexists(indir);
+    sys::rmtree_ifexists(outdir);
+    sys::makedirs(indir);
+    sys::makedirs(outdir);
+}
+
+/// List the contents of a directory, including hidden files
+vector<string> list_dir(const std::string& pathname)
+{
+    vector<string> res;
+    DIR* dir = opendir(pathname.c_str());
+    if (!dir)
+        error_system::throwf("cannot open directory %s", pathname.c_str());
+    while (struct dirent* e = readdir(dir))
+    {
+        string name = e->d_name;
+        if (name == "." || name == "..") continue;
+        res.push_back(name);
+    }
+    closedir(dir);
+    return res;
+}
+
+class Tests : public TestCase
+{
+    using TestCase::TestCase;
+
+    void register_tests() override
+    {
+        add_method("convert", []() {
+            reset_dirs();
+            Options opts;
+            Watcher watcher(opts, outdir);
+            wassert_true(watcher.convert(b2nc::tests::datafile("bufr/cdfin_acars")));
+
+            vector<string> outputs = list_dir(outdir);
+            wassert_false(outputs.empty());
+            for (const auto& name: outputs)
+            {
+                wassert(actual(name).startswith("cdfin_acars-"));
+                wassert(actual(name).endswith(".nc"));
+            }
+        });
+
+        add_method("jobs", []() {
+            Options opts;
+            opts.jobs = 3;
+            Watcher watcher(opts, outdir);
+            // Each file is converted by one thread, across opts.jobs workers
+            wassert(actual(watcher.worker_count()) == 3u);
+
+            opts.jobs = 0;
+            Watcher watcher1(opts, outdir);
+            wassert(actual(watcher1.worker_count()) == 1u);
+        });
+
+        add_method("failed", []() {
+            reset_dirs();
+
+            // A valid message followed by a truncated one
+            string data = sys::read_file(b2nc::tests::datafile("bufr/cdfin_acars"));
+            string fname = string(indir) + "/broken";
+            sys::write_file(fname, data + data.substr(0, 100));
+
+            Options opts;
+            Watcher watcher(opts, outdir);
+            wassert_false(watcher.convert(fname));
+
+            // Incomplete outputs are removed
+            wassert(actual(list_dir(outdir).size()) == 0u);
+        });
+
+        add_method("run", []() {
+            reset_dirs();
+            Options opts;
+            opts.jobs = 2;
+            Watcher watcher(opts, outdir);
+            watcher.add_directory(indir);
+            thread runner([&] { watcher.run(); });
+
+            try {
+                // Files appear in the watch directory by rename, as
+                // recommended for producers, or by writing them in place
+                string data = sys::read_file(b2nc::tests::datafile("bufr/cdfin_acars"));
+                sys::write_file(string(indir) + "/.acars.part", data);
+                sys::rename(string(indir) + "/.acars.part", string(indir) + "/acars");
+                sys::write_file(string(indir) + "/temp", sys::read_file(b2nc::tests::datafile("bufr/cdfin_temp")));
+                // Hidden files and outputs are ignored
+                sys::write_file(string(indir) + "/.hidden", data);
+                sys::write_file(string(indir) + "/output.nc", data);
+
+                // Wait for the outputs to appear
+                bool found_acars = false;
+                bool found_temp = false;
+                for (unsigned i = 0; i < 600 && !(found_acars && found_temp); ++i)
+                {
+                    usleep(100000);
+                    for (const auto& name: list_dir(outdir))
+                    {
+                        if (name.compare(0, 6, "acars-") == 0) found_acars = true;
+                        if (name.compare(0, 5, "temp-") == 0) found_temp = true;
+                    }
+                }
+                watcher.stop();
+                runner.join();
+
+                wassert_true(found_acars);
+                wassert_true(found_temp);
+                for (const auto& name: list_dir(outdir))
+                {
+                    wassert(actual(name[0]) != '.');
+                    wassert(actual(name.compare(0, 6, "output")) != 0);
+                }
+            } catch (...) {
+                if (runner.joinable())
+                {
+                    watcher.stop();
+                    runner.join();
+                }
+                throw;
+            }
+        });
+    }
+} test("watch");
+
+}
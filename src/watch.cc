@@ -0,0 +1,200 @@
+/*
+ * watch - Convert BUFR files as they are written to a directory
+ *
+ * Copyright (C) 2026  ARPA-SIM <urpsim@smr.arpa.emr.it>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#include "watch.h"
+#include "convert.h"
+#include <wreport/error.h>
+#include <wreport/utils/sys.h>
+#include <algorithm>
+#include <thread>
+#include <vector>
+#include <cerrno>
+#include <cstdio>
+#include <sys/inotify.h>
+#include <poll.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+using namespace wreport;
+using namespace std;
+
+namespace b2nc {
+
+Watcher::Watcher(const Options& opts, const std::string& outdir)
+    : opts(opts), outdir(outdir), workers(max(1u, opts.jobs))
+{
+    this->opts.atomic_output = true;
+    // Parallelism is across files
+    this->opts.jobs = 1;
+
+    inotify_fd = inotify_init1(IN_CLOEXEC | IN_NONBLOCK);
+    if (inotify_fd == -1)
+        throw error_system("cannot initialize inotify");
+    if (pipe2(stop_pipe, O_CLOEXEC | O_NONBLOCK) == -1)
+    {
+        ::close(inotify_fd);
+        throw error_system("cannot create pipe");
+    }
+}
+
+Watcher::~Watcher()
+{
+    ::close(inotify_fd);
+    ::close(stop_pipe[0]);
+    ::close(stop_pipe[1]);
+}
+
+void Watcher::add_directory(const std::string& pathname)
+{
+    int wd = inotify_add_watch(inotify_fd, pathname.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO | IN_ONLYDIR);
+    if (wd == -1)
+        error_system::throwf("cannot watch directory %s", pathname.c_str());
+    watches[wd] = pathname;
+}
+
+bool Watcher::is_input(const std::string& name) const
+{
+    if (name.empty() || name[0] == '.')
+        return false;
+    string ext = Outfile::backend_extension(opts.format);
+    if (name.size() >= ext.size() && name.compare(name.size() - ext.size(), ext.size(), ext) == 0)
+        return false;
+    return true;
+}
+
+bool Watcher::convert(const std::string& pathname)
+{
+    return convert_batch(opts, { pathname }, outdir) == 0;
+}
+
+void Watcher::enqueue(const std::string& pathname)
+{
+    lock_guard<mutex> lock(queue_lock);
+    queue.push_back(pathname);
+    queue_cond.notify_one();
+}
+
+void Watcher::worker()
+{
+    while (true)
+    {
+        string pathname;
+        {
+            unique_lock<mutex> lock(queue_lock);
+            queue_cond.wait(lock, [&] { return !queue.empty() || stopping; });
+            if (queue.empty())
+                return;
+            pathname = queue.front();
+            queue.pop_front();
+        }
+        convert(pathname);
+    }
+}
+
+void Watcher::stop()
+{
+    // write(2) is async-signal-safe; if the pipe is full, a stop is already
+    // pending
+    char c = 0;
+    ssize_t res = write(stop_pipe[1], &c, 1);
+    (void)res;
+}
+
+void Watcher::run()
+{
+    {
+        lock_guard<mutex> lock(queue_lock);
+        stopping = false;
+    }
+
+    vector<thread> threads;
+    for (unsigned i = 0; i < workers; ++i)
+        threads.emplace_back([this] { worker(); });
+    // Let the workers finish the queue, and wait for them
+    auto join_workers = [&] {
+        {
+            lock_guard<mutex> lock(queue_lock);
+            stopping = true;
+            queue_cond.notify_all();
+        }
+        for (auto& t: threads)
+            t.join();
+    };
+
+    // Events are aligned to struct inotify_event
+    alignas(struct inotify_event) char buf[4096];
+    pollfd fds[2];
+    fds[0].fd = inotify_fd;
+    fds[0].events = POLLIN;
+    fds[1].fd = stop_pipe[0];
+    fds[1].events = POLLIN;
+    try {
+        while (true)
+        {
+            if (poll(fds, 2, -1) == -1)
+            {
+                if (errno == EINTR) continue;
+                throw error_system("cannot wait for inotify events");
+            }
+
+            if (fds[1].revents)
+            {
+                // Drain the stop requests
+                char c;
+                while (read(stop_pipe[0], &c, 1) > 0)
+                    ;
+                break;
+            }
+
+            if (!fds[0].revents)
+                continue;
+
+            while (true)
+            {
+                ssize_t len = read(inotify_fd, buf, sizeof(buf));
+                if (len == -1)
+                {
+                    if (errno == EAGAIN || errno == EINTR) break;
+                    throw error_system("cannot read inotify events");
+                }
+                for (char* p = buf; p < buf + len; )
+                {
+                    const struct inotify_event* ev = (const struct inotify_event*)p;
+                    p += sizeof(struct inotify_event) + ev->len;
+
+                    if (ev->mask & IN_Q_OVERFLOW)
+                        fprintf(stderr, "inotify event queue overflow: some files may not have been converted\n");
+                    if (!(ev->mask & (IN_CLOSE_WRITE | IN_MOVED_TO)) || (ev->mask & IN_ISDIR) || !ev->len)
+                        continue;
+                    auto w = watches.find(ev->wd);
+                    if (w == watches.end() || !is_input(ev->name))
+                        continue;
+                    enqueue(w->second + "/" + ev->name);
+                }
+            }
+        }
+    } catch (...) {
+        join_workers();
+        throw;
+    }
+
+    join_workers();
+}
+
+}
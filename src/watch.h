@@ -0,0 +1,116 @@
+/*
+ * watch - Convert BUFR files as they are written to a directory
+ *
+ * Copyright (C) 2026  ARPA-SIM <urpsim@smr.arpa.emr.it>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#ifndef B2NC_WATCH_H
+#define B2NC_WATCH_H
+
+#include "options.h"
+#include <condition_variable>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <string>
+
+namespace b2nc {
+
+/**
+ * Long running converter, that watches directories with inotify and converts
+ * each file that is closed after writing or moved into them.
+ *
+ * Files are converted by a pool of Options::jobs worker threads, each
+ * conversion using a single thread. Tables and conversion plans stay cached
+ * in memory across conversions.
+ *
+ * The outputs of a file are written to the output directory, named with
+ * output_fname() as in --batch mode: the name of the file, without its
+ * directory, plus the extension of the output format. They only appear there
+ * once complete (see Options::atomic_output).
+ *
+ * Hidden files and files with the extension of the output format are
+ * ignored.
+ */
+class Watcher
+{
+protected:
+    /// Options used for all conversions
+    Options opts;
+    std::string outdir;
+    /// Number of worker threads
+    unsigned workers;
+    int inotify_fd = -1;
+    /// Pipe used to wake up run() from stop()
+    int stop_pipe[2] = { -1, -1 };
+    /// Watched directory for each inotify watch descriptor
+    std::map<int, std::string> watches;
+
+    std::mutex queue_lock;
+    std::condition_variable queue_cond;
+    std::deque<std::string> queue;
+    bool stopping = false;
+
+    /// Check if a file in a watched directory should be converted
+    bool is_input(const std::string& name) const;
+
+    /// Take files from the queue and convert them, until stopping is set
+    void worker();
+
+public:
+    /**
+     * @param opts
+     *   Conversion options: out_fname is ignored, and jobs is the number of
+     *   worker threads.
+     * @param outdir
+     *   Directory where outputs are written
+     */
+    Watcher(const Options& opts, const std::string& outdir);
+    ~Watcher();
+
+    /// Watch a directory
+    void add_directory(const std::string& pathname);
+
+    /**
+     * Convert files as they appear, until stop() is called.
+     *
+     * Files already queued are converted before returning.
+     */
+    void run();
+
+    /**
+     * Make run() return. It is safe to call this from a signal handler.
+     */
+    void stop();
+
+    /// Number of files converted at the same time by run()
+    unsigned worker_count() const { return workers; }
+
+    /// Add a file to the conversion queue
+    void enqueue(const std::string& pathname);
+
+    /**
+     * Convert one file, as a batch of one with convert_batch(), so that
+     * watch and --batch mode name and write outputs in the same way.
+     *
+     * Errors are reported on standard error, and false is returned.
+     */
+    bool convert(const std::string& pathname);
+};
+
+}
+
+#endif
@@ -0,0 +1,98 @@
+/*
+ * Copyright (C) 2026  ARPA-SIM <urpsim@smr.arpa.emr.it>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#include "zarr.h"
+#include "convert.h"
+#include "options.h"
+#include "tests/tests.h"
+#include <wreport/utils/sys.h>
+
+using namespace b2nc;
+using namespace wreport;
+using namespace wreport::tests;
+using namespace std;
+
+namespace {
+
+static const char* testdir = "test-zarr.zarr";
+
+void convert(const Options& opts, const std::string& testname)
+{
+    unique_ptr<Outfile> outfile = Outfile::get(opts);
+    outfile->open(testdir);
+    read_bufr(b2nc::tests::datafile("bufr/" + testname), *outfile);
+    outfile->close();
+}
+
+class Tests : public TestCase
+{
+    using TestCase::TestCase;
+
+    void register_tests() override
+    {
+        add_method("registry", []() {
+            wassert(actual(Outfile::backend_extension("netcdf")) == ".nc");
+            wassert(actual(Outfile::backend_extension("zarr")) == ".zarr");
+            wassert_throws(error_notfound, Outfile::backend_extension("foo"));
+
+            Outfile::register_backend("test", ".test", make_zarr_outfile);
+            wassert(actual(Outfile::backend_extension("test")) == ".test");
+            Outfile::unregister_backend("test");
+            wassert_throws(error_notfound, Outfile::backend_extension("test"));
+        });
+
+        add_method("synop", []() {
+            Options opts;
+            opts.format = "zarr";
+            convert(opts, "cdfin_synop");
+
+            wassert(actual(sys::read_file(string(testdir) + "/.zgroup")) == "{\"zarr_format\":2}");
+            string zmetadata = sys::read_file(string(testdir) + "/.zmetadata");
+            wassert(actual(zmetadata).contains("\"MII/.zarray\""));
+            wassert(actual(zmetadata).contains("\"zarr_consolidated_format\":1"));
+
+            string zarray = sys::read_file(string(testdir) + "/edition_number/.zarray");
+            wassert(actual(zarray).contains("\"dtype\":\"<i4\""));
+            wassert(actual(zarray).contains("\"fill_value\":-2147483647"));
+            wassert(actual_file(string(testdir) + "/edition_number/0").exists());
+
+            // Attributes are the same as in NetCDF
+            string zattrs = sys::read_file(string(testdir) + "/MII/.zattrs");
+            wassert(actual(zattrs).contains("\"_ARRAY_DIMENSIONS\":[\"BUFR_records\"]"));
+            wassert(actual(zattrs).contains("\"mnemonic\":\"MII\""));
+            wassert(actual(zattrs).contains("\"dim0_length\":\"_constant\""));
+        });
+
+        add_method("parallel", []() {
+            // Output does not depend on the number of threads
+            Options opts;
+            opts.format = "zarr";
+            opts.zarr_chunk_records = 2;
+            convert(opts, "cdfin_temp");
+            string chunk = sys::read_file(string(testdir) + "/MPN/0.0");
+            string zarray = sys::read_file(string(testdir) + "/MPN/.zarray");
+            wassert(actual(zarray).contains("\"chunks\":[2,"));
+
+            opts.jobs = 4;
+            convert(opts, "cdfin_temp");
+            wassert(actual(sys::read_file(string(testdir) + "/MPN/0.0")) == chunk);
+            wassert(actual(sys::read_file(string(testdir) + "/MPN/.zarray")) == zarray);
+        });
+    }
+} tests("zarr");
+
+}
@@ -0,0 +1,375 @@
+/*
+ * zarr - Write converted data as a Zarr v2 directory store
+ *
+ * Copyright (C) 2026  ARPA-SIM <urpsim@smr.arpa.emr.it>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#include "zarr.h"
+#include "columnio.h"
+#include "convert.h"
+#include "arrays.h"
+#include "options.h"
+#include "instruments.h"
+#include "json.h"
+#include "stats.h"
+#include "threads.h"
+#include "trace.h"
+#include "config.h"
+#include <wreport/error.h>
+#include <wreport/bulletin.h>
+#include <wreport/utils/sys.h>
+#include <netcdf.h>
+#include <cstring>
+#ifdef HAVE_ZLIB
+#include <zlib.h>
+#endif
+
+using namespace wreport;
+using namespace std;
+
+namespace b2nc {
+
+namespace {
+
+/// Size in bytes of one element of a column
+size_t element_size(const Column& col)
+{
+    switch (col.type)
+    {
+        case VT_INT: return sizeof(int);
+        case VT_FLOAT: return sizeof(float);
+        case VT_DOUBLE: return sizeof(double);
+        case VT_STRING: return col.strlen;
+        case VT_BYTES: return 1;
+    }
+    return 0;
+}
+
+/// Number of elements in each record of a column
+size_t record_elements(const Column& col)
+{
+    size_t res = col.loop_size;
+    if (col.type == VT_BYTES)
+        res *= col.strlen;
+    return res;
+}
+
+void add_fill_value(JSONWriter& out, const Column& col)
+{
+    switch (col.type)
+    {
+        case VT_INT: out.add(NC_FILL_INT); break;
+        case VT_FLOAT: out.add(NC_FILL_FLOAT); break;
+        case VT_DOUBLE: out.add(NC_FILL_DOUBLE); break;
+        // Base64 encoding of the empty string
+        case VT_STRING: out.add(""); break;
+        case VT_BYTES: out.add((int)NC_FILL_BYTE); break;
+    }
+}
+
+/// Shape of a column with the given number of records
+std::vector<size_t> column_shape(const Column& col, size_t records)
+{
+    std::vector<size_t> res { records };
+    if (!col.loop_dim.empty())
+        res.push_back(col.loop_size);
+    if (col.type == VT_BYTES)
+        res.push_back(col.strlen);
+    return res;
+}
+
+/**
+ * Write an output file as a Zarr v2 store.
+ *
+ * Data is accumulated by an NCFiller, and everything is written on close().
+ */
+struct ZarrOutfile : public Outfile
+{
+    const Options& opts;
+    NCFiller filler;
+    std::string dirname;
+
+    explicit ZarrOutfile(const Options& opts)
+        : opts(opts), filler(opts)
+    {
+    }
+
+    ~ZarrOutfile()
+    {
+        close();
+    }
+
+    void open(const std::string& fname) override
+    {
+        dirname = fname;
+        sys::rmtree_ifexists(dirname);
+        sys::makedirs(dirname);
+    }
+
+    void close() override
+    {
+        if (dirname.empty())
+            return;
+        // Do not try to write things out again in the destructor in case of
+        // errors
+        std::string dir = dirname;
+        dirname.clear();
+        write(dir);
+    }
+
+    void add_bufr(std::unique_ptr<wreport::BufrBulletin>&& bulletin, const std::string& raw) override
+    {
+        filler.add(move(bulletin), raw);
+    }
+
+    void set_stats(KeyStats* stats) override
+    {
+        filler.set_stats(stats);
+    }
+
+    void memory_usage(MemoryUsage& out) const override
+    {
+        filler.memory_usage(out);
+    }
+
+    void sparsity(OutputSparsity& out) const override
+    {
+        filler.sparsity(out);
+    }
+
+    size_t chunk_records() const
+    {
+        return opts.zarr_chunk_records ? opts.zarr_chunk_records : 1;
+    }
+
+    void write_zarray(JSONWriter& out, const Column& col, size_t records) const
+    {
+        out.start_mapping();
+        out.add("zarr_format", 2);
+        out.add_cstring("shape");
+        out.start_list();
+        for (size_t s: column_shape(col, records))
+            out.add(s);
+        out.end_list();
+        out.add_cstring("chunks");
+        out.start_list();
+        for (size_t s: column_shape(col, chunk_records()))
+            out.add(s);
+        out.end_list();
+        out.add("dtype", numpy_dtype(col));
+        out.add_cstring("compressor");
+#ifdef HAVE_ZLIB
+        out.start_mapping();
+        out.add("id", "zlib");
+        out.add("level", 6);
+        out.end_mapping();
+#else
+        out.add_null();
+#endif
+        out.add_cstring("fill_value");
+        add_fill_value(out, col);
+        out.add("order", "C");
+        out.add_cstring("filters");
+        out.add_null();
+        out.add("dimension_separator", ".");
+        out.end_mapping();
+    }
+
+    void write_zattrs(JSONWriter& out, const Column& col) const
+    {
+        out.start_mapping();
+        // Dimension names, as used by xarray
+        out.add_cstring("_ARRAY_DIMENSIONS");
+        out.start_list();
+        out.add("BUFR_records");
+        if (!col.loop_dim.empty())
+            out.add(col.loop_dim);
+        if (col.type == VT_BYTES)
+            out.add(col.strlen_dim);
+        out.end_list();
+        for (const auto& attr: col.attributes)
+        {
+            // Represented by fill_value in .zarray
+            if (attr.name == "_FillValue") continue;
+            out.add_string(attr.name);
+            add_attribute_value(out, attr);
+        }
+        out.end_mapping();
+    }
+
+    /// Encode the values of one chunk as a C-ordered array
+    void encode_chunk(const Column& col, const ColumnData& data, std::string& out) const
+    {
+        size_t elsize = element_size(col);
+        size_t per_record = record_elements(col);
+        size_t rowsize = per_record * elsize;
+        out.assign(chunk_records() * rowsize, 0);
+
+        char* buf = &out[0];
+        for (size_t r = 0; r < chunk_records(); ++r)
+        {
+            char* row = buf + r * rowsize;
+            size_t begin = r < data.records() ? data.offsets[r] : 0;
+            size_t end = r < data.records() ? data.offsets[r + 1] : 0;
+            if (end - begin > col.loop_size)
+                end = begin + col.loop_size;
+            switch (col.type)
+            {
+                case VT_INT:
+                    for (size_t i = 0; i < per_record; ++i)
+                    {
+                        int val = begin + i < end ? data.ints[begin + i] : NC_FILL_INT;
+                        memcpy(row + i * elsize, &val, elsize);
+                    }
+                    break;
+                case VT_FLOAT:
+                    for (size_t i = 0; i < per_record; ++i)
+                    {
+                        float val = begin + i < end ? data.floats[begin + i] : NC_FILL_FLOAT;
+                        memcpy(row + i * elsize, &val, elsize);
+                    }
+                    break;
+                case VT_DOUBLE:
+                    for (size_t i = 0; i < per_record; ++i)
+                    {
+                        double val = begin + i < end ? data.doubles[begin + i] : NC_FILL_DOUBLE;
+                        memcpy(row + i * elsize, &val, elsize);
+                    }
+                    break;
+                case VT_STRING:
+                    // NUL padded, and missing values are all NULs
+                    for (size_t i = begin; i < end; ++i)
+                    {
+                        const string& val = data.strings[i];
+                        memcpy(row + (i - begin) * elsize, val.data(), min(val.size(), elsize));
+                    }
+                    break;
+                case VT_BYTES: {
+                    // Fill padded like in NetCDF
+                    memset(row, NC_FILL_BYTE, rowsize);
+                    if (begin < end)
+                    {
+                        const string& val = data.strings[begin];
+                        memcpy(row, val.data(), min(val.size(), rowsize));
+                    }
+                    break;
+                }
+            }
+        }
+    }
+
+    void compress(std::string& buf) const
+    {
+#ifdef HAVE_ZLIB
+        uLongf size = compressBound(buf.size());
+        std::string res(size, 0);
+        int zres = compress2((Bytef*)&res[0], &size, (const Bytef*)buf.data(), buf.size(), 6);
+        if (zres != Z_OK)
+            error_consistency::throwf("zlib compression failed with code %d", zres);
+        res.resize(size);
+        buf.swap(res);
+#endif
+    }
+
+    void write(const std::string& dir) const
+    {
+        TraceSpan span(instruments(opts).trace, "write", dir);
+        std::vector<Column> columns;
+        filler.columns(columns);
+        size_t records = filler.record_count();
+        filler.count_stats();
+        size_t chunks = records ? (records + chunk_records() - 1) / chunk_records() : 0;
+
+        // Metadata
+        std::string zmetadata;
+        JSONWriter consolidated(zmetadata);
+        consolidated.start_mapping();
+        consolidated.add_cstring("metadata");
+        consolidated.start_mapping();
+
+        std::string buf;
+        JSONWriter group(buf);
+        group.start_mapping();
+        group.add("zarr_format", 2);
+        group.end_mapping();
+        sys::write_file(dir + "/.zgroup", buf);
+        sys::write_file(dir + "/.zattrs", "{}");
+        consolidated.add_cstring(".zgroup");
+        consolidated.start_mapping();
+        consolidated.add("zarr_format", 2);
+        consolidated.end_mapping();
+        consolidated.add_cstring(".zattrs");
+        consolidated.start_mapping();
+        consolidated.end_mapping();
+
+        for (const auto& col: columns)
+        {
+            std::string coldir = dir + "/" + col.name;
+            sys::makedirs(coldir);
+
+            buf.clear();
+            JSONWriter zarray(buf);
+            write_zarray(zarray, col, records);
+            sys::write_file(coldir + "/.zarray", buf);
+
+            buf.clear();
+            JSONWriter zattrs(buf);
+            write_zattrs(zattrs, col);
+            sys::write_file(coldir + "/.zattrs", buf);
+
+            consolidated.add_string(col.name + "/.zarray");
+            write_zarray(consolidated, col, records);
+            consolidated.add_string(col.name + "/.zattrs");
+            write_zattrs(consolidated, col);
+        }
+
+        consolidated.end_mapping();
+        consolidated.add("zarr_consolidated_format", 1);
+        consolidated.end_mapping();
+
+        // Chunks are independent, and can be encoded and written in parallel
+        parallel_for(opts.jobs, columns.size() * chunks, [&](size_t task) {
+            const Column& col = columns[task / chunks];
+            size_t chunk = task % chunks;
+            TraceSpan span(instruments(opts).trace, "putvar", instruments(opts).trace ? col.name + "/" + to_string(chunk) : std::string());
+            size_t first = chunk * chunk_records();
+            ColumnData data;
+            col.collect(first, min(chunk_records(), records - first), data);
+
+            std::string encoded;
+            encode_chunk(col, data, encoded);
+            compress(encoded);
+            if (filler.stats)
+                filler.stats->add_variable_bytes(col.name, encoded.size());
+
+            std::string fname = dir + "/" + col.name + "/" + to_string(chunk);
+            for (size_t i = 1; i < column_shape(col, records).size(); ++i)
+                fname += ".0";
+            sys::write_file(fname, encoded);
+        });
+
+        sys::write_file(dir + "/.zmetadata", zmetadata);
+    }
+};
+
+}
+
+std::unique_ptr<Outfile> make_zarr_outfile(const Options& opts)
+{
+    return unique_ptr<Outfile>(new ZarrOutfile(opts));
+}
+
+}
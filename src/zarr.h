@@ -0,0 +1,42 @@
+/*
+ * zarr - Write converted data as a Zarr v2 directory store
+ *
+ * Copyright (C) 2026  ARPA-SIM <urpsim@smr.arpa.emr.it>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#ifndef B2NC_ZARR_H
+#define B2NC_ZARR_H
+
+#include <memory>
+
+namespace b2nc {
+
+struct Options;
+struct Outfile;
+
+/**
+ * Create an Outfile that writes a Zarr v2 directory store.
+ *
+ * The store has the same variables, dimensions and attributes as the NetCDF
+ * output. Variables are chunked along BUFR_records, every
+ * Options::zarr_chunk_records records, and chunks are encoded and written in
+ * parallel using Options::jobs threads.
+ */
+std::unique_ptr<Outfile> make_zarr_outfile(const Options& opts);
+
+}
+
+#endif